@@ -0,0 +1,350 @@
+#include "asyncLog.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+int logLevel = LOG_LEVEL_DEBUG;
+unsigned int logSubsystemMask = LOG_SUBSYS_ALL;
+
+static LogRecord logRing[LOG_RING_SIZE];
+static uint64_t enqueuePosition = 0;
+static uint64_t dequeuePosition = 0;
+static uint64_t droppedRecords = 0;
+static int logInitialized = 0;
+static int logRunning = 0;
+
+static pthread_t logThread;
+static pthread_mutex_t wakeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;
+static int consumerSleeping = 0;
+
+static FILE* logOutput = NULL;
+static char logFilePath[256] = {0};
+static long logFileBytes = 0;
+
+static const char* levelNames[] = {"error", "warn", "info", "debug", "trace"};
+
+static const struct {
+    const char* name;
+    unsigned int bit;
+} subsystemNames[] = {
+    {"net", LOG_SUBSYS_NET},
+    {"filter", LOG_SUBSYS_FILTER},
+    {"rate", LOG_SUBSYS_RATE},
+    {"action", LOG_SUBSYS_ACTION},
+    {"avatar", LOG_SUBSYS_AVATAR},
+    {NULL, 0}
+};
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Bounded MPMC queue (Vyukov): producers claim a cell with one CAS and
+// publish it through the cell's sequence number; a full ring drops
+void logRecord(LogLevel level, unsigned int subsystem, LogEventId event, const char* text,
+               int64_t a0, int64_t a1, int64_t a2, int64_t a3) {
+    if (!__atomic_load_n(&logInitialized, __ATOMIC_ACQUIRE)) return;
+    
+    uint64_t position = __atomic_load_n(&enqueuePosition, __ATOMIC_RELAXED);
+    LogRecord* cell;
+    
+    for (;;) {
+        cell = &logRing[position & (LOG_RING_SIZE - 1)];
+        uint64_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)sequence - (int64_t)position;
+        
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueuePosition, &position, position + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&droppedRecords, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            position = __atomic_load_n(&enqueuePosition, __ATOMIC_RELAXED);
+        }
+    }
+    
+    cell->timestampNs = nowNs();
+    cell->level = (uint16_t)level;
+    cell->event = (uint16_t)event;
+    cell->subsystem = subsystem;
+    cell->args[0] = a0;
+    cell->args[1] = a1;
+    cell->args[2] = a2;
+    cell->args[3] = a3;
+    if (text) {
+        strncpy(cell->text, text, LOG_TEXT_LENGTH - 1);
+        cell->text[LOG_TEXT_LENGTH - 1] = '\0';
+    } else {
+        cell->text[0] = '\0';
+    }
+    
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+    
+    if (__atomic_load_n(&consumerSleeping, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&wakeMutex);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&wakeMutex);
+    }
+}
+
+void logMessage(LogLevel level, unsigned int subsystem, const char* text) {
+    logRecord(level, subsystem, LOG_EVENT_MESSAGE, text, 0, 0, 0, 0);
+}
+
+static void rotateLogFile(void) {
+    if (!logFilePath[0]) return;
+    
+    fclose(logOutput);
+    
+    char from[300], to[300];
+    for (int i = LOG_ROTATE_KEEP - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", logFilePath, i);
+        snprintf(to, sizeof(to), "%s.%d", logFilePath, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", logFilePath);
+    rename(logFilePath, to);
+    
+    logOutput = fopen(logFilePath, "a");
+    if (!logOutput) {
+        logOutput = stdout;
+        logFilePath[0] = '\0';
+    }
+    logFileBytes = 0;
+}
+
+static void formatRecord(const LogRecord* record) {
+    char line[512];
+    int length;
+    const int64_t* a = record->args;
+    
+    switch (record->event) {
+        case LOG_EVENT_PACKET_RECEIVED: {
+            char srcIP[INET_ADDRSTRLEN];
+            struct in_addr address;
+            address.s_addr = (in_addr_t)a[0];
+            inet_ntop(AF_INET, &address, srcIP, sizeof(srcIP));
+            length = snprintf(line, sizeof(line), "Received message: %s\nFrom IP: %s, Port: %d\n",
+                              record->text, srcIP, (int)a[1]);
+            break;
+        }
+        case LOG_EVENT_PACKET_MALFORMED:
+            length = snprintf(line, sizeof(line), "Ignoring malformed OSC packet (%lld bytes)\n",
+                              (long long)a[0]);
+            break;
+        case LOG_EVENT_FILTER_MATCH:
+            length = snprintf(line, sizeof(line), "FILTER MATCH: '%s' (Count: %lld, LastExec: %lld, Rate: %lldc/%llds)\n",
+                              record->text, (long long)a[0], (long long)a[1], (long long)a[2], (long long)a[3]);
+            break;
+        case LOG_EVENT_RATE_CHECK:
+            length = snprintf(line, sizeof(line),
+                              "Rate limit check: Count diff=%lld (need >=%lld, %s), Time diff=%.1fs (need >=%llds, %s)\n",
+                              (long long)a[0], (long long)a[1], ((a[3] >> 32) & 1) ? "OK" : "BLOCKED",
+                              a[2] / 1000.0, (long long)(uint32_t)a[3], ((a[3] >> 33) & 1) ? "OK" : "BLOCKED");
+            break;
+        case LOG_EVENT_ACTION_EXECUTED:
+            length = snprintf(line, sizeof(line), "Executing action (rate limits OK): %s\n", record->text);
+            break;
+        case LOG_EVENT_ACTION_RATE_LIMITED:
+            length = snprintf(line, sizeof(line), "Action RATE LIMITED (%lldc/%llds): %s\n",
+                              (long long)a[0], (long long)a[1], record->text);
+            break;
+        case LOG_EVENT_AVATAR_CHANGED:
+            length = snprintf(line, sizeof(line), "Avatar changed: %s (%lld profile filters)\n",
+                              record->text, (long long)a[0]);
+            break;
+        case LOG_EVENT_GESTURE_DROPPED:
+            length = snprintf(line, sizeof(line), "Long press on '%s' not tracked (%lld ms): timer wheel unavailable\n",
+                              record->text, (long long)a[0]);
+            break;
+        default:
+            length = snprintf(line, sizeof(line), "%s\n", record->text);
+            break;
+    }
+    
+    if (length <= 0) return;
+    if (length >= (int)sizeof(line)) length = sizeof(line) - 1;
+    
+    if (logOutput != stdout) {
+        // Files get a timestamp and level prefix; the console keeps the
+        // original unprefixed output
+        time_t seconds = (time_t)(record->timestampNs / 1000000000ULL);
+        struct tm tmInfo;
+        char timeStr[32];
+        localtime_r(&seconds, &tmInfo);
+        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &tmInfo);
+        logFileBytes += fprintf(logOutput, "%s.%06llu [%s] ", timeStr,
+                                (unsigned long long)(record->timestampNs % 1000000000ULL / 1000),
+                                levelNames[record->level < 5 ? record->level : 4]);
+    }
+    
+    fwrite(line, 1, (size_t)length, logOutput);
+    logFileBytes += length;
+    
+    if (logFilePath[0] && logFileBytes >= LOG_ROTATE_BYTES) {
+        rotateLogFile();
+    }
+}
+
+static int drainRing(void) {
+    int drained = 0;
+    
+    for (;;) {
+        LogRecord* cell = &logRing[dequeuePosition & (LOG_RING_SIZE - 1)];
+        uint64_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        
+        if (sequence != dequeuePosition + 1) break;
+        
+        formatRecord(cell);
+        __atomic_store_n(&cell->sequence, dequeuePosition + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        dequeuePosition++;
+        drained++;
+    }
+    
+    if (drained > 0) {
+        fflush(logOutput);
+    }
+    return drained;
+}
+
+static void *logThreadLoop(void *arg) {
+    (void)arg;
+    
+    while (__atomic_load_n(&logRunning, __ATOMIC_ACQUIRE)) {
+        if (drainRing() > 0) continue;
+        
+        pthread_mutex_lock(&wakeMutex);
+        __atomic_store_n(&consumerSleeping, 1, __ATOMIC_RELEASE);
+        
+        // Re-check after advertising sleep so a racing producer is not missed
+        LogRecord* cell = &logRing[dequeuePosition & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != dequeuePosition + 1 &&
+            __atomic_load_n(&logRunning, __ATOMIC_ACQUIRE)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&wakeCond, &wakeMutex, &deadline);
+        }
+        
+        __atomic_store_n(&consumerSleeping, 0, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&wakeMutex);
+    }
+    
+    drainRing();
+    return NULL;
+}
+
+int asyncLogStart(const char* filePath) {
+    if (logRunning) return 0;
+    
+    logOutput = stdout;
+    if (filePath && filePath[0]) {
+        FILE* file = fopen(filePath, "a");
+        if (!file) {
+            perror("Failed to open log file, logging to stdout");
+        } else {
+            logOutput = file;
+            strncpy(logFilePath, filePath, sizeof(logFilePath) - 1);
+            fseek(file, 0, SEEK_END);
+            logFileBytes = ftell(file);
+        }
+    }
+    
+    for (uint64_t i = 0; i < LOG_RING_SIZE; i++) {
+        logRing[i].sequence = i;
+    }
+    enqueuePosition = 0;
+    dequeuePosition = 0;
+    
+    logRunning = 1;
+    if (pthread_create(&logThread, NULL, logThreadLoop, NULL) != 0) {
+        perror("Failed to create log thread");
+        logRunning = 0;
+        return -1;
+    }
+    
+    __atomic_store_n(&logInitialized, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void asyncLogStop(void) {
+    if (!logRunning) return;
+    
+    __atomic_store_n(&logInitialized, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&logRunning, 0, __ATOMIC_RELEASE);
+    
+    pthread_mutex_lock(&wakeMutex);
+    pthread_cond_signal(&wakeCond);
+    pthread_mutex_unlock(&wakeMutex);
+    pthread_join(logThread, NULL);
+    
+    if (logOutput && logOutput != stdout) {
+        fclose(logOutput);
+    }
+    logOutput = NULL;
+}
+
+int parseLogLevel(const char* name) {
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(name, levelNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int parseLogSubsystems(const char* list, unsigned int* mask) {
+    if (strcmp(list, "all") == 0) {
+        *mask = LOG_SUBSYS_ALL;
+        return 0;
+    }
+    if (strcmp(list, "none") == 0) {
+        *mask = 0;
+        return 0;
+    }
+    
+    char work[256];
+    strncpy(work, list, sizeof(work) - 1);
+    work[sizeof(work) - 1] = '\0';
+    
+    unsigned int result = 0;
+    for (char* token = strtok(work, ","); token; token = strtok(NULL, ",")) {
+        int found = 0;
+        for (int i = 0; subsystemNames[i].name; i++) {
+            if (strcmp(token, subsystemNames[i].name) == 0) {
+                result |= subsystemNames[i].bit;
+                found = 1;
+                break;
+            }
+        }
+        if (!found) return -1;
+    }
+    
+    *mask = result;
+    return 0;
+}
+
+void printLogSettings(void) {
+    printf("=== Logging ===\n");
+    printf("Message printing: %s\n", messagePrintingEnabled ? "ENABLED" : "DISABLED");
+    printf("Level: %s\n", levelNames[logLevel]);
+    printf("Subsystems:");
+    for (int i = 0; subsystemNames[i].name; i++) {
+        printf(" %s=%s", subsystemNames[i].name, (logSubsystemMask & subsystemNames[i].bit) ? "on" : "off");
+    }
+    printf("\nOutput: %s\n", logFilePath[0] ? logFilePath : "stdout");
+    printf("Ring: %d records, %llu dropped\n", LOG_RING_SIZE,
+           (unsigned long long)__atomic_load_n(&droppedRecords, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,69 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdint.h>
+
+#define LOG_RING_SIZE 8192               // Power of two
+#define LOG_TEXT_LENGTH 72
+#define LOG_ROTATE_BYTES (8 * 1024 * 1024)
+#define LOG_ROTATE_KEEP 3
+
+typedef enum {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_TRACE
+} LogLevel;
+
+// Subsystem enable bits
+#define LOG_SUBSYS_NET      (1u << 0)
+#define LOG_SUBSYS_FILTER   (1u << 1)
+#define LOG_SUBSYS_RATE     (1u << 2)
+#define LOG_SUBSYS_ACTION   (1u << 3)
+#define LOG_SUBSYS_AVATAR   (1u << 4)
+#define LOG_SUBSYS_ALL      0xffffffffu
+
+typedef enum {
+    LOG_EVENT_PACKET_RECEIVED,      // text=address, a0=IPv4 (network order), a1=port, a2=bytes
+    LOG_EVENT_PACKET_MALFORMED,     // a0=bytes
+    LOG_EVENT_FILTER_MATCH,         // text=pattern, a0=count, a1=lastExecCount, a2=rateCount, a3=rateSeconds
+    LOG_EVENT_RATE_CHECK,           // a0=countDiff, a1=needCount, a2=timeDiffMs,
+                                    // a3=needSeconds | countOK << 32 | timeOK << 33
+    LOG_EVENT_ACTION_EXECUTED,      // text=action
+    LOG_EVENT_ACTION_RATE_LIMITED,  // text=action, a0=rateCount, a1=rateSeconds
+    LOG_EVENT_AVATAR_CHANGED,       // text=avatar ID, a0=profile filters
+    LOG_EVENT_GESTURE_DROPPED,      // text=pattern, a0=threshold ms
+    LOG_EVENT_MESSAGE               // text=preformatted message
+} LogEventId;
+
+// Fixed-size record; the hot path copies raw values and never formats
+typedef struct {
+    uint64_t sequence;
+    uint64_t timestampNs;
+    uint16_t level;
+    uint16_t event;
+    uint32_t subsystem;
+    int64_t args[4];
+    char text[LOG_TEXT_LENGTH];
+} LogRecord;
+
+extern int messagePrintingEnabled;
+extern int logLevel;
+extern unsigned int logSubsystemMask;
+
+// Cheap inline gate: the printing toggle plus level and subsystem filters
+#define LOG_ENABLED(level, subsystem) \
+    (messagePrintingEnabled && (int)(level) <= logLevel && (logSubsystemMask & (subsystem)))
+
+int asyncLogStart(const char* filePath);
+void asyncLogStop(void);
+void logRecord(LogLevel level, unsigned int subsystem, LogEventId event, const char* text,
+               int64_t a0, int64_t a1, int64_t a2, int64_t a3);
+void logMessage(LogLevel level, unsigned int subsystem, const char* text);
+
+int parseLogLevel(const char* name);
+int parseLogSubsystems(const char* list, unsigned int* mask);
+void printLogSettings(void);
+
+#endif
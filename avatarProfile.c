@@ -0,0 +1,206 @@
+#include "avatarProfile.h"
+#include "configCache.h"
+#include "asyncLog.h"
+#include "quiescence.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+static AvatarProfileSet profileSets[2];
+static AvatarProfileSet* publishedSet = NULL;
+static uint64_t activeAvatarHash = 0;
+static char activeAvatarId[MAX_AVATAR_ID_LENGTH] = {0};    // For display, under avatarIdMutex
+static pthread_mutex_t avatarIdMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t avatarHash(const char* avatarId) {
+    uint64_t hash = hashConfigBytes(avatarId, strlen(avatarId));
+    return hash ? hash : 1;
+}
+
+static const AvatarProfile* findProfileByHash(const AvatarProfileSet* set, uint64_t hash) {
+    for (int probe = 0; probe < AVATAR_PROFILE_SLOTS; probe++) {
+        int slot = set->slots[(hash + probe) & (AVATAR_PROFILE_SLOTS - 1)];
+        if (slot < 0) return NULL;
+        
+        const AvatarProfile* profile = &set->profiles[slot];
+        if (profile->avatarHash == hash) {
+            return profile;
+        }
+    }
+    
+    return NULL;
+}
+
+static const AvatarProfile* findProfile(const AvatarProfileSet* set, const char* avatarId) {
+    const AvatarProfile* profile = findProfileByHash(set, avatarHash(avatarId));
+    return profile && strcmp(profile->avatarId, avatarId) == 0 ? profile : NULL;
+}
+
+static AvatarProfile* addProfile(AvatarProfileSet* set, const char* avatarId) {
+    if (set->profileCount >= MAX_AVATAR_PROFILES) return NULL;
+    
+    uint64_t hash = avatarHash(avatarId);
+    AvatarProfile* profile = &set->profiles[set->profileCount];
+    
+    strcpy(profile->avatarId, avatarId);
+    profile->avatarHash = hash;
+    profile->filterCount = 0;
+    profile->boundCount = 0;
+    
+    for (int probe = 0; probe < AVATAR_PROFILE_SLOTS; probe++) {
+        int* slot = &set->slots[(hash + probe) & (AVATAR_PROFILE_SLOTS - 1)];
+        if (*slot < 0) {
+            *slot = set->profileCount;
+            break;
+        }
+    }
+    
+    set->profileCount++;
+    return profile;
+}
+
+void rebuildAvatarProfiles(void) {
+    AvatarProfileSet* set = (publishedSet == &profileSets[0]) ? &profileSets[1] : &profileSets[0];
+    
+    // The spare set was unpublished by the previous rebuild; once the
+    // matches that may still walk it are done, it can be rewritten
+    waitForReaders();
+    
+    set->globalCount = 0;
+    set->profileCount = 0;
+    set->wildcardCount = 0;
+    memset(set->slots, -1, sizeof(set->slots));
+    
+    oscPatternSetFree(set->patterns);
+    set->patterns = NULL;
+    freeMatchIndex(set->matchIndex);
+    set->matchIndex = buildMatchIndex();
+    if (!set->matchIndex) {
+        printf("Warning: Out of memory indexing exact, prefix and regex filters\n");
+    }
+    
+    static const char* wildcardPatterns[MAX_FILTERS];
+    static int wildcardIds[MAX_FILTERS];
+    
+    for (int i = 0; i < filterCount; i++) {
+        const char* avatarId = perimeterFilters[i].avatar;
+        set->boundHashes[i] = avatarId[0] ? avatarHash(avatarId) : 0;
+        
+        // Every bound avatar gets a profile, whatever its filters' kinds
+        AvatarProfile* profile = NULL;
+        if (avatarId[0]) {
+            profile = (AvatarProfile*)findProfile(set, avatarId);
+            if (!profile) profile = addProfile(set, avatarId);
+            if (profile) profile->boundCount++;
+        }
+        
+        // Other kinds are matched through an index for every avatar at
+        // once; bindings are sifted before a match is cached
+        if (perimeterFilters[i].matchKind == MATCH_WILDCARD) {
+            wildcardPatterns[set->wildcardCount] = perimeterFilters[i].pattern;
+            wildcardIds[set->wildcardCount++] = i;
+            continue;
+        }
+        if (perimeterFilters[i].matchKind != MATCH_SUBSTRING) continue;
+        
+        if (!avatarId[0]) {
+            set->globalIndices[set->globalCount++] = i;
+            continue;
+        }
+        
+        // Only the substring scan walks profiles
+        if (!profile) {
+            printf("Warning: Too many avatar profiles (max %d), ignoring filter '%s'\n",
+                   MAX_AVATAR_PROFILES, perimeterFilters[i].pattern);
+            continue;
+        }
+        profile->filterIndices[profile->filterCount++] = i;
+    }
+    
+    if (set->wildcardCount > 0) {
+        set->patterns = oscPatternSetBuild(wildcardPatterns, wildcardIds, set->wildcardCount);
+        if (!set->patterns) {
+            printf("Warning: Out of memory compiling %d wildcard filters\n", set->wildcardCount);
+        }
+    }
+    
+    __atomic_store_n(&publishedSet, set, __ATOMIC_RELEASE);
+}
+
+const AvatarProfileSet* currentAvatarProfiles(void) {
+    return __atomic_load_n(&publishedSet, __ATOMIC_ACQUIRE);
+}
+
+void selectAvatarProfile(const char* avatarId) {
+    if (!avatarId) return;
+    
+    pthread_mutex_lock(&avatarIdMutex);
+    strncpy(activeAvatarId, avatarId, MAX_AVATAR_ID_LENGTH - 1);
+    activeAvatarId[MAX_AVATAR_ID_LENGTH - 1] = '\0';
+    uint64_t hash = avatarHash(activeAvatarId);
+    pthread_mutex_unlock(&avatarIdMutex);
+    
+    __atomic_store_n(&activeAvatarHash, hash, __ATOMIC_RELEASE);
+    
+    if (LOG_ENABLED(LOG_LEVEL_INFO, LOG_SUBSYS_AVATAR)) {
+        readSectionEnter();
+        const AvatarProfileSet* set = currentAvatarProfiles();
+        const AvatarProfile* profile = set ? activeAvatarProfile(set) : NULL;
+        logRecord(LOG_LEVEL_INFO, LOG_SUBSYS_AVATAR, LOG_EVENT_AVATAR_CHANGED, avatarId,
+                  profile ? profile->boundCount : 0, 0, 0, 0);
+        readSectionLeave();
+    }
+}
+
+uint64_t currentAvatarHash(void) {
+    return __atomic_load_n(&activeAvatarHash, __ATOMIC_ACQUIRE);
+}
+
+const AvatarProfile* activeAvatarProfile(const AvatarProfileSet* set) {
+    return avatarProfileForHash(set, currentAvatarHash());
+}
+
+const AvatarProfile* avatarProfileForHash(const AvatarProfileSet* set, uint64_t hash) {
+    return hash ? findProfileByHash(set, hash) : NULL;
+}
+
+void currentAvatarId(char* avatarId, size_t size) {
+    pthread_mutex_lock(&avatarIdMutex);
+    snprintf(avatarId, size, "%s", activeAvatarId);
+    pthread_mutex_unlock(&avatarIdMutex);
+}
+
+void listAvatarProfiles(void) {
+    const AvatarProfileSet* set = currentAvatarProfiles();
+    if (!set) {
+        printf("Avatar profiles not built\n");
+        return;
+    }
+    
+    char avatarId[MAX_AVATAR_ID_LENGTH];
+    currentAvatarId(avatarId, sizeof(avatarId));
+    printf("Current avatar: %s\n", avatarId[0] ? avatarId : "(unknown)");
+    printf("Global filters: %d\n", set->globalCount);
+    if (set->matchIndex) {
+        printf("Exact filters: %d in %d hash groups, prefix filters: %d in a %d-node trie, regex filters: %d\n",
+               set->matchIndex->exactCount, set->matchIndex->exactGroupCount, set->matchIndex->prefixCount,
+               set->matchIndex->prefixNodeCount, set->matchIndex->regexCount);
+    }
+    if (set->wildcardCount > 0) {
+        printf("Wildcard filters: %d (one automaton, %d DFA states built)\n", set->wildcardCount,
+               oscPatternSetStates(set->patterns));
+    }
+    if (set->profileCount == 0) {
+        printf("No avatar profiles configured\n");
+        return;
+    }
+    
+    printf("%-48s %-8s %s\n", "Avatar ID", "Filters", "Active");
+    printf("%-48s %-8s %s\n", "---------", "-------", "------");
+    
+    const AvatarProfile* active = activeAvatarProfile(set);
+    for (int i = 0; i < set->profileCount; i++) {
+        printf("%-48s %-8d %s\n", set->profiles[i].avatarId, set->profiles[i].boundCount,
+               &set->profiles[i] == active ? "YES" : "");
+    }
+}
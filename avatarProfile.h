@@ -0,0 +1,49 @@
+#ifndef AVATAR_PROFILE_H
+#define AVATAR_PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "oscUtility.h"
+#include "oscPattern.h"
+#include "matchIndex.h"
+
+#define AVATAR_CHANGE_ADDRESS "/avatar/change"
+#define MAX_AVATAR_PROFILES 32
+#define AVATAR_PROFILE_SLOTS 64       // Power of two, > MAX_AVATAR_PROFILES
+
+// Filters bound to one avatar ID, resolved to table indices at build time
+typedef struct {
+    char avatarId[MAX_AVATAR_ID_LENGTH];
+    uint64_t avatarHash;
+    int boundCount;                   // Filters of any kind bound to it
+    int filterCount;                  // Substring filters, scanned per address
+    int filterIndices[MAX_FILTERS];
+} AvatarProfile;
+
+// Immutable once published; rebuilt into the spare set on filter changes
+typedef struct {
+    int globalCount;
+    int globalIndices[MAX_FILTERS];
+    int profileCount;
+    AvatarProfile profiles[MAX_AVATAR_PROFILES];
+    int slots[AVATAR_PROFILE_SLOTS];  // Open addressing by avatarHash, -1 = empty
+    uint64_t boundHashes[MAX_FILTERS];    // Per filter: hash of its avatar ID, 0 when global
+    int wildcardCount;                // Only substring filters are in the index lists
+    OscPatternSet* patterns;
+    MatchIndex* matchIndex;           // Exact, prefix and regex filters
+} AvatarProfileSet;
+
+void rebuildAvatarProfiles(void);
+const AvatarProfileSet* currentAvatarProfiles(void);
+// The active avatar is published as one atomic hash of its ID, 0 until
+// the first /avatar/change; sets never change once published
+void selectAvatarProfile(const char* avatarId);
+uint64_t currentAvatarHash(void);
+// NULL when the active avatar has no filters bound
+const AvatarProfile* activeAvatarProfile(const AvatarProfileSet* set);
+// The profile of the avatar with this currentAvatarHash, NULL for 0 or none
+const AvatarProfile* avatarProfileForHash(const AvatarProfileSet* set, uint64_t hash);
+void currentAvatarId(char* avatarId, size_t size);
+void listAvatarProfiles(void);
+
+#endif
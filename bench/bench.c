@@ -0,0 +1,733 @@
+#include "../oscUtility.h"
+#include "../oscMessage.h"
+#include "../keyPress.h"
+#include "../socket.h"
+#include "../metrics.h"
+#include "../histogram.h"
+#include "../outputBackend.h"
+#include "../oscPattern.h"
+#include "../avatarProfile.h"
+#include "../matchCache.h"
+#include "../oscDecode.h"
+#include "oscSynth.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define BENCH_PACKET_POOL 4096
+#define BENCH_DEFAULT_OUTPUT "bench_results.jsonl"
+
+typedef void (*BenchFunc)(void);
+
+typedef struct {
+    const char* name;
+    BenchFunc func;
+    const char* description;
+} BenchCase;
+
+static FILE* results = NULL;
+static char packetPool[BENCH_PACKET_POOL][SYNTH_MAX_PACKET];
+static size_t packetLengths[BENCH_PACKET_POOL];
+static char addressPool[BENCH_PACKET_POOL][128];
+static volatile uint64_t benchSink = 0;     // Keeps results observable to the optimizer
+
+// One JSON object per line on the results file, a readable row on stderr
+static void report(const char* name, const char* parameter, uint64_t operations, uint64_t elapsedNs,
+                   const char* extra) {
+    double nsPerOp = operations ? (double)elapsedNs / operations : 0.0;
+    double opsPerSec = elapsedNs ? operations * 1e9 / elapsedNs : 0.0;
+    
+    fprintf(results, "{\"case\":\"%s\",\"param\":\"%s\",\"ops\":%llu,\"elapsed_ns\":%llu,"
+                     "\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f%s%s}\n",
+            name, parameter, (unsigned long long)operations, (unsigned long long)elapsedNs,
+            nsPerOp, opsPerSec, extra ? "," : "", extra ? extra : "");
+    fflush(results);
+    
+    fprintf(stderr, "%-14s %-22s %12.1f ns/op %14.0f ops/s %s\n", name, parameter, nsPerOp, opsPerSec,
+            extra ? extra : "");
+}
+
+static void fillPacketPool(uint64_t seed) {
+    SynthRng rng;
+    synthSeed(&rng, seed);
+    
+    for (int i = 0; i < BENCH_PACKET_POOL; i++) {
+        packetLengths[i] = synthRandomPacket(packetPool[i], SYNTH_MAX_PACKET, &rng);
+        size_t length = strnlen(packetPool[i], sizeof(addressPool[i]) - 1);
+        memcpy(addressPool[i], packetPool[i], length);
+        addressPool[i][length] = '\0';
+    }
+}
+
+// Realistic avatar parameters first, then synthetic custom parameters
+static void buildFilters(int count, int withActions) {
+    filterCount = 0;
+    
+    for (int i = 0; i < count && i < MAX_FILTERS; i++) {
+        perimeterFilter* filter = &perimeterFilters[filterCount];
+        memset(filter, 0, sizeof(perimeterFilter));
+        
+        if (i < synthParameterCount()) {
+            snprintf(filter->pattern, MAX_PATTERN_LENGTH, "/avatar/parameters/%s", synthParameter(i)->name);
+        } else {
+            snprintf(filter->pattern, MAX_PATTERN_LENGTH, "/avatar/parameters/Custom%06d", i);
+        }
+        
+        filter->enabled = 1;
+        filter->triggerAction = withActions;
+        if (withActions) {
+            strcpy(filter->action, "@key:f13");
+        }
+        initRateLimiter(&filter->rateLimiter);
+        compileFilter(filter);
+        filterCount++;
+    }
+    
+    rebuildFilterIndex();
+}
+
+static void benchSynth(void) {
+    SynthRng rng;
+    synthSeed(&rng, 42);
+    char packet[SYNTH_MAX_PACKET];
+    uint64_t operations = 2000000, bytes = 0;
+    
+    uint64_t start = metricsNowNs();
+    for (uint64_t i = 0; i < operations; i++) {
+        bytes += synthRandomPacket(packet, sizeof(packet), &rng);
+    }
+    uint64_t elapsed = metricsNowNs() - start;
+    
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"avg_bytes\":%.1f", (double)bytes / operations);
+    report("synth", "message", operations, elapsed, extra);
+    
+    start = metricsNowNs();
+    for (uint64_t i = 0; i < operations / 8; i++) {
+        bytes += synthRandomBundle(packet, sizeof(packet), 4, &rng);
+    }
+    elapsed = metricsNowNs() - start;
+    report("synth", "bundle4", operations / 8, elapsed, NULL);
+    benchSink += bytes;
+}
+
+static void benchMatch(void) {
+    static const int filterCounts[] = {10, 100, 1000, 10000, 100000};
+    
+    for (size_t c = 0; c < sizeof(filterCounts) / sizeof(filterCounts[0]); c++) {
+        int count = filterCounts[c];
+        if (count > MAX_FILTERS) break;
+        
+        buildFilters(count, 0);
+        uint64_t operations = 20000000ULL / (uint64_t)count;
+        if (operations < 2000) operations = 2000;
+        
+        uint64_t matched = 0;
+        uint64_t start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            matched += checkParameterFilter(addressPool[i & (BENCH_PACKET_POOL - 1)]);
+        }
+        uint64_t elapsed = metricsNowNs() - start;
+        
+        char parameter[32], extra[64];
+        snprintf(parameter, sizeof(parameter), "filters=%d", count);
+        snprintf(extra, sizeof(extra), "\"match_ratio\":%.3f", (double)matched / operations);
+        report("match", parameter, operations, elapsed, extra);
+        
+        start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            size_t index = i & (BENCH_PACKET_POOL - 1);
+            matched += processOscPacket(packetPool[index], packetLengths[index]);
+        }
+        elapsed = metricsNowNs() - start;
+        report("parse+match", parameter, operations, elapsed, NULL);
+        benchSink += matched;
+    }
+}
+
+// An idle avatar resending the values it already has, matched with every
+// update passed through (the old behaviour) and with repeats dropped
+static void benchUnchanged(void) {
+    buildFilters(1000, 0);
+    
+    int parameters = synthParameterCount() < 64 ? synthParameterCount() : 64;
+    static char idlePackets[64][SYNTH_MAX_PACKET];
+    size_t idleLengths[64];
+    SynthRng rng;
+    synthSeed(&rng, 99);
+    for (int i = 0; i < parameters; i++) {
+        char address[128];
+        snprintf(address, sizeof(address), "/avatar/parameters/%s", synthParameter(i)->name);
+        idleLengths[i] = synthBuildMessage(idlePackets[i], SYNTH_MAX_PACKET, address, synthParameter(i)->type, &rng);
+    }
+    
+    for (int pass = 1; pass >= 0; pass--) {
+        for (int i = 0; i < filterCount; i++) {
+            perimeterFilters[i].passUnchanged = pass;
+        }
+        rebuildFilterIndex();
+    
+        uint64_t operations = 200000, matched = 0;
+        uint64_t start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            size_t index = i % (uint64_t)parameters;
+            matched += processOscPacket(idlePackets[index], idleLengths[index]);
+        }
+        uint64_t elapsed = metricsNowNs() - start;
+    
+        char extra[64];
+        snprintf(extra, sizeof(extra), "\"match_ratio\":%.3f", (double)matched / operations);
+        report("unchanged", pass ? "filters=1000,pass" : "filters=1000,drop", operations, elapsed, extra);
+        benchSink += matched;
+    }
+}
+
+// Wildcard mix: trailing '*', '{}' alternatives, '//' and a '[]' class,
+// over the same names buildFilters uses
+static void wildcardPattern(int i, char* out, size_t size) {
+    char name[64];
+    if (i < synthParameterCount()) {
+        snprintf(name, sizeof(name), "%s", synthParameter(i)->name);
+    } else {
+        snprintf(name, sizeof(name), "Custom%06d", i);
+    }
+    
+    switch (i % 4) {
+        case 0: snprintf(out, size, "/avatar/parameters/%s*", name); break;
+        case 1: snprintf(out, size, "/avatar/{parameters,params}/%s", name); break;
+        case 2: snprintf(out, size, "//%s", name); break;
+        default: snprintf(out, size, "/avatar/parameters/[A-Za-z]%s", name + 1); break;
+    }
+}
+
+// The substring scan, every wildcard pattern backtracked in turn, and the
+// combined automaton, each against the same number of filters
+static void benchPattern(void) {
+    static const int filterCounts[] = {10, 100, 1000, 10000};
+    matchCacheSetEnabled(0);
+    
+    for (size_t c = 0; c < sizeof(filterCounts) / sizeof(filterCounts[0]); c++) {
+        int count = filterCounts[c];
+        if (count > MAX_FILTERS) break;
+        
+        uint64_t operations = 20000000ULL / (uint64_t)count;
+        if (operations < 2000) operations = 2000;
+        char parameter[48], extra[96];
+        
+        buildFilters(count, 0);
+        uint64_t matched = 0;
+        uint64_t start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            matched += checkParameterFilter(addressPool[i & (BENCH_PACKET_POOL - 1)]);
+        }
+        uint64_t elapsed = metricsNowNs() - start;
+        snprintf(parameter, sizeof(parameter), "filters=%d,scan", count);
+        report("pattern", parameter, operations, elapsed, NULL);
+        
+        for (int i = 0; i < filterCount; i++) {
+            wildcardPattern(i, perimeterFilters[i].pattern, MAX_PATTERN_LENGTH);
+            perimeterFilters[i].matchKind = MATCH_AUTO;
+            compileFilter(&perimeterFilters[i]);
+        }
+        
+        start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            const char* address = addressPool[i & (BENCH_PACKET_POOL - 1)];
+            for (int f = 0; f < filterCount; f++) {
+                matched += oscPatternMatch(perimeterFilters[f].pattern, address);
+            }
+        }
+        elapsed = metricsNowNs() - start;
+        snprintf(parameter, sizeof(parameter), "filters=%d,backtrack", count);
+        report("pattern", parameter, operations, elapsed, NULL);
+        
+        start = metricsNowNs();
+        rebuildFilterIndex();
+        uint64_t buildNs = metricsNowNs() - start;
+        
+        // States are built as addresses first reach them; time that apart
+        start = metricsNowNs();
+        for (int i = 0; i < BENCH_PACKET_POOL; i++) {
+            matched += checkParameterFilter(addressPool[i]);
+        }
+        uint64_t warmNs = metricsNowNs() - start;
+        
+        start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            matched += checkParameterFilter(addressPool[i & (BENCH_PACKET_POOL - 1)]);
+        }
+        elapsed = metricsNowNs() - start;
+        snprintf(extra, sizeof(extra), "\"dfa_states\":%d,\"build_ms\":%.2f,\"warm_ms\":%.2f",
+                 oscPatternSetStates(currentAvatarProfiles()->patterns), buildNs / 1e6, warmNs / 1e6);
+        snprintf(parameter, sizeof(parameter), "filters=%d,automaton", count);
+        report("pattern", parameter, operations, elapsed, extra);
+        benchSink += matched;
+    }
+    matchCacheSetEnabled(1);
+}
+
+// The same filter table matched as each kind; regex patterns are the
+// names anchored at the end
+static void benchMatchKind(void) {
+    static const MatchKind kinds[] = {MATCH_EXACT, MATCH_PREFIX, MATCH_WILDCARD, MATCH_SUBSTRING, MATCH_REGEX};
+    static const int filterCounts[] = {100, 1000};
+    matchCacheSetEnabled(0);
+    
+    for (size_t c = 0; c < sizeof(filterCounts) / sizeof(filterCounts[0]); c++) {
+        int count = filterCounts[c];
+        if (count > MAX_FILTERS) break;
+    
+        for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+            buildFilters(count, 0);
+            for (int i = 0; i < filterCount; i++) {
+                if (kinds[k] == MATCH_REGEX) {
+                    strcat(perimeterFilters[i].pattern, "$");
+                } else if (kinds[k] == MATCH_WILDCARD) {
+                    strcat(perimeterFilters[i].pattern, "*");
+                }
+                perimeterFilters[i].matchKind = kinds[k];
+                compileFilter(&perimeterFilters[i]);
+            }
+            rebuildFilterIndex();
+    
+            uint64_t operations = kinds[k] == MATCH_EXACT || kinds[k] == MATCH_PREFIX ? 2000000 : 20000000ULL / (uint64_t)count;
+            uint64_t matched = 0;
+            uint64_t start = metricsNowNs();
+            for (uint64_t i = 0; i < operations; i++) {
+                matched += checkParameterFilter(addressPool[i & (BENCH_PACKET_POOL - 1)]);
+            }
+            uint64_t elapsed = metricsNowNs() - start;
+    
+            char parameter[48], extra[64];
+            snprintf(parameter, sizeof(parameter), "filters=%d,%s", count, matchKindName(kinds[k]));
+            snprintf(extra, sizeof(extra), "\"match_ratio\":%.3f", (double)matched / operations);
+            report("matchkind", parameter, operations, elapsed, extra);
+            benchSink += matched;
+        }
+    }
+    matchCacheSetEnabled(1);
+}
+
+// Warm cache against a full rescan of the filters for every message
+static void benchMatchCache(void) {
+    static const int filterCounts[] = {10, 100, 1000, 10000};
+    
+    for (size_t c = 0; c < sizeof(filterCounts) / sizeof(filterCounts[0]); c++) {
+        int count = filterCounts[c];
+        if (count > MAX_FILTERS) break;
+    
+        buildFilters(count, 0);
+        uint64_t operations = 20000000ULL / (uint64_t)count;
+        if (operations < 2000) operations = 2000;
+    
+        for (int enabled = 0; enabled <= 1; enabled++) {
+            matchCacheSetEnabled(enabled);
+            uint64_t matched = 0;
+            for (int i = 0; i < BENCH_PACKET_POOL; i++) {
+                matched += checkParameterFilter(addressPool[i]);
+            }
+    
+            MatchCacheStats before, after;
+            matchCacheGetStats(&before);
+            uint64_t start = metricsNowNs();
+            for (uint64_t i = 0; i < operations; i++) {
+                matched += checkParameterFilter(addressPool[i & (BENCH_PACKET_POOL - 1)]);
+            }
+            uint64_t elapsed = metricsNowNs() - start;
+            matchCacheGetStats(&after);
+    
+            char parameter[48], extra[64];
+            snprintf(parameter, sizeof(parameter), "filters=%d,%s", count, enabled ? "cached" : "rescan");
+            snprintf(extra, sizeof(extra), "\"hit_ratio\":%.3f",
+                     (double)(after.hits - before.hits) / operations);
+            report("cache", parameter, operations, elapsed, extra);
+            benchSink += matched;
+        }
+    }
+}
+
+// One message with count arguments of the given tag, counting up from 1;
+// packet needs room for count * 5 bytes plus the address
+static size_t buildArgumentMessage(char* packet, char tag, int count) {
+    const char* address = "/tracking/trackers/head/pose";
+    size_t length = (strlen(address) + 4) & ~(size_t)3;
+    memset(packet, 0, length + (size_t)count * 5 + 8);
+    memcpy(packet, address, strlen(address));
+    
+    packet[length] = ',';
+    memset(packet + length + 1, tag, (size_t)count);
+    length += ((size_t)count + 2 + 3) & ~(size_t)3;
+    
+    for (int a = 0; a < count; a++) {
+        uint32_t word;
+        if (tag == 'f') {
+            float number = (float)(a + 1) * 0.25f;
+            memcpy(&word, &number, 4);
+        } else {
+            word = (uint32_t)(a + 1);
+        }
+        word = __builtin_bswap32(word);
+        memcpy(packet + length, &word, 4);
+        length += 4;
+    }
+    return length;
+}
+
+static void benchDecode(void) {
+    static const struct { char tag; int count; } shapes[] = {{'f', 16}, {'f', 64}, {'i', 64}};
+    static const OscDecodeLevel levels[] = {OSC_DECODE_SCALAR, OSC_DECODE_SSSE3, OSC_DECODE_AVX2};
+    OscDecodeLevel defaultLevel = oscDecodeLevel();
+    char packet[1024];
+    double values[OSC_DECODE_BLOCK];
+    
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t length = buildArgumentMessage(packet, shapes[s].tag, shapes[s].count);
+        uint64_t operations = 4000000ULL / (uint64_t)shapes[s].count * 16;
+        OscMessage message;
+        double sum = 0.0;
+    
+        // Before: one oscArgumentNumber call per argument, each walking from the start
+        uint64_t start = metricsNowNs();
+        for (uint64_t i = 0; i < operations / 16; i++) {
+            parseOscMessage(packet, length, &message);
+            for (int a = 0; a < message.argumentCount; a++) {
+                double value;
+                if (oscArgumentNumber(&message, a, &value)) sum += value;
+            }
+        }
+        uint64_t elapsed = metricsNowNs() - start;
+    
+        char parameter[48];
+        snprintf(parameter, sizeof(parameter), "%dx%c,indexed", shapes[s].count, shapes[s].tag);
+        report("decode", parameter, operations / 16, elapsed, NULL);
+    
+        for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+            if (oscDecodeSelect(levels[l]) != levels[l]) continue;
+    
+            start = metricsNowNs();
+            for (uint64_t i = 0; i < operations; i++) {
+                parseOscMessage(packet, length, &message);
+                int decoded = oscArgumentNumbers(&message, values, OSC_DECODE_BLOCK);
+                sum += values[decoded - 1];
+            }
+            elapsed = metricsNowNs() - start;
+    
+            snprintf(parameter, sizeof(parameter), "%dx%c,%s", shapes[s].count, shapes[s].tag,
+                     oscDecodeLevelName(levels[l]));
+            report("decode", parameter, operations, elapsed, NULL);
+        }
+        benchSink += (uint64_t)sum;
+    }
+    
+    // Address and tag scanning alone, over the synthetic packets
+    fillPacketPool(47);
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        if (oscDecodeSelect(levels[l]) != levels[l]) continue;
+    
+        uint64_t operations = 10000000, parsed = 0;
+        uint64_t start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            OscMessage message;
+            int index = (int)(i & (BENCH_PACKET_POOL - 1));
+            if (parseOscMessage(packetPool[index], packetLengths[index], &message) == 0) {
+                parsed += (uint64_t)message.argumentCount;
+            }
+        }
+        uint64_t elapsed = metricsNowNs() - start;
+    
+        char parameter[48];
+        snprintf(parameter, sizeof(parameter), "parse,%s", oscDecodeLevelName(levels[l]));
+        report("decode", parameter, operations, elapsed, NULL);
+        benchSink += parsed;
+    }
+    
+    oscDecodeSelect(defaultLevel);
+}
+
+static void benchKeyLookup(void) {
+    static const char* names[] = {
+        "a", "ctrl", "shift", "space", "enter", "f12", "pageup", "printscreen",
+        "semicolon", "backslash", "CTRL", "Escape", "nonexistent", "win", "9", "rightbrace"
+    };
+    const int nameCount = (int)(sizeof(names) / sizeof(names[0]));
+    uint64_t operations = 4000000;
+    uint64_t sum = 0;
+    
+    initKeyHashTable();
+    
+    uint64_t start = metricsNowNs();
+    for (uint64_t i = 0; i < operations; i++) {
+        sum += hashFunction(names[i % nameCount]);
+    }
+    uint64_t elapsed = metricsNowNs() - start;
+    report("key-hash", "hashFunction", operations, elapsed, NULL);
+    
+    start = metricsNowNs();
+    for (uint64_t i = 0; i < operations; i++) {
+        sum += (uint64_t)getKeycodeFromName(names[i % nameCount]);
+    }
+    elapsed = metricsNowNs() - start;
+    report("key-hash", "getKeycodeFromName", operations, elapsed, NULL);
+    
+    KeyPressAction action;
+    start = metricsNowNs();
+    for (uint64_t i = 0; i < operations / 8; i++) {
+        sum += parseKeyString("ctrl+shift+m", &action);
+    }
+    elapsed = metricsNowNs() - start;
+    report("key-hash", "parseKeyString", operations / 8, elapsed, NULL);
+    benchSink += sum;
+}
+
+static void benchConfig(void) {
+    static const int filterCounts[] = {100, 1000, 10000};
+    
+    for (size_t c = 0; c < sizeof(filterCounts) / sizeof(filterCounts[0]); c++) {
+        int count = filterCounts[c];
+        if (count > MAX_FILTERS) break;
+        
+        char parameter[32];
+        snprintf(parameter, sizeof(parameter), "filters=%d", count);
+        
+        buildFilters(count, 1);
+        int iterations = count >= 10000 ? 3 : 20;
+        
+        uint64_t start = metricsNowNs();
+        for (int i = 0; i < iterations; i++) {
+            saveConfig();
+        }
+        report("config-save", parameter, iterations, metricsNowNs() - start, NULL);
+        
+        uint64_t cold = 0, warm = 0;
+        for (int i = 0; i < iterations; i++) {
+            unlink("config.bin");
+            start = metricsNowNs();
+            loadConfig();          // Parses JSON, then writes the cache
+            cold += metricsNowNs() - start;
+            
+            start = metricsNowNs();
+            loadConfig();          // Served from the cache
+            warm += metricsNowNs() - start;
+        }
+        
+        report("config-load", parameter, iterations, cold, "\"source\":\"json\"");
+        report("config-load", parameter, iterations, warm, "\"source\":\"cache\"");
+    }
+}
+
+// Time from handing a packet to processOscPacket until the first key event
+// reaches the in-memory output sink
+static void benchTriggerLatency(void) {
+    static const struct {
+        const char* parameter;
+        const char* action;
+    } triggers[] = {
+        {"key",   "@key:f12"},
+        {"combo", "@copy"},
+        {"media", "@media-next"},
+    };
+    
+    if (selectOutputBackend("ring") < 0) return;
+    initKeyHashTable();
+    
+    for (size_t t = 0; t < sizeof(triggers) / sizeof(triggers[0]); t++) {
+        filterCount = 0;
+        perimeterFilter* filter = &perimeterFilters[filterCount++];
+        memset(filter, 0, sizeof(perimeterFilter));
+        strcpy(filter->pattern, "/avatar/parameters/Trigger");
+        strcpy(filter->action, triggers[t].action);
+        filter->enabled = 1;
+        filter->triggerAction = 1;
+        filter->passUnchanged = 1;                                  // The same packet every time
+        initRateLimiterWithValues(&filter->rateLimiter, 1, 0);     // Fire on every match
+        compileFilter(filter);
+        rebuildFilterIndex();
+        
+        SynthRng rng;
+        synthSeed(&rng, 7);
+        char packet[SYNTH_MAX_PACKET];
+        size_t length = synthBuildMessage(packet, sizeof(packet), filter->pattern, 'T', &rng);
+        
+        static LatencyHistogram latency;
+        histogramReset(&latency);
+        uint64_t operations = 100000, missed = 0;
+        OutputEvent events[32];
+        
+        uint64_t start = metricsNowNs();
+        for (uint64_t i = 0; i < operations; i++) {
+            uint64_t cursor = outputRingPosition();
+            uint64_t triggered = metricsNowNs();
+            processOscPacket(packet, length);
+            
+            int count = outputRingRead(&cursor, events, 32);
+            if (count > 0) {
+                histogramRecord(&latency, events[0].timestampNs - triggered);
+            } else {
+                missed++;
+            }
+        }
+        uint64_t elapsed = metricsNowNs() - start;
+        
+        char extra[160];
+        snprintf(extra, sizeof(extra), "\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu,\"missed\":%llu",
+                 (unsigned long long)histogramPercentile(&latency, 50.0),
+                 (unsigned long long)histogramPercentile(&latency, 99.0),
+                 (unsigned long long)latency.maxNs, (unsigned long long)missed);
+        report("trigger-event", triggers[t].parameter, operations, elapsed, extra);
+    }
+    
+    selectOutputBackend(OUTPUT_DEFAULT_BACKEND);
+}
+
+static void *receiverThread(void *arg) {
+    receiveMessages(*(int *)arg);
+    return NULL;
+}
+
+static void benchUdpBackend(const char* backend) {
+    if (selectIngestBackend(backend) < 0) return;
+    
+    int receiveFd = udpSocket(0);
+    if (receiveFd < 0) return;
+    
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof(address);
+    getsockname(receiveFd, (struct sockaddr *)&address, &addressLength);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    int sendFd = socket(AF_INET, SOCK_DGRAM, 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, receiverThread, &receiveFd);
+    
+    MetricsSnapshot before, after;
+    metricsSnapshot(&before);
+    
+    uint64_t sent = 200000;
+    uint64_t start = metricsNowNs();
+    for (uint64_t i = 0; i < sent; i++) {
+        size_t index = i & (BENCH_PACKET_POOL - 1);
+        sendto(sendFd, packetPool[index], packetLengths[index], 0, (struct sockaddr *)&address, sizeof(address));
+    }
+    
+    // Wait until the receiver catches up or stops making progress
+    uint64_t lastCount = 0, lastProgress = metricsNowNs();
+    for (;;) {
+        metricsSnapshot(&after);
+        uint64_t received = after.packets - before.packets;
+        if (received >= sent) break;
+        if (received != lastCount) {
+            lastCount = received;
+            lastProgress = metricsNowNs();
+        } else if (metricsNowNs() - lastProgress > 200000000ULL) {
+            break;
+        }
+        usleep(1000);
+    }
+    uint64_t elapsed = metricsNowNs() - start;
+    uint64_t received = after.packets - before.packets;
+    
+    stopReceiving();
+    sendto(sendFd, packetPool[0], packetLengths[0], 0, (struct sockaddr *)&address, sizeof(address));
+    pthread_join(thread, NULL);
+    close(sendFd);
+    close(receiveFd);
+    
+    // auto quietly falls back, so label the row with what actually ran
+    char parameter[64];
+    snprintf(parameter, sizeof(parameter), "%s,filters=100", ingestBackendName());
+    if (strcmp(backend, "io_uring") == 0 && strcmp(ingestBackendName(), "io_uring") != 0) {
+        fprintf(stderr, "%-14s io_uring unavailable, skipped\n", "udp-loopback");
+        return;
+    }
+    
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"sent\":%llu,\"received\":%llu,\"loss\":%.4f",
+             (unsigned long long)sent, (unsigned long long)received, 1.0 - (double)received / sent);
+    report("udp-loopback", parameter, received, elapsed, extra);
+}
+
+static void benchUdpLoopback(void) {
+    buildFilters(100, 0);
+    benchUdpBackend("recvmsg");
+    benchUdpBackend("io_uring");
+    selectIngestBackend("auto");
+}
+
+static const BenchCase benchCases[] = {
+    {"synth",   benchSynth,       "Synthetic OSC packet generation"},
+    {"match",   benchMatch,       "checkParameterFilter/processOscPacket vs filter count"},
+    {"unchanged", benchUnchanged, "Idle avatar resends, matched vs dropped by the parameter store"},
+    {"pattern", benchPattern,     "Wildcard filters: substring scan vs backtracking vs combined automaton"},
+    {"matchkind", benchMatchKind, "One filter table matched as exact, prefix, wildcard, substring and regex"},
+    {"cache",   benchMatchCache,  "Address-to-filters cache against a full rescan"},
+    {"decode",  benchDecode,      "Argument byte swapping and string scanning, scalar vs SSSE3 vs AVX2"},
+    {"keys",    benchKeyLookup,   "hashFunction/getKeycodeFromName lookups"},
+    {"config",  benchConfig,      "saveConfig/loadConfig on large configs"},
+    {"output",  benchTriggerLatency, "Trigger-to-event latency through the ring output sink"},
+    {"udp",     benchUdpLoopback, "End-to-end UDP loopback throughput, recvmsg vs io_uring"},
+    {NULL,      NULL,             NULL}
+};
+
+static int caseSelected(const char* name, int argc, char* argv[]) {
+    int anySelected = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') continue;
+        anySelected = 1;
+        if (strcmp(argv[i], name) == 0) return 1;
+    }
+    return !anySelected;
+}
+
+int main(int argc, char* argv[]) {
+    const char* outputPath = BENCH_DEFAULT_OUTPUT;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--output=", 9) == 0) {
+            outputPath = argv[i] + 9;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            for (int c = 0; benchCases[c].name; c++) {
+                printf("%-10s %s\n", benchCases[c].name, benchCases[c].description);
+            }
+            return 0;
+        }
+    }
+    
+    results = fopen(outputPath, "w");
+    if (!results) {
+        perror("Failed to open benchmark output");
+        return 1;
+    }
+    
+    // The library reports to stdout; keep it out of the benchmark output
+    // and run in a scratch directory so config.json is never touched
+    char workDir[] = "/tmp/osc_bench.XXXXXX";
+    if (!mkdtemp(workDir) || chdir(workDir) < 0) {
+        perror("Failed to create benchmark directory");
+        return 1;
+    }
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("Failed to silence stdout");
+    }
+    
+    fillPacketPool(12345);
+    fprintf(stderr, "Benchmarks (MAX_FILTERS=%d), results in %s\n", MAX_FILTERS, outputPath);
+    
+    for (int c = 0; benchCases[c].name; c++) {
+        if (caseSelected(benchCases[c].name, argc, argv)) {
+            benchCases[c].func();
+        }
+    }
+    
+    unlink("config.json");
+    unlink("config.bin");
+    unlink("state.journal");
+    if (chdir("/") == 0) {
+        rmdir(workDir);
+    }
+    
+    fclose(results);
+    return 0;
+}
@@ -0,0 +1,404 @@
+#include "oscSynth.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define LOADGEN_POOL_SIZE 8192
+#define LOADGEN_MAX_BATCH 64
+#define LOADGEN_DEFAULT_PORT 9001
+#define LOADGEN_DEFAULT_METRICS_PORT 9464
+#define LOADGEN_SETTLE_NS 150000000ULL        // Counter must be stable this long after a step
+#define LOADGEN_DRAIN_LIMIT_NS 3000000000ULL
+
+typedef struct {
+    char host[64];
+    int port;
+    int metricsPort;
+    double rate;                // Fixed rate in packets/s; 0 searches for the maximum
+    double startRate;
+    double maxRate;
+    double duration;            // Seconds per step
+    double bundleRatio;         // Fraction of datagrams sent as bundles
+    int bundleSize;
+    int batch;                  // Upper bound on datagrams per sendmmsg
+    int json;
+    uint64_t seed;
+    SynthMix mix;
+} LoadgenOptions;
+
+typedef struct {
+    uint64_t received;
+    uint64_t kernelDrops;
+} DaemonCounters;
+
+typedef struct {
+    double targetRate;
+    double achievedRate;
+    uint64_t sent;
+    uint64_t messages;
+    uint64_t received;
+    uint64_t kernelDrops;
+    uint64_t sendErrors;
+    int sustained;
+} StepResult;
+
+static char packetPool[LOADGEN_POOL_SIZE][SYNTH_MAX_PACKET];
+static size_t packetLengths[LOADGEN_POOL_SIZE];
+static int packetMessages[LOADGEN_POOL_SIZE];
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleepUntil(uint64_t deadlineNs) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadlineNs / 1000000000ULL);
+    ts.tv_nsec = (long)(deadlineNs % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+static void fillPacketPool(const LoadgenOptions* options) {
+    SynthRng rng;
+    synthSeed(&rng, options->seed);
+    synthSetMix(options->mix);
+    
+    for (int i = 0; i < LOADGEN_POOL_SIZE; i++) {
+        double roll = (double)synthNext(&rng) / 4294967296.0;
+        if (roll < options->bundleRatio) {
+            packetLengths[i] = synthRandomBundle(packetPool[i], SYNTH_MAX_PACKET, options->bundleSize, &rng);
+            packetMessages[i] = options->bundleSize;
+        } else {
+            packetLengths[i] = synthRandomPacket(packetPool[i], SYNTH_MAX_PACKET, &rng);
+            packetMessages[i] = 1;
+        }
+    }
+}
+
+// Counter hook: the daemon's /metrics endpoint (osc_utility --metrics)
+static int readDaemonCounters(const LoadgenOptions* options, DaemonCounters* counters) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options->metricsPort);
+    inet_pton(AF_INET, options->host, &address.sin_addr);
+    
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    
+    const char* request = "GET /metrics HTTP/1.0\r\n\r\n";
+    if (write(fd, request, strlen(request)) < 0) {
+        close(fd);
+        return -1;
+    }
+    
+    static char response[65536];
+    size_t total = 0;
+    ssize_t bytes;
+    while (total < sizeof(response) - 1 &&
+           (bytes = read(fd, response + total, sizeof(response) - 1 - total)) > 0) {
+        total += (size_t)bytes;
+    }
+    response[total] = '\0';
+    close(fd);
+    
+    int found = 0;
+    memset(counters, 0, sizeof(DaemonCounters));
+    for (char* line = strtok(response, "\n"); line; line = strtok(NULL, "\n")) {
+        unsigned long long value;
+        if (sscanf(line, "osc_packets_received_total %llu", &value) == 1) {
+            counters->received = value;
+            found |= 1;
+        } else if (sscanf(line, "osc_kernel_drops_total %llu", &value) == 1) {
+            counters->kernelDrops = value;
+            found |= 2;
+        }
+    }
+    
+    return found == 3 ? 0 : -1;
+}
+
+// Paces sendmmsg batches so a step delivers `rate` datagrams per second
+static void runStep(int fd, const struct sockaddr_in* target, const LoadgenOptions* options,
+                    double rate, StepResult* result) {
+    static struct mmsghdr messages[LOADGEN_MAX_BATCH];
+    static struct iovec vectors[LOADGEN_MAX_BATCH];
+    
+    memset(result, 0, sizeof(StepResult));
+    result->targetRate = rate;
+    
+    // Keep each batch under a millisecond of traffic so pacing stays smooth
+    int batch = (int)(rate / 1000.0);
+    if (batch < 1) batch = 1;
+    if (batch > options->batch) batch = options->batch;
+    
+    uint64_t total = (uint64_t)(rate * options->duration);
+    double intervalNs = batch * 1e9 / rate;
+    size_t poolIndex = 0;
+    
+    uint64_t start = nowNs();
+    uint64_t batches = 0;
+    
+    while (result->sent < total) {
+        int count = (int)((total - result->sent) < (uint64_t)batch ? (total - result->sent) : (uint64_t)batch);
+        
+        for (int i = 0; i < count; i++) {
+            size_t index = (poolIndex + (size_t)i) % LOADGEN_POOL_SIZE;
+            vectors[i].iov_base = packetPool[index];
+            vectors[i].iov_len = packetLengths[index];
+            memset(&messages[i].msg_hdr, 0, sizeof(struct msghdr));
+            messages[i].msg_hdr.msg_name = (void *)target;
+            messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        
+        int sent = sendmmsg(fd, messages, (unsigned int)count, 0);
+        if (sent < 0) {
+            result->sendErrors++;
+            sent = count;       // Count the batch as attempted so the step still ends
+        }
+        
+        for (int i = 0; i < sent; i++) {
+            result->messages += (uint64_t)packetMessages[(poolIndex + (size_t)i) % LOADGEN_POOL_SIZE];
+        }
+        result->sent += (uint64_t)sent;
+        poolIndex = (poolIndex + (size_t)sent) % LOADGEN_POOL_SIZE;
+        
+        batches++;
+        sleepUntil(start + (uint64_t)(batches * intervalNs));
+    }
+    
+    uint64_t elapsed = nowNs() - start;
+    result->achievedRate = elapsed ? result->sent * 1e9 / elapsed : 0.0;
+}
+
+static int measureStep(int fd, const struct sockaddr_in* target, const LoadgenOptions* options,
+                       double rate, StepResult* result) {
+    DaemonCounters before, after;
+    if (readDaemonCounters(options, &before) < 0) return -1;
+    
+    runStep(fd, target, options, rate, result);
+    
+    // Let the daemon drain its socket before reading the counters
+    uint64_t waitStart = nowNs();
+    uint64_t lastChange = waitStart;
+    uint64_t lastReceived = before.received;
+    for (;;) {
+        if (readDaemonCounters(options, &after) < 0) return -1;
+        uint64_t now = nowNs();
+        
+        if (after.received - before.received >= result->sent) break;
+        if (after.received != lastReceived) {
+            lastReceived = after.received;
+            lastChange = now;
+        } else if (now - lastChange > LOADGEN_SETTLE_NS) {
+            break;
+        }
+        if (now - waitStart > LOADGEN_DRAIN_LIMIT_NS) break;
+        usleep(10000);
+    }
+    
+    result->received = after.received - before.received;
+    result->kernelDrops = after.kernelDrops - before.kernelDrops;
+    result->sustained = result->kernelDrops == 0 && result->received >= result->sent &&
+                        result->sendErrors == 0 && result->achievedRate >= rate * 0.95;
+    return 0;
+}
+
+static void printStep(const LoadgenOptions* options, const StepResult* result) {
+    if (options->json) {
+        printf("{\"target_pps\":%.0f,\"achieved_pps\":%.0f,\"sent\":%llu,\"messages\":%llu,"
+               "\"received\":%llu,\"kernel_drops\":%llu,\"send_errors\":%llu,\"sustained\":%s}\n",
+               result->targetRate, result->achievedRate, (unsigned long long)result->sent,
+               (unsigned long long)result->messages, (unsigned long long)result->received,
+               (unsigned long long)result->kernelDrops, (unsigned long long)result->sendErrors,
+               result->sustained ? "true" : "false");
+    } else {
+        printf("%12.0f %12.0f %10llu %10llu %10llu %8llu  %s\n",
+               result->targetRate, result->achievedRate, (unsigned long long)result->sent,
+               (unsigned long long)result->received, (unsigned long long)result->kernelDrops,
+               (unsigned long long)result->sendErrors, result->sustained ? "ok" : "DROPS");
+    }
+    fflush(stdout);
+}
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Sends synthetic /avatar/parameters/* traffic to a running osc_utility\n");
+    printf("started with --metrics, and reads its counters to detect drops.\n\n");
+    printf("  --host=<ip>            Target address (default 127.0.0.1)\n");
+    printf("  --port=<port>          Target OSC port (default %d)\n", LOADGEN_DEFAULT_PORT);
+    printf("  --metrics-port=<port>  Daemon metrics port (default %d)\n", LOADGEN_DEFAULT_METRICS_PORT);
+    printf("  --rate=<pps>           Run a single step at a fixed rate\n");
+    printf("  --start-rate=<pps>     First step of the search (default 10000)\n");
+    printf("  --max-rate=<pps>       Upper bound of the search (default 2000000)\n");
+    printf("  --duration=<seconds>   Length of each step (default 2)\n");
+    printf("  --mix=<weighted|uniform|floats>  Parameter mix (default weighted)\n");
+    printf("  --bundle-ratio=<0..1>  Fraction of datagrams sent as bundles (default 0.1)\n");
+    printf("  --bundle-size=<n>      Messages per bundle (default 4)\n");
+    printf("  --batch=<n>            Maximum datagrams per sendmmsg (default %d)\n", LOADGEN_MAX_BATCH);
+    printf("  --seed=<n>             Traffic seed\n");
+    printf("  --json                 One JSON object per step\n");
+}
+
+static int parseOptions(int argc, char* argv[], LoadgenOptions* options) {
+    memset(options, 0, sizeof(LoadgenOptions));
+    strcpy(options->host, "127.0.0.1");
+    options->port = LOADGEN_DEFAULT_PORT;
+    options->metricsPort = LOADGEN_DEFAULT_METRICS_PORT;
+    options->startRate = 10000;
+    options->maxRate = 2000000;
+    options->duration = 2.0;
+    options->bundleRatio = 0.1;
+    options->bundleSize = 4;
+    options->batch = LOADGEN_MAX_BATCH;
+    options->seed = 1;
+    options->mix = SYNTH_MIX_WEIGHTED;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--host=", 7) == 0) {
+            snprintf(options->host, sizeof(options->host), "%s", arg + 7);
+        } else if (strncmp(arg, "--port=", 7) == 0) {
+            options->port = atoi(arg + 7);
+        } else if (strncmp(arg, "--metrics-port=", 15) == 0) {
+            options->metricsPort = atoi(arg + 15);
+        } else if (strncmp(arg, "--rate=", 7) == 0) {
+            options->rate = atof(arg + 7);
+        } else if (strncmp(arg, "--start-rate=", 13) == 0) {
+            options->startRate = atof(arg + 13);
+        } else if (strncmp(arg, "--max-rate=", 11) == 0) {
+            options->maxRate = atof(arg + 11);
+        } else if (strncmp(arg, "--duration=", 11) == 0) {
+            options->duration = atof(arg + 11);
+        } else if (strncmp(arg, "--mix=", 6) == 0) {
+            if (synthParseMix(arg + 6, &options->mix) < 0) {
+                fprintf(stderr, "Unknown mix: %s\n", arg + 6);
+                return -1;
+            }
+        } else if (strncmp(arg, "--bundle-ratio=", 15) == 0) {
+            options->bundleRatio = atof(arg + 15);
+        } else if (strncmp(arg, "--bundle-size=", 14) == 0) {
+            options->bundleSize = atoi(arg + 14);
+        } else if (strncmp(arg, "--batch=", 8) == 0) {
+            options->batch = atoi(arg + 8);
+        } else if (strncmp(arg, "--seed=", 7) == 0) {
+            options->seed = strtoull(arg + 7, NULL, 10);
+        } else if (strcmp(arg, "--json") == 0) {
+            options->json = 1;
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    
+    if (options->batch < 1 || options->batch > LOADGEN_MAX_BATCH) options->batch = LOADGEN_MAX_BATCH;
+    if (options->bundleSize < 1) options->bundleSize = 1;
+    if (options->duration <= 0) options->duration = 2.0;
+    if (options->startRate < 1) options->startRate = 1;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    LoadgenOptions options;
+    if (parseOptions(argc, argv, &options) < 0) {
+        return 1;
+    }
+    
+    struct sockaddr_in target;
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.host, &target.sin_addr) != 1) {
+        fprintf(stderr, "Invalid host: %s\n", options.host);
+        return 1;
+    }
+    
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("Socket creation failed");
+        return 1;
+    }
+    
+    DaemonCounters probe;
+    if (readDaemonCounters(&options, &probe) < 0) {
+        fprintf(stderr, "Cannot read counters from %s:%d/metrics - start osc_utility with --metrics\n",
+                options.host, options.metricsPort);
+        close(fd);
+        return 1;
+    }
+    
+    fillPacketPool(&options);
+    
+    if (!options.json) {
+        printf("%12s %12s %10s %10s %10s %8s\n", "target/s", "achieved/s", "sent", "received", "k.drops", "errors");
+    }
+    
+    StepResult result;
+    double bestRate = 0.0, bestMessageRate = 0.0;
+    
+    if (options.rate > 0) {
+        if (measureStep(fd, &target, &options, options.rate, &result) < 0) goto counterError;
+        printStep(&options, &result);
+        close(fd);
+        return result.sustained ? 0 : 2;
+    }
+    
+    // Double until the daemon drops, then bisect between the last good and first bad rate
+    double good = 0.0, bad = 0.0;
+    for (double rate = options.startRate; rate <= options.maxRate; rate *= 2) {
+        if (measureStep(fd, &target, &options, rate, &result) < 0) goto counterError;
+        printStep(&options, &result);
+        if (!result.sustained) {
+            bad = rate;
+            break;
+        }
+        good = rate;
+        bestRate = result.achievedRate;
+        bestMessageRate = result.messages / options.duration;
+    }
+    
+    while (bad > 0 && good > 0 && (bad - good) / good > 0.05) {
+        double rate = (good + bad) / 2;
+        if (measureStep(fd, &target, &options, rate, &result) < 0) goto counterError;
+        printStep(&options, &result);
+        if (result.sustained) {
+            good = rate;
+            bestRate = result.achievedRate;
+            bestMessageRate = result.messages / options.duration;
+        } else {
+            bad = rate;
+        }
+    }
+    
+    close(fd);
+    
+    if (options.json) {
+        printf("{\"max_sustainable_pps\":%.0f,\"max_sustainable_mps\":%.0f,\"limited_by\":\"%s\"}\n",
+               bestRate, bestMessageRate, bad > 0 ? "drops" : "max-rate");
+    } else if (good == 0) {
+        printf("No sustainable rate found at or above %.0f packets/s\n", options.startRate);
+    } else {
+        printf("Maximum sustainable rate: %.0f packets/s (%.0f messages/s)%s\n", bestRate, bestMessageRate,
+               bad > 0 ? "" : " - reached --max-rate without drops");
+    }
+    return 0;
+    
+counterError:
+    fprintf(stderr, "Lost contact with the daemon metrics endpoint\n");
+    close(fd);
+    return 1;
+}
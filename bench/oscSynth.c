@@ -0,0 +1,149 @@
+#include "oscSynth.h"
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+static const SynthParameter parameters[] = {
+    {"VelocityX", 'f', 120}, {"VelocityY", 'f', 120}, {"VelocityZ", 'f', 120},
+    {"AngularY", 'f', 90}, {"Upright", 'f', 60},
+    {"GestureLeftWeight", 'f', 80}, {"GestureRightWeight", 'f', 80},
+    {"Voice", 'f', 70}, {"Viseme", 'i', 50},
+    {"GestureLeft", 'i', 20}, {"GestureRight", 'i', 20},
+    {"Grounded", 'T', 15}, {"Seated", 'T', 3}, {"AFK", 'T', 2},
+    {"InStation", 'T', 2}, {"MuteSelf", 'T', 3}, {"TrackingType", 'i', 1},
+    {"VRMode", 'i', 1}, {"Earmuffs", 'T', 1},
+    {"MediaPlay", 'T', 2}, {"MediaStop", 'T', 1}, {"MediaNext", 'T', 2}, {"MediaPrev", 'T', 1},
+    {"ContactHeadPat", 'f', 25}, {"ContactBoop", 'f', 10},
+    {"ToggleHat", 'T', 2}, {"ToggleGlasses", 'T', 2}, {"OutfitIndex", 'i', 1},
+};
+
+#define PARAMETER_COUNT ((int)(sizeof(parameters) / sizeof(parameters[0])))
+
+void synthSeed(SynthRng* rng, uint64_t seed) {
+    rng->state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+// xorshift64*
+uint32_t synthNext(SynthRng* rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (uint32_t)((rng->state * 2685821657736338717ULL) >> 32);
+}
+
+int synthParameterCount(void) {
+    return PARAMETER_COUNT;
+}
+
+const SynthParameter* synthParameter(int index) {
+    return (index >= 0 && index < PARAMETER_COUNT) ? &parameters[index] : NULL;
+}
+
+static SynthMix currentMix = SYNTH_MIX_WEIGHTED;
+static unsigned int totalWeight = 0;           // Recomputed when the mix changes
+
+static unsigned int mixWeight(int index) {
+    switch (currentMix) {
+        case SYNTH_MIX_UNIFORM: return 1;
+        case SYNTH_MIX_FLOATS:  return parameters[index].type == 'f' ? 1 : 0;
+        default:                return parameters[index].weight;
+    }
+}
+
+void synthSetMix(SynthMix mix) {
+    currentMix = mix;
+    totalWeight = 0;
+}
+
+int synthParseMix(const char* name, SynthMix* mix) {
+    if (strcmp(name, "weighted") == 0) *mix = SYNTH_MIX_WEIGHTED;
+    else if (strcmp(name, "uniform") == 0) *mix = SYNTH_MIX_UNIFORM;
+    else if (strcmp(name, "floats") == 0) *mix = SYNTH_MIX_FLOATS;
+    else return -1;
+    return 0;
+}
+
+int synthPickParameter(SynthRng* rng) {
+    if (totalWeight == 0) {
+        for (int i = 0; i < PARAMETER_COUNT; i++) {
+            totalWeight += mixWeight(i);
+        }
+    }
+    
+    unsigned int pick = synthNext(rng) % totalWeight;
+    for (int i = 0; i < PARAMETER_COUNT; i++) {
+        unsigned int weight = mixWeight(i);
+        if (pick < weight) return i;
+        pick -= weight;
+    }
+    return 0;
+}
+
+static size_t appendPadded(char* out, size_t offset, size_t capacity, const char* text) {
+    size_t length = strlen(text) + 1;
+    size_t padded = (length + 3) & ~(size_t)3;
+    if (offset + padded > capacity) return 0;
+    
+    memcpy(out + offset, text, length);
+    memset(out + offset + length, 0, padded - length);
+    return offset + padded;
+}
+
+size_t synthBuildMessage(char* out, size_t capacity, const char* address, char type, SynthRng* rng) {
+    size_t offset = appendPadded(out, 0, capacity, address);
+    if (!offset) return 0;
+    
+    char tags[3] = {',', type, '\0'};
+    if (type == 'T' && (synthNext(rng) & 1)) {
+        tags[1] = 'F';
+    }
+    
+    offset = appendPadded(out, offset, capacity, tags);
+    if (!offset) return 0;
+    
+    if (type == 'f' || type == 'i') {
+        if (offset + 4 > capacity) return 0;
+        
+        uint32_t raw;
+        if (type == 'f') {
+            float value = (float)(synthNext(rng) % 2001) / 1000.0f - 1.0f;
+            memcpy(&raw, &value, 4);
+        } else {
+            raw = synthNext(rng) % 16;
+        }
+        raw = htonl(raw);
+        memcpy(out + offset, &raw, 4);
+        offset += 4;
+    }
+    
+    return offset;
+}
+
+size_t synthRandomPacket(char* out, size_t capacity, SynthRng* rng) {
+    const SynthParameter* parameter = &parameters[synthPickParameter(rng)];
+    char address[128];
+    snprintf(address, sizeof(address), "/avatar/parameters/%s", parameter->name);
+    return synthBuildMessage(out, capacity, address, parameter->type, rng);
+}
+
+size_t synthRandomBundle(char* out, size_t capacity, int messages, SynthRng* rng) {
+    if (capacity < 16) return 0;
+    
+    memcpy(out, "#bundle\0", 8);
+    memset(out + 8, 0, 7);
+    out[15] = 1;                    // Time tag "immediately"
+    size_t offset = 16;
+    
+    for (int i = 0; i < messages; i++) {
+        if (offset + 4 >= capacity) break;
+        
+        size_t length = synthRandomPacket(out + offset + 4, capacity - offset - 4, rng);
+        if (!length) break;
+        
+        uint32_t size = htonl((uint32_t)length);
+        memcpy(out + offset, &size, 4);
+        offset += 4 + length;
+    }
+    
+    return offset;
+}
@@ -0,0 +1,40 @@
+#ifndef OSC_SYNTH_H
+#define OSC_SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYNTH_MAX_PACKET 256
+
+// Parameter mix modelled on a VRChat avatar: locomotion and gesture
+// floats arrive nearly every frame, toggles only occasionally
+typedef struct {
+    const char* name;               // Appended to /avatar/parameters/
+    char type;                      // 'f', 'i' or 'T' (bool)
+    unsigned int weight;            // Relative send frequency
+} SynthParameter;
+
+typedef struct {
+    uint64_t state;
+} SynthRng;
+
+typedef enum {
+    SYNTH_MIX_WEIGHTED,             // Frequencies from the parameter table
+    SYNTH_MIX_UNIFORM,              // Every parameter equally likely
+    SYNTH_MIX_FLOATS                // Continuous float parameters only
+} SynthMix;
+
+void synthSeed(SynthRng* rng, uint64_t seed);
+uint32_t synthNext(SynthRng* rng);
+
+int synthParameterCount(void);
+const SynthParameter* synthParameter(int index);
+int synthPickParameter(SynthRng* rng);
+void synthSetMix(SynthMix mix);
+int synthParseMix(const char* name, SynthMix* mix);
+
+size_t synthBuildMessage(char* out, size_t capacity, const char* address, char type, SynthRng* rng);
+size_t synthRandomPacket(char* out, size_t capacity, SynthRng* rng);
+size_t synthRandomBundle(char* out, size_t capacity, int messages, SynthRng* rng);
+
+#endif
@@ -0,0 +1,363 @@
+#include "capture.h"
+#include "oscUtility.h"
+#include "histogram.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int captureFd = -1;
+static char capturePath[256] = {0};
+static char* window = NULL;         // Mapped view of [windowOffset, windowOffset + CAPTURE_WINDOW_BYTES)
+static uint64_t windowOffset = 0;
+static uint64_t writeOffset = 0;    // Logical end of data in the file
+static uint64_t fileSize = 0;
+static uint64_t capturedPackets = 0;
+static int captureActive = 0;
+static pthread_mutex_t captureMutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define REPLAY_SLICE_NS 100000000ULL        // Longest sleep between stop checks
+#define REPLAY_MAX_DELAY_NS 1000000000000000ULL    // About 11 days; keeps the scaled offset in range
+
+// A replay started from the CLI runs on its own thread, so the loop keeps
+// draining the socket and its output is paced like any off-loop submit
+typedef struct {
+    char path[256];
+    double speed;
+} ReplayRequest;
+
+static pthread_t replayThread;
+static int replayThreadStarted = 0;         // Joinable; CLI (loop) thread only
+static int replayRunning = 0;
+static int replayStopRequested = 0;
+static ReplayRequest replayRequest;
+
+uint64_t captureTimestampNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Map a window starting at the page containing offset, growing the file
+// as needed so the whole window is backed
+static int mapWindowAt(uint64_t offset) {
+    if (window) {
+        munmap(window, CAPTURE_WINDOW_BYTES);
+        window = NULL;
+    }
+    
+    uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+    windowOffset = offset & ~(pageSize - 1);
+    
+    if (windowOffset + CAPTURE_WINDOW_BYTES > fileSize) {
+        fileSize = windowOffset + CAPTURE_WINDOW_BYTES;
+        if (ftruncate(captureFd, (off_t)fileSize) < 0) {
+            perror("Failed to grow capture file");
+            return -1;
+        }
+    }
+    
+    window = mmap(NULL, CAPTURE_WINDOW_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, captureFd, (off_t)windowOffset);
+    if (window == MAP_FAILED) {
+        window = NULL;
+        perror("Failed to map capture file");
+        return -1;
+    }
+    
+    return 0;
+}
+
+static int appendBytes(const void* data, size_t length) {
+    if (writeOffset + length > windowOffset + CAPTURE_WINDOW_BYTES) {
+        if (mapWindowAt(writeOffset) < 0) return -1;
+    }
+    
+    memcpy(window + (writeOffset - windowOffset), data, length);
+    writeOffset += length;
+    return 0;
+}
+
+int startCapture(const char* path) {
+    pthread_mutex_lock(&captureMutex);
+    
+    if (captureActive) {
+        pthread_mutex_unlock(&captureMutex);
+        printf("Capture already running to '%s'\n", capturePath);
+        return -1;
+    }
+    
+    captureFd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (captureFd < 0) {
+        pthread_mutex_unlock(&captureMutex);
+        perror("Failed to open capture file");
+        return -1;
+    }
+    
+    fileSize = 0;
+    writeOffset = 0;
+    capturedPackets = 0;
+    
+    CaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.recordHeaderSize = sizeof(CaptureRecordHeader);
+    header.startTimeNs = captureTimestampNow();
+    
+    if (mapWindowAt(0) < 0 || appendBytes(&header, sizeof(header)) < 0) {
+        close(captureFd);
+        captureFd = -1;
+        pthread_mutex_unlock(&captureMutex);
+        return -1;
+    }
+    
+    strncpy(capturePath, path, sizeof(capturePath) - 1);
+    __atomic_store_n(&captureActive, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&captureMutex);
+    
+    printf("Capturing OSC traffic to '%s'\n", path);
+    return 0;
+}
+
+void stopCapture(void) {
+    pthread_mutex_lock(&captureMutex);
+    
+    if (!captureActive) {
+        pthread_mutex_unlock(&captureMutex);
+        return;
+    }
+    
+    __atomic_store_n(&captureActive, 0, __ATOMIC_RELEASE);
+    
+    if (window) {
+        munmap(window, CAPTURE_WINDOW_BYTES);
+        window = NULL;
+    }
+    if (ftruncate(captureFd, (off_t)writeOffset) < 0) {
+        perror("Failed to trim capture file");
+    }
+    close(captureFd);
+    captureFd = -1;
+    
+    printf("Capture stopped: %llu packets, %llu bytes in '%s'\n",
+           (unsigned long long)capturedPackets, (unsigned long long)writeOffset, capturePath);
+    pthread_mutex_unlock(&captureMutex);
+}
+
+int isCaptureActive(void) {
+    return __atomic_load_n(&captureActive, __ATOMIC_ACQUIRE);
+}
+
+void captureDatagram(const char* data, size_t length, const struct sockaddr_in* source, uint64_t timestampNs) {
+    static const char padding[8] = {0};
+    
+    pthread_mutex_lock(&captureMutex);
+    
+    if (captureActive) {
+        CaptureRecordHeader record;
+        memset(&record, 0, sizeof(record));
+        record.timestampNs = timestampNs;
+        record.length = (uint32_t)length;
+        if (source) {
+            record.sourceAddress = source->sin_addr.s_addr;
+            record.sourcePort = ntohs(source->sin_port);
+        }
+        
+        size_t paddedLength = (length + 7) & ~(size_t)7;
+        if (appendBytes(&record, sizeof(record)) == 0 &&
+            appendBytes(data, length) == 0 &&
+            appendBytes(padding, paddedLength - length) == 0) {
+            capturedPackets++;
+        }
+    }
+    
+    pthread_mutex_unlock(&captureMutex);
+}
+
+void printCaptureStatus(void) {
+    pthread_mutex_lock(&captureMutex);
+    if (captureActive) {
+        printf("Capture: ACTIVE -> '%s' (%llu packets, %llu bytes)\n", capturePath,
+               (unsigned long long)capturedPackets, (unsigned long long)writeOffset);
+    } else {
+        printf("Capture: INACTIVE\n");
+    }
+    pthread_mutex_unlock(&captureMutex);
+}
+
+// Sleeps in slices so stopReplay does not wait out a long gap
+static void sleepUntil(uint64_t targetNs) {
+    while (!__atomic_load_n(&replayStopRequested, __ATOMIC_ACQUIRE)) {
+        uint64_t nowNs = metricsNowNs();
+        if (nowNs >= targetNs) return;
+    
+        uint64_t wakeNs = targetNs - nowNs > REPLAY_SLICE_NS ? nowNs + REPLAY_SLICE_NS : targetNs;
+        struct timespec target;
+        target.tv_sec = (time_t)(wakeNs / 1000000000ULL);
+        target.tv_nsec = (long)(wakeNs % 1000000000ULL);
+        int result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+        if (result != 0 && result != EINTR) return;
+    }
+}
+
+int replayCapture(const char* path, double speed) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("Failed to open capture for replay");
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(CaptureFileHeader)) {
+        printf("Capture file '%s' is empty or unreadable\n", path);
+        close(fd);
+        return -1;
+    }
+    
+    const char* image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        perror("Failed to map capture for replay");
+        return -1;
+    }
+    madvise((void*)image, st.st_size, MADV_SEQUENTIAL);
+    
+    const CaptureFileHeader* header = (const CaptureFileHeader*)image;
+    if (memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->recordHeaderSize != sizeof(CaptureRecordHeader)) {
+        printf("'%s' is not an OSC capture file\n", path);
+        munmap((void*)image, st.st_size);
+        return -1;
+    }
+    
+    static LatencyHistogram processing;
+    static LatencyHistogram lateness;
+    histogramReset(&processing);
+    histogramReset(&lateness);
+    
+    uint64_t packets = 0, bytes = 0, matched = 0;
+    uint64_t firstCaptureNs = 0;
+    uint64_t replayStartNs = metricsNowNs();
+    size_t offset = sizeof(CaptureFileHeader);
+    
+    if (speed > 0) {
+        printf("Replaying '%s' at %.2fx speed...\n", path, speed);
+    } else {
+        printf("Replaying '%s' as fast as possible...\n", path);
+    }
+    
+    while (offset + sizeof(CaptureRecordHeader) <= (size_t)st.st_size) {
+        if (__atomic_load_n(&replayStopRequested, __ATOMIC_ACQUIRE)) {
+            printf("Replay stopped\n");
+            break;
+        }
+    
+        const CaptureRecordHeader* record = (const CaptureRecordHeader*)(image + offset);
+        size_t dataOffset = offset + sizeof(CaptureRecordHeader);
+        
+        if (record->length > (size_t)st.st_size - dataOffset) {
+            printf("Truncated record at offset %zu, stopping\n", offset);
+            break;
+        }
+        
+        if (packets == 0) {
+            firstCaptureNs = record->timestampNs;
+        }
+        
+        if (speed > 0) {
+            // Shards append in lock order and the realtime clock can step,
+            // so a record may be older than the first; it is due at once
+            int64_t offsetNs = (int64_t)(record->timestampNs - firstCaptureNs);
+            double scaledNs = offsetNs > 0 ? offsetNs / speed : 0.0;
+            uint64_t dueNs = replayStartNs + (scaledNs < REPLAY_MAX_DELAY_NS ? (uint64_t)scaledNs : REPLAY_MAX_DELAY_NS);
+            uint64_t nowNs = metricsNowNs();
+            if (nowNs < dueNs) {
+                sleepUntil(dueNs);
+            } else {
+                histogramRecord(&lateness, nowNs - dueNs);
+            }
+        }
+        
+        uint64_t startNs = metricsNowNs();
+        matched += processOscPacket(image + dataOffset, record->length) ? 1 : 0;
+        histogramRecord(&processing, metricsNowNs() - startNs);
+        
+        packets++;
+        bytes += record->length;
+        offset = dataOffset + ((record->length + 7) & ~(size_t)7);
+    }
+    
+    double elapsedSec = (metricsNowNs() - replayStartNs) / 1e9;
+    munmap((void*)image, st.st_size);
+    
+    char p50[16], p99[16], p999[16], max[16];
+    formatLatency(histogramPercentile(&processing, 50.0), p50, sizeof(p50));
+    formatLatency(histogramPercentile(&processing, 99.0), p99, sizeof(p99));
+    formatLatency(histogramPercentile(&processing, 99.9), p999, sizeof(p999));
+    formatLatency(processing.maxNs, max, sizeof(max));
+    
+    printf("=== Replay Report ===\n");
+    printf("Packets: %llu (%llu matched a filter)\n", (unsigned long long)packets, (unsigned long long)matched);
+    printf("Bytes: %llu\n", (unsigned long long)bytes);
+    printf("Elapsed: %.3fs\n", elapsedSec);
+    if (elapsedSec > 0) {
+        printf("Throughput: %.0f packets/s, %.2f MB/s\n", packets / elapsedSec, bytes / elapsedSec / 1e6);
+    }
+    printf("Processing latency: p50=%s p99=%s p99.9=%s max=%s\n", p50, p99, p999, max);
+    
+    if (speed > 0 && lateness.totalCount > 0) {
+        formatLatency(histogramPercentile(&lateness, 50.0), p50, sizeof(p50));
+        formatLatency(histogramPercentile(&lateness, 99.0), p99, sizeof(p99));
+        formatLatency(lateness.maxNs, max, sizeof(max));
+        printf("Schedule slip (%llu late packets): p50=%s p99=%s max=%s\n",
+               (unsigned long long)lateness.totalCount, p50, p99, max);
+    }
+    
+    return 0;
+}
+
+static void *replayThreadMain(void *arg) {
+    const ReplayRequest* request = arg;
+    replayCapture(request->path, request->speed);
+    __atomic_store_n(&replayRunning, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int startReplay(const char* path, double speed) {
+    if (__atomic_load_n(&replayRunning, __ATOMIC_ACQUIRE)) {
+        printf("A replay is already running\n");
+        return -1;
+    }
+    if (replayThreadStarted) {
+        pthread_join(replayThread, NULL);
+        replayThreadStarted = 0;
+    }
+    
+    strncpy(replayRequest.path, path, sizeof(replayRequest.path) - 1);
+    replayRequest.path[sizeof(replayRequest.path) - 1] = '\0';
+    replayRequest.speed = speed;
+    __atomic_store_n(&replayStopRequested, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&replayRunning, 1, __ATOMIC_RELEASE);
+    
+    if (pthread_create(&replayThread, NULL, replayThreadMain, &replayRequest) != 0) {
+        perror("Failed to create replay thread");
+        __atomic_store_n(&replayRunning, 0, __ATOMIC_RELEASE);
+        return -1;
+    }
+    replayThreadStarted = 1;
+    return 0;
+}
+
+void stopReplay(void) {
+    if (!replayThreadStarted) return;
+    
+    __atomic_store_n(&replayStopRequested, 1, __ATOMIC_RELEASE);
+    pthread_join(replayThread, NULL);
+    replayThreadStarted = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+#define CAPTURE_MAGIC "OSCCAP01"
+#define CAPTURE_WINDOW_BYTES (4 * 1024 * 1024)   // mmap window and growth step
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordHeaderSize;
+    uint64_t startTimeNs;            // CLOCK_REALTIME when the capture began
+} CaptureFileHeader;
+
+// Followed by the datagram, padded to 8 bytes
+typedef struct {
+    uint64_t timestampNs;            // CLOCK_REALTIME receive time
+    uint32_t length;
+    uint32_t sourceAddress;          // Network byte order
+    uint16_t sourcePort;             // Host byte order
+    uint16_t reserved;
+    uint32_t reserved2;
+} CaptureRecordHeader;
+
+int startCapture(const char* path);
+void stopCapture(void);
+int isCaptureActive(void);
+void captureDatagram(const char* data, size_t length, const struct sockaddr_in* source, uint64_t timestampNs);
+uint64_t captureTimestampNow(void);
+void printCaptureStatus(void);
+
+// speed: 1.0 = original timing, N = N times faster, 0 = as fast as possible.
+// Runs in the calling thread, which sleeps through the capture's gaps
+int replayCapture(const char* path, double speed);
+// The same on a replay thread, for callers on the event loop; one at a time
+int startReplay(const char* path, double speed);
+// Ends a running replay at the next packet and waits for its thread
+void stopReplay(void);
+
+#endif
@@ -1,6 +1,20 @@
 #include "oscUtility.h"
 #include "mediaControl.h"
 #include "keyPress.h"
+#include "startupReport.h"
+#include "stateJournal.h"
+#include "avatarProfile.h"
+#include "metrics.h"
+#include "asyncLog.h"
+#include "capture.h"
+#include "outputBackend.h"
+#include "trace.h"
+#include "eventLoop.h"
+#include "stateMachine.h"
+#include "socket.h"
+#include "ingestShards.h"
+#include "parameterStore.h"
+#include "matchCache.h"
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -15,10 +29,13 @@ typedef struct {
     const char* description;
 } Command;
 
+static int cliExitRequested = 0;
+
 void cmd_help(int argc, char args[][256]) {
     (void)argc; (void)args; 
     printf("OSC Utility CLI Commands:\n");
-    printf("  add <pattern>              - Add a new filter pattern\n");
+    printf("  add <pattern> [match]      - Add a new filter pattern; match is exact, prefix, substring,\n");
+    printf("                               wildcard (OSC * ? [a-z] {A,B} //) or regex\n");
     printf("  remove <pattern>           - Remove a filter pattern\n");
     printf("  list                       - List all filters\n");
     printf("  clear                      - Clear all filters\n");
@@ -27,11 +44,27 @@ void cmd_help(int argc, char args[][256]) {
     printf("  disable <pattern>          - Disable a filter\n");
     printf("  action <pattern> <command> - Set action command for filter\n");
     printf("  toggle <pattern>           - Toggle action execution for filter\n");
+    printf("  condition <pattern> <cond> - Fire only for values: true, > 0.5, 0.2..0.8, rising, any\n");
+    printf("  gesture <pattern> <kind> <ms> - Fire on longpress, doubletap or hold-then-release\n");
+    printf("  smooth <pattern> <smoothing> - Condition sees avg/ema/min/max over a window, band for hysteresis\n");
+    printf("  unchanged <pattern> <pass|drop> - Match updates that repeat the last value, or not\n");
+    printf("  machines [reset]           - Show the config's state machines, or restart them\n");
     printf("  rate <pattern> <count> <seconds> - Set rate limit for filter\n");
+    printf("  avatar <pattern> <id|global> - Bind filter to an avatar profile\n");
+    printf("  profiles                   - List avatar profiles and the active avatar\n");
+    printf("  params [prefix]            - Show the last value received for each address\n");
+    printf("  cache [on|off|clear]       - Show or control the address-to-filters match cache\n");
     printf("  rate-list                  - Show rate limiting settings\n");
     printf("  rate-reset <pattern>       - Reset filter rate limit to defaults\n");
     printf("  print                      - Toggle message printing on/off\n");
+    printf("  log [level <lvl>|subsystems <list>] - Show or change log filtering\n");
     printf("  status                     - Show system status\n");
+    printf("  capture <start <file>|stop|status> - Record received datagrams\n");
+    printf("  replay <file> [speed]      - Replay a capture (speed 0 = as fast as possible)\n");
+    printf("  output [uinput|ring|file <path>|events [n]] - Show or switch the key/media output backend\n");
+    printf("  ingest                     - Show the receive backend (io_uring or recvmsg) and shards\n");
+    printf("  trace [on|off|reset|record <file> [every]|stop] - Per-stage packet latency, Chrome trace export\n");
+    printf("  stats [reset]              - Show throughput, latency and per-filter metrics\n");
     printf("  media-status               - Show current media player status\n");
     printf("  test-media                 - Test media controls\n");
     printf("  defaults                   - Setup default media control filters\n");
@@ -43,6 +76,9 @@ void cmd_help(int argc, char args[][256]) {
     printf("  save                       - Save current config\n");
     printf("  load                       - Reload config from file\n");
     printf("  hash-stats                 - Show key hash table performance stats\n");
+    printf("  startup                    - Show startup time breakdown\n");
+    printf("  journal                    - Show rate limiter state journal info\n");
+    printf("  journal-compact            - Compact the state journal now\n");
     printf("  help                       - Show this help\n");
     printf("  exit                       - Exit CLI\n");
     printf("\nQuick Commands:\n");
@@ -56,10 +92,17 @@ void cmd_help(int argc, char args[][256]) {
 
 void cmd_add(int argc, char args[][256]) {
     if (argc < 1) {
-        printf("Usage: add <pattern>\n");
+        printf("Usage: add <pattern> [exact|prefix|substring|wildcard|regex]\n");
         return;
     }
-    addPerimeterFilter(args[0]);
+    
+    // Without a kind, patterns using OSC wildcards are wildcards
+    MatchKind matchKind = MATCH_AUTO;
+    if (argc > 1 && parseMatchKind(args[1], &matchKind) < 0) {
+        printf("Unknown match kind '%s' (exact, prefix, substring, wildcard or regex)\n", args[1]);
+        return;
+    }
+    addPerimeterFilter(args[0], matchKind);
 }
 
 void cmd_remove(int argc, char args[][256]) {
@@ -117,6 +160,105 @@ void cmd_toggle(int argc, char args[][256]) {
     toggleFilterAction(args[0]);
 }
 
+void cmd_condition(int argc, char args[][256]) {
+    if (argc < 2) {
+        printf("Usage: condition <pattern> <condition>\n");
+        printf("Examples:\n");
+        printf("  condition MediaPlay true       - Fire on true only\n");
+        printf("  condition Volume > 0.5         - Fire while above 0.5\n");
+        printf("  condition Volume 0.2..0.8      - Fire while inside the range\n");
+        printf("  condition Gesture == 3         - Fire on one int value\n");
+        printf("  condition Grab rising          - Fire once when it becomes >= 0.5\n");
+        printf("  condition Grab falling < 0.1   - Fire once when it leaves < 0.1\n");
+        printf("  condition MediaPlay any        - Remove the condition\n");
+        return;
+    }
+    
+    // Conditions may contain spaces ("> 0.5"); the tokenizer split them
+    char condition[256] = "";
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) strncat(condition, " ", sizeof(condition) - strlen(condition) - 1);
+        strncat(condition, args[i], sizeof(condition) - strlen(condition) - 1);
+    }
+    setFilterCondition(args[0], condition);
+}
+
+void cmd_gesture(int argc, char args[][256]) {
+    if (argc < 2) {
+        printf("Usage: gesture <pattern> <longpress|doubletap|hold> <ms> | none\n");
+        printf("Nonzero values press, zero releases; the gesture replaces the condition\n");
+        printf("  gesture MenuButton longpress 600 - Fire once held for 600 ms\n");
+        printf("  gesture MenuButton doubletap 300 - Fire on a second press within 300 ms\n");
+        printf("  gesture MenuButton hold 800      - Fire on release after at least 800 ms\n");
+        printf("  gesture MenuButton none          - Remove the gesture\n");
+        return;
+    }
+    
+    char gesture[256] = "";
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) strncat(gesture, " ", sizeof(gesture) - strlen(gesture) - 1);
+        strncat(gesture, args[i], sizeof(gesture) - strlen(gesture) - 1);
+    }
+    setFilterGesture(args[0], gesture);
+}
+
+void cmd_smooth(int argc, char args[][256]) {
+    if (argc < 2) {
+        printf("Usage: smooth <pattern> <smoothing> | none\n");
+        printf("The condition and gesture see the smoothed value:\n");
+        printf("  smooth Proximity avg 200       - Mean over the last 200 ms\n");
+        printf("  smooth Proximity ema 0.2       - Exponential average, 0.2 of each new sample\n");
+        printf("  smooth Grab max 500            - Highest value over the last 500 ms\n");
+        printf("  smooth Grab min 500            - Lowest value over the last 500 ms\n");
+        printf("  smooth Proximity avg 200 band 0.05 - Also hold until it moves by 0.05\n");
+        printf("  smooth Proximity none          - Raw values again\n");
+        return;
+    }
+    
+    char smoothing[256] = "";
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) strncat(smoothing, " ", sizeof(smoothing) - strlen(smoothing) - 1);
+        strncat(smoothing, args[i], sizeof(smoothing) - strlen(smoothing) - 1);
+    }
+    setFilterSmoothing(args[0], smoothing);
+}
+
+void cmd_machines(int argc, char args[][256]) {
+    if (argc >= 1 && strcmp(args[0], "reset") == 0) {
+        resetStateMachines();
+        return;
+    }
+    listStateMachines();
+}
+
+void cmd_unchanged(int argc, char args[][256]) {
+    if (argc < 2 || (strcmp(args[1], "pass") != 0 && strcmp(args[1], "drop") != 0)) {
+        printf("Usage: unchanged <pattern> <pass|drop>\n");
+        printf("  drop - Ignore updates that repeat the last value (default)\n");
+        printf("  pass - Match every update, e.g. for actions that count resends\n");
+        return;
+    }
+    setFilterPassUnchanged(args[0], strcmp(args[1], "pass") == 0);
+}
+
+void cmd_params(int argc, char args[][256]) {
+    printParameterSnapshot(argc >= 1 ? args[0] : NULL);
+}
+
+void cmd_cache(int argc, char args[][256]) {
+    if (argc >= 1) {
+        if (strcmp(args[0], "on") == 0 || strcmp(args[0], "off") == 0) {
+            matchCacheSetEnabled(strcmp(args[0], "on") == 0);
+        } else if (strcmp(args[0], "clear") == 0) {
+            matchCacheInvalidate();
+        } else {
+            printf("Usage: cache [on|off|clear]\n");
+            return;
+        }
+    }
+    printMatchCacheStats();
+}
+
 void cmd_rate(int argc, char args[][256]) {
     if (argc < 3) {
         printf("Usage: rate <pattern> <count> <seconds>\n");
@@ -133,6 +275,19 @@ void cmd_rate(int argc, char args[][256]) {
     setFilterRateLimit(args[0], count, seconds);
 }
 
+void cmd_avatar(int argc, char args[][256]) {
+    if (argc < 2) {
+        printf("Usage: avatar <pattern> <avatarId|global>\n");
+        return;
+    }
+    setFilterAvatar(args[0], args[1]);
+}
+
+void cmd_profiles(int argc, char args[][256]) {
+    (void)argc; (void)args;
+    listAvatarProfiles();
+}
+
 void cmd_rate_list(int argc, char args[][256]) {
     (void)argc; (void)args;
     listFilterRateLimits();
@@ -151,6 +306,102 @@ void cmd_print(int argc, char args[][256]) {
     toggleMessagePrinting();
 }
 
+void cmd_log(int argc, char args[][256]) {
+    if (argc >= 2 && strcmp(args[0], "level") == 0) {
+        int level = parseLogLevel(args[1]);
+        if (level < 0) {
+            printf("Unknown log level '%s' (error, warn, info, debug, trace)\n", args[1]);
+            return;
+        }
+        logLevel = level;
+    } else if (argc >= 2 && strcmp(args[0], "subsystems") == 0) {
+        if (parseLogSubsystems(args[1], &logSubsystemMask) < 0) {
+            printf("Unknown log subsystem in '%s' (net, filter, rate, action, avatar, all, none)\n", args[1]);
+            return;
+        }
+    } else if (argc > 0) {
+        printf("Usage: log [level <lvl>|subsystems <list>]\n");
+        return;
+    }
+    printLogSettings();
+}
+
+void cmd_capture(int argc, char args[][256]) {
+    if (argc >= 2 && strcmp(args[0], "start") == 0) {
+        startCapture(args[1]);
+    } else if (argc >= 1 && strcmp(args[0], "stop") == 0) {
+        if (!isCaptureActive()) {
+            printf("No capture running\n");
+            return;
+        }
+        stopCapture();
+    } else if (argc >= 1 && strcmp(args[0], "status") == 0) {
+        printCaptureStatus();
+    } else {
+        printf("Usage: capture <start <file>|stop|status>\n");
+    }
+}
+
+void cmd_replay(int argc, char args[][256]) {
+    if (argc < 1) {
+        printf("Usage: replay <file> [speed]\n");
+        return;
+    }
+    // Commands run on the event loop, which must not sleep through the capture
+    startReplay(args[0], argc >= 2 ? atof(args[1]) : 1.0);
+}
+
+void cmd_output(int argc, char args[][256]) {
+    if (argc == 0) {
+        printOutputBackend();
+        return;
+    }
+    
+    if (strcmp(args[0], "events") == 0) {
+        printOutputRing(argc >= 2 ? atoi(args[1]) : 20);
+        return;
+    }
+    
+    char spec[300];
+    if (strcmp(args[0], "file") == 0 && argc >= 2) {
+        snprintf(spec, sizeof(spec), "file:%s", args[1]);
+    } else {
+        snprintf(spec, sizeof(spec), "%s", args[0]);
+    }
+    
+    if (selectOutputBackend(spec) < 0) {
+        printf("Usage: output [uinput|ring|file <path>|events [n]]\n");
+        return;
+    }
+    printOutputBackend();
+}
+
+void cmd_ingest(int argc, char args[][256]) {
+    (void)argc; (void)args;
+    printIngestStatus();
+    printIngestShards();
+}
+
+void cmd_trace(int argc, char args[][256]) {
+    if (argc == 0) {
+        printTraceStats();
+    } else if (strcmp(args[0], "on") == 0 || strcmp(args[0], "off") == 0) {
+        tracingEnabled = strcmp(args[0], "on") == 0;
+        printf("Tracing %s\n", tracingEnabled ? "ENABLED" : "DISABLED");
+    } else if (strcmp(args[0], "reset") == 0) {
+        traceReset();
+        printf("Trace histograms reset\n");
+    } else if (strcmp(args[0], "record") == 0 && argc >= 2) {
+        traceStartRecording(args[1], argc >= 3 ? atoi(args[2]) : TRACE_DEFAULT_SAMPLE);
+    } else if (strcmp(args[0], "stop") == 0) {
+        if (traceStopRecording() < 0) {
+            printf("No trace recording running\n");
+        }
+    } else {
+        printf("Usage: trace [on|off|reset|record <file> [every]|stop]\n");
+    }
+}
+
 void cmd_status(int argc, char args[][256]) {
     (void)argc; (void)args;
     printf("=== OSC Utility Status ===\n");
@@ -169,6 +420,15 @@ void cmd_status(int argc, char args[][256]) {
            DEFAULT_RATE_LIMIT_COUNT, DEFAULT_RATE_LIMIT_SECONDS);
 }
 
+void cmd_stats(int argc, char args[][256]) {
+    if (argc >= 1 && strcmp(args[0], "reset") == 0) {
+        metricsReset();
+        printf("Metrics reset\n");
+        return;
+    }
+    printMetricsStats();
+}
+
 void cmd_media_status(int argc, char args[][256]) {
     (void)argc; (void)args;
     updateMediaState();
@@ -263,10 +523,12 @@ void cmd_load(int argc, char args[][256]) {
     }
 }
 
+// Shutdown itself happens in main once the event loop returns
 void cmd_exit(int argc, char args[][256]) {
     (void)argc; (void)args;
     printf("Goodbye!\n");
-    exit(0);
+    cliExitRequested = 1;
+    eventLoopStop();
 }
 
 void cmd_hash_stats(int argc, char args[][256]) {
@@ -274,9 +536,28 @@ void cmd_hash_stats(int argc, char args[][256]) {
     printHashTableStats();
 }
 
+void cmd_startup(int argc, char args[][256]) {
+    (void)argc; (void)args;
+    printStartupReport();
+}
+
+void cmd_journal(int argc, char args[][256]) {
+    (void)argc; (void)args;
+    printStateJournalStats();
+}
+
+void cmd_journal_compact(int argc, char args[][256]) {
+    (void)argc; (void)args;
+    if (compactStateJournal() == 0) {
+        printf("State journal compacted (%d filters)\n", filterCount);
+    } else {
+        printf("Failed to compact state journal\n");
+    }
+}
+
 static const Command commands[] = {
     {"help",         cmd_help,         0, "help",                       "Show this help"},
-    {"add",          cmd_add,          1, "add <pattern>",              "Add a new filter pattern"},
+    {"add",          cmd_add,          1, "add <pattern> [match]",      "Add a new filter pattern"},
     {"remove",       cmd_remove,       1, "remove <pattern>",           "Remove a filter pattern"},
     {"list",         cmd_list,         0, "list",                       "List all filters"},
     {"clear",        cmd_clear,        0, "clear",                      "Clear all filters"},
@@ -285,11 +566,27 @@ static const Command commands[] = {
     {"disable",      cmd_disable,      1, "disable <pattern>",          "Disable a filter"},
     {"action",       cmd_action,       2, "action <pattern> <command>", "Set action command for filter"},
     {"toggle",       cmd_toggle,       1, "toggle <pattern>",           "Toggle action execution for filter"},
+    {"condition",    cmd_condition,    2, "condition <pattern> <condition>", "Fire only for matching argument values"},
+    {"gesture",      cmd_gesture,      2, "gesture <pattern> <kind> <ms>", "Fire on a long press, double tap or hold"},
+    {"smooth",       cmd_smooth,       2, "smooth <pattern> <smoothing>", "Smooth values before the condition"},
+    {"machines",     cmd_machines,     0, "machines [reset]", "Show state machines and their current states"},
+    {"unchanged",    cmd_unchanged,    2, "unchanged <pattern> <pass|drop>", "Match updates that repeat the last value"},
     {"rate",         cmd_rate,         3, "rate <pattern> <count> <seconds>", "Set rate limit for filter"},
+    {"avatar",       cmd_avatar,       2, "avatar <pattern> <id|global>", "Bind filter to an avatar profile"},
+    {"profiles",     cmd_profiles,     0, "profiles",                   "List avatar profiles"},
+    {"params",       cmd_params,       0, "params [prefix]",            "Show the last value of each address"},
+    {"cache",        cmd_cache,        0, "cache [on|off|clear]",       "Show or control the match cache"},
     {"rate-list",    cmd_rate_list,    0, "rate-list",                  "Show rate limiting settings"},
     {"rate-reset",   cmd_rate_reset,   1, "rate-reset <pattern>",       "Reset filter rate limit to defaults"},
     {"print",        cmd_print,        0, "print",                      "Toggle message printing"},
+    {"log",          cmd_log,          0, "log [level <lvl>|subsystems <list>]", "Show or change log filtering"},
+    {"capture",      cmd_capture,      1, "capture <start <file>|stop|status>", "Record received datagrams"},
+    {"replay",       cmd_replay,       1, "replay <file> [speed]",      "Replay a capture through the filters"},
+    {"output",       cmd_output,       0, "output [uinput|ring|file <path>|events [n]]", "Show or switch the key/media output backend"},
+    {"ingest",       cmd_ingest,       0, "ingest", "Show the socket receive backend, its counters and shards"},
+    {"trace",        cmd_trace,        0, "trace [on|off|reset|record <file> [every]|stop]", "Per-stage packet latency and Chrome trace export"},
     {"status",       cmd_status,       0, "status",                     "Show system status"},
+    {"stats",        cmd_stats,        0, "stats [reset]",              "Show metrics"},
     {"media-status", cmd_media_status, 0, "media-status",               "Show media player status"},
     {"test-media",   cmd_test_media,   0, "test-media",                 "Test media controls"},
     {"defaults",     cmd_defaults,     0, "defaults",                   "Setup default media control filters"},
@@ -302,6 +599,9 @@ static const Command commands[] = {
     {"load",         cmd_load,         0, "load",                       "Reload config from file"},
     {"exit",         cmd_exit,         0, "exit",                       "Exit CLI"},
     {"hash-stats",   cmd_hash_stats,   0, "hash-stats",                 "Show key hash table statistics"},
+    {"startup",      cmd_startup,      0, "startup",                    "Show startup time breakdown"},
+    {"journal",      cmd_journal,      0, "journal",                    "Show state journal info"},
+    {"journal-compact", cmd_journal_compact, 0, "journal-compact",      "Compact the state journal"},
     {NULL,           NULL,             0, NULL,                         NULL} 
 };
 
@@ -314,11 +614,93 @@ const Command* findCommand(const char* name) {
     return NULL;
 }
 
-void runCLI(void) {
-    char input[1024];
+static void printPrompt(void) {
+    printf("osc%s> ", isMessagePrintingEnabled() ? "" : " [QUIET]");
+    fflush(stdout);
+}
+
+static void executeCommandLine(char* input) {
     char args[10][256]; 
     int argc;
     
+    if (strlen(input) == 0) {
+        return;
+    }
+    
+    if (strcmp(input, "/") == 0) {
+        toggleMessagePrinting();
+        return;
+    }
+    
+    argc = 0;
+    char* token = strtok(input, " \t");
+    while (token != NULL && argc < 10) {
+        strncpy(args[argc], token, 255);
+        args[argc][255] = '\0';
+        argc++;
+        token = strtok(NULL, " \t");
+    }
+    
+    if (argc == 0) {
+        return;
+    }
+    
+    const Command* cmd = findCommand(args[0]);
+    if (cmd != NULL) {
+        if (argc - 1 < cmd->minArgs) {
+            printf("Usage: %s\n", cmd->usage);
+        } else {
+            cmd->func(argc - 1, &args[1]);
+        }
+    } else {
+        printf("Unknown command: %s\n", args[0]);
+        printf("Type 'help' for available commands\n");
+    }
+}
+
+// stdin is read in chunks and split into lines here, since a FILE buffer
+// could hold lines epoll would never report again
+static char inputBuffer[1024];
+static size_t inputLength = 0;
+
+static void handleInput(int fd, uint32_t events, void* context) {
+    (void)events; (void)context;
+    
+    ssize_t bytes = read(fd, inputBuffer + inputLength, sizeof(inputBuffer) - 1 - inputLength);
+    if (bytes < 0) {
+        return;
+    }
+    if (bytes == 0) {
+        eventLoopRemoveFd(fd);
+        eventLoopStop();
+        return;
+    }
+    inputLength += (size_t)bytes;
+    
+    char* lineStart = inputBuffer;
+    char* newline;
+    while (!cliExitRequested && (newline = memchr(lineStart, '\n', inputLength - (size_t)(lineStart - inputBuffer)))) {
+        *newline = '\0';
+        executeCommandLine(lineStart);
+        lineStart = newline + 1;
+        if (!cliExitRequested) {
+            printPrompt();
+        }
+    }
+    
+    inputLength -= (size_t)(lineStart - inputBuffer);
+    memmove(inputBuffer, lineStart, inputLength);
+    
+    // Overlong lines are cut rather than stalling the reader
+    if (inputLength == sizeof(inputBuffer) - 1) {
+        inputBuffer[inputLength] = '\0';
+        executeCommandLine(inputBuffer);
+        inputLength = 0;
+        printPrompt();
+    }
+}
+
+int startCLI(void) {
     printf("=== OSC Utility CLI ===\n");
     printf("Listening for messages in background...\n");
     printf("Message printing is %s (press '/' to toggle)\n", 
@@ -326,49 +708,21 @@ void runCLI(void) {
     printf("Type 'help' for commands, 'defaults' to setup media controls\n");
     printf("Default rate limiting: %d counts, %d seconds\n\n", 
            DEFAULT_RATE_LIMIT_COUNT, DEFAULT_RATE_LIMIT_SECONDS);
+    printPrompt();
     
-    while (1) {
-        printf("osc%s> ", isMessagePrintingEnabled() ? "" : " [QUIET]");
-        fflush(stdout);
-        
-        if (!fgets(input, sizeof(input), stdin)) {
-            break;
-        }
-        
+    if (eventLoopAddFd(STDIN_FILENO, EPOLLIN, handleInput, NULL) == 0) {
+        return 0;
+    }
+    
+    // Regular files cannot be polled; run a redirected script straight through
+    char input[1024];
+    while (!cliExitRequested && fgets(input, sizeof(input), stdin)) {
         input[strcspn(input, "\n")] = 0;
-        
-        if (strlen(input) == 0) {
-            continue;
-        }
-        
-        if (strcmp(input, "/") == 0) {
-            toggleMessagePrinting();
-            continue;
-        }
-        
-        argc = 0;
-        char* token = strtok(input, " \t");
-        while (token != NULL && argc < 10) {
-            strncpy(args[argc], token, 255);
-            args[argc][255] = '\0';
-            argc++;
-            token = strtok(NULL, " \t");
-        }
-        
-        if (argc == 0) {
-            continue;
-        }
-        
-        const Command* cmd = findCommand(args[0]);
-        if (cmd != NULL) {
-            if (argc - 1 < cmd->minArgs) {
-                printf("Usage: %s\n", cmd->usage);
-            } else {
-                cmd->func(argc - 1, &args[1]);
-            }
-        } else {
-            printf("Unknown command: %s\n", args[0]);
-            printf("Type 'help' for available commands\n");
+        executeCommandLine(input);
+        if (!cliExitRequested) {
+            printPrompt();
         }
     }
+    eventLoopStop();
+    return 0;
 }
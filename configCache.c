@@ -0,0 +1,152 @@
+#include "configCache.h"
+#include "oscUtility.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int configLoadedFromCache = 0;
+
+uint64_t hashConfigBytes(const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    uint64_t hash = 1469598103934665603ULL;
+    
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    
+    return hash;
+}
+
+static int hashSourceFile(const char* filename, struct stat* st, uint64_t* hash) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+    
+    if (fstat(fd, st) < 0) {
+        close(fd);
+        return -1;
+    }
+    
+    if (st->st_size == 0) {
+        close(fd);
+        *hash = hashConfigBytes(NULL, 0);
+        return 0;
+    }
+    
+    void* data = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+    
+    *hash = hashConfigBytes(data, st->st_size);
+    munmap(data, st->st_size);
+    return 0;
+}
+
+int loadConfigCache(void) {
+    configLoadedFromCache = 0;
+    
+    int fd = open(CONFIG_CACHE_FILE, O_RDONLY);
+    if (fd < 0) return -1;
+    
+    struct stat cacheStat;
+    if (fstat(fd, &cacheStat) < 0 || cacheStat.st_size < (off_t)sizeof(ConfigCacheHeader)) {
+        close(fd);
+        return -1;
+    }
+    
+    void* image = mmap(NULL, cacheStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return -1;
+    
+    const ConfigCacheHeader* header = image;
+    int result = -1;
+    struct stat sourceStat;
+    uint64_t sourceHash;
+    
+    if (memcmp(header->magic, CONFIG_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CONFIG_CACHE_VERSION ||
+        header->recordSize != sizeof(perimeterFilter) ||
+        header->filterCount < 0 || header->filterCount > MAX_FILTERS ||
+        (size_t)cacheStat.st_size != sizeof(ConfigCacheHeader) + 
+                                     (size_t)header->filterCount * sizeof(perimeterFilter)) {
+        goto done;
+    }
+    
+    if (stat(CONFIG_FILE, &sourceStat) < 0 ||
+        sourceStat.st_size != header->sourceSize ||
+        sourceStat.st_mtim.tv_sec != header->sourceMtimeSec ||
+        sourceStat.st_mtim.tv_nsec != header->sourceMtimeNsec) {
+        goto done;
+    }
+    
+    if (hashSourceFile(CONFIG_FILE, &sourceStat, &sourceHash) < 0 ||
+        sourceHash != header->sourceHash) {
+        goto done;
+    }
+    
+    memcpy(perimeterFilters, (const char*)image + sizeof(ConfigCacheHeader),
+           (size_t)header->filterCount * sizeof(perimeterFilter));
+    filterCount = header->filterCount;
+    messagePrintingEnabled = header->messagePrintingEnabled;
+    
+    for (int i = 0; i < filterCount; i++) {
+        perimeterFilters[i].count = 0;
+        perimeterFilters[i].lastReceived = 0;
+        perimeterFilters[i].fireCount = 0;
+        perimeterFilters[i].suppressCount = 0;
+        resetTriggerCondition(&perimeterFilters[i].trigger);
+        resetGesture(&perimeterFilters[i].gestureState);
+        // Cached channel owners belong to another run; the index rebuild attaches fresh ones
+        compileSmoothing(perimeterFilters[i].smoothing, &perimeterFilters[i].smoothingState);
+    }
+    
+    configLoadedFromCache = 1;
+    result = 0;
+    
+done:
+    munmap(image, cacheStat.st_size);
+    return result;
+}
+
+int writeConfigCache(void) {
+    ConfigCacheHeader header;
+    struct stat sourceStat;
+    
+    memset(&header, 0, sizeof(header));
+    if (hashSourceFile(CONFIG_FILE, &sourceStat, &header.sourceHash) < 0) {
+        return -1;
+    }
+    
+    memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+    header.version = CONFIG_CACHE_VERSION;
+    header.recordSize = sizeof(perimeterFilter);
+    header.sourceSize = sourceStat.st_size;
+    header.sourceMtimeSec = sourceStat.st_mtim.tv_sec;
+    header.sourceMtimeNsec = sourceStat.st_mtim.tv_nsec;
+    header.filterCount = filterCount;
+    header.messagePrintingEnabled = messagePrintingEnabled;
+    
+    char tempFile[64];
+    snprintf(tempFile, sizeof(tempFile), "%s.tmp", CONFIG_CACHE_FILE);
+    
+    FILE* file = fopen(tempFile, "wb");
+    if (!file) return -1;
+    
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(perimeterFilters, sizeof(perimeterFilter), filterCount, file) == (size_t)filterCount;
+    
+    if (fclose(file) != 0 || !ok) {
+        unlink(tempFile);
+        return -1;
+    }
+    
+    if (rename(tempFile, CONFIG_CACHE_FILE) < 0) {
+        unlink(tempFile);
+        return -1;
+    }
+    
+    return 0;
+}
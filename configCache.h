@@ -0,0 +1,32 @@
+#ifndef CONFIG_CACHE_H
+#define CONFIG_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CONFIG_CACHE_FILE "config.bin"
+#define CONFIG_CACHE_MAGIC "OSCCFGC1"
+#define CONFIG_CACHE_VERSION 1
+
+// Binary image of the compiled filter table, written next to config.json.
+// The header pins the source file (size, mtime, content hash) and the record
+// layout so any edit or rebuild invalidates it.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;            // sizeof(perimeterFilter) at write time
+    uint64_t sourceHash;            // FNV-1a of config.json contents
+    int64_t sourceSize;
+    int64_t sourceMtimeSec;
+    int64_t sourceMtimeNsec;
+    int32_t filterCount;
+    int32_t messagePrintingEnabled;
+} ConfigCacheHeader;
+
+extern int configLoadedFromCache;
+
+int loadConfigCache(void);
+int writeConfigCache(void);
+uint64_t hashConfigBytes(const void* data, size_t length);
+
+#endif
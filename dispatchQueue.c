@@ -0,0 +1,312 @@
+#include "dispatchQueue.h"
+#include "oscUtility.h"
+#include "trace.h"
+#include "packetPool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define DISPATCH_QUEUE_MASK (DISPATCH_QUEUE_SIZE - 1)
+#define CACHE_LINE 64
+
+// Lock-free single-producer/single-consumer ring of pool indices. Each side
+// keeps a stale copy of the other's position and only rereads the shared
+// one when the ring looks full (producer) or empty (consumer)
+typedef struct {
+    uint32_t entries[DISPATCH_QUEUE_SIZE];
+    uint64_t head __attribute__((aligned(CACHE_LINE)));     // Written by the producer
+    uint64_t cachedTail;
+    uint64_t tail __attribute__((aligned(CACHE_LINE)));     // Written by the consumer
+    uint64_t cachedHead;
+} SpscRing;
+
+struct DispatchQueue {
+    SpscRing ready;                         // Receiver to dispatcher
+    SpscRing free;                          // Dispatcher back to receiver
+    PacketBuffer* pool;
+    PacketBuffer* spare;                    // Acquired by the receiver, not yet submitted
+    
+    pthread_t thread;
+    int running;
+    pthread_mutex_t wakeMutex;
+    pthread_cond_t wakeCond;
+    int consumerSleeping;
+    
+    // Written by the receiver only
+    uint64_t submitted;
+    uint64_t dropped;
+    uint64_t highWater;
+};
+
+static DispatchQueue* queues[MAX_DISPATCH_QUEUES];
+static pthread_mutex_t queuesMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t retiredDrops = 0;           // Drops of queues already stopped
+
+static int spscPush(SpscRing* ring, uint32_t value) {
+    uint64_t head = ring->head;
+    if (head - ring->cachedTail >= DISPATCH_QUEUE_SIZE) {
+        ring->cachedTail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - ring->cachedTail >= DISPATCH_QUEUE_SIZE) return 0;
+    }
+    
+    ring->entries[head & DISPATCH_QUEUE_MASK] = value;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    return 1;
+}
+
+static int spscPop(SpscRing* ring, uint32_t* value) {
+    uint64_t tail = ring->tail;
+    if (tail == ring->cachedHead) {
+        ring->cachedHead = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail == ring->cachedHead) return 0;
+    }
+    
+    *value = ring->entries[tail & DISPATCH_QUEUE_MASK];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static uint64_t spscDepth(SpscRing* ring) {
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+}
+
+static void statStore(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+static void processPacket(DispatchQueue* queue, uint32_t index) {
+    PacketBuffer* packet = &queue->pool[index];
+    
+    traceBeginQueuedPacket(packet->originNs, packet->receivedNs);
+    traceLap(TRACE_STAGE_QUEUE);
+    processOscPacket(packet->data, packet->length);
+    traceEndPacket();
+    
+    if (packet->data != packet->inlineData) {
+        packetPoolRelease(packet->data);
+        packet->data = packet->inlineData;
+    }
+    
+    // The free ring holds every pool index, so this cannot fail
+    spscPush(&queue->free, index);
+}
+
+static int drainQueue(DispatchQueue* queue) {
+    uint32_t index;
+    int drained = 0;
+    
+    while (spscPop(&queue->ready, &index)) {
+        processPacket(queue, index);
+        drained++;
+    }
+    return drained;
+}
+
+static void *dispatcherLoop(void *arg) {
+    DispatchQueue* queue = arg;
+    
+    while (__atomic_load_n(&queue->running, __ATOMIC_ACQUIRE)) {
+        if (drainQueue(queue) > 0) continue;
+    
+        pthread_mutex_lock(&queue->wakeMutex);
+        __atomic_store_n(&queue->consumerSleeping, 1, __ATOMIC_SEQ_CST);
+    
+        // Re-check after advertising sleep so a racing producer is not missed
+        if (spscDepth(&queue->ready) == 0 && __atomic_load_n(&queue->running, __ATOMIC_ACQUIRE)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&queue->wakeCond, &queue->wakeMutex, &deadline);
+        }
+    
+        __atomic_store_n(&queue->consumerSleeping, 0, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&queue->wakeMutex);
+    }
+    
+    drainQueue(queue);
+    return NULL;
+}
+
+DispatchQueue* dispatchQueueStart(void) {
+    DispatchQueue* queue = NULL;
+    if (posix_memalign((void**)&queue, CACHE_LINE, sizeof(DispatchQueue)) != 0) {
+        perror("Failed to allocate dispatch queue");
+        return NULL;
+    }
+    memset(queue, 0, sizeof(*queue));
+    
+    queue->pool = malloc(sizeof(PacketBuffer) * DISPATCH_QUEUE_SIZE);
+    if (!queue->pool) {
+        perror("Failed to allocate packet pool");
+        free(queue);
+        return NULL;
+    }
+    
+    for (uint32_t i = 0; i < DISPATCH_QUEUE_SIZE; i++) {
+        queue->pool[i].data = queue->pool[i].inlineData;
+        spscPush(&queue->free, i);
+    }
+    
+    pthread_mutex_init(&queue->wakeMutex, NULL);
+    pthread_cond_init(&queue->wakeCond, NULL);
+    queue->running = 1;
+    
+    if (pthread_create(&queue->thread, NULL, dispatcherLoop, queue) != 0) {
+        perror("Failed to create dispatcher thread");
+        free(queue->pool);
+        free(queue);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&queuesMutex);
+    for (int i = 0; i < MAX_DISPATCH_QUEUES; i++) {
+        if (!queues[i]) {
+            queues[i] = queue;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&queuesMutex);
+    
+    return queue;
+}
+
+void dispatchQueueStop(DispatchQueue* queue) {
+    if (!queue) return;
+    
+    pthread_mutex_lock(&queuesMutex);
+    for (int i = 0; i < MAX_DISPATCH_QUEUES; i++) {
+        if (queues[i] == queue) {
+            queues[i] = NULL;
+        }
+    }
+    retiredDrops += queue->dropped;
+    pthread_mutex_unlock(&queuesMutex);
+    
+    __atomic_store_n(&queue->running, 0, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&queue->wakeMutex);
+    pthread_cond_signal(&queue->wakeCond);
+    pthread_mutex_unlock(&queue->wakeMutex);
+    pthread_join(queue->thread, NULL);
+    
+    pthread_mutex_destroy(&queue->wakeMutex);
+    pthread_cond_destroy(&queue->wakeCond);
+    free(queue->pool);
+    free(queue);
+}
+
+PacketBuffer* dispatchQueueAcquire(DispatchQueue* queue) {
+    if (!queue->spare) {
+        uint32_t index;
+        if (!spscPop(&queue->free, &index)) return NULL;
+        queue->spare = &queue->pool[index];
+    }
+    return queue->spare;
+}
+
+int dispatchQueueSubmit(DispatchQueue* queue, const char* data, size_t length,
+                        uint64_t originNs, uint64_t receivedNs) {
+    PacketBuffer* packet = dispatchQueueAcquire(queue);
+    if (!packet) {
+        statStore(&queue->dropped, queue->dropped + 1);
+        return -1;
+    }
+    
+    // Datagrams received straight into the pooled buffer need no copy
+    if (data != packet->data) {
+        if (length > DISPATCH_BUFFER_SIZE) {
+            packet->data = packetPoolAcquire(length);
+            if (!packet->data) {
+                packet->data = packet->inlineData;
+                statStore(&queue->dropped, queue->dropped + 1);
+                return -1;
+            }
+        }
+        memcpy(packet->data, data, length);
+    }
+    packet->data[length] = '\0';
+    packet->length = length;
+    packet->originNs = originNs;
+    packet->receivedNs = receivedNs;
+    queue->spare = NULL;
+    
+    spscPush(&queue->ready, (uint32_t)(packet - queue->pool));
+    statStore(&queue->submitted, queue->submitted + 1);
+    
+    uint64_t depth = queue->ready.head - __atomic_load_n(&queue->ready.tail, __ATOMIC_RELAXED);
+    if (depth > queue->highWater) {
+        statStore(&queue->highWater, depth);
+    }
+    
+    if (__atomic_load_n(&queue->consumerSleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&queue->wakeMutex);
+        pthread_cond_signal(&queue->wakeCond);
+        pthread_mutex_unlock(&queue->wakeMutex);
+    }
+    return 0;
+}
+
+uint64_t dispatchQueueDrops(void) {
+    pthread_mutex_lock(&queuesMutex);
+    uint64_t drops = retiredDrops;
+    for (int i = 0; i < MAX_DISPATCH_QUEUES; i++) {
+        if (queues[i]) {
+            drops += __atomic_load_n(&queues[i]->dropped, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&queuesMutex);
+    return drops;
+}
+
+void printDispatchQueueStats(void) {
+    pthread_mutex_lock(&queuesMutex);
+    
+    int header = 0;
+    for (int i = 0; i < MAX_DISPATCH_QUEUES; i++) {
+        DispatchQueue* queue = queues[i];
+        if (!queue) continue;
+    
+        if (!header) {
+            printf("\n%-8s %-8s %-10s %-10s %-12s %s\n", "Queue", "Depth", "HighWater", "Capacity", "Submitted", "Dropped");
+            printf("%-8s %-8s %-10s %-10s %-12s %s\n", "-----", "-----", "---------", "--------", "---------", "-------");
+            header = 1;
+        }
+        printf("%-8d %-8llu %-10llu %-10d %-12llu %llu\n", i,
+               (unsigned long long)spscDepth(&queue->ready),
+               (unsigned long long)__atomic_load_n(&queue->highWater, __ATOMIC_RELAXED),
+               DISPATCH_QUEUE_SIZE,
+               (unsigned long long)__atomic_load_n(&queue->submitted, __ATOMIC_RELAXED),
+               (unsigned long long)__atomic_load_n(&queue->dropped, __ATOMIC_RELAXED));
+    }
+    
+    pthread_mutex_unlock(&queuesMutex);
+}
+
+void writeDispatchQueueMetrics(FILE* out) {
+    pthread_mutex_lock(&queuesMutex);
+    
+    fprintf(out, "# HELP osc_dispatch_queue_depth Packets waiting for the dispatcher thread\n");
+    fprintf(out, "# TYPE osc_dispatch_queue_depth gauge\n");
+    for (int i = 0; i < MAX_DISPATCH_QUEUES; i++) {
+        if (queues[i]) {
+            fprintf(out, "osc_dispatch_queue_depth{queue=\"%d\"} %llu\n", i,
+                    (unsigned long long)spscDepth(&queues[i]->ready));
+        }
+    }
+    
+    fprintf(out, "# HELP osc_dispatch_queue_high_water Deepest the dispatch queue has been\n");
+    fprintf(out, "# TYPE osc_dispatch_queue_high_water gauge\n");
+    for (int i = 0; i < MAX_DISPATCH_QUEUES; i++) {
+        if (queues[i]) {
+            fprintf(out, "osc_dispatch_queue_high_water{queue=\"%d\"} %llu\n", i,
+                    (unsigned long long)__atomic_load_n(&queues[i]->highWater, __ATOMIC_RELAXED));
+        }
+    }
+    
+    pthread_mutex_unlock(&queuesMutex);
+}
@@ -0,0 +1,45 @@
+#ifndef DISPATCH_QUEUE_H
+#define DISPATCH_QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define DISPATCH_QUEUE_SIZE 1024            // Ring slots and pooled buffers, power of two
+#define DISPATCH_BUFFER_SIZE 1024           // Datagrams up to this size stay in the pooled buffer
+#define MAX_DISPATCH_QUEUES 8               // One per receiving thread
+
+// Pooled packet; the receiver fills it, the dispatcher processes and
+// returns it. Only indices travel through the rings. data points at
+// inlineData, or at a packet pool buffer for longer datagrams
+typedef struct {
+    uint64_t originNs;                      // Kernel receive on the monotonic clock, 0 if unknown
+    uint64_t receivedNs;                    // Monotonic time the receiver read it
+    size_t length;
+    char* data;
+    char inlineData[DISPATCH_BUFFER_SIZE + 1];
+} PacketBuffer;
+
+typedef struct DispatchQueue DispatchQueue;
+
+// Allocates the pool and starts the dispatcher thread. The thread that
+// submits is the single producer
+DispatchQueue* dispatchQueueStart(void);
+// Processes what is still queued, then joins the dispatcher
+void dispatchQueueStop(DispatchQueue* queue);
+
+// Buffer the next datagram can be received into, or NULL when the pool is
+// exhausted. Stays reserved until submitted, so an unused one is not lost
+PacketBuffer* dispatchQueueAcquire(DispatchQueue* queue);
+// Queues a datagram; data that is not the acquired buffer is copied, into
+// a packet pool buffer when it is longer than DISPATCH_BUFFER_SIZE.
+// Returns -1 and counts a drop when either pool is exhausted
+int dispatchQueueSubmit(DispatchQueue* queue, const char* data, size_t length,
+                        uint64_t originNs, uint64_t receivedNs);
+
+// Packets dropped because a pool was exhausted, including stopped queues
+uint64_t dispatchQueueDrops(void);
+void printDispatchQueueStats(void);
+void writeDispatchQueueMetrics(FILE* out);
+
+#endif
@@ -0,0 +1,389 @@
+#include "eventLoop.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+typedef enum {
+    SOURCE_FREE,
+    SOURCE_FD,
+    SOURCE_TIMER,
+    SOURCE_SIGNAL,
+    SOURCE_WAKE
+} SourceType;
+
+typedef struct {
+    SourceType type;
+    int fd;
+    uint32_t generation;            // Bumped on every reuse so stale epoll events are ignored
+    int oneShot;
+    EventCallback fdCallback;
+    TimerCallback timerCallback;
+    void* context;
+} EventSource;
+
+typedef struct {
+    TimerCallback callback;
+    void* context;
+} PostedCall;
+
+static EventSource sources[EVENT_LOOP_MAX_SOURCES];
+static pthread_mutex_t sourceMutex = PTHREAD_MUTEX_INITIALIZER;
+static PostedCall postedCalls[EVENT_LOOP_MAX_POSTS];   // Under sourceMutex
+static int postedCount = 0;
+static int epollFd = -1;
+static int wakeFd = -1;
+static SignalCallback signalCallback = NULL;
+static int stopRequested = 0;
+static pthread_t loopThread;
+static int loopThreadValid = 0;
+
+static int addSource(SourceType type, int fd, uint32_t events, EventSource* settings) {
+    pthread_mutex_lock(&sourceMutex);
+    
+    int slot = -1;
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (sources[i].type == SOURCE_FREE) {
+            slot = i;
+            break;
+        }
+    }
+    
+    if (slot < 0) {
+        pthread_mutex_unlock(&sourceMutex);
+        fprintf(stderr, "Event loop: no free source slots\n");
+        return -1;
+    }
+    
+    EventSource* source = &sources[slot];
+    uint32_t generation = source->generation + 1;
+    *source = *settings;
+    source->type = type;
+    source->fd = fd;
+    source->generation = generation;
+    
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = ((uint64_t)generation << 32) | (uint32_t)slot;
+    
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        int savedErrno = errno;
+        source->type = SOURCE_FREE;
+        pthread_mutex_unlock(&sourceMutex);
+        errno = savedErrno;
+        return -1;
+    }
+    
+    pthread_mutex_unlock(&sourceMutex);
+    return slot;
+}
+
+// Caller holds sourceMutex
+static void releaseSource(int slot, int closeFd) {
+    EventSource* source = &sources[slot];
+    if (source->type == SOURCE_FREE) return;
+    
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, source->fd, NULL);
+    if (closeFd) {
+        close(source->fd);
+    }
+    source->type = SOURCE_FREE;
+    source->generation++;
+}
+
+int eventLoopInit(void) {
+    if (epollFd >= 0) return 0;
+    
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+    
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        perror("eventfd failed");
+        close(epollFd);
+        epollFd = -1;
+        return -1;
+    }
+    
+    EventSource settings;
+    memset(&settings, 0, sizeof(settings));
+    if (addSource(SOURCE_WAKE, wakeFd, EPOLLIN, &settings) < 0) {
+        perror("Event loop wake registration failed");
+        eventLoopShutdown();
+        return -1;
+    }
+    
+    return 0;
+}
+
+void eventLoopShutdown(void) {
+    pthread_mutex_lock(&sourceMutex);
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        // Plain fd sources belong to their callers
+        releaseSource(i, sources[i].type != SOURCE_FD);
+    }
+    pthread_mutex_unlock(&sourceMutex);
+    
+    wakeFd = -1;
+    if (epollFd >= 0) {
+        close(epollFd);
+        epollFd = -1;
+    }
+}
+
+int eventLoopAddFd(int fd, uint32_t events, EventCallback callback, void* context) {
+    EventSource settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.fdCallback = callback;
+    settings.context = context;
+    return addSource(SOURCE_FD, fd, events, &settings) < 0 ? -1 : 0;
+}
+
+int eventLoopModifyFd(int fd, uint32_t events) {
+    int result = -1;
+    
+    pthread_mutex_lock(&sourceMutex);
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (sources[i].type == SOURCE_FD && sources[i].fd == fd) {
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = events;
+            event.data.u64 = ((uint64_t)sources[i].generation << 32) | (uint32_t)i;
+            result = epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sourceMutex);
+    
+    return result;
+}
+
+void eventLoopRemoveFd(int fd) {
+    pthread_mutex_lock(&sourceMutex);
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (sources[i].type == SOURCE_FD && sources[i].fd == fd) {
+            releaseSource(i, 0);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sourceMutex);
+}
+
+int eventLoopAddTimer(uint64_t delayNs, uint64_t intervalNs, TimerCallback callback, void* context) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        perror("timerfd_create failed");
+        return -1;
+    }
+    
+    // A zero it_value would disarm the timer, so "now" becomes 1ns
+    if (delayNs == 0) delayNs = 1;
+    
+    struct itimerspec spec;
+    spec.it_value.tv_sec = (time_t)(delayNs / 1000000000ULL);
+    spec.it_value.tv_nsec = (long)(delayNs % 1000000000ULL);
+    spec.it_interval.tv_sec = (time_t)(intervalNs / 1000000000ULL);
+    spec.it_interval.tv_nsec = (long)(intervalNs % 1000000000ULL);
+    
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0) {
+        perror("timerfd_settime failed");
+        close(fd);
+        return -1;
+    }
+    
+    EventSource settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.timerCallback = callback;
+    settings.context = context;
+    settings.oneShot = intervalNs == 0;
+    
+    int slot = addSource(SOURCE_TIMER, fd, EPOLLIN, &settings);
+    if (slot < 0) {
+        close(fd);
+    }
+    return slot;
+}
+
+void eventLoopCancelTimer(int timer) {
+    if (timer < 0 || timer >= EVENT_LOOP_MAX_SOURCES) return;
+    
+    pthread_mutex_lock(&sourceMutex);
+    if (sources[timer].type == SOURCE_TIMER) {
+        releaseSource(timer, 1);
+    }
+    pthread_mutex_unlock(&sourceMutex);
+}
+
+int eventLoopWatchSignals(const int* signals, int count, SignalCallback callback) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int i = 0; i < count; i++) {
+        sigaddset(&mask, signals[i]);
+    }
+    
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+        perror("pthread_sigmask failed");
+        return -1;
+    }
+    
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        perror("signalfd failed");
+        return -1;
+    }
+    
+    signalCallback = callback;
+    
+    EventSource settings;
+    memset(&settings, 0, sizeof(settings));
+    if (addSource(SOURCE_SIGNAL, fd, EPOLLIN, &settings) < 0) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+int eventLoopPost(TimerCallback callback, void* context) {
+    pthread_mutex_lock(&sourceMutex);
+    if (wakeFd < 0 || !__atomic_load_n(&loopThreadValid, __ATOMIC_ACQUIRE) || postedCount >= EVENT_LOOP_MAX_POSTS) {
+        pthread_mutex_unlock(&sourceMutex);
+        return -1;
+    }
+    postedCalls[postedCount++] = (PostedCall){ callback, context };
+    pthread_mutex_unlock(&sourceMutex);
+    
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // Counter saturated; the loop is already due to wake
+    }
+    return 0;
+}
+
+static void runPostedCalls(void) {
+    PostedCall calls[EVENT_LOOP_MAX_POSTS];
+    
+    pthread_mutex_lock(&sourceMutex);
+    int count = postedCount;
+    memcpy(calls, postedCalls, sizeof(PostedCall) * (size_t)count);
+    postedCount = 0;
+    pthread_mutex_unlock(&sourceMutex);
+    
+    for (int i = 0; i < count; i++) {
+        calls[i].callback(calls[i].context);
+    }
+}
+
+static void dispatchEvent(const struct epoll_event* event) {
+    int slot = (int)(event->data.u64 & 0xffffffffu);
+    uint32_t generation = (uint32_t)(event->data.u64 >> 32);
+    
+    pthread_mutex_lock(&sourceMutex);
+    if (slot >= EVENT_LOOP_MAX_SOURCES || sources[slot].type == SOURCE_FREE ||
+        sources[slot].generation != generation) {
+        pthread_mutex_unlock(&sourceMutex);
+        return;
+    }
+    
+    EventSource source = sources[slot];
+    
+    // One-shot timers are gone before their callback runs, so the callback
+    // may freely schedule the next timer
+    if (source.type == SOURCE_TIMER && source.oneShot) {
+        uint64_t expirations;
+        if (read(source.fd, &expirations, sizeof(expirations)) < 0) {
+            // Spurious wakeup; the timer has not expired yet
+            pthread_mutex_unlock(&sourceMutex);
+            return;
+        }
+        releaseSource(slot, 1);
+    }
+    pthread_mutex_unlock(&sourceMutex);
+    
+    switch (source.type) {
+        case SOURCE_FD:
+            source.fdCallback(source.fd, event->events, source.context);
+            break;
+    
+        case SOURCE_TIMER: {
+            if (!source.oneShot) {
+                uint64_t expirations;
+                if (read(source.fd, &expirations, sizeof(expirations)) < 0) break;
+            }
+            source.timerCallback(source.context);
+            break;
+        }
+    
+        case SOURCE_SIGNAL: {
+            struct signalfd_siginfo info;
+            while (read(source.fd, &info, sizeof(info)) == sizeof(info)) {
+                if (signalCallback) {
+                    signalCallback((int)info.ssi_signo);
+                }
+            }
+            break;
+        }
+    
+        case SOURCE_WAKE: {
+            uint64_t value;
+            if (read(source.fd, &value, sizeof(value)) < 0) {
+                // Nothing pending; the wakeup was already consumed
+            }
+            runPostedCalls();
+            break;
+        }
+    
+        default:
+            break;
+    }
+}
+
+int eventLoopRun(void) {
+    if (epollFd < 0) return -1;
+    
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    loopThread = pthread_self();
+    __atomic_store_n(&loopThreadValid, 1, __ATOMIC_RELEASE);
+    
+    while (!__atomic_load_n(&stopRequested, __ATOMIC_ACQUIRE)) {
+        int count = epoll_wait(epollFd, events, EVENT_LOOP_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+    
+        for (int i = 0; i < count && !__atomic_load_n(&stopRequested, __ATOMIC_ACQUIRE); i++) {
+            dispatchEvent(&events[i]);
+        }
+    }
+    
+    pthread_mutex_lock(&sourceMutex);
+    __atomic_store_n(&loopThreadValid, 0, __ATOMIC_RELEASE);
+    postedCount = 0;
+    pthread_mutex_unlock(&sourceMutex);
+    return 0;
+}
+
+void eventLoopStop(void) {
+    __atomic_store_n(&stopRequested, 1, __ATOMIC_RELEASE);
+    
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            // Counter saturated; the loop is already due to wake
+        }
+    }
+}
+
+int onEventLoopThread(void) {
+    return __atomic_load_n(&loopThreadValid, __ATOMIC_ACQUIRE) && pthread_equal(pthread_self(), loopThread);
+}
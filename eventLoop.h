@@ -0,0 +1,42 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#define EVENT_LOOP_MAX_SOURCES 256
+#define EVENT_LOOP_MAX_EVENTS 32            // Ready events handled per epoll_wait
+#define EVENT_LOOP_MAX_POSTS 256            // Calls queued from other threads
+
+typedef void (*EventCallback)(int fd, uint32_t events, void* context);
+typedef void (*TimerCallback)(void* context);
+typedef void (*SignalCallback)(int signal);
+
+int eventLoopInit(void);
+void eventLoopShutdown(void);
+
+// Sources are level-triggered; callbacks run on the loop thread
+int eventLoopAddFd(int fd, uint32_t events, EventCallback callback, void* context);
+// Changes the events a registered fd waits for, keeping its callback
+int eventLoopModifyFd(int fd, uint32_t events);
+void eventLoopRemoveFd(int fd);
+
+// Returns a timer id (>= 0). intervalNs 0 makes a one-shot timer that
+// removes itself before its callback runs
+int eventLoopAddTimer(uint64_t delayNs, uint64_t intervalNs, TimerCallback callback, void* context);
+void eventLoopCancelTimer(int timer);
+
+// Blocks the signals in the calling thread (call before starting other
+// threads so they inherit the mask) and delivers them through a signalfd
+int eventLoopWatchSignals(const int* signals, int count, SignalCallback callback);
+
+// Runs callback on the loop thread soon, woken through the wake eventfd.
+// Safe from any thread; -1 when the queue is full or the loop is not
+// running. Calls still queued when the loop stops are dropped
+int eventLoopPost(TimerCallback callback, void* context);
+
+int eventLoopRun(void);
+void eventLoopStop(void);                   // Safe from any thread
+int onEventLoopThread(void);
+
+#endif
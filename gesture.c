@@ -0,0 +1,127 @@
+#include "gesture.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+
+// Gesture traffic is a handful of edges per second, so one lock shared by
+// every gesture is enough to serialize receivers and the timer wheel
+static pthread_mutex_t gestureMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct {
+    const char* name;
+    GestureKind kind;
+} gestureNames[] = {
+    {"longpress", GESTURE_LONG_PRESS},
+    {"doubletap", GESTURE_DOUBLE_TAP},
+    {"hold", GESTURE_HOLD_RELEASE}
+};
+
+int compileGesture(const char* text, Gesture* gesture) {
+    memset(gesture, 0, sizeof(Gesture));
+    
+    while (text && isspace((unsigned char)*text)) text++;
+    if (!text || !*text || strcasecmp(text, "none") == 0) return 0;
+    
+    for (size_t g = 0; g < sizeof(gestureNames) / sizeof(gestureNames[0]); g++) {
+        size_t length = strlen(gestureNames[g].name);
+        if (strncasecmp(text, gestureNames[g].name, length) != 0 || !isspace((unsigned char)text[length])) {
+            continue;
+        }
+    
+        char* end;
+        long thresholdMs = strtol(text + length, &end, 10);
+        while (isspace((unsigned char)*end)) end++;
+        if (end == text + length || *end || thresholdMs <= 0 || thresholdMs > 60000) return -1;
+    
+        gesture->kind = (uint8_t)gestureNames[g].kind;
+        gesture->thresholdMs = (uint32_t)thresholdMs;
+        return 0;
+    }
+    return -1;
+}
+
+GestureResult updateGesture(Gesture* gesture, int hasValue, double value, uint64_t nowNs, uint32_t* sequence) {
+    if (!hasValue) return GESTURE_IGNORED;
+    
+    uint8_t pressed = value != 0.0;
+    GestureResult result = GESTURE_IGNORED;
+    
+    pthread_mutex_lock(&gestureMutex);
+    uint64_t thresholdNs = (uint64_t)gesture->thresholdMs * 1000000ULL;
+    
+    if (pressed == gesture->pressed) {
+        pthread_mutex_unlock(&gestureMutex);
+        return GESTURE_IGNORED;
+    }
+    
+    gesture->pressed = pressed;
+    gesture->sequence++;
+    
+    switch (gesture->kind) {
+        case GESTURE_LONG_PRESS:
+            if (pressed) {
+                gesture->fired = 0;
+                *sequence = gesture->sequence;
+                result = GESTURE_ARM;
+            }
+            break;
+    
+        case GESTURE_DOUBLE_TAP:
+            if (pressed) {
+                if (gesture->tapNs && nowNs - gesture->tapNs <= thresholdNs) {
+                    gesture->tapNs = 0;
+                    result = GESTURE_FIRE;
+                } else {
+                    gesture->tapNs = nowNs;
+                }
+            }
+            break;
+    
+        case GESTURE_HOLD_RELEASE:
+            if (!pressed && gesture->pressNs && nowNs - gesture->pressNs >= thresholdNs) {
+                result = GESTURE_FIRE;
+            }
+            break;
+    
+        default:
+            break;
+    }
+    
+    gesture->pressNs = pressed ? nowNs : 0;
+    
+    pthread_mutex_unlock(&gestureMutex);
+    return result;
+}
+
+int expireGesture(Gesture* gesture, uint32_t sequence) {
+    pthread_mutex_lock(&gestureMutex);
+    
+    int fire = gesture->kind == GESTURE_LONG_PRESS && gesture->pressed && !gesture->fired &&
+               gesture->sequence == sequence;
+    if (fire) {
+        gesture->fired = 1;
+    }
+    
+    pthread_mutex_unlock(&gestureMutex);
+    return fire;
+}
+
+void resetGesture(Gesture* gesture) {
+    pthread_mutex_lock(&gestureMutex);
+    gesture->pressed = 0;
+    gesture->fired = 0;
+    gesture->sequence++;
+    gesture->pressNs = 0;
+    gesture->tapNs = 0;
+    pthread_mutex_unlock(&gestureMutex);
+}
+
+void setGesture(Gesture* gesture, const Gesture* compiled) {
+    pthread_mutex_lock(&gestureMutex);
+    uint32_t sequence = gesture->sequence + 1;
+    *gesture = *compiled;
+    gesture->sequence = sequence;
+    pthread_mutex_unlock(&gestureMutex);
+}
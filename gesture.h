@@ -0,0 +1,47 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <stdint.h>
+
+#define MAX_GESTURE_LENGTH 32
+
+typedef enum {
+    GESTURE_NONE,
+    GESTURE_LONG_PRESS,             // Held for threshold; fires while still held
+    GESTURE_DOUBLE_TAP,             // Second press within threshold of the first
+    GESTURE_HOLD_RELEASE            // Released after being held for threshold
+} GestureKind;
+
+typedef enum {
+    GESTURE_IGNORED,                // No edge, or an edge that completes nothing
+    GESTURE_FIRE,
+    GESTURE_ARM                     // Long press started: schedule a check after thresholdMs
+} GestureResult;
+
+// A nonzero value is pressed, zero released, so bool and int parameters
+// both work. Only edges move the state machine; repeated values are no-ops
+typedef struct {
+    uint8_t kind;
+    uint8_t pressed;
+    uint8_t fired;                  // Long press already fired for this press
+    uint32_t thresholdMs;
+    uint32_t sequence;              // Bumped on every edge; stale checks carry an old one
+    uint64_t pressNs;
+    uint64_t tapNs;                 // Double tap: first press still waiting for a second, or 0
+} Gesture;
+
+// Text forms: longpress <ms> | doubletap <ms> | hold <ms> | none
+// Returns -1 when the text is not a gesture
+int compileGesture(const char* text, Gesture* gesture);
+// hasValue is 0 when the message carried no numeric argument; such updates
+// are ignored. sequence receives the token to schedule with on GESTURE_ARM.
+// Updates and checks for one gesture are serialized internally
+GestureResult updateGesture(Gesture* gesture, int hasValue, double value, uint64_t nowNs, uint32_t* sequence);
+// The scheduled check for a long press: 1 when the same press is still held
+int expireGesture(Gesture* gesture, uint32_t sequence);
+void resetGesture(Gesture* gesture);
+// Replaces a live filter's gesture; any press in progress starts over and
+// checks scheduled for it are dropped
+void setGesture(Gesture* gesture, const Gesture* compiled);
+
+#endif
@@ -0,0 +1,108 @@
+#include "histogram.h"
+#include <stdio.h>
+#include <string.h>
+
+static int bucketIndex(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) return (int)value;
+    
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= HISTOGRAM_MAX_MAGNITUDE) return HISTOGRAM_BUCKETS - 1;
+    
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) + (int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+static uint64_t bucketUpperBound(int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) return (uint64_t)index;
+    
+    int shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t subBucket = (uint64_t)(index & (HISTOGRAM_SUB_BUCKETS - 1));
+    return ((HISTOGRAM_SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
+
+static void relaxedAdd(uint64_t* counter, uint64_t amount) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+void histogramRecord(LatencyHistogram* histogram, uint64_t valueNs) {
+    relaxedAdd(&histogram->counts[bucketIndex(valueNs)], 1);
+    relaxedAdd(&histogram->totalCount, 1);
+    relaxedAdd(&histogram->sumNs, valueNs);
+    if (valueNs > __atomic_load_n(&histogram->maxNs, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&histogram->maxNs, valueNs, __ATOMIC_RELAXED);
+    }
+}
+
+void histogramRecordShared(LatencyHistogram* histogram, uint64_t valueNs) {
+    __atomic_fetch_add(&histogram->counts[bucketIndex(valueNs)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->totalCount, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sumNs, valueNs, __ATOMIC_RELAXED);
+    
+    uint64_t maxNs = __atomic_load_n(&histogram->maxNs, __ATOMIC_RELAXED);
+    while (valueNs > maxNs &&
+           !__atomic_compare_exchange_n(&histogram->maxNs, &maxNs, valueNs, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void histogramMerge(LatencyHistogram* into, const LatencyHistogram* from) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        into->counts[i] += __atomic_load_n(&from->counts[i], __ATOMIC_RELAXED);
+    }
+    into->totalCount += __atomic_load_n(&from->totalCount, __ATOMIC_RELAXED);
+    into->sumNs += __atomic_load_n(&from->sumNs, __ATOMIC_RELAXED);
+    
+    uint64_t maxNs = __atomic_load_n(&from->maxNs, __ATOMIC_RELAXED);
+    if (maxNs > into->maxNs) {
+        into->maxNs = maxNs;
+    }
+}
+
+void histogramReset(LatencyHistogram* histogram) {
+    memset(histogram, 0, sizeof(LatencyHistogram));
+}
+
+uint64_t histogramPercentile(const LatencyHistogram* histogram, double percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += histogram->counts[i];
+    }
+    if (total == 0) return 0;
+    
+    uint64_t target = (uint64_t)(percentile / 100.0 * total);
+    if (target >= total) target = total - 1;
+    
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen > target) {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < histogram->maxNs ? bound : histogram->maxNs;
+        }
+    }
+    
+    return histogram->maxNs;
+}
+
+void formatLatency(uint64_t valueNs, char* buffer, int bufferSize) {
+    if (valueNs < 1000) {
+        snprintf(buffer, bufferSize, "%lluns", (unsigned long long)valueNs);
+    } else if (valueNs < 1000000) {
+        snprintf(buffer, bufferSize, "%.1fus", valueNs / 1e3);
+    } else if (valueNs < 1000000000ULL) {
+        snprintf(buffer, bufferSize, "%.2fms", valueNs / 1e6);
+    } else {
+        snprintf(buffer, bufferSize, "%.2fs", valueNs / 1e9);
+    }
+}
+
+void printHistogramRow(const char* name, const LatencyHistogram* histogram) {
+    char p50[16], p90[16], p99[16], p999[16], max[16];
+    formatLatency(histogramPercentile(histogram, 50.0), p50, sizeof(p50));
+    formatLatency(histogramPercentile(histogram, 90.0), p90, sizeof(p90));
+    formatLatency(histogramPercentile(histogram, 99.0), p99, sizeof(p99));
+    formatLatency(histogramPercentile(histogram, 99.9), p999, sizeof(p999));
+    formatLatency(histogram->maxNs, max, sizeof(max));
+    
+    printf("%-16s %-10llu %-10s %-10s %-10s %-10s %s\n", name,
+           (unsigned long long)histogram->totalCount, p50, p90, p99, p999, max);
+}
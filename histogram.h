@@ -0,0 +1,32 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// Log-linear (HDR-style) buckets: 8 linear sub-buckets per power of two,
+// ~12.5% worst-case error over 1ns .. 2^40ns (about 18 minutes)
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_MAGNITUDE 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_MAGNITUDE - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t totalCount;
+    uint64_t sumNs;
+    uint64_t maxNs;
+} LatencyHistogram;
+
+// Single-writer recording: relaxed loads/stores, no read-modify-write,
+// so a reader on another thread sees untorn (if slightly stale) values
+void histogramRecord(LatencyHistogram* histogram, uint64_t valueNs);
+// For a histogram several threads record into: atomic read-modify-write
+void histogramRecordShared(LatencyHistogram* histogram, uint64_t valueNs);
+void histogramMerge(LatencyHistogram* into, const LatencyHistogram* from);
+void histogramReset(LatencyHistogram* histogram);
+uint64_t histogramPercentile(const LatencyHistogram* histogram, double percentile);
+void formatLatency(uint64_t valueNs, char* buffer, int bufferSize);
+// One row of the p50/p90/p99/p99.9/max tables printed by the CLI
+void printHistogramRow(const char* name, const LatencyHistogram* histogram);
+
+#endif
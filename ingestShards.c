@@ -0,0 +1,136 @@
+#include "ingestShards.h"
+#include "socket.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+typedef struct {
+    int sockfd;
+    int cpu;                                // -1 when unpinned
+    pthread_t thread;
+    const MetricsThreadSlot* metrics;       // Claimed by the shard thread
+} IngestShard;
+
+static IngestShard shards[MAX_INGEST_SHARDS];
+static int shardCount = 0;
+
+static void *shardThread(void *arg) {
+    IngestShard* shard = arg;
+    
+    if (shard->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shard->cpu, &cpus);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0) {
+            fprintf(stderr, "Pinning shard to CPU %d failed: %s\n", shard->cpu, strerror(result));
+            shard->cpu = -1;
+        }
+    }
+    
+    __atomic_store_n(&shard->metrics, metricsThreadSlot(), __ATOMIC_RELEASE);
+    receiveMessages(shard->sockfd);
+    return NULL;
+}
+
+// CPUs from the process affinity mask, so taskset and cgroup limits hold
+static int allowedCpus(int* cpus, int maxCpus) {
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) < 0) return 0;
+    
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && count < maxCpus; cpu++) {
+        if (CPU_ISSET(cpu, &mask)) {
+            cpus[count++] = cpu;
+        }
+    }
+    return count;
+}
+
+int startIngestShards(int port, int count) {
+    if (count < 1 || count > MAX_INGEST_SHARDS) {
+        printf("Shard count must be between 1 and %d\n", MAX_INGEST_SHARDS);
+        return -1;
+    }
+    
+    int cpus[CPU_SETSIZE];
+    int cpuCount = allowedCpus(cpus, CPU_SETSIZE);
+    if (cpuCount > 0 && count > cpuCount) {
+        printf("Warning: %d shards on %d CPUs; shards will share cores\n", count, cpuCount);
+    }
+    
+    for (int i = 0; i < count; i++) {
+        IngestShard* shard = &shards[i];
+        memset(shard, 0, sizeof(*shard));
+        shard->cpu = cpuCount > 0 ? cpus[i % cpuCount] : -1;
+        shard->sockfd = udpSocketReusePort(port);
+        if (shard->sockfd < 0) {
+            stopIngestShards();
+            return -1;
+        }
+    
+        if (pthread_create(&shard->thread, NULL, shardThread, shard) != 0) {
+            perror("Failed to create shard thread");
+            close(shard->sockfd);
+            stopIngestShards();
+            return -1;
+        }
+        shardCount++;
+    }
+    
+    return 0;
+}
+
+void stopIngestShards(void) {
+    if (shardCount == 0) return;
+    
+    stopReceiving();
+    for (int i = 0; i < shardCount; i++) {
+        // Wakes a receiver blocked in recvmsg or io_uring_enter
+        shutdown(shards[i].sockfd, SHUT_RD);
+    }
+    
+    for (int i = 0; i < shardCount; i++) {
+        pthread_join(shards[i].thread, NULL);
+        close(shards[i].sockfd);
+    }
+    shardCount = 0;
+}
+
+int ingestShardCount(void) {
+    return shardCount;
+}
+
+void printIngestShards(void) {
+    if (shardCount == 0) return;
+    
+    uint64_t totalPackets = 0;
+    uint64_t packets[MAX_INGEST_SHARDS];
+    uint64_t bytes[MAX_INGEST_SHARDS];
+    
+    for (int i = 0; i < shardCount; i++) {
+        const MetricsThreadSlot* slot = __atomic_load_n(&shards[i].metrics, __ATOMIC_ACQUIRE);
+        packets[i] = slot ? __atomic_load_n(&slot->packets, __ATOMIC_RELAXED) : 0;
+        bytes[i] = slot ? __atomic_load_n(&slot->bytes, __ATOMIC_RELAXED) : 0;
+        totalPackets += packets[i];
+    }
+    
+    printf("\nSO_REUSEPORT shards: %d\n", shardCount);
+    printf("%-8s %-6s %-12s %-12s %s\n", "Shard", "CPU", "Packets", "Bytes", "Share");
+    printf("%-8s %-6s %-12s %-12s %s\n", "-----", "---", "-------", "-----", "-----");
+    for (int i = 0; i < shardCount; i++) {
+        char cpu[16];
+        if (shards[i].cpu >= 0) {
+            snprintf(cpu, sizeof(cpu), "%d", shards[i].cpu);
+        } else {
+            snprintf(cpu, sizeof(cpu), "-");
+        }
+        printf("%-8d %-6s %-12llu %-12llu %.1f%%\n", i, cpu, (unsigned long long)packets[i],
+               (unsigned long long)bytes[i], totalPackets ? packets[i] * 100.0 / totalPackets : 0.0);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef INGEST_SHARDS_H
+#define INGEST_SHARDS_H
+
+#define MAX_INGEST_SHARDS 8                 // Metrics and trace size their thread slots from this
+
+// Binds count sockets to port with SO_REUSEPORT, each drained by its own
+// thread pinned to a CPU the process may run on. The kernel spreads
+// senders across the sockets by source address and port, so one sender
+// always lands on the same shard
+int startIngestShards(int port, int count);
+void stopIngestShards(void);
+int ingestShardCount(void);
+void printIngestShards(void);
+
+#endif
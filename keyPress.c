@@ -1,5 +1,6 @@
 #include "keyPress.h"
 #include "oscUtility.h"  
+#include "outputBackend.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -89,7 +90,7 @@ unsigned int hashFunction(const char* key) {
     
     while ((c = *key++)) {
         c = tolower(c);
-        hash = ((hash << 5) + hash) + c; /
+        hash = ((hash << 5) + hash) + c;
     }
     
     return hash % KEY_HASH_TABLE_SIZE;
@@ -259,7 +260,7 @@ int setupKeypressUinputDevice(void) {
         perror("Failed to open /dev/uinput for keypress - you may need to run as root or add user to input group");
         return -1;
     }
-
+    
     ioctl(keypress_uinput_fd, UI_SET_EVBIT, EV_KEY);
     ioctl(keypress_uinput_fd, UI_SET_EVBIT, EV_SYN);
     
@@ -277,7 +278,7 @@ int setupKeypressUinputDevice(void) {
     for (int key = KEY_ESC; key <= KEY_MICMUTE; key++) {
         ioctl(keypress_uinput_fd, UI_SET_KEYBIT, key);
     }
-
+    
     struct uinput_user_dev uidev;
     memset(&uidev, 0, sizeof(uidev));
     snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "OSC-KeyPress-Control");
@@ -285,14 +286,14 @@ int setupKeypressUinputDevice(void) {
     uidev.id.vendor = 0x1234;
     uidev.id.product = 0x5679;
     uidev.id.version = 1;
-
+    
     write(keypress_uinput_fd, &uidev, sizeof(uidev));
     ioctl(keypress_uinput_fd, UI_DEV_CREATE);
-
+    
     if (keyPressDebugEnabled) {
         printf("KeyPress control device initialized\n");
     }
-
+    
     return keypress_uinput_fd;
 }
 
@@ -316,7 +317,7 @@ int initKeyPressSystem(void) {
         return -1;
     }
     
-    if (setupKeypressUinputDevice() < 0) {
+    if (outputOpen(OUTPUT_DEVICE_KEYBOARD) < 0) {
         destroyKeyHashTable();
         return -1;
     }
@@ -333,7 +334,7 @@ int initKeyPressSystem(void) {
 
 void shutdownKeyPressSystem(void) {
     if (keyPressSystemInitialized) {
-        cleanupKeypressUinputDevice();
+        outputClose(OUTPUT_DEVICE_KEYBOARD);
         destroyKeyHashTable();
         keyPressSystemInitialized = 0;
         if (keyPressDebugEnabled) {
@@ -342,35 +343,12 @@ void shutdownKeyPressSystem(void) {
     }
 }
 
-int sendKeyEvent(int fd, int keycode, int value) {
-    struct input_event ie;
-    memset(&ie, 0, sizeof(ie));
-    ie.type = EV_KEY;
-    ie.code = keycode;
-    ie.value = value;
-    ie.time.tv_sec = 0;
-    ie.time.tv_usec = 0;
-    
-    if (write(fd, &ie, sizeof(ie)) != sizeof(ie)) {
-        return -1;
-    }
-    
-    ie.type = EV_SYN;
-    ie.code = SYN_REPORT;
-    ie.value = 0;
-    return write(fd, &ie, sizeof(ie));
-}
-
+// Press/release timings are submitted as one schedule so the output layer
+// can turn the gaps into event loop timers instead of sleeping
 int sendSingleKey(int keycode) {
-    int fd = setupKeypressUinputDevice();
-    if (fd < 0) return 0;
+    OutputStep steps[] = {{keycode, 1, 0}, {keycode, 0, 10}};
     
-    if (sendKeyEvent(fd, keycode, 1) < 0) return 0;
-    
-    struct timespec ts = {0, 10000000}; 
-    nanosleep(&ts, NULL);
-    
-    if (sendKeyEvent(fd, keycode, 0) < 0) return 0;
+    if (outputSubmit(OUTPUT_DEVICE_KEYBOARD, steps, 2) < 0) return 0;
     
     if (keyPressDebugEnabled) {
         printf("KeyPress: Sent key %s (%d)\n", getKeyNameFromCode(keycode), keycode);
@@ -380,24 +358,22 @@ int sendSingleKey(int keycode) {
 }
 
 int sendKeyCombo(const KeyAction* keys, int keyCount) {
-    int fd = setupKeypressUinputDevice();
-    if (fd < 0 || !keys || keyCount <= 0) return 0;
+    if (!keys || keyCount <= 0 || keyCount > OUTPUT_MAX_STEPS / 2) return 0;
+    
+    OutputStep steps[OUTPUT_MAX_STEPS];
+    int count = 0;
     
     for (int i = 0; i < keyCount; i++) {
-        if (sendKeyEvent(fd, keys[i].keycode, 1) < 0) return 0;
-        struct timespec ts = {0, 5000000}; // 5ms
-        nanosleep(&ts, NULL);
+        steps[count++] = (OutputStep){keys[i].keycode, 1, i == 0 ? 0 : 5};
     }
     
-    struct timespec ts = {0, 20000000}; // 20ms
-    nanosleep(&ts, NULL);
-    
+    // Hold the whole chord for 20ms before releasing in reverse order
     for (int i = keyCount - 1; i >= 0; i--) {
-        if (sendKeyEvent(fd, keys[i].keycode, 0) < 0) return 0;
-        struct timespec ts2 = {0, 5000000}; // 5ms
-        nanosleep(&ts2, NULL);
+        steps[count++] = (OutputStep){keys[i].keycode, 0, i == keyCount - 1 ? 25 : 5};
     }
     
+    if (outputSubmit(OUTPUT_DEVICE_KEYBOARD, steps, count) < 0) return 0;
+    
     if (keyPressDebugEnabled) {
         printf("KeyPress: Sent key combo with %d keys\n", keyCount);
     }
@@ -406,17 +382,18 @@ int sendKeyCombo(const KeyAction* keys, int keyCount) {
 }
 
 int sendKeySequence(const KeyAction* keys, int keyCount) {
-    if (!keys || keyCount <= 0) return 0;
+    if (!keys || keyCount <= 0 || keyCount > OUTPUT_MAX_STEPS / 2) return 0;
+    
+    OutputStep steps[OUTPUT_MAX_STEPS];
+    int count = 0;
     
     for (int i = 0; i < keyCount; i++) {
-        if (!sendSingleKey(keys[i].keycode)) return 0;
-        
-        if (i < keyCount - 1) {
-            struct timespec ts = {0, 50000000}; // 50ms
-            nanosleep(&ts, NULL);
-        }
+        steps[count++] = (OutputStep){keys[i].keycode, 1, i == 0 ? 0 : 50};
+        steps[count++] = (OutputStep){keys[i].keycode, 0, 10};
     }
     
+    if (outputSubmit(OUTPUT_DEVICE_KEYBOARD, steps, count) < 0) return 0;
+    
     if (keyPressDebugEnabled) {
         printf("KeyPress: Sent key sequence with %d keys\n", keyCount);
     }
@@ -425,15 +402,9 @@ int sendKeySequence(const KeyAction* keys, int keyCount) {
 }
 
 int sendKeyHold(int keycode, int duration_ms) {
-    int fd = setupKeypressUinputDevice();
-    if (fd < 0) return 0;
-    
-    if (sendKeyEvent(fd, keycode, 1) < 0) return 0;
+    OutputStep steps[] = {{keycode, 1, 0}, {keycode, 0, duration_ms}};
     
-    struct timespec ts = {duration_ms / 1000, (duration_ms % 1000) * 1000000};
-    nanosleep(&ts, NULL);
-    
-    if (sendKeyEvent(fd, keycode, 0) < 0) return 0;
+    if (outputSubmit(OUTPUT_DEVICE_KEYBOARD, steps, 2) < 0) return 0;
     
     if (keyPressDebugEnabled) {
         printf("KeyPress: Held key %s for %dms\n", getKeyNameFromCode(keycode), duration_ms);
@@ -514,36 +485,30 @@ int parseKeyString(const char* keyString, KeyPressAction* action) {
     return 1;
 }
 
-int executeKeyPress(const char* keyString) {
-    if (!keyString) return 0;
+int sendKeyPressAction(const KeyPressAction* action) {
+    if (!action) return 0;
     
     if (initKeyPressSystem() < 0) {
         printf("Failed to initialize keypress system\n");
         return 0;
     }
     
-    KeyPressAction action;
-    if (!parseKeyString(keyString, &action)) {
-        printf("Failed to parse key string: %s\n", keyString);
-        return 0;
-    }
-    
     if (keyPressDebugEnabled) {
-        printf("Executing keypress: %s\n", action.description);
+        printf("Executing keypress: %s\n", action->description);
     }
     
-    switch (action.type) {
+    switch (action->type) {
         case KEY_ACTION_SINGLE:
-            return sendSingleKey(action.keys[0].keycode);
+            return sendSingleKey(action->keys[0].keycode);
             
         case KEY_ACTION_COMBO:
-            return sendKeyCombo(action.keys, action.keyCount);
+            return sendKeyCombo(action->keys, action->keyCount);
             
         case KEY_ACTION_SEQUENCE:
-            return sendKeySequence(action.keys, action.keyCount);
+            return sendKeySequence(action->keys, action->keyCount);
             
         case KEY_ACTION_HOLD:
-            return sendKeyHold(action.keys[0].keycode, action.keys[0].duration_ms);
+            return sendKeyHold(action->keys[0].keycode, action->keys[0].duration_ms);
             
         default:
             printf("Unknown key action type\n");
@@ -551,6 +516,23 @@ int executeKeyPress(const char* keyString) {
     }
 }
 
+int executeKeyPress(const char* keyString) {
+    if (!keyString) return 0;
+    
+    if (initKeyPressSystem() < 0) {
+        printf("Failed to initialize keypress system\n");
+        return 0;
+    }
+    
+    KeyPressAction action;
+    if (!parseKeyString(keyString, &action)) {
+        printf("Failed to parse key string: %s\n", keyString);
+        return 0;
+    }
+    
+    return sendKeyPressAction(&action);
+}
+
 void listAvailableKeys(void) {
     if (!keyHashTable) {
         printf("Key hash table not initialized\n");
@@ -614,28 +596,39 @@ void listKeyPressExamples(void) {
     printf("\nNote: Hash table provides O(1) key lookup performance!\n");
 }
 
-int executeBuiltinKeyAction(const char* actionName, const char* parameter) {
-    if (strcmp(actionName, "key") == 0 && parameter) {
-        return executeKeyPress(parameter);
+const char* resolveBuiltinKeyString(const char* actionName, const char* parameter) {
+    if (!actionName) return NULL;
+    
+    if (strcmp(actionName, "key") == 0) {
+        return parameter;
     }
     
     if (strcmp(actionName, "copy") == 0) {
-        return executeKeyPress("ctrl+c");
+        return "ctrl+c";
     } else if (strcmp(actionName, "paste") == 0) {
-        return executeKeyPress("ctrl+v");
+        return "ctrl+v";
     } else if (strcmp(actionName, "cut") == 0) {
-        return executeKeyPress("ctrl+x");
+        return "ctrl+x";
     } else if (strcmp(actionName, "undo") == 0) {
-        return executeKeyPress("ctrl+z");
+        return "ctrl+z";
     } else if (strcmp(actionName, "redo") == 0) {
-        return executeKeyPress("ctrl+y");
+        return "ctrl+y";
     } else if (strcmp(actionName, "select-all") == 0) {
-        return executeKeyPress("ctrl+a");
+        return "ctrl+a";
     } else if (strcmp(actionName, "alt-tab") == 0) {
-        return executeKeyPress("alt+tab");
+        return "alt+tab";
     } else if (strcmp(actionName, "screenshot") == 0) {
-        return executeKeyPress("printscreen");
+        return "printscreen";
+    }
+    
+    return NULL;
+}
+
+int executeBuiltinKeyAction(const char* actionName, const char* parameter) {
+    const char* keyString = resolveBuiltinKeyString(actionName, parameter);
+    if (!keyString) {
+        return 0;
     }
     
-    return 0; 
+    return executeKeyPress(keyString);
 }
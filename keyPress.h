@@ -55,6 +55,7 @@ int initKeyPressSystem(void);
 void shutdownKeyPressSystem(void);
 int executeKeyPress(const char* keyString);
 int parseKeyString(const char* keyString, KeyPressAction* action);
+int sendKeyPressAction(const KeyPressAction* action);
 
 // Hash table functions
 unsigned int hashFunction(const char* key);
@@ -71,12 +72,17 @@ int sendKeyCombo(const KeyAction* keys, int keyCount);
 int sendKeySequence(const KeyAction* keys, int keyCount);
 int sendKeyHold(int keycode, int duration_ms);
 
+// uinput keyboard device, driven through the output backend
+int setupKeypressUinputDevice(void);
+void cleanupKeypressUinputDevice(void);
+
 // Utility functions
 void listAvailableKeys(void);
 void listKeyPressExamples(void);
 
 // Built-in key press actions
 int executeBuiltinKeyAction(const char* actionName, const char* parameter);
+const char* resolveBuiltinKeyString(const char* actionName, const char* parameter);
 
 extern int keyPressSystemInitialized;
 extern int keyPressDebugEnabled;
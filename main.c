@@ -7,31 +7,133 @@
 #include <signal.h>
 #include "socket.h"
 #include "oscUtility.h"
+#include "stateJournal.h"
 #include "mediaControl.h"
 #include "keyPress.h"
+#include "startupReport.h"
+#include "metrics.h"
+#include "asyncLog.h"
+#include "capture.h"
+#include "outputBackend.h"
+#include "trace.h"
+#include "eventLoop.h"
+#include "ingestShards.h"
 
 #define PORT_IN 9001
 #define CLIENT "127.0.0.1"
 #define PORT_OUT 9000
 
 int sockfd;
-int running = 1;
+static char traceRecordPath[256];
+static int traceSampleEvery = TRACE_DEFAULT_SAMPLE;
+static int shardCount = 0;
 
-void runCLI(void);
+int startCLI(void);
 
-void parseArguments(int argc, char *argv[], int *inPort, char *clientIP, int *outPort, int *listenOnly) {
+// "4m", "512k" or plain bytes
+static int parseByteSize(const char* text) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (*end == 'k' || *end == 'K') value *= 1024;
+    if (*end == 'm' || *end == 'M') value *= 1024 * 1024;
+    return value > 0 && value <= 0x7fffffff ? (int)value : 0;
+}
+
+void parseArguments(int argc, char *argv[], int *inPort, char *clientIP, int *outPort, int *listenOnly,
+                    int *startupReport, int *metricsPort, char *logFile,
+                    char *capturePath, char *replayPath, double *replaySpeed) {
     *listenOnly = 0;
+    *startupReport = 0;
+    *metricsPort = 0;
     
     for (int i = 1; i < argc; i++) {
         if (strncmp(argv[i], "--osc=", 6) == 0) {
             sscanf(argv[i] + 6, "%d:%[^:]:%d", inPort, clientIP, outPort);
         } else if (strcmp(argv[i], "--listen-only") == 0) {
             *listenOnly = 1;
+        } else if (strcmp(argv[i], "--startup-report") == 0) {
+            *startupReport = 1;
+        } else if (strncmp(argv[i], "--log-file=", 11) == 0) {
+            strncpy(logFile, argv[i] + 11, 255);
+            logFile[255] = '\0';
+        } else if (strncmp(argv[i], "--log-level=", 12) == 0) {
+            int level = parseLogLevel(argv[i] + 12);
+            if (level < 0) {
+                printf("Unknown log level '%s' (error, warn, info, debug, trace)\n", argv[i] + 12);
+                exit(1);
+            }
+            logLevel = level;
+        } else if (strncmp(argv[i], "--log-subsystems=", 17) == 0) {
+            if (parseLogSubsystems(argv[i] + 17, &logSubsystemMask) < 0) {
+                printf("Unknown log subsystem in '%s' (net, filter, rate, action, avatar, all)\n", argv[i] + 17);
+                exit(1);
+            }
+        } else if (strncmp(argv[i], "--capture=", 10) == 0) {
+            strncpy(capturePath, argv[i] + 10, 255);
+            capturePath[255] = '\0';
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            strncpy(replayPath, argv[i] + 9, 255);
+            replayPath[255] = '\0';
+        } else if (strncmp(argv[i], "--replay-speed=", 15) == 0) {
+            *replaySpeed = atof(argv[i] + 15);
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            if (selectOutputBackend(argv[i] + 9) < 0) {
+                printf("Unknown output backend '%s' (uinput, ring, file:<path>)\n", argv[i] + 9);
+                exit(1);
+            }
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            strncpy(traceRecordPath, argv[i] + 8, sizeof(traceRecordPath) - 1);
+        } else if (strncmp(argv[i], "--trace-sample=", 15) == 0) {
+            traceSampleEvery = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--ingest=", 9) == 0) {
+            if (selectIngestBackend(argv[i] + 9) < 0) {
+                printf("Unknown ingest backend '%s' (auto, io_uring, recvmsg)\n", argv[i] + 9);
+                exit(1);
+            }
+        } else if (strncmp(argv[i], "--rcvbuf=", 9) == 0) {
+            setSocketReceiveBuffer(parseByteSize(argv[i] + 9));
+        } else if (strncmp(argv[i], "--busy-poll=", 12) == 0) {
+            setSocketBusyPoll(atoi(argv[i] + 12));
+        } else if (strcmp(argv[i], "--dispatch-thread") == 0) {
+            setDispatchThread(1);
+        } else if (strncmp(argv[i], "--shards=", 9) == 0) {
+            shardCount = atoi(argv[i] + 9);
+            if (shardCount < 1 || shardCount > MAX_INGEST_SHARDS) {
+                printf("Shard count must be between 1 and %d\n", MAX_INGEST_SHARDS);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            *metricsPort = METRICS_DEFAULT_PORT;
+        } else if (strncmp(argv[i], "--metrics=", 10) == 0) {
+            *metricsPort = atoi(argv[i] + 10);
         } else if (strcmp(argv[i], "--help") == 0) {
             printf("Usage: %s [options]\n", argv[0]);
             printf("Options:\n");
             printf("  --osc=<inport>:<ip>:<outport>  Set OSC ports and IP\n");
             printf("  --listen-only                  Run in listen-only mode (no CLI)\n");
+            printf("  --startup-report               Print startup time breakdown\n");
+            printf("  --log-file=<path>              Write message log to a rotating file\n");
+            printf("  --log-level=<level>            error, warn, info, debug (default) or trace\n");
+            printf("  --log-subsystems=<list>        Comma list of net,filter,rate,action,avatar or all\n");
+            printf("  --capture=<file>               Record every received datagram to a capture file\n");
+            printf("  --replay=<file>                Replay a capture through the filters and exit\n");
+            printf("  --replay-speed=<n>             1 = original timing (default), n = n times faster,\n");
+            printf("                                 0 = as fast as possible\n");
+            printf("  --output=<backend>             Key/media output: uinput (default), ring, or\n");
+            printf("                                 file:<path> (a FIFO works as a pipe sink)\n");
+            printf("  --ingest=<backend>             Socket receive path: auto (default, io_uring when\n");
+            printf("                                 the kernel allows it), io_uring or recvmsg\n");
+            printf("  --shards=<n>                   Receive on n SO_REUSEPORT sockets, one pinned\n");
+            printf("                                 thread each (max %d)\n", MAX_INGEST_SHARDS);
+            printf("  --rcvbuf=<bytes>               Socket receive buffer (k/m suffixes), forced past\n");
+            printf("                                 net.core.rmem_max when running as root\n");
+            printf("  --busy-poll=<us>               SO_BUSY_POLL low-latency mode (needs CAP_NET_ADMIN)\n");
+            printf("  --dispatch-thread              Match and run actions on a separate thread per\n");
+            printf("                                 receiver, fed through a lock-free packet queue\n");
+            printf("  --trace=<file>                 Write a Chrome trace of sampled packets on exit\n");
+            printf("  --trace-sample=<n>             Trace every nth packet (default %d)\n", TRACE_DEFAULT_SAMPLE);
+            printf("  --metrics[=<port>]             Serve Prometheus metrics on 127.0.0.1 (default %d)\n",
+                   METRICS_DEFAULT_PORT);
             printf("  --help                         Show this help\n");
             printf("\nDefault behavior: Start CLI with background listening\n");
             printf("\nNote: For media controls to work, you may need to:\n");
@@ -47,65 +149,130 @@ void parseArguments(int argc, char *argv[], int *inPort, char *clientIP, int *ou
     if (*outPort == 0) *outPort = PORT_OUT;
 }
 
-void signalHandler(int sig) {
+static const int shutdownSignals[] = { SIGINT, SIGTERM };
+
+static void handleShutdownSignal(int sig) {
     (void)sig; 
     printf("\nShutting down...\n");
-    running = 0;
-    
-    shutdownKeyPressSystem();
-    mediaShutdown();
-    
-    if (sockfd >= 0) {
-        close(sockfd);
-    }
-    exit(0);
-}
-
-void *listenForMessages(void *arg) {
-    int sockfd = *(int *)arg;
-    receiveMessages(sockfd);
-    return NULL;
+    eventLoopStop();
 }
 
 int main(int argc, char *argv[]) {
-    int inPort = 0, outPort = 0, listenOnly = 0;
+    int inPort = 0, outPort = 0, listenOnly = 0, startupReport = 0, metricsPort = 0;
     char clientIP[INET_ADDRSTRLEN] = {0};
+    char logFile[256] = {0};
+    char capturePath[256] = {0};
+    char replayPath[256] = {0};
+    double replaySpeed = 1.0;
+    
+    startupBegin();
     
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    parseArguments(argc, argv, &inPort, clientIP, &outPort, &listenOnly, &startupReport,
+                   &metricsPort, logFile, capturePath, replayPath, &replaySpeed);
+    startupMark("arguments");
+    
+    // Signals are routed to the loop before any thread exists, so every
+    // later thread inherits the blocked mask
+    if (eventLoopInit() < 0 ||
+        eventLoopWatchSignals(shutdownSignals, 2, handleShutdownSignal) < 0) {
+        return EXIT_FAILURE;
+    }
+    startupMark("event loop");
     
-    parseArguments(argc, argv, &inPort, clientIP, &outPort, &listenOnly);
+    asyncLogStart(logFile);
     
     loadConfig();
+    startupMark("config load");
     
     mediaStartup();
+    startupMark("media startup");
     
     if (initKeyPressSystem() < 0) {
         printf("Warning: KeyPress system initialization failed\n");
         printf("Key press actions will not be available\n");
     }
+    startupMark("keypress init");
     
-    sockfd = udpSocket(inPort);
-    if (sockfd < 0) {
+    if (replayPath[0]) {
+        // Replay runs synchronously; let Ctrl+C end it the default way
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+        
+        int result = replayCapture(replayPath, replaySpeed);
+        closeStateJournal();
+        shutdownKeyPressSystem();
+        mediaShutdown();
+        asyncLogStop();
+        eventLoopShutdown();
+        return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    // Sharded receivers bind their own sockets once everything else is up
+    sockfd = -1;
+    if (shardCount == 0) {
+        sockfd = udpSocket(inPort);
+        if (sockfd < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    startupMark("socket bind");
+    
+    if (capturePath[0] && startCapture(capturePath) < 0) {
+        if (sockfd >= 0) close(sockfd);
         return EXIT_FAILURE;
     }
     
-    printf("OSC Utility started - listening on port %d\n", inPort);
+    metricsSetListenPort(inPort);
+    startMetricsServer(metricsPort);
+    if (traceRecordPath[0]) {
+        traceStartRecording(traceRecordPath, traceSampleEvery);
+    }
+    startupMark("metrics");
     
-    pthread_t listenerThread;
-    if (pthread_create(&listenerThread, NULL, listenForMessages, (void *)&sockfd) != 0) {
-        perror("Failed to create listener thread");
+    if (shardCount > 0) {
+        if (startIngestShards(inPort, shardCount) < 0) {
+            return EXIT_FAILURE;
+        }
+    } else if (startIngest(sockfd) < 0) {
         close(sockfd);
         return EXIT_FAILURE;
     }
+    startupMark("ingest");
+    
+    if (shardCount > 0) {
+        printf("OSC Utility started - listening on port %d (%d SO_REUSEPORT shards)\n", inPort, shardCount);
+    } else {
+        printf("OSC Utility started - listening on port %d (%s)\n", inPort, ingestBackendName());
+    }
+    
+    if (startupReport) {
+        printStartupReport();
+    }
     
     if (listenOnly) {
         printf("Running in listen-only mode. Press Ctrl+C to stop.\n");
-        pthread_join(listenerThread, NULL);
     } else {
-        runCLI();
+        startCLI();
     }
     
-    close(sockfd);
+    eventLoopRun();
+    
+    stopReplay();
+    // Release any keys still held by scheduled output before devices close
+    outputFlushPending();
+    stopIngest();
+    stopIngestShards();
+    closeStateJournal();
+    if (sockfd >= 0) close(sockfd);
+    stopCapture();
+    traceStopRecording();
+    stopMetricsServer();
+    shutdownKeyPressSystem();
+    mediaShutdown();
+    asyncLogStop();
+    eventLoopShutdown();
     return EXIT_SUCCESS;
 }
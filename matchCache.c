@@ -0,0 +1,204 @@
+#include "matchCache.h"
+#include "quiescence.h"
+#include "metrics.h"
+#include "eventLoop.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    uint64_t hash;                          // Key hash, 0 while empty; written last when claimed
+    uint64_t avatar;
+    const char* address;                    // Interned in the table's arena
+    int start;                              // Range in the table's ids
+    int count;
+} MatchCacheEntry;
+
+typedef struct {
+    uint64_t generation;
+    MatchCacheEntry entries[MATCH_CACHE_SLOTS];
+    int entryCount;
+    char arena[MATCH_CACHE_ARENA_SIZE];
+    size_t arenaUsed;
+    int ids[MATCH_CACHE_IDS];
+    int idCount;
+} MatchCacheTable;
+
+// Invalidation fills the spare table and publishes it, like the avatar
+// profile sets, so lookups never see a table being cleared under them
+static MatchCacheTable tables[2];
+static MatchCacheTable* publishedTable = &tables[0];
+static uint64_t currentGeneration = 0;
+static int cacheEnabled = 1;
+static pthread_mutex_t storeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t invalidateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t cacheHits = 0;
+static uint64_t cacheMisses = 0;
+static uint64_t cacheUncached = 0;
+static uint64_t cacheResets = 0;
+static int resetPosted = 0;
+static uint64_t lastResetNs = 0;
+
+static uint64_t entryKey(uint64_t hash, uint64_t avatar) {
+    uint64_t key = hash ^ (avatar * 0x9E3779B97F4A7C15ULL);
+    return key ? key : 1;
+}
+
+static const MatchCacheEntry* findEntry(const MatchCacheTable* table, const char* address, uint64_t key,
+                                        uint64_t avatar) {
+    for (int probe = 0; probe < MATCH_CACHE_SLOTS; probe++) {
+        const MatchCacheEntry* entry = &table->entries[(key + probe) & (MATCH_CACHE_SLOTS - 1)];
+        uint64_t slotHash = __atomic_load_n(&entry->hash, __ATOMIC_ACQUIRE);
+        if (slotHash == 0) return NULL;
+        if (slotHash == key && entry->avatar == avatar && strcmp(entry->address, address) == 0) return entry;
+    }
+    return NULL;
+}
+
+int matchCacheLookup(const char* address, uint64_t hash, uint64_t avatar, uint64_t* generation, const int** ids) {
+    uint64_t key = entryKey(hash, avatar);
+    
+    const MatchCacheTable* table = __atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE);
+    *generation = table->generation;
+    
+    if (!__atomic_load_n(&cacheEnabled, __ATOMIC_RELAXED)) return -1;
+    
+    const MatchCacheEntry* entry = findEntry(table, address, key, avatar);
+    if (!entry) {
+        __atomic_fetch_add(&cacheMisses, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    
+    __atomic_fetch_add(&cacheHits, 1, __ATOMIC_RELAXED);
+    *ids = table->ids + entry->start;
+    return entry->count;
+}
+
+static void resetFullCache(void* context) {
+    (void)context;
+    matchCacheInvalidate();
+    __atomic_fetch_add(&cacheResets, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&lastResetNs, metricsNowNs(), __ATOMIC_RELAXED);
+    __atomic_store_n(&resetPosted, 0, __ATOMIC_RELEASE);
+}
+
+// The reset waits for readers, which a matching thread inside its read
+// section must not do, so the event loop runs it
+static void cacheFull(void) {
+    __atomic_fetch_add(&cacheUncached, 1, __ATOMIC_RELAXED);
+    
+    if (metricsNowNs() - __atomic_load_n(&lastResetNs, __ATOMIC_RELAXED) < MATCH_CACHE_RESET_INTERVAL_NS ||
+        __atomic_exchange_n(&resetPosted, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    if (eventLoopPost(resetFullCache, NULL) < 0) {
+        __atomic_store_n(&resetPosted, 0, __ATOMIC_RELEASE);
+    }
+}
+
+static int tableFull(const MatchCacheTable* table, size_t length, int count) {
+    return __atomic_load_n(&table->entryCount, __ATOMIC_RELAXED) >= MATCH_CACHE_CAPACITY ||
+           __atomic_load_n(&table->arenaUsed, __ATOMIC_RELAXED) + length > MATCH_CACHE_ARENA_SIZE ||
+           __atomic_load_n(&table->idCount, __ATOMIC_RELAXED) + count > MATCH_CACHE_IDS;
+}
+
+void matchCacheStore(const char* address, uint64_t hash, uint64_t avatar, uint64_t generation,
+                     const int* ids, int count) {
+    uint64_t key = entryKey(hash, avatar);
+    if (!__atomic_load_n(&cacheEnabled, __ATOMIC_RELAXED)) return;
+    
+    // Full tables only grow again after a reset: no lock on this path
+    size_t length = strlen(address) + 1;
+    MatchCacheTable* table = __atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE);
+    if (table->generation != generation) return;
+    if (tableFull(table, length, count)) {
+        cacheFull();
+        return;
+    }
+    
+    pthread_mutex_lock(&storeMutex);
+    
+    table = publishedTable;
+    if (table->generation != generation || findEntry(table, address, key, avatar)) {
+        pthread_mutex_unlock(&storeMutex);
+        return;
+    }
+    if (tableFull(table, length, count)) {
+        pthread_mutex_unlock(&storeMutex);
+        cacheFull();
+        return;
+    }
+    
+    MatchCacheEntry* entry = NULL;
+    for (int probe = 0; probe < MATCH_CACHE_SLOTS; probe++) {
+        entry = &table->entries[(key + probe) & (MATCH_CACHE_SLOTS - 1)];
+        if (entry->hash == 0) break;
+    }
+    
+    memcpy(table->arena + table->arenaUsed, address, length);
+    entry->address = table->arena + table->arenaUsed;
+    __atomic_store_n(&table->arenaUsed, table->arenaUsed + length, __ATOMIC_RELAXED);
+    
+    memcpy(table->ids + table->idCount, ids, sizeof(int) * (size_t)count);
+    entry->start = table->idCount;
+    entry->count = count;
+    __atomic_store_n(&table->idCount, table->idCount + count, __ATOMIC_RELAXED);
+    __atomic_store_n(&table->entryCount, table->entryCount + 1, __ATOMIC_RELAXED);
+    entry->avatar = avatar;
+    __atomic_store_n(&entry->hash, key, __ATOMIC_RELEASE);
+    
+    pthread_mutex_unlock(&storeMutex);
+}
+
+void matchCacheInvalidate(void) {
+    pthread_mutex_lock(&invalidateMutex);
+    // The spare table was unpublished by the previous invalidation, and a
+    // lookup from back then may still walk its ids. Waited for outside
+    // storeMutex, which those readers take to store a miss
+    waitForReaders();
+    pthread_mutex_lock(&storeMutex);
+    
+    MatchCacheTable* spare = publishedTable == &tables[0] ? &tables[1] : &tables[0];
+    memset(spare->entries, 0, sizeof(spare->entries));
+    spare->entryCount = 0;
+    spare->arenaUsed = 0;
+    spare->idCount = 0;
+    spare->generation = ++currentGeneration;
+    __atomic_store_n(&publishedTable, spare, __ATOMIC_RELEASE);
+    
+    pthread_mutex_unlock(&storeMutex);
+    pthread_mutex_unlock(&invalidateMutex);
+}
+
+void matchCacheSetEnabled(int enabled) {
+    __atomic_store_n(&cacheEnabled, enabled, __ATOMIC_RELAXED);
+    matchCacheInvalidate();
+}
+
+void matchCacheGetStats(MatchCacheStats* stats) {
+    const MatchCacheTable* table = __atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE);
+    stats->hits = __atomic_load_n(&cacheHits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&cacheMisses, __ATOMIC_RELAXED);
+    stats->uncached = __atomic_load_n(&cacheUncached, __ATOMIC_RELAXED);
+    stats->resets = __atomic_load_n(&cacheResets, __ATOMIC_RELAXED);
+    stats->entries = (uint64_t)__atomic_load_n(&table->entryCount, __ATOMIC_RELAXED);
+    stats->generation = table->generation;
+    stats->enabled = __atomic_load_n(&cacheEnabled, __ATOMIC_RELAXED);
+}
+
+void printMatchCacheStats(void) {
+    MatchCacheStats stats;
+    matchCacheGetStats(&stats);
+    uint64_t lookups = stats.hits + stats.misses;
+    
+    printf("Match cache: %s, generation %llu\n", stats.enabled ? "on" : "off",
+           (unsigned long long)stats.generation);
+    printf("Addresses cached: %llu of %d\n", (unsigned long long)stats.entries, MATCH_CACHE_CAPACITY);
+    printf("Hits: %llu, misses: %llu (%.1f%% hit rate)\n", (unsigned long long)stats.hits,
+           (unsigned long long)stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0);
+    if (stats.uncached) {
+        printf("Not cached: %llu misses (cache full), %llu resets\n", (unsigned long long)stats.uncached,
+               (unsigned long long)stats.resets);
+    }
+}
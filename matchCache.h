@@ -0,0 +1,43 @@
+#ifndef MATCH_CACHE_H
+#define MATCH_CACHE_H
+
+#include <stdint.h>
+
+#define MATCH_CACHE_SLOTS 4096              // Power of two
+#define MATCH_CACHE_CAPACITY 3072           // Addresses kept per generation
+#define MATCH_CACHE_ARENA_SIZE (128 * 1024) // Interned address strings
+#define MATCH_CACHE_IDS 65536               // Filter ids across all cached lists
+#define MATCH_CACHE_RESET_INTERVAL_NS 1000000000ULL    // At most one reset of a full cache per second
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uncached;                      // Misses whose list did not fit
+    uint64_t resets;                        // Full caches started over
+    uint64_t entries;
+    uint64_t generation;
+    int enabled;
+} MatchCacheStats;
+
+// Filters that apply to address while the avatar with the given hash
+// (currentAvatarHash) is active, as computed at the current generation of
+// the filter table. Each avatar has its own entries, so switching avatars
+// keeps what was cached for the others. Returns -1 on a miss. Read the filter
+// index only after this call, so a list computed from it is never stored
+// under a newer generation than the index it came from. Call inside a
+// read section; ids stays valid until it is left
+int matchCacheLookup(const char* address, uint64_t hash, uint64_t avatar, uint64_t* generation, const int** ids);
+// Remembers a list computed after a miss; dropped when the generation has
+// moved on or the cache is full. A full cache is checked without the lock
+// and is started over from the event loop, so the addresses in use now
+// get cached again instead of missing for good
+void matchCacheStore(const char* address, uint64_t hash, uint64_t avatar, uint64_t generation,
+                     const int* ids, int count);
+// The filter table changed: starts a new, empty generation
+void matchCacheInvalidate(void);
+void matchCacheSetEnabled(int enabled);
+
+void matchCacheGetStats(MatchCacheStats* stats);
+void printMatchCacheStats(void);
+
+#endif
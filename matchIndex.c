@@ -0,0 +1,180 @@
+#include "matchIndex.h"
+#include "configCache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int findExactGroup(const MatchIndex* index, const char* pattern, size_t length, uint64_t hash) {
+    for (int probe = 0; probe < index->exactSlotCount; probe++) {
+        int group = index->exactSlots[(hash + probe) & (uint64_t)(index->exactSlotCount - 1)];
+        if (group < 0) return -1;
+    
+        const ExactGroup* exact = &index->exactGroups[group];
+        if (exact->hash != hash) continue;
+    
+        // Groups are only probed once filled, so ids[start] is a member
+        const perimeterFilter* filter = &perimeterFilters[index->ids[exact->start]];
+        if ((size_t)filter->patternLength == length && memcmp(filter->pattern, pattern, length) == 0) {
+            return group;
+        }
+    }
+    return -1;
+}
+
+int matchIndexExact(const MatchIndex* index, const char* address, size_t length, const int** ids) {
+    if (index->exactGroupCount == 0) return 0;
+    
+    int group = findExactGroup(index, address, length, hashConfigBytes(address, length));
+    if (group < 0) return 0;
+    
+    *ids = index->ids + index->exactGroups[group].start;
+    return index->exactGroups[group].count;
+}
+
+int matchIndexPrefixStep(const MatchIndex* index, int node, unsigned char byte) {
+    for (int child = index->prefixNodes[node].child; child >= 0; child = index->prefixNodes[child].sibling) {
+        if (index->prefixNodes[child].byte == byte) return child;
+    }
+    return -1;
+}
+
+static int addPrefixNode(MatchIndex* index, int parent, unsigned char byte) {
+    PrefixNode* node = &index->prefixNodes[index->prefixNodeCount];
+    node->child = -1;
+    node->sibling = index->prefixNodes[parent].child;
+    node->byte = byte;
+    node->start = 0;
+    node->count = 0;
+    index->prefixNodes[parent].child = index->prefixNodeCount;
+    return index->prefixNodeCount++;
+}
+
+// Exact filters are grouped by pattern and prefix filters by trie node;
+// both then get contiguous ranges of ids via a count and prefix sum
+MatchIndex* buildMatchIndex(void) {
+    MatchIndex* index = calloc(1, sizeof(MatchIndex));
+    if (!index) return NULL;
+    
+    int regexCount = 0;
+    size_t prefixBytes = 0;
+    for (int i = 0; i < filterCount; i++) {
+        switch (perimeterFilters[i].matchKind) {
+            case MATCH_EXACT: index->exactCount++; break;
+            case MATCH_PREFIX: index->prefixCount++; prefixBytes += perimeterFilters[i].patternLength; break;
+            case MATCH_REGEX: regexCount++; break;
+            default: break;
+        }
+    }
+    
+    index->exactSlotCount = 16;
+    while (index->exactSlotCount < index->exactCount * 2) index->exactSlotCount *= 2;
+    
+    index->exactSlots = malloc(sizeof(int) * (size_t)index->exactSlotCount);
+    index->exactGroups = malloc(sizeof(ExactGroup) * (size_t)(index->exactCount + 1));
+    index->prefixNodes = malloc(sizeof(PrefixNode) * (prefixBytes + 1));
+    index->regexes = malloc(sizeof(RegexFilter) * (size_t)(regexCount + 1));
+    index->ids = malloc(sizeof(int) * (size_t)(index->exactCount + index->prefixCount + 1));
+    int* slotOf = malloc(sizeof(int) * (size_t)(filterCount + 1));
+    if (!index->exactSlots || !index->exactGroups || !index->prefixNodes || !index->regexes || !index->ids ||
+        !slotOf) {
+        free(slotOf);
+        freeMatchIndex(index);
+        return NULL;
+    }
+    
+    memset(index->exactSlots, -1, sizeof(int) * (size_t)index->exactSlotCount);
+    index->prefixNodes[0] = (PrefixNode){ .child = -1, .sibling = -1 };
+    index->prefixNodeCount = 1;
+    
+    // Pass 1: each exact filter finds or opens its group, each prefix
+    // filter its trie node; counts are kept in the group or node
+    for (int i = 0; i < filterCount; i++) {
+        const perimeterFilter* filter = &perimeterFilters[i];
+        slotOf[i] = -1;
+    
+        if (filter->matchKind == MATCH_EXACT) {
+            uint64_t hash = filter->patternHash;
+            int group = -1;
+            for (int probe = 0; probe < index->exactSlotCount; probe++) {
+                int* slot = &index->exactSlots[(hash + probe) & (uint64_t)(index->exactSlotCount - 1)];
+                if (*slot < 0) {
+                    group = index->exactGroupCount++;
+                    index->exactGroups[group] = (ExactGroup){ .hash = hash, .start = i, .count = 0 };
+                    *slot = group;
+                    break;
+                }
+                // start holds a member filter until the ranges are laid out
+                const perimeterFilter* member = &perimeterFilters[index->exactGroups[*slot].start];
+                if (index->exactGroups[*slot].hash == hash && strcmp(member->pattern, filter->pattern) == 0) {
+                    group = *slot;
+                    break;
+                }
+            }
+            index->exactGroups[group].count++;
+            slotOf[i] = group;
+        } else if (filter->matchKind == MATCH_PREFIX) {
+            int node = 0;
+            for (const char* p = filter->pattern; *p; p++) {
+                int next = matchIndexPrefixStep(index, node, (unsigned char)*p);
+                node = next >= 0 ? next : addPrefixNode(index, node, (unsigned char)*p);
+            }
+            index->prefixNodes[node].count++;
+            slotOf[i] = node;
+        } else if (filter->matchKind == MATCH_REGEX) {
+            RegexFilter* regex = &index->regexes[index->regexCount];
+            // compileFilter turns invalid regexes into substrings, so this
+            // only fails when regcomp runs out of memory
+            int result = regcomp(&regex->regex, filter->pattern, REG_EXTENDED | REG_NOSUB);
+            if (result == 0) {
+                regex->filter = i;
+                index->regexCount++;
+            } else {
+                char reason[128];
+                regerror(result, NULL, reason, sizeof(reason));
+                printf("Warning: cannot compile regex '%s' (%s); the filter will not match\n",
+                       filter->pattern, reason);
+            }
+        }
+    }
+    
+    // Pass 2: ranges
+    int offset = 0;
+    for (int g = 0; g < index->exactGroupCount; g++) {
+        index->exactGroups[g].start = offset;
+        offset += index->exactGroups[g].count;
+        index->exactGroups[g].count = 0;
+    }
+    for (int n = 0; n < index->prefixNodeCount; n++) {
+        index->prefixNodes[n].start = offset;
+        offset += index->prefixNodes[n].count;
+        index->prefixNodes[n].count = 0;
+    }
+    
+    // Pass 3: fill, in filter order within each range
+    for (int i = 0; i < filterCount; i++) {
+        if (slotOf[i] < 0) continue;
+        if (perimeterFilters[i].matchKind == MATCH_EXACT) {
+            ExactGroup* group = &index->exactGroups[slotOf[i]];
+            index->ids[group->start + group->count++] = i;
+        } else {
+            PrefixNode* node = &index->prefixNodes[slotOf[i]];
+            index->ids[node->start + node->count++] = i;
+        }
+    }
+    
+    free(slotOf);
+    return index;
+}
+
+void freeMatchIndex(MatchIndex* index) {
+    if (!index) return;
+    for (int r = 0; r < index->regexCount; r++) {
+        regfree(&index->regexes[r].regex);
+    }
+    free(index->exactSlots);
+    free(index->exactGroups);
+    free(index->prefixNodes);
+    free(index->regexes);
+    free(index->ids);
+    free(index);
+}
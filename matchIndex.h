@@ -0,0 +1,54 @@
+#ifndef MATCH_INDEX_H
+#define MATCH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <regex.h>
+#include "oscUtility.h"
+
+// Exact filters sharing one pattern text
+typedef struct {
+    uint64_t hash;
+    int start;                      // Range in MatchIndex.ids
+    int count;
+} ExactGroup;
+
+// Byte trie over prefix patterns, children kept as a sibling list
+typedef struct {
+    int child;                      // -1 = none
+    int sibling;
+    unsigned char byte;
+    int start;                      // Filters whose prefix ends at this node
+    int count;
+} PrefixNode;
+
+typedef struct {
+    int filter;
+    regex_t regex;                  // Compiled once per rebuild, never per packet
+} RegexFilter;
+
+// Exact, prefix and regex filters for every avatar; bindings are sifted
+// before caching. Built with the avatar profiles and immutable once published
+typedef struct {
+    int exactSlotCount;             // Power of two, at least twice exactGroupCount
+    int* exactSlots;                // Group index, -1 = empty
+    ExactGroup* exactGroups;
+    int exactGroupCount;
+    int exactCount;
+    PrefixNode* prefixNodes;        // Node 0 is the root
+    int prefixNodeCount;
+    int prefixCount;
+    RegexFilter* regexes;
+    int regexCount;
+    int* ids;                       // Filter indices, grouped by exact pattern then by trie node
+} MatchIndex;
+
+// Reads perimeterFilters; NULL on allocation failure
+MatchIndex* buildMatchIndex(void);
+void freeMatchIndex(MatchIndex* index);
+// Filters whose exact pattern is address: one hash probe
+int matchIndexExact(const MatchIndex* index, const char* address, size_t length, const int** ids);
+// Trie node below node for byte, -1 when no prefix continues that way
+int matchIndexPrefixStep(const MatchIndex* index, int node, unsigned char byte);
+
+#endif
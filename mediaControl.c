@@ -1,4 +1,6 @@
 #include "mediaControl.h"
+#include "outputBackend.h"
+#include "asyncLog.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,9 +8,12 @@
 #include <unistd.h>
 #include <linux/uinput.h>
 #include <sys/ioctl.h>
+#include <pthread.h>
 
 static int uinput_fd = -1;
-MediaState currentMediaState = MEDIA_STATE_UNKNOWN;
+// Written by the startup probe and by dispatch threads, so only touched
+// through atomics
+static MediaState currentMediaState = MEDIA_STATE_UNKNOWN;
 
 int emit(int fd, int type, int code, int value) {
     struct input_event ie;
@@ -68,50 +73,30 @@ void cleanupUinputDevice(int fd) {
     }
 }
 
-void mediaShutdown(void) {
+void releaseUinputDevice(void) {
     if (uinput_fd >= 0) {
         cleanupUinputDevice(uinput_fd);
         uinput_fd = -1;
     }
 }
 
+void mediaShutdown(void) {
+    outputClose(OUTPUT_DEVICE_MEDIA);
+}
+
 int sendMediaKey(int keycode) {
-    int fd = setupUinputDevice();
-    if (fd < 0) {
+    if (outputOpen(OUTPUT_DEVICE_MEDIA) < 0) {
         return 0;
     }
 
-    emit(fd, EV_KEY, keycode, 1);
-    emit(fd, EV_SYN, SYN_REPORT, 0);
-    
-    emit(fd, EV_KEY, keycode, 0);
-    emit(fd, EV_SYN, SYN_REPORT, 0);
+    outputKeyEvent(OUTPUT_DEVICE_MEDIA, keycode, 1);
+    outputKeyEvent(OUTPUT_DEVICE_MEDIA, keycode, 0);
 
     return 1;
 }
 
-void mediaStartup(void) {
-    if (messagePrintingEnabled) {
-        printf("Initializing media control system...\n");
-    }
-    
-    setupUinputDevice();
-    
-    updateMediaState();
-    
-    if (messagePrintingEnabled) {
-        const char* stateStr;
-        switch (currentMediaState) {
-            case MEDIA_STATE_PLAYING: stateStr = "PLAYING"; break;
-            case MEDIA_STATE_PAUSED: stateStr = "PAUSED"; break;
-            case MEDIA_STATE_STOPPED: stateStr = "STOPPED"; break;
-            default: stateStr = "UNKNOWN"; break;
-        }
-        printf("Media startup complete. Current state: %s\n", stateStr);
-    }
-}
-
-void updateMediaState(void) {
+static MediaState queryMediaState(void) {
+    MediaState state = MEDIA_STATE_UNKNOWN;
     FILE *fp = popen("playerctl status 2>/dev/null", "r");
     if (fp != NULL) {
         char status[32];
@@ -119,31 +104,74 @@ void updateMediaState(void) {
             status[strcspn(status, "\n")] = 0;
             
             if (strcmp(status, "Playing") == 0) {
-                currentMediaState = MEDIA_STATE_PLAYING;
+                state = MEDIA_STATE_PLAYING;
             } else if (strcmp(status, "Paused") == 0) {
-                currentMediaState = MEDIA_STATE_PAUSED;
+                state = MEDIA_STATE_PAUSED;
             } else if (strcmp(status, "Stopped") == 0) {
-                currentMediaState = MEDIA_STATE_STOPPED;
-            } else {
-                currentMediaState = MEDIA_STATE_UNKNOWN;
+                state = MEDIA_STATE_STOPPED;
             }
-        } else {
-            currentMediaState = MEDIA_STATE_UNKNOWN;
         }
         pclose(fp);
-    } else {
-        currentMediaState = MEDIA_STATE_UNKNOWN;
     }
+    return state;
+}
+
+static void setMediaState(MediaState state) {
+    __atomic_store_n(&currentMediaState, state, __ATOMIC_RELEASE);
+}
+
+void updateMediaState(void) {
+    setMediaState(queryMediaState());
 }
 
 MediaState getMediaState(void) {
-    return currentMediaState;
+    return __atomic_load_n(&currentMediaState, __ATOMIC_ACQUIRE);
+}
+
+// playerctl can take tens of milliseconds to answer, so the initial state
+// probe runs off the startup path. It only fills in a state nothing else
+// has set yet, so a late answer never overwrites a toggle
+static void *mediaStateProbe(void *arg) {
+    (void)arg;
+    MediaState expected = MEDIA_STATE_UNKNOWN;
+    MediaState state = queryMediaState();
+    __atomic_compare_exchange_n(&currentMediaState, &expected, state, 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    
+    if (LOG_ENABLED(LOG_LEVEL_INFO, LOG_SUBSYS_ACTION)) {
+        const char* stateStr;
+        switch (getMediaState()) {
+            case MEDIA_STATE_PLAYING: stateStr = "PLAYING"; break;
+            case MEDIA_STATE_PAUSED: stateStr = "PAUSED"; break;
+            case MEDIA_STATE_STOPPED: stateStr = "STOPPED"; break;
+            default: stateStr = "UNKNOWN"; break;
+        }
+        char message[LOG_TEXT_LENGTH];
+        snprintf(message, sizeof(message), "Media startup complete. Current state: %s", stateStr);
+        logMessage(LOG_LEVEL_INFO, LOG_SUBSYS_ACTION, message);
+    }
+    return NULL;
+}
+
+void mediaStartup(void) {
+    if (messagePrintingEnabled) {
+        printf("Initializing media control system...\n");
+    }
+    
+    outputOpen(OUTPUT_DEVICE_MEDIA);
+    
+    pthread_t probeThread;
+    if (pthread_create(&probeThread, NULL, mediaStateProbe, NULL) == 0) {
+        pthread_detach(probeThread);
+    } else {
+        mediaStateProbe(NULL);
+    }
 }
 
 void mediaPlayPause(void) {
     updateMediaState();
     
-    if (currentMediaState == MEDIA_STATE_PLAYING) {
+    if (getMediaState() == MEDIA_STATE_PLAYING) {
         mediaPause();
     } else {
         mediaPlay();
@@ -153,33 +181,33 @@ void mediaPlayPause(void) {
 void mediaPlay(void) {
     if (sendMediaKey(KEY_PLAY)) {
         if (messagePrintingEnabled) printf("Media: Play (uinput)\n");
-        currentMediaState = MEDIA_STATE_PLAYING;
+        setMediaState(MEDIA_STATE_PLAYING);
     } else {
         system("playerctl play 2>/dev/null");
         if (messagePrintingEnabled) printf("Media: Play (fallback)\n");
-        currentMediaState = MEDIA_STATE_PLAYING;
+        setMediaState(MEDIA_STATE_PLAYING);
     }
 }
 
 void mediaPause(void) {
     if (sendMediaKey(KEY_PAUSE)) {
         if (messagePrintingEnabled) printf("Media: Pause (uinput)\n");
-        currentMediaState = MEDIA_STATE_PAUSED;
+        setMediaState(MEDIA_STATE_PAUSED);
     } else {
         system("playerctl pause 2>/dev/null");
         if (messagePrintingEnabled) printf("Media: Pause (fallback)\n");
-        currentMediaState = MEDIA_STATE_PAUSED;
+        setMediaState(MEDIA_STATE_PAUSED);
     }
 }
 
 void mediaStop(void) {
     if (sendMediaKey(KEY_STOPCD)) {
         if (messagePrintingEnabled) printf("Media: Stop (uinput)\n");
-        currentMediaState = MEDIA_STATE_STOPPED;
+        setMediaState(MEDIA_STATE_STOPPED);
     } else {
         system("playerctl stop 2>/dev/null");
         if (messagePrintingEnabled) printf("Media: Stop (fallback)\n");
-        currentMediaState = MEDIA_STATE_STOPPED;
+        setMediaState(MEDIA_STATE_STOPPED);
     }
 }
 
@@ -200,3 +228,38 @@ void mediaPrevious(void) {
         if (messagePrintingEnabled) printf("Media: Previous track (fallback)\n");
     }
 }
+
+MediaCommand mediaCommandFromName(const char* actionName) {
+    if (!actionName) return MEDIA_CMD_NONE;
+    
+    if (strcmp(actionName, "media-play") == 0) {
+        return MEDIA_CMD_PLAY_PAUSE;
+    } else if (strcmp(actionName, "media-stop") == 0) {
+        return MEDIA_CMD_STOP;
+    } else if (strcmp(actionName, "media-next") == 0) {
+        return MEDIA_CMD_NEXT;
+    } else if (strcmp(actionName, "media-prev") == 0) {
+        return MEDIA_CMD_PREVIOUS;
+    }
+    
+    return MEDIA_CMD_NONE;
+}
+
+int runMediaCommand(MediaCommand command) {
+    switch (command) {
+        case MEDIA_CMD_PLAY_PAUSE:
+            mediaPlayPause();
+            return 1;
+        case MEDIA_CMD_STOP:
+            mediaStop();
+            return 1;
+        case MEDIA_CMD_NEXT:
+            mediaNext();
+            return 1;
+        case MEDIA_CMD_PREVIOUS:
+            mediaPrevious();
+            return 1;
+        default:
+            return 0;
+    }
+}
@@ -16,7 +16,13 @@ typedef enum {
     MEDIA_STATE_STOPPED
 } MediaState;
 
-extern MediaState currentMediaState;
+typedef enum {
+    MEDIA_CMD_NONE,
+    MEDIA_CMD_PLAY_PAUSE,
+    MEDIA_CMD_STOP,
+    MEDIA_CMD_NEXT,
+    MEDIA_CMD_PREVIOUS
+} MediaCommand;
 
 void mediaStartup(void);
 void mediaShutdown(void);  
@@ -29,9 +35,13 @@ void mediaPrevious(void);
 MediaState getMediaState(void);
 void updateMediaState(void);
 
+MediaCommand mediaCommandFromName(const char* actionName);
+int runMediaCommand(MediaCommand command);
+
 int emit(int fd, int type, int code, int value);
 int setupUinputDevice(void);
 void cleanupUinputDevice(int fd);
+void releaseUinputDevice(void);
 int sendMediaKey(int keycode);
 
 #endif
@@ -0,0 +1,548 @@
+#include "metrics.h"
+#include "oscUtility.h"
+#include "dispatchQueue.h"
+#include "packetPool.h"
+#include "parameterStore.h"
+#include "matchCache.h"
+#include "timerWheel.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "eventLoop.h"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static MetricsThreadSlot threadSlots[MAX_METRICS_THREADS];
+static int threadSlotCount = 0;
+static __thread MetricsThreadSlot* localSlot = NULL;
+static __thread int localShared = 0;        // localSlot is the overflow slot
+
+static int listenPort = 0;
+static double packetsPerSecond = 0.0;
+static uint64_t lastSamplePackets = 0;
+static uint64_t lastSampleTimeNs = 0;
+static pthread_mutex_t sampleMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int metricsServerFd = -1;
+static int metricsServerRunning = 0;
+static int sampleTimer = -1;
+
+#define METRICS_REQUEST_TIMEOUT_NS 1000000000ULL
+#define METRICS_RESPONSE_TIMEOUT_NS 5000000000ULL
+
+// An accepted scrape connection. Its socket is non-blocking: the request
+// is collected and the response sent across readiness events, so a slow
+// scraper never holds up the loop that also drains the OSC socket
+typedef struct {
+    int fd;
+    int timeoutTimer;
+    char request[1024];
+    size_t requestLength;
+    char* response;                 // Headers and body, NULL until the request is complete
+    size_t responseLength;
+    size_t sent;
+} MetricsClient;
+
+uint64_t metricsNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Each recording thread claims a slot on first use; threads beyond the
+// limit share the last slot, which is only updated with atomic adds
+static MetricsThreadSlot* currentSlot(void) {
+    if (!localSlot) {
+        int index = __atomic_fetch_add(&threadSlotCount, 1, __ATOMIC_RELAXED);
+        if (index >= MAX_METRICS_THREADS - 1) {
+            index = MAX_METRICS_THREADS - 1;
+            localShared = 1;
+        }
+        localSlot = &threadSlots[index];
+    }
+    return localSlot;
+}
+
+const MetricsThreadSlot* metricsThreadSlot(void) {
+    return currentSlot();
+}
+
+// The caller has claimed its slot through currentSlot
+static void slotAdd(uint64_t* counter, uint64_t amount) {
+    if (localShared) {
+        __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+    }
+}
+
+static void slotRecord(LatencyHistogram* histogram, uint64_t valueNs) {
+    if (localShared) {
+        histogramRecordShared(histogram, valueNs);
+    } else {
+        histogramRecord(histogram, valueNs);
+    }
+}
+
+void metricsRecordPacket(size_t bytes) {
+    MetricsThreadSlot* slot = currentSlot();
+    slotAdd(&slot->packets, 1);
+    slotAdd(&slot->bytes, bytes);
+}
+
+void metricsRecordSocketOverflows(uint64_t dropped) {
+    slotAdd(&currentSlot()->socketOverflows, dropped);
+}
+
+void metricsRecordTruncated(void) {
+    slotAdd(&currentSlot()->truncated, 1);
+}
+
+void metricsRecordMatchTime(uint64_t elapsedNs) {
+    slotRecord(&currentSlot()->matchTime, elapsedNs);
+}
+
+void metricsRecordDispatchTime(uint64_t elapsedNs) {
+    slotRecord(&currentSlot()->dispatchTime, elapsedNs);
+}
+
+void metricsSetListenPort(int port) {
+    listenPort = port;
+}
+
+// Kernel-side drops for our port from /proc/net/udp (last column)
+static uint64_t readKernelDrops(void) {
+    if (listenPort <= 0) return 0;
+    
+    FILE* file = fopen("/proc/net/udp", "r");
+    if (!file) return 0;
+    
+    char line[512];
+    uint64_t drops = 0;
+    
+    if (!fgets(line, sizeof(line), file)) {
+        fclose(file);
+        return 0;
+    }
+    
+    while (fgets(line, sizeof(line), file)) {
+        unsigned int localPort;
+        if (sscanf(line, " %*d: %*[0-9A-Fa-f]:%x", &localPort) != 1 || (int)localPort != listenPort) {
+            continue;
+        }
+        
+        char* lastField = strrchr(line, ' ');
+        if (lastField) {
+            drops += strtoull(lastField + 1, NULL, 10);
+        }
+    }
+    
+    fclose(file);
+    return drops;
+}
+
+static uint64_t totalPackets(void) {
+    uint64_t packets = 0;
+    for (int i = 0; i < MAX_METRICS_THREADS; i++) {
+        packets += __atomic_load_n(&threadSlots[i].packets, __ATOMIC_RELAXED);
+    }
+    return packets;
+}
+
+void metricsSamplePacketRate(void) {
+    uint64_t now = metricsNowNs();
+    uint64_t packets = totalPackets();
+    
+    pthread_mutex_lock(&sampleMutex);
+    if (lastSampleTimeNs != 0 && now > lastSampleTimeNs) {
+        packetsPerSecond = (double)(packets - lastSamplePackets) * 1e9 / (double)(now - lastSampleTimeNs);
+    }
+    lastSamplePackets = packets;
+    lastSampleTimeNs = now;
+    pthread_mutex_unlock(&sampleMutex);
+}
+
+void metricsSnapshot(MetricsSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(MetricsSnapshot));
+    
+    uint64_t socketOverflows = 0;
+    for (int i = 0; i < MAX_METRICS_THREADS; i++) {
+        snapshot->packets += __atomic_load_n(&threadSlots[i].packets, __ATOMIC_RELAXED);
+        snapshot->bytes += __atomic_load_n(&threadSlots[i].bytes, __ATOMIC_RELAXED);
+        socketOverflows += __atomic_load_n(&threadSlots[i].socketOverflows, __ATOMIC_RELAXED);
+        snapshot->truncated += __atomic_load_n(&threadSlots[i].truncated, __ATOMIC_RELAXED);
+        histogramMerge(&snapshot->matchTime, &threadSlots[i].matchTime);
+        histogramMerge(&snapshot->dispatchTime, &threadSlots[i].dispatchTime);
+    }
+    
+    // SO_RXQ_OVFL only arrives with the next datagram, /proc/net/udp is
+    // current but unavailable in some sandboxes; both count the same drops
+    snapshot->kernelDrops = readKernelDrops();
+    if (socketOverflows > snapshot->kernelDrops) {
+        snapshot->kernelDrops = socketOverflows;
+    }
+    snapshot->applicationDrops = dispatchQueueDrops();
+    
+    pthread_mutex_lock(&sampleMutex);
+    snapshot->packetsPerSecond = packetsPerSecond;
+    pthread_mutex_unlock(&sampleMutex);
+}
+
+void metricsReset(void) {
+    // Racy against recording threads by design; a reset only needs to be
+    // approximately clean, and recorders never block on it
+    for (int i = 0; i < MAX_METRICS_THREADS; i++) {
+        memset(&threadSlots[i], 0, sizeof(MetricsThreadSlot));
+    }
+    for (int i = 0; i < filterCount; i++) {
+        __atomic_store_n(&perimeterFilters[i].fireCount, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&perimeterFilters[i].suppressCount, 0, __ATOMIC_RELAXED);
+    }
+    
+    pthread_mutex_lock(&sampleMutex);
+    lastSamplePackets = 0;
+    lastSampleTimeNs = 0;
+    packetsPerSecond = 0.0;
+    pthread_mutex_unlock(&sampleMutex);
+}
+
+void printMetricsStats(void) {
+    MetricsSnapshot snapshot;
+    metricsSnapshot(&snapshot);
+    
+    printf("=== OSC Utility Metrics ===\n");
+    printf("Packets received: %llu\n", (unsigned long long)snapshot.packets);
+    printf("Bytes received: %llu\n", (unsigned long long)snapshot.bytes);
+    printf("Packets/second: %.1f\n", snapshot.packetsPerSecond);
+    printf("Kernel drops: %llu (socket receive queue overflow)\n", (unsigned long long)snapshot.kernelDrops);
+    printf("Application drops: %llu (dispatch queue full)\n", (unsigned long long)snapshot.applicationDrops);
+    printf("Truncated: %llu (longer than %d bytes)\n", (unsigned long long)snapshot.truncated, PACKET_MAX_DATAGRAM);
+    
+    ParameterStoreStats parameters;
+    parameterStoreGetStats(&parameters);
+    printf("Unchanged updates: %llu of %llu (not matched unless a filter passes them)\n",
+           (unsigned long long)parameters.unchanged, (unsigned long long)parameters.updates);
+    
+    MatchCacheStats cache;
+    matchCacheGetStats(&cache);
+    printf("Match cache: %llu hits, %llu misses, %llu addresses\n", (unsigned long long)cache.hits,
+           (unsigned long long)cache.misses, (unsigned long long)cache.entries);
+    
+    TimerWheelStats wheel;
+    timerWheelGetStats(&wheel);
+    if (wheel.scheduled) {
+        printf("Gesture timers: %d pending, %llu fired, %llu dropped\n", wheel.pending,
+               (unsigned long long)wheel.fired, (unsigned long long)wheel.dropped);
+    }
+    printDispatchQueueStats();
+    printPacketPoolStats();
+    
+    printf("\n%-16s %-10s %-10s %-10s %-10s %-10s %s\n", "Latency", "Samples", "p50", "p90", "p99", "p99.9", "Max");
+    printf("%-16s %-10s %-10s %-10s %-10s %-10s %s\n", "-------", "-------", "---", "---", "---", "-----", "---");
+    printHistogramRow("match", &snapshot.matchTime);
+    printHistogramRow("dispatch", &snapshot.dispatchTime);
+    
+    if (filterCount == 0) return;
+    
+    printf("\n%-40s %-10s %-10s %s\n", "Filter", "Matches", "Fired", "Suppressed");
+    printf("%-40s %-10s %-10s %s\n", "------", "-------", "-----", "----------");
+    for (int i = 0; i < filterCount; i++) {
+        printf("%-40s %-10d %-10llu %llu\n", perimeterFilters[i].pattern, perimeterFilters[i].count,
+               (unsigned long long)__atomic_load_n(&perimeterFilters[i].fireCount, __ATOMIC_RELAXED),
+               (unsigned long long)__atomic_load_n(&perimeterFilters[i].suppressCount, __ATOMIC_RELAXED));
+    }
+}
+
+static void writeLabelValue(FILE* out, const char* value) {
+    for (; *value; value++) {
+        if (*value == '"' || *value == '\\') {
+            fputc('\\', out);
+        } else if (*value == '\n') {
+            fputs("\\n", out);
+            continue;
+        }
+        fputc(*value, out);
+    }
+}
+
+static void writeSummary(FILE* out, const char* name, const char* help, const LatencyHistogram* histogram) {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    
+    fprintf(out, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        fprintf(out, "%s{quantile=\"%g\"} %.9f\n", name, quantiles[i],
+                histogramPercentile(histogram, quantiles[i] * 100.0) / 1e9);
+    }
+    fprintf(out, "%s_sum %.9f\n", name, histogram->sumNs / 1e9);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long)histogram->totalCount);
+}
+
+void writePrometheusMetrics(FILE* out) {
+    MetricsSnapshot snapshot;
+    metricsSnapshot(&snapshot);
+    
+    fprintf(out, "# HELP osc_packets_received_total Datagrams received on the OSC socket\n");
+    fprintf(out, "# TYPE osc_packets_received_total counter\n");
+    fprintf(out, "osc_packets_received_total %llu\n", (unsigned long long)snapshot.packets);
+    fprintf(out, "# HELP osc_bytes_received_total Bytes received on the OSC socket\n");
+    fprintf(out, "# TYPE osc_bytes_received_total counter\n");
+    fprintf(out, "osc_bytes_received_total %llu\n", (unsigned long long)snapshot.bytes);
+    fprintf(out, "# HELP osc_packets_per_second Receive rate over the last sample interval\n");
+    fprintf(out, "# TYPE osc_packets_per_second gauge\n");
+    fprintf(out, "osc_packets_per_second %.3f\n", snapshot.packetsPerSecond);
+    fprintf(out, "# HELP osc_kernel_drops_total Datagrams dropped by the kernel before we read them\n");
+    fprintf(out, "# TYPE osc_kernel_drops_total counter\n");
+    fprintf(out, "osc_kernel_drops_total %llu\n", (unsigned long long)snapshot.kernelDrops);
+    fprintf(out, "# HELP osc_application_drops_total Datagrams received but discarded because the dispatch queue was full\n");
+    fprintf(out, "# TYPE osc_application_drops_total counter\n");
+    fprintf(out, "osc_application_drops_total %llu\n", (unsigned long long)snapshot.applicationDrops);
+    
+    fprintf(out, "# HELP osc_truncated_datagrams_total Datagrams discarded because they did not fit the receive buffer\n");
+    fprintf(out, "# TYPE osc_truncated_datagrams_total counter\n");
+    fprintf(out, "osc_truncated_datagrams_total %llu\n", (unsigned long long)snapshot.truncated);
+    
+    ParameterStoreStats parameters;
+    parameterStoreGetStats(&parameters);
+    fprintf(out, "# HELP osc_parameter_updates_total Messages with arguments recorded in the parameter store\n");
+    fprintf(out, "# TYPE osc_parameter_updates_total counter\n");
+    fprintf(out, "osc_parameter_updates_total %llu\n", (unsigned long long)parameters.updates);
+    fprintf(out, "# HELP osc_parameter_unchanged_total Updates that repeated the previous value of their address\n");
+    fprintf(out, "# TYPE osc_parameter_unchanged_total counter\n");
+    fprintf(out, "osc_parameter_unchanged_total %llu\n", (unsigned long long)parameters.unchanged);
+    
+    MatchCacheStats cache;
+    matchCacheGetStats(&cache);
+    fprintf(out, "# HELP osc_match_cache_hits_total Messages whose matching filters came from the cache\n");
+    fprintf(out, "# TYPE osc_match_cache_hits_total counter\n");
+    fprintf(out, "osc_match_cache_hits_total %llu\n", (unsigned long long)cache.hits);
+    fprintf(out, "# HELP osc_match_cache_misses_total Messages matched against the filter index\n");
+    fprintf(out, "# TYPE osc_match_cache_misses_total counter\n");
+    fprintf(out, "osc_match_cache_misses_total %llu\n", (unsigned long long)cache.misses);
+    
+    writeDispatchQueueMetrics(out);
+    
+    writeSummary(out, "osc_match_time_seconds", "Time spent matching one message against the filters",
+                 &snapshot.matchTime);
+    writeSummary(out, "osc_dispatch_latency_seconds", "Time spent executing one filter action",
+                 &snapshot.dispatchTime);
+    
+    fprintf(out, "# HELP osc_filter_fired_total Actions executed per filter\n");
+    fprintf(out, "# TYPE osc_filter_fired_total counter\n");
+    for (int i = 0; i < filterCount; i++) {
+        fprintf(out, "osc_filter_fired_total{pattern=\"");
+        writeLabelValue(out, perimeterFilters[i].pattern);
+        fprintf(out, "\"} %llu\n", (unsigned long long)__atomic_load_n(&perimeterFilters[i].fireCount, __ATOMIC_RELAXED));
+    }
+    
+    fprintf(out, "# HELP osc_filter_suppressed_total Actions blocked by the rate limiter per filter\n");
+    fprintf(out, "# TYPE osc_filter_suppressed_total counter\n");
+    for (int i = 0; i < filterCount; i++) {
+        fprintf(out, "osc_filter_suppressed_total{pattern=\"");
+        writeLabelValue(out, perimeterFilters[i].pattern);
+        fprintf(out, "\"} %llu\n", (unsigned long long)__atomic_load_n(&perimeterFilters[i].suppressCount, __ATOMIC_RELAXED));
+    }
+}
+
+// Builds the whole reply, so it can be sent in as many pieces as the
+// socket takes
+static char* buildMetricsResponse(const char* request, size_t* length) {
+    char* response = NULL;
+    FILE* out = open_memstream(&response, length);
+    if (!out) return NULL;
+    
+    if (strncmp(request, "GET /metrics ", 13) != 0 && strncmp(request, "GET /metrics?", 13) != 0) {
+        fprintf(out, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        fclose(out);
+        return response;
+    }
+    
+    char* body = NULL;
+    size_t bodyLength = 0;
+    FILE* bodyOut = open_memstream(&body, &bodyLength);
+    if (!bodyOut) {
+        fclose(out);
+        free(response);
+        return NULL;
+    }
+    writePrometheusMetrics(bodyOut);
+    fclose(bodyOut);
+    
+    fprintf(out, "HTTP/1.0 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Connection: close\r\n\r\n", bodyLength);
+    fwrite(body, 1, bodyLength, out);
+    fclose(out);
+    free(body);
+    return response;
+}
+
+static void closeMetricsClient(MetricsClient* client) {
+    eventLoopCancelTimer(client->timeoutTimer);
+    eventLoopRemoveFd(client->fd);
+    close(client->fd);
+    free(client->response);
+    free(client);
+}
+
+static void metricsClientTimeout(void* context) {
+    MetricsClient* client = context;
+    client->timeoutTimer = -1;
+    closeMetricsClient(client);
+}
+
+// Returns 1 once the request line and headers are in, -1 when the client
+// is gone
+static int receiveRequest(MetricsClient* client) {
+    size_t room = sizeof(client->request) - 1 - client->requestLength;
+    ssize_t length = recv(client->fd, client->request + client->requestLength, room, 0);
+    if (length < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    if (length == 0) return -1;
+    
+    client->requestLength += (size_t)length;
+    client->request[client->requestLength] = '\0';
+    
+    // Only the request line matters; a full buffer is answered as is
+    return strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n") ||
+           client->requestLength == sizeof(client->request) - 1;
+}
+
+// Returns 1 once everything is sent, -1 when the client is gone
+static int sendResponse(MetricsClient* client) {
+    while (client->sent < client->responseLength) {
+        ssize_t sent = send(client->fd, client->response + client->sent, client->responseLength - client->sent,
+                            MSG_NOSIGNAL);
+        if (sent < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        client->sent += (size_t)sent;
+    }
+    return 1;
+}
+
+static void metricsClientEvent(int fd, uint32_t events, void* context) {
+    (void)fd;
+    MetricsClient* client = context;
+    
+    if (!client->response) {
+        if (!(events & EPOLLIN) && (events & (EPOLLERR | EPOLLHUP))) {
+            closeMetricsClient(client);
+            return;
+        }
+    
+        int received = receiveRequest(client);
+        if (received == 0) return;
+        if (received < 0) {
+            closeMetricsClient(client);
+            return;
+        }
+    
+        client->response = buildMetricsResponse(client->request, &client->responseLength);
+        eventLoopCancelTimer(client->timeoutTimer);
+        client->timeoutTimer = eventLoopAddTimer(METRICS_RESPONSE_TIMEOUT_NS, 0, metricsClientTimeout, client);
+        if (!client->response || client->timeoutTimer < 0) {
+            closeMetricsClient(client);
+            return;
+        }
+    }
+    
+    int result = sendResponse(client);
+    if (result != 0) {
+        closeMetricsClient(client);
+    } else if (!(events & EPOLLOUT)) {
+        // The socket buffer is full: wait for room instead of for requests
+        eventLoopModifyFd(client->fd, EPOLLOUT);
+    }
+}
+
+static void acceptMetricsClient(int fd, uint32_t events, void* context) {
+    (void)events; (void)context;
+    
+    int clientFd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (clientFd < 0) return;
+    
+    MetricsClient* client = calloc(1, sizeof(MetricsClient));
+    if (!client) {
+        close(clientFd);
+        return;
+    }
+    client->fd = clientFd;
+    
+    // A scraper that connects but never sends is dropped after a second
+    client->timeoutTimer = eventLoopAddTimer(METRICS_REQUEST_TIMEOUT_NS, 0, metricsClientTimeout, client);
+    if (client->timeoutTimer < 0 || eventLoopAddFd(clientFd, EPOLLIN, metricsClientEvent, client) < 0) {
+        eventLoopCancelTimer(client->timeoutTimer);
+        close(clientFd);
+        free(client);
+    }
+}
+
+static void samplePacketRateTimer(void* context) {
+    (void)context;
+    metricsSamplePacketRate();
+}
+
+// Port 0 runs only the packet-rate sampler without the HTTP endpoint.
+// Both run on the event loop, which must be initialized
+int startMetricsServer(int port) {
+    if (metricsServerRunning) return 0;
+    
+    uint64_t intervalNs = METRICS_SAMPLE_INTERVAL_MS * 1000000ULL;
+    sampleTimer = eventLoopAddTimer(intervalNs, intervalNs, samplePacketRateTimer, NULL);
+    if (sampleTimer < 0) {
+        return -1;
+    }
+    metricsServerRunning = 1;
+    
+    if (port <= 0) {
+        metricsServerFd = -1;
+        return 0;
+    }
+    
+    metricsServerFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (metricsServerFd < 0) {
+        perror("Metrics socket creation failed");
+        return -1;
+    }
+    
+    int opt = 1;
+    setsockopt(metricsServerFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    
+    if (bind(metricsServerFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(metricsServerFd, 8) < 0) {
+        perror("Metrics endpoint bind failed");
+        close(metricsServerFd);
+        metricsServerFd = -1;
+        return -1;
+    }
+    
+    if (eventLoopAddFd(metricsServerFd, EPOLLIN, acceptMetricsClient, NULL) < 0) {
+        perror("Failed to register metrics endpoint");
+        close(metricsServerFd);
+        metricsServerFd = -1;
+        return -1;
+    }
+    
+    printf("Metrics endpoint: http://127.0.0.1:%d/metrics\n", port);
+    return 0;
+}
+
+void stopMetricsServer(void) {
+    if (!metricsServerRunning) return;
+    
+    metricsServerRunning = 0;
+    eventLoopCancelTimer(sampleTimer);
+    sampleTimer = -1;
+    if (metricsServerFd >= 0) {
+        eventLoopRemoveFd(metricsServerFd);
+        close(metricsServerFd);
+        metricsServerFd = -1;
+    }
+}
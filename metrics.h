@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "histogram.h"
+#include "ingestShards.h"
+
+// A receiver and a dispatcher per shard, plus the event loop, CLI and replay
+#define METRICS_HELPER_THREADS 4
+#define MAX_METRICS_THREADS (MAX_INGEST_SHARDS * 2 + METRICS_HELPER_THREADS)
+#define METRICS_DEFAULT_PORT 9464
+#define METRICS_SAMPLE_INTERVAL_MS 1000
+
+// Counters owned by one recording thread; readers merge every slot
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t socketOverflows;       // SO_RXQ_OVFL drops on this thread's socket
+    uint64_t truncated;             // Datagrams longer than the receive buffer
+    LatencyHistogram matchTime;
+    LatencyHistogram dispatchTime;
+} MetricsThreadSlot;
+
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t kernelDrops;           // Socket queue overflows before we read them
+    uint64_t applicationDrops;      // Received but discarded by us (dispatch queue full)
+    uint64_t truncated;             // Discarded because they did not fit the receive buffer
+    double packetsPerSecond;
+    LatencyHistogram matchTime;
+    LatencyHistogram dispatchTime;
+} MetricsSnapshot;
+
+uint64_t metricsNowNs(void);
+// The calling thread's slot, claimed on first use
+const MetricsThreadSlot* metricsThreadSlot(void);
+void metricsRecordPacket(size_t bytes);
+void metricsRecordSocketOverflows(uint64_t dropped);
+void metricsRecordTruncated(void);
+void metricsRecordMatchTime(uint64_t elapsedNs);
+void metricsRecordDispatchTime(uint64_t elapsedNs);
+void metricsSetListenPort(int port);
+void metricsSamplePacketRate(void);
+void metricsSnapshot(MetricsSnapshot* snapshot);
+void metricsReset(void);
+
+void printMetricsStats(void);
+void writePrometheusMetrics(FILE* out);
+
+int startMetricsServer(int port);
+void stopMetricsServer(void);
+
+#endif
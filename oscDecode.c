@@ -0,0 +1,191 @@
+#include "oscDecode.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OSC_DECODE_X86 1
+#endif
+
+typedef void (*Swap32Kernel)(uint32_t* out, const unsigned char* in, size_t count);
+typedef size_t (*PaddedLengthKernel)(const char* data, size_t available);
+
+static void swap32Scalar(uint32_t* out, const unsigned char* in, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word;
+        memcpy(&word, in + i * 4, 4);
+        out[i] = __builtin_bswap32(word);
+    }
+}
+
+// Rounds the terminator position up to the padded length
+static size_t padTerminator(size_t terminator, size_t available) {
+    size_t length = (terminator + 4) & ~(size_t)3;
+    return length <= available ? length : 0;
+}
+
+// Four bytes at a time: a word has a zero byte when some byte borrows
+// on subtracting 0x01 and had its top bit clear
+static size_t paddedLengthScalar(const char* data, size_t available) {
+    size_t i = 0;
+    for (; i + 4 <= available; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, 4);
+        if ((word - 0x01010101u) & ~word & 0x80808080u) break;
+    }
+    for (; i < available; i++) {
+        if (data[i] == '\0') return padTerminator(i, available);
+    }
+    return 0;
+}
+
+#ifdef OSC_DECODE_X86
+__attribute__((target("ssse3")))
+static void swap32Ssse3(uint32_t* out, const unsigned char* in, size_t count) {
+    const __m128i reverse = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i words = _mm_loadu_si128((const __m128i*)(in + i * 4));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_shuffle_epi8(words, reverse));
+    }
+    swap32Scalar(out + i, in + i * 4, count - i);
+}
+
+__attribute__((target("avx2")))
+static void swap32Avx2(uint32_t* out, const unsigned char* in, size_t count) {
+    // vpshufb shuffles within each 128-bit lane, so the pattern repeats
+    const __m256i reverse = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i words = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_shuffle_epi8(words, reverse));
+    }
+    // The tail stays in VEX code; dropping into the SSE kernels with the
+    // upper halves dirty costs a state transition per call
+    if (i + 4 <= count) {
+        __m128i words = _mm_loadu_si128((const __m128i*)(in + i * 4));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_shuffle_epi8(words, _mm256_castsi256_si128(reverse)));
+        i += 4;
+    }
+    for (; i < count; i++) {
+        uint32_t word;
+        memcpy(&word, in + i * 4, 4);
+        out[i] = __builtin_bswap32(word);
+    }
+}
+
+// Full vectors only while they stay inside available; the tail is scalar
+__attribute__((target("sse2")))
+static size_t paddedLengthSse2(const char* data, size_t available) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= available; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero));
+        if (mask) return padTerminator(i + (size_t)__builtin_ctz((unsigned)mask), available);
+    }
+    size_t tail = paddedLengthScalar(data + i, available - i);
+    return tail ? i + tail : 0;
+}
+
+__attribute__((target("avx2")))
+static size_t paddedLengthAvx2(const char* data, size_t available) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= available; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero));
+        if (mask) return padTerminator(i + (size_t)__builtin_ctz(mask), available);
+    }
+    if (i + 16 <= available) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm256_castsi256_si128(zero)));
+        if (mask) return padTerminator(i + (size_t)__builtin_ctz(mask), available);
+        i += 16;
+    }
+    for (; i < available; i++) {
+        if (data[i] == '\0') return padTerminator(i, available);
+    }
+    return 0;
+}
+#endif
+
+static OscDecodeLevel supportedLevel(void) {
+#ifdef OSC_DECODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return OSC_DECODE_AVX2;
+    if (__builtin_cpu_supports("ssse3")) return OSC_DECODE_SSSE3;
+#endif
+    return OSC_DECODE_SCALAR;
+}
+
+static void resolveKernels(void);
+
+static void swap32Resolve(uint32_t* out, const unsigned char* in, size_t count);
+static size_t paddedLengthResolve(const char* data, size_t available);
+
+// Start out pointing at resolvers that pick the kernels on first use;
+// racing first calls all store the same pointers
+static Swap32Kernel swap32Kernel = swap32Resolve;
+static PaddedLengthKernel paddedLengthKernel = paddedLengthResolve;
+static OscDecodeLevel activeLevel = OSC_DECODE_SCALAR;
+
+static void installLevel(OscDecodeLevel level) {
+    Swap32Kernel swap = swap32Scalar;
+    PaddedLengthKernel scan = paddedLengthScalar;
+#ifdef OSC_DECODE_X86
+    if (level == OSC_DECODE_AVX2) {
+        swap = swap32Avx2;
+        scan = paddedLengthAvx2;
+    } else if (level == OSC_DECODE_SSSE3) {
+        swap = swap32Ssse3;
+        scan = paddedLengthSse2;
+    }
+#endif
+    __atomic_store_n(&activeLevel, level, __ATOMIC_RELAXED);
+    __atomic_store_n(&swap32Kernel, swap, __ATOMIC_RELEASE);
+    __atomic_store_n(&paddedLengthKernel, scan, __ATOMIC_RELEASE);
+}
+
+static void resolveKernels(void) {
+    installLevel(supportedLevel());
+}
+
+static void swap32Resolve(uint32_t* out, const unsigned char* in, size_t count) {
+    resolveKernels();
+    oscSwap32(out, in, count);
+}
+
+static size_t paddedLengthResolve(const char* data, size_t available) {
+    resolveKernels();
+    return oscPaddedLength(data, available);
+}
+
+void oscSwap32(uint32_t* out, const unsigned char* in, size_t count) {
+    __atomic_load_n(&swap32Kernel, __ATOMIC_ACQUIRE)(out, in, count);
+}
+
+size_t oscPaddedLength(const char* data, size_t available) {
+    return __atomic_load_n(&paddedLengthKernel, __ATOMIC_ACQUIRE)(data, available);
+}
+
+OscDecodeLevel oscDecodeLevel(void) {
+    if (__atomic_load_n(&swap32Kernel, __ATOMIC_ACQUIRE) == swap32Resolve) {
+        resolveKernels();
+    }
+    return __atomic_load_n(&activeLevel, __ATOMIC_RELAXED);
+}
+
+OscDecodeLevel oscDecodeSelect(OscDecodeLevel level) {
+    OscDecodeLevel supported = supportedLevel();
+    installLevel(level < supported ? level : supported);
+    return oscDecodeLevel();
+}
+
+const char* oscDecodeLevelName(OscDecodeLevel level) {
+    switch (level) {
+        case OSC_DECODE_AVX2: return "avx2";
+        case OSC_DECODE_SSSE3: return "ssse3";
+        default: return "scalar";
+    }
+}
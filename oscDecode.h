@@ -0,0 +1,27 @@
+#ifndef OSC_DECODE_H
+#define OSC_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-order and padding kernels behind the message parser. The widest
+// level the CPU supports is picked on first use; the scalar level runs
+// everywhere and is the only one off x86
+typedef enum {
+    OSC_DECODE_SCALAR,
+    OSC_DECODE_SSSE3,               // 16-byte shuffles; SSE2 for the string scan
+    OSC_DECODE_AVX2                 // 32-byte shuffles and scans
+} OscDecodeLevel;
+
+// Big-endian 32-bit words to host order
+void oscSwap32(uint32_t* out, const unsigned char* in, size_t count);
+// Length of the NUL-terminated OSC string at data including its 4-byte
+// padding, or 0 when there is no terminator within available bytes
+size_t oscPaddedLength(const char* data, size_t available);
+
+OscDecodeLevel oscDecodeLevel(void);
+// Forces a level, capped at what the CPU supports; returns the one in use
+OscDecodeLevel oscDecodeSelect(OscDecodeLevel level);
+const char* oscDecodeLevelName(OscDecodeLevel level);
+
+#endif
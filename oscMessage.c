@@ -0,0 +1,217 @@
+#include "oscMessage.h"
+#include "oscDecode.h"
+#include <string.h>
+#include <arpa/inet.h>
+
+// Length of a NUL-terminated OSC string including its 4-byte padding,
+// or 0 if the terminator is missing
+static size_t paddedStringLength(const char* data, size_t available) {
+    return oscPaddedLength(data, available);
+}
+
+// Size of the argument with the given type tag, or -1 if it overruns
+static long argumentSize(char tag, const unsigned char* argument, const unsigned char* end) {
+    size_t available = (size_t)(end - argument);
+    
+    switch (tag) {
+        case 'i': case 'f': case 'c': case 'r': case 'm':
+            return available >= 4 ? 4 : -1;
+        case 'h': case 'd': case 't':
+            return available >= 8 ? 8 : -1;
+        case 's': case 'S': {
+            size_t length = paddedStringLength((const char*)argument, available);
+            return length ? (long)length : -1;
+        }
+        case 'b': {
+            if (available < 4) return -1;
+            uint32_t blobLength;
+            memcpy(&blobLength, argument, 4);
+            blobLength = ntohl(blobLength);
+            size_t total = 4 + (((size_t)blobLength + 3) & ~(size_t)3);
+            return total <= available ? (long)total : -1;
+        }
+        case 'T': case 'F': case 'N': case 'I': case '[': case ']':
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int parseOscMessage(const char* data, size_t length, OscMessage* message) {
+    if (!data || !message || length < 4 || data[0] != '/') return -1;
+    
+    size_t addressLength = paddedStringLength(data, length);
+    if (!addressLength) return -1;
+    
+    message->address = data;
+    message->typeTags = "";
+    message->arguments = (const unsigned char*)data + addressLength;
+    message->end = (const unsigned char*)data + length;
+    message->argumentCount = 0;
+    
+    if (addressLength < length && data[addressLength] == ',') {
+        size_t tagLength = paddedStringLength(data + addressLength, length - addressLength);
+        if (!tagLength) return -1;
+        
+        message->typeTags = data + addressLength + 1;
+        message->arguments += tagLength;
+        message->argumentCount = (int)strlen(message->typeTags);
+    }
+    
+    return 0;
+}
+
+static int walkPacket(const char* data, size_t length, OscMessageHandler handler, void* context, int depth) {
+    if (length >= 16 && memcmp(data, OSC_BUNDLE_TAG, sizeof(OSC_BUNDLE_TAG)) == 0) {
+        if (depth >= OSC_MAX_BUNDLE_DEPTH) return -1;
+        
+        int dispatched = 0;
+        size_t offset = 16;   // "#bundle\0" plus the 8-byte time tag
+        
+        while (offset + 4 <= length) {
+            uint32_t elementLength;
+            memcpy(&elementLength, data + offset, 4);
+            elementLength = ntohl(elementLength);
+            offset += 4;
+            
+            if (elementLength > length - offset) return -1;
+            
+            int result = walkPacket(data + offset, elementLength, handler, context, depth + 1);
+            if (result < 0) return -1;
+            
+            dispatched += result;
+            offset += elementLength;
+        }
+        return dispatched;
+    }
+    
+    OscMessage message;
+    if (parseOscMessage(data, length, &message) < 0) return -1;
+    
+    handler(&message, context);
+    return 1;
+}
+
+int forEachOscMessage(const char* data, size_t length, OscMessageHandler handler, void* context) {
+    if (!data || !handler) return -1;
+    return walkPacket(data, length, handler, context, 0);
+}
+
+int oscArgumentString(const OscMessage* message, int index, const char** value) {
+    if (!message || index < 0 || index >= message->argumentCount) return 0;
+    
+    const unsigned char* argument = message->arguments;
+    
+    for (int i = 0; i <= index; i++) {
+        char tag = message->typeTags[i];
+        long size = argumentSize(tag, argument, message->end);
+        if (size < 0) return 0;
+        
+        if (i == index) {
+            if (tag != 's' && tag != 'S') return 0;
+            *value = (const char*)argument;
+            return 1;
+        }
+        argument += size;
+    }
+    
+    return 0;
+}
+
+// Numeric value of one argument already checked to fit
+static int decodeNumber(char tag, const unsigned char* argument, double* value) {
+    uint32_t word;
+    uint64_t wide;
+    switch (tag) {
+        case 'T':
+            *value = 1.0;
+            return 1;
+        case 'F':
+            *value = 0.0;
+            return 1;
+        case 'i':
+            memcpy(&word, argument, 4);
+            *value = (double)(int32_t)ntohl(word);
+            return 1;
+        case 'f': {
+            float number;
+            memcpy(&word, argument, 4);
+            word = ntohl(word);
+            memcpy(&number, &word, 4);
+            *value = number;
+            return 1;
+        }
+        case 'h': case 'd':
+            memcpy(&wide, argument, 8);
+            wide = ((uint64_t)ntohl((uint32_t)wide) << 32) | ntohl((uint32_t)(wide >> 32));
+            if (tag == 'h') {
+                *value = (double)(int64_t)wide;
+            } else {
+                memcpy(value, &wide, 8);
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int oscArgumentNumber(const OscMessage* message, int index, double* value) {
+    if (!message || index < 0 || index >= message->argumentCount) return 0;
+    
+    const unsigned char* argument = message->arguments;
+    
+    for (int i = 0; i < index; i++) {
+        long size = argumentSize(message->typeTags[i], argument, message->end);
+        if (size < 0) return 0;
+        argument += size;
+    }
+    
+    char tag = message->typeTags[index];
+    if (argumentSize(tag, argument, message->end) < 0) return 0;
+    
+    return decodeNumber(tag, argument, value);
+}
+
+// Runs of i or f arguments are swapped a block at a time by the decode
+// kernels; anything else goes through decodeNumber one by one
+int oscArgumentNumbers(const OscMessage* message, double* values, int capacity) {
+    if (!message || !values) return 0;
+    
+    const unsigned char* argument = message->arguments;
+    int limit = message->argumentCount < capacity ? message->argumentCount : capacity;
+    uint32_t words[OSC_DECODE_BLOCK];
+    int count = 0;
+    
+    while (count < limit) {
+        char tag = message->typeTags[count];
+    
+        if (tag == 'i' || tag == 'f') {
+            int run = 1;
+            while (count + run < limit && run < OSC_DECODE_BLOCK && message->typeTags[count + run] == tag) run++;
+            if ((size_t)(message->end - argument) < (size_t)run * 4) return count;
+    
+            oscSwap32(words, argument, (size_t)run);
+            if (tag == 'f') {
+                for (int k = 0; k < run; k++) {
+                    float number;
+                    memcpy(&number, &words[k], 4);
+                    values[count + k] = number;
+                }
+            } else {
+                for (int k = 0; k < run; k++) {
+                    values[count + k] = (double)(int32_t)words[k];
+                }
+            }
+            count += run;
+            argument += run * 4;
+            continue;
+        }
+    
+        long size = argumentSize(tag, argument, message->end);
+        if (size < 0 || !decodeNumber(tag, argument, &values[count])) return count;
+        count++;
+        argument += size;
+    }
+    
+    return count;
+}
@@ -0,0 +1,31 @@
+#ifndef OSC_MESSAGE_H
+#define OSC_MESSAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OSC_BUNDLE_TAG "#bundle"
+#define OSC_MAX_BUNDLE_DEPTH 4
+#define OSC_DECODE_BLOCK 64        // 32-bit arguments swapped per kernel call
+
+// Zero-copy view of one OSC message inside a received datagram
+typedef struct {
+    const char* address;
+    const char* typeTags;            // Tags after the ',' ("" when absent)
+    const unsigned char* arguments;  // First argument byte
+    const unsigned char* end;        // One past the last message byte
+    int argumentCount;
+} OscMessage;
+
+typedef void (*OscMessageHandler)(const OscMessage* message, void* context);
+
+int parseOscMessage(const char* data, size_t length, OscMessage* message);
+int forEachOscMessage(const char* data, size_t length, OscMessageHandler handler, void* context);
+int oscArgumentString(const OscMessage* message, int index, const char** value);
+// Numeric view of an i, f, h, d, T or F argument (booleans as 1 and 0)
+int oscArgumentNumber(const OscMessage* message, int index, double* value);
+// Leading numeric arguments into values, up to capacity; stops at the
+// first argument that is not numeric and returns how many were decoded
+int oscArgumentNumbers(const OscMessage* message, double* values, int capacity);
+
+#endif
@@ -0,0 +1,600 @@
+#include "oscPattern.h"
+#include "configCache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+enum {
+    OP_CHAR,                                // Consume ch
+    OP_CLASS,                               // Consume a byte in classes[arg]
+    OP_SPLIT,                               // Continue at arg and alt
+    OP_JMP,                                 // Continue at arg
+    OP_MATCH                                // Pattern arg matched
+};
+
+#define CLASS_NOT_SLASH 0                   // '?' and '*': anything within one path level
+
+typedef struct {
+    uint8_t op;
+    uint8_t ch;
+    int arg;
+    int alt;
+} PatternInst;
+
+typedef struct {
+    uint8_t bits[32];
+} CharClass;
+
+struct OscPatternSet {
+    PatternInst* program;
+    int programLength;
+    CharClass* classes;
+    int classCount;
+    int* startItems;                        // Closure of every pattern's entry point
+    int startCount;
+    int byteClassCount;
+    int byteClass[256];                     // Bytes no instruction tells apart share a column
+    int representative[256];                // One byte of each column
+    
+    // DFA built on first use. A row holds byteClassCount transitions (-1 not
+    // built yet, 0 dead), then the accept count and ids. Rows never move and
+    // are complete before the transition reaching them is published, so
+    // matching reads them without the lock; the rest is guarded by it
+    int* rows[OSC_PATTERN_MAX_STATES];
+    int states;
+    pthread_mutex_t lock;
+    int* items;                             // NFA instruction lists of every state
+    int itemCount;
+    int itemCapacity;
+    int itemOffsets[OSC_PATTERN_MAX_STATES + 1];
+    int stateTable[OSC_PATTERN_MAX_STATES * 2];     // Open addressing over item lists, -1 empty
+};
+
+// Per-thread work space for closures; sized to the largest program seen
+typedef struct {
+    unsigned* marks;
+    unsigned mark;
+    int* stack;
+    int* current;
+    int* next;
+    int* ids;
+    int capacity;
+} PatternScratch;
+
+static __thread PatternScratch threadScratch;
+
+static const char* parseClass(const char* p, CharClass* out) {
+    int negate = 0;
+    memset(out, 0, sizeof(*out));
+    
+    if (*p == '!') {
+        negate = 1;
+        p++;
+    }
+    
+    while (*p && *p != ']') {
+        unsigned char low = (unsigned char)*p, high = low;
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            high = (unsigned char)p[2];
+            p += 3;
+        } else {
+            p++;
+        }
+        for (int c = low; c <= high; c++) {
+            out->bits[c >> 3] |= (uint8_t)(1 << (c & 7));
+        }
+    }
+    if (!*p) return NULL;
+    
+    if (negate) {
+        for (int i = 0; i < 32; i++) out->bits[i] = (uint8_t)~out->bits[i];
+    }
+    out->bits[0] &= (uint8_t)~1;                            // NUL
+    out->bits['/' >> 3] &= (uint8_t)~(1 << ('/' & 7));     // Classes never cross a level
+    return p + 1;
+}
+
+static int classHas(const CharClass* cls, unsigned char c) {
+    return (cls->bits[c >> 3] >> (c & 7)) & 1;
+}
+
+int oscPatternIsWildcard(const char* pattern) {
+    return strpbrk(pattern, "*?[{") != NULL || strstr(pattern, "//") != NULL;
+}
+
+int oscPatternValid(const char* pattern) {
+    for (const char* p = pattern; *p; p++) {
+        if (*p == '[') {
+            CharClass cls;
+            const char* end = parseClass(p + 1, &cls);
+            if (!end) return 0;
+            p = end - 1;
+        } else if (*p == '{') {
+            const char* end = strpbrk(p + 1, "{}[*?");
+            if (!end || *end != '}') return 0;
+            p = end;
+        }
+    }
+    return 1;
+}
+
+int oscPatternMatch(const char* pattern, const char* address) {
+    const char* p = pattern;
+    const char* a = address;
+    
+    while (*p) {
+        if (*p == '?') {
+            if (!*a || *a == '/') return 0;
+            p++;
+            a++;
+        } else if (*p == '*') {
+            while (*p == '*') p++;
+            for (;;) {
+                if (oscPatternMatch(p, a)) return 1;
+                if (!*a || *a == '/') return 0;
+                a++;
+            }
+        } else if (*p == '[') {
+            CharClass cls;
+            p = parseClass(p + 1, &cls);
+            if (!p || !classHas(&cls, (unsigned char)*a)) return 0;
+            a++;
+        } else if (*p == '{') {
+            const char* end = strchr(p, '}');
+            if (!end) return 0;
+    
+            const char* alternative = p + 1;
+            while (alternative <= end) {
+                const char* altEnd = alternative;
+                while (*altEnd != ',' && *altEnd != '}') altEnd++;
+                size_t length = (size_t)(altEnd - alternative);
+                if (strncmp(a, alternative, length) == 0 && oscPatternMatch(end + 1, a + length)) return 1;
+                alternative = altEnd + 1;
+            }
+            return 0;
+        } else if (p[0] == '/' && p[1] == '/') {
+            if (*a != '/') return 0;
+            p += 2;
+            a++;
+            for (;;) {
+                if (oscPatternMatch(p, a)) return 1;
+                while (*a && *a != '/') a++;
+                if (!*a) return 0;
+                a++;
+            }
+        } else {
+            if (*p != *a) return 0;
+            p++;
+            a++;
+        }
+    }
+    
+    return *a == '\0';
+}
+
+// Program builder; a failed allocation sticks and is checked once at the end
+typedef struct {
+    OscPatternSet* set;
+    int capacity;
+    int classCapacity;
+    int failed;
+} PatternBuilder;
+
+static int emit(PatternBuilder* b, uint8_t op, uint8_t ch, int arg, int alt) {
+    OscPatternSet* set = b->set;
+    if (set->programLength == b->capacity) {
+        int capacity = b->capacity ? b->capacity * 2 : 256;
+        PatternInst* program = realloc(set->program, sizeof(PatternInst) * capacity);
+        if (!program) {
+            b->failed = 1;
+            return set->programLength;
+        }
+        set->program = program;
+        b->capacity = capacity;
+    }
+    
+    PatternInst* inst = &set->program[set->programLength];
+    inst->op = op;
+    inst->ch = ch;
+    inst->arg = arg;
+    inst->alt = alt;
+    return set->programLength++;
+}
+
+static void patch(PatternBuilder* b, int pc, int arg, int alt) {
+    if (b->failed) return;
+    b->set->program[pc].arg = arg;
+    b->set->program[pc].alt = alt;
+}
+
+static int addClass(PatternBuilder* b, const CharClass* cls) {
+    OscPatternSet* set = b->set;
+    if (set->classCount == b->classCapacity) {
+        int capacity = b->classCapacity ? b->classCapacity * 2 : 16;
+        CharClass* classes = realloc(set->classes, sizeof(CharClass) * capacity);
+        if (!classes) {
+            b->failed = 1;
+            return CLASS_NOT_SLASH;
+        }
+        set->classes = classes;
+        b->classCapacity = capacity;
+    }
+    set->classes[set->classCount] = *cls;
+    return set->classCount++;
+}
+
+// Thompson construction: each pattern becomes a run of instructions
+// ending in OP_MATCH id
+static int emitPattern(PatternBuilder* b, const char* p, int id) {
+    int start = b->set->programLength;
+    
+    while (*p) {
+        if (*p == '?') {
+            emit(b, OP_CLASS, 0, CLASS_NOT_SLASH, 0);
+            p++;
+        } else if (*p == '*') {
+            int loop = emit(b, OP_SPLIT, 0, 0, 0);
+            emit(b, OP_CLASS, 0, CLASS_NOT_SLASH, 0);
+            emit(b, OP_JMP, 0, loop, 0);
+            patch(b, loop, loop + 1, b->set->programLength);
+            while (*p == '*') p++;
+        } else if (*p == '[') {
+            CharClass cls;
+            p = parseClass(p + 1, &cls);
+            emit(b, OP_CLASS, 0, addClass(b, &cls), 0);
+        } else if (*p == '{') {
+            // Each alternative but the last forks off the next one and
+            // jumps to the end; pending jumps chain through arg until patched
+            int pendingJumps = -1;
+            p++;
+            for (;;) {
+                const char* altEnd = p;
+                while (*altEnd != ',' && *altEnd != '}') altEnd++;
+                int last = *altEnd == '}';
+    
+                int split = last ? -1 : emit(b, OP_SPLIT, 0, 0, 0);
+                for (; p < altEnd; p++) {
+                    emit(b, OP_CHAR, (uint8_t)*p, 0, 0);
+                }
+                if (!last) {
+                    pendingJumps = emit(b, OP_JMP, 0, pendingJumps, 0);
+                    patch(b, split, split + 1, b->set->programLength);
+                }
+                p = altEnd + 1;
+                if (last) break;
+            }
+            while (pendingJumps >= 0 && !b->failed) {
+                int next = b->set->program[pendingJumps].arg;
+                patch(b, pendingJumps, b->set->programLength, 0);
+                pendingJumps = next;
+            }
+        } else if (p[0] == '/' && p[1] == '/') {
+            // '/' then ([^/]*/)*: zero or more whole levels
+            emit(b, OP_CHAR, '/', 0, 0);
+            int levels = emit(b, OP_SPLIT, 0, 0, 0);
+            int segment = emit(b, OP_SPLIT, 0, 0, 0);
+            emit(b, OP_CLASS, 0, CLASS_NOT_SLASH, 0);
+            emit(b, OP_JMP, 0, segment, 0);
+            int slash = emit(b, OP_CHAR, '/', 0, 0);
+            emit(b, OP_JMP, 0, levels, 0);
+            patch(b, levels, b->set->programLength, segment);
+            patch(b, segment, segment + 1, slash);
+            p += 2;
+        } else {
+            emit(b, OP_CHAR, (uint8_t)*p, 0, 0);
+            p++;
+        }
+    }
+    
+    emit(b, OP_MATCH, 0, id, 0);
+    return start;
+}
+
+static int instAccepts(const OscPatternSet* set, const PatternInst* inst, unsigned char c) {
+    if (inst->op == OP_CHAR) return inst->ch == c;
+    if (inst->op == OP_CLASS) return classHas(&set->classes[inst->arg], c);
+    return 0;
+}
+
+static int scratchReserve(PatternScratch* scratch, int programLength) {
+    if (scratch->capacity >= programLength) return 0;
+    
+    free(scratch->marks);
+    free(scratch->stack);
+    free(scratch->current);
+    free(scratch->next);
+    free(scratch->ids);
+    memset(scratch, 0, sizeof(*scratch));
+    
+    scratch->marks = calloc((size_t)programLength, sizeof(unsigned));
+    scratch->stack = malloc(sizeof(int) * (2 * (size_t)programLength + 1));
+    scratch->current = malloc(sizeof(int) * (size_t)programLength);
+    scratch->next = malloc(sizeof(int) * (size_t)programLength);
+    scratch->ids = malloc(sizeof(int) * (size_t)programLength);
+    if (!scratch->marks || !scratch->stack || !scratch->current || !scratch->next || !scratch->ids) {
+        return -1;
+    }
+    scratch->capacity = programLength;
+    return 0;
+}
+
+static void nextMark(PatternScratch* scratch) {
+    if (++scratch->mark == 0) {
+        memset(scratch->marks, 0, sizeof(unsigned) * (size_t)scratch->capacity);
+        scratch->mark = 1;
+    }
+}
+
+// Appends pc and everything reachable from it through SPLIT and JMP to
+// list, skipping instructions already added since the last nextMark
+static void addClosure(const OscPatternSet* set, PatternScratch* scratch, int pc, int* list, int* count) {
+    int depth = 0;
+    scratch->stack[depth++] = pc;
+    
+    while (depth > 0) {
+        pc = scratch->stack[--depth];
+        if (scratch->marks[pc] == scratch->mark) continue;
+        scratch->marks[pc] = scratch->mark;
+    
+        const PatternInst* inst = &set->program[pc];
+        if (inst->op == OP_SPLIT) {
+            scratch->stack[depth++] = inst->alt;
+            scratch->stack[depth++] = inst->arg;
+        } else if (inst->op == OP_JMP) {
+            scratch->stack[depth++] = inst->arg;
+        } else {
+            list[(*count)++] = pc;
+        }
+    }
+}
+
+static int step(const OscPatternSet* set, PatternScratch* scratch, const int* current, int count,
+                unsigned char c, int* next) {
+    int nextCount = 0;
+    nextMark(scratch);
+    for (int i = 0; i < count; i++) {
+        if (instAccepts(set, &set->program[current[i]], c)) {
+            addClosure(set, scratch, current[i] + 1, next, &nextCount);
+        }
+    }
+    return nextCount;
+}
+
+static int compareInts(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Matched ids of a state, sorted and without duplicates
+static int collectIds(const OscPatternSet* set, const int* items, int count, int* ids) {
+    int idCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (set->program[items[i]].op == OP_MATCH) {
+            ids[idCount++] = set->program[items[i]].arg;
+        }
+    }
+    
+    qsort(ids, (size_t)idCount, sizeof(int), compareInts);
+    int unique = 0;
+    for (int i = 0; i < idCount; i++) {
+        if (unique == 0 || ids[unique - 1] != ids[i]) ids[unique++] = ids[i];
+    }
+    return unique;
+}
+
+// Partitions bytes so that two bytes share a column exactly when every
+// instruction treats them alike, keeping rows short
+static void computeByteClasses(OscPatternSet* set) {
+    int remap[512];
+    int sizes[256] = {256};
+    memset(set->byteClass, 0, sizeof(set->byteClass));
+    set->byteClassCount = 1;
+    
+    for (int pc = 0; pc < set->programLength; pc++) {
+        const PatternInst* inst = &set->program[pc];
+        
+        // A literal only splits its own byte off, no need to look at the rest
+        if (inst->op == OP_CHAR) {
+            int k = set->byteClass[inst->ch];
+            if (sizes[k] > 1) {
+                sizes[k]--;
+                sizes[set->byteClassCount] = 1;
+                set->byteClass[inst->ch] = set->byteClassCount++;
+            }
+            continue;
+        }
+        if (inst->op != OP_CLASS) continue;
+        
+        for (int k = 0; k < set->byteClassCount * 2; k++) remap[k] = -1;
+        int classes = 0;
+        memset(sizes, 0, sizeof(sizes));
+        for (int c = 0; c < 256; c++) {
+            int key = set->byteClass[c] * 2 + instAccepts(set, inst, (unsigned char)c);
+            if (remap[key] < 0) remap[key] = classes++;
+            set->byteClass[c] = remap[key];
+            sizes[remap[key]]++;
+        }
+        set->byteClassCount = classes;
+    }
+    
+    for (int c = 255; c >= 0; c--) {
+        set->representative[set->byteClass[c]] = c;
+    }
+}
+
+// Returns the state for a sorted item list, creating it and its row when
+// new, or -1 once OSC_PATTERN_MAX_STATES exist. Caller holds the lock
+static int findOrAddState(OscPatternSet* set, PatternScratch* scratch, const int* items, int count) {
+    uint64_t hash = hashConfigBytes(items, sizeof(int) * (size_t)count);
+    const int tableSize = OSC_PATTERN_MAX_STATES * 2;
+    
+    for (int probe = 0; probe < tableSize; probe++) {
+        int* slot = &set->stateTable[(hash + probe) & (tableSize - 1)];
+        if (*slot >= 0) {
+            int length = set->itemOffsets[*slot + 1] - set->itemOffsets[*slot];
+            if (length == count && memcmp(set->items + set->itemOffsets[*slot], items, sizeof(int) * (size_t)count) == 0) {
+                return *slot;
+            }
+            continue;
+        }
+        
+        int state = set->states;
+        if (state >= OSC_PATTERN_MAX_STATES) return -1;
+        
+        if (!set->items || set->itemCount + count > set->itemCapacity) {
+            int capacity = set->itemCapacity ? set->itemCapacity * 2 : 1024;
+            while (capacity < set->itemCount + count) capacity *= 2;
+            int* grown = realloc(set->items, sizeof(int) * (size_t)capacity);
+            if (!grown) return -1;
+            set->items = grown;
+            set->itemCapacity = capacity;
+        }
+        
+        int idCount = collectIds(set, items, count, scratch->ids);
+        int* row = malloc(sizeof(int) * (size_t)(set->byteClassCount + 1 + idCount));
+        if (!row) return -1;
+        for (int k = 0; k < set->byteClassCount; k++) {
+            row[k] = state == 0 ? 0 : -1;
+        }
+        row[set->byteClassCount] = idCount;
+        memcpy(row + set->byteClassCount + 1, scratch->ids, sizeof(int) * (size_t)idCount);
+        
+        memcpy(set->items + set->itemCount, items, sizeof(int) * (size_t)count);
+        set->itemCount += count;
+        set->itemOffsets[state + 1] = set->itemCount;
+        set->rows[state] = row;
+        *slot = state;
+        __atomic_store_n(&set->states, state + 1, __ATOMIC_RELEASE);
+        return state;
+    }
+    return -1;
+}
+
+// Fills in one missing transition. Another thread may have got there
+// first; either way the published value is returned
+static int addTransition(OscPatternSet* set, int state, int k) {
+    pthread_mutex_lock(&set->lock);
+    
+    int next = __atomic_load_n(&set->rows[state][k], __ATOMIC_ACQUIRE);
+    PatternScratch* scratch = &threadScratch;
+    if (next < 0 && scratchReserve(scratch, set->programLength + 1) == 0) {
+        const int* items = set->items + set->itemOffsets[state];
+        int count = set->itemOffsets[state + 1] - set->itemOffsets[state];
+        int nextCount = step(set, scratch, items, count, (unsigned char)set->representative[k], scratch->next);
+        
+        // Equal lists must compare equal bytewise
+        qsort(scratch->next, (size_t)nextCount, sizeof(int), compareInts);
+        next = nextCount ? findOrAddState(set, scratch, scratch->next, nextCount) : 0;
+        if (next >= 0) {
+            __atomic_store_n(&set->rows[state][k], next, __ATOMIC_RELEASE);
+        }
+    }
+    
+    pthread_mutex_unlock(&set->lock);
+    return next;
+}
+
+OscPatternSet* oscPatternSetBuild(const char* const* patterns, const int* ids, int count) {
+    OscPatternSet* set = calloc(1, sizeof(OscPatternSet));
+    if (!set) return NULL;
+    pthread_mutex_init(&set->lock, NULL);
+    memset(set->stateTable, -1, sizeof(set->stateTable));
+    
+    PatternBuilder builder = { .set = set };
+    CharClass notSlash;
+    parseClass("!]", &notSlash);
+    addClass(&builder, &notSlash);
+    
+    int* starts = malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+    int startCount = 0;
+    if (!starts) builder.failed = 1;
+    
+    for (int i = 0; i < count && !builder.failed; i++) {
+        if (!oscPatternValid(patterns[i])) continue;
+        starts[startCount++] = emitPattern(&builder, patterns[i], ids[i]);
+    }
+    
+    PatternScratch* scratch = &threadScratch;
+    set->startItems = malloc(sizeof(int) * (size_t)(set->programLength + 1));
+    if (builder.failed || !set->startItems || scratchReserve(scratch, set->programLength + 1) < 0) {
+        free(starts);
+        oscPatternSetFree(set);
+        return NULL;
+    }
+    
+    nextMark(scratch);
+    for (int i = 0; i < startCount; i++) {
+        addClosure(set, scratch, starts[i], set->startItems, &set->startCount);
+    }
+    qsort(set->startItems, (size_t)set->startCount, sizeof(int), compareInts);
+    free(starts);
+    
+    computeByteClasses(set);
+    
+    // State 0 is dead, state 1 is the start
+    if (findOrAddState(set, scratch, set->startItems, 0) != 0 ||
+        findOrAddState(set, scratch, set->startItems, set->startCount) != 1) {
+        oscPatternSetFree(set);
+        return NULL;
+    }
+    return set;
+}
+
+void oscPatternSetFree(OscPatternSet* set) {
+    if (!set) return;
+    for (int i = 0; i < set->states; i++) {
+        free(set->rows[i]);
+    }
+    pthread_mutex_destroy(&set->lock);
+    free(set->program);
+    free(set->classes);
+    free(set->startItems);
+    free(set->items);
+    free(set);
+}
+
+// Thompson simulation, for addresses arriving after the DFA is full
+static int simulate(const OscPatternSet* set, const char* address, const int** ids) {
+    PatternScratch* scratch = &threadScratch;
+    if (scratchReserve(scratch, set->programLength + 1) < 0) return 0;
+    
+    int count = set->startCount;
+    memcpy(scratch->current, set->startItems, sizeof(int) * (size_t)count);
+    
+    for (const unsigned char* p = (const unsigned char*)address; *p && count > 0; p++) {
+        count = step(set, scratch, scratch->current, count, *p, scratch->next);
+        int* swap = scratch->current;
+        scratch->current = scratch->next;
+        scratch->next = swap;
+    }
+    
+    *ids = scratch->ids;
+    return collectIds(set, scratch->current, count, scratch->ids);
+}
+
+int oscPatternSetMatch(const OscPatternSet* set, const char* address, const int** ids) {
+    *ids = NULL;
+    if (!set || set->startCount == 0) return 0;
+    
+    int state = 1;
+    const int* row = set->rows[state];
+    for (const unsigned char* p = (const unsigned char*)address; *p; p++) {
+        int k = set->byteClass[*p];
+        int next = __atomic_load_n(&row[k], __ATOMIC_ACQUIRE);
+        if (next < 0) {
+            next = addTransition((OscPatternSet*)set, state, k);
+            if (next < 0) return simulate(set, address, ids);
+        }
+        if (next == 0) return 0;
+        state = next;
+        row = set->rows[state];
+    }
+    
+    *ids = row + set->byteClassCount + 1;
+    return row[set->byteClassCount];
+}
+
+int oscPatternSetStates(const OscPatternSet* set) {
+    return set ? __atomic_load_n(&set->states, __ATOMIC_ACQUIRE) : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef OSC_PATTERN_H
+#define OSC_PATTERN_H
+
+#define OSC_PATTERN_MAX_STATES 4096         // DFA states per set; later addresses fall back to NFA simulation
+
+// OSC 1.1 address patterns: '?' one character, '*' any run of characters,
+// '[a-z]' and '[!a-z]' character classes, '{Foo,Bar}' alternatives, none of
+// which cross a '/', and '//' for any number of intermediate path levels.
+// A pattern must match the whole address
+typedef struct OscPatternSet OscPatternSet;
+
+// Pattern text uses at least one of the wildcards above
+int oscPatternIsWildcard(const char* pattern);
+// Brackets and braces are closed
+int oscPatternValid(const char* pattern);
+// Reference matcher, one pattern at a time by backtracking
+int oscPatternMatch(const char* pattern, const char* address);
+
+// Compiles every pattern into one program whose DFA is built lazily, a
+// state at a time as addresses first reach it; ids are reported back by
+// oscPatternSetMatch. Invalid patterns are skipped. Returns NULL on
+// allocation failure
+OscPatternSet* oscPatternSetBuild(const char* const* patterns, const int* ids, int count);
+void oscPatternSetFree(OscPatternSet* set);
+// One pass over address. Returns the number of matching ids and points ids
+// at them in ascending order; valid until the next call on this thread.
+// Safe from several threads: known transitions are read without locking
+int oscPatternSetMatch(const OscPatternSet* set, const char* address, const int** ids);
+// DFA states built so far
+int oscPatternSetStates(const OscPatternSet* set);
+
+#endif
@@ -3,10 +3,25 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include "keyPress.h"
+#include "configCache.h"
+#include "stateJournal.h"
+#include "avatarProfile.h"
+#include "oscMessage.h"
+#include "metrics.h"
+#include "asyncLog.h"
+#include "trace.h"
+#include "parameterStore.h"
+#include "matchIndex.h"
+#include "matchCache.h"
+#include "timerWheel.h"
+#include "stateMachine.h"
+#include "quiescence.h"
+#include <regex.h>
 
 perimeterFilter perimeterFilters[MAX_FILTERS];
 int filterCount = 0;
 int messagePrintingEnabled = 0;
+static int passUnchangedCount = 0;      // Filters that opt out of change-only dispatch
 
 typedef struct {
     const char* pattern;
@@ -34,14 +49,17 @@ int generateDefaultConfig(void) {
     filterCount = 0;
     
     for (int i = 0; defaultFilters[i].pattern != NULL && filterCount < MAX_FILTERS; i++) {
+        memset(&perimeterFilters[filterCount], 0, sizeof(perimeterFilter));
         strcpy(perimeterFilters[filterCount].pattern, defaultFilters[i].pattern);
         strcpy(perimeterFilters[filterCount].action, defaultFilters[i].action);
         perimeterFilters[filterCount].count = 0;
         perimeterFilters[filterCount].enabled = 1;
         perimeterFilters[filterCount].lastReceived = 0;
         perimeterFilters[filterCount].triggerAction = 1;
+        perimeterFilters[filterCount].avatar[0] = '\0';
         
         initRateLimiter(&perimeterFilters[filterCount].rateLimiter);
+        compileFilter(&perimeterFilters[filterCount]);
         
         filterCount++;
         
@@ -64,42 +82,55 @@ int generateDefaultConfig(void) {
     }
 }
 
-void addPerimeterFilter(const char* pattern) {
+void addPerimeterFilter(const char* pattern, MatchKind matchKind) {
     if (filterCount >= MAX_FILTERS) {
         printf("Maximum number of filters reached (%d)\n", MAX_FILTERS);
         return;
     }
-
+    
     for (int i = 0; i < filterCount; i++) {
         if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
             printf("Filter '%s' already exists\n", pattern);
             return;
         }
     }
-
+    
+    // Matches from before a clear may still hold the slot's old id
+    waitForReaders();
+    memset(&perimeterFilters[filterCount], 0, sizeof(perimeterFilter));
     strcpy(perimeterFilters[filterCount].pattern, pattern);
     perimeterFilters[filterCount].count = 0;
     perimeterFilters[filterCount].enabled = 1;
     perimeterFilters[filterCount].lastReceived = 0;
     perimeterFilters[filterCount].triggerAction = 0;
     memset(perimeterFilters[filterCount].action, 0, MAX_ACTION_LENGTH);
+    memset(perimeterFilters[filterCount].avatar, 0, MAX_AVATAR_ID_LENGTH);
+    perimeterFilters[filterCount].matchKind = matchKind;
     
     initRateLimiter(&perimeterFilters[filterCount].rateLimiter);
+    compileFilter(&perimeterFilters[filterCount]);
     
     filterCount++;
+    rebuildFilterIndex();
     
-    printf("Added filter: '%s' [Default rate limit: %dc/%ds]\n", 
-           pattern, DEFAULT_RATE_LIMIT_COUNT, DEFAULT_RATE_LIMIT_SECONDS);
+    printf("Added filter: '%s' (%s) [Default rate limit: %dc/%ds]\n", pattern,
+           matchKindName(perimeterFilters[filterCount - 1].matchKind),
+           DEFAULT_RATE_LIMIT_COUNT, DEFAULT_RATE_LIMIT_SECONDS);
     saveConfig();
 }
 
 void removePerimeterFilter(const char* pattern) {
     for (int i = 0; i < filterCount; i++) {
         if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            // Indexes and cached lists name filters by position. Matching
+            // waits until the ones naming the new positions are published
+            pauseReaders();
             for (int j = i; j < filterCount - 1; j++) {
                 perimeterFilters[j] = perimeterFilters[j + 1];
             }
             filterCount--;
+            rebuildFilterIndex();
+            resumeReaders();
             printf("Removed filter: '%s'\n", pattern);
             saveConfig();
             return;
@@ -113,17 +144,18 @@ void listParameterFilters(void) {
         printf("No parameter filters configured\n");
         return;
     }
-
+    
     printf("Parameter Filters:\n");
-    printf("%-40s %-8s %-8s %-8s %-8s %-12s %-15s %-15s %s\n", 
-           "Pattern", "Count", "Status", "Action", "LastExec", "Rate Limit", "Last Received", "Last Executed", "Command");
-    printf("%-40s %-8s %-8s %-8s %-8s %-12s %-15s %-15s %s\n", 
-           "-------", "-----", "------", "------", "--------", "----------", "-------------", "-------------", "-------");
+    printf("%-40s %-9s %-8s %-8s %-8s %-8s %-12s %-12s %-15s %-15s %s\n", 
+           "Pattern", "Match", "Count", "Status", "Action", "LastExec", "Rate Limit", "Condition", "Last Received", "Last Executed", "Command");
+    printf("%-40s %-9s %-8s %-8s %-8s %-8s %-12s %-12s %-15s %-15s %s\n", 
+           "-------", "-----", "-----", "------", "------", "--------", "----------", "---------", "-------------", "-------------", "-------");
     
     for (int i = 0; i < filterCount; i++) {
         char timeStr[64] = "Never";
         char execTimeStr[64] = "Never";
         char rateLimitStr[32];
+        char conditionStr[MAX_CONDITION_LENGTH + MAX_SMOOTHING_LENGTH + 4];
         
         if (perimeterFilters[i].lastReceived > 0) {
             struct tm *tm_info = localtime(&perimeterFilters[i].lastReceived);
@@ -136,14 +168,20 @@ void listParameterFilters(void) {
         }
         
         formatRateLimitString(&perimeterFilters[i].rateLimiter, rateLimitStr, sizeof(rateLimitStr));
+        snprintf(conditionStr, sizeof(conditionStr), "%s%s%s",
+                 perimeterFilters[i].gesture[0] ? perimeterFilters[i].gesture :
+                 perimeterFilters[i].condition[0] ? perimeterFilters[i].condition : "any",
+                 perimeterFilters[i].smoothing[0] ? " ~" : "", perimeterFilters[i].smoothing);
         
-        printf("%-40s %-8d %-8s %-8s %-8d %-12s %-15s %-15s %s\n",
+        printf("%-40s %-9s %-8d %-8s %-8s %-8d %-12s %-12s %-15s %-15s %s\n",
                perimeterFilters[i].pattern,
+               matchKindName(perimeterFilters[i].matchKind),
                perimeterFilters[i].count,
                perimeterFilters[i].enabled ? "ON" : "OFF",
                perimeterFilters[i].triggerAction ? "ON" : "OFF",
                perimeterFilters[i].rateLimiter.lastExecutionCount,
                rateLimitStr,
+               conditionStr,
                timeStr,
                execTimeStr,
                perimeterFilters[i].action[0] ? perimeterFilters[i].action : "None");
@@ -152,8 +190,10 @@ void listParameterFilters(void) {
 
 void clearParameterFilters(void) {
     filterCount = 0;
+    rebuildFilterIndex();
     printf("All parameter filters cleared\n");
     saveConfig();
+    compactStateJournal();
 }
 
 void resetFilterCounts(void) {
@@ -161,9 +201,12 @@ void resetFilterCounts(void) {
         perimeterFilters[i].count = 0;
         perimeterFilters[i].lastReceived = 0;
         resetRateLimiter(&perimeterFilters[i].rateLimiter);
+        resetTriggerCondition(&perimeterFilters[i].trigger);
+        resetGesture(&perimeterFilters[i].gestureState);
+        resetSmoothing(&perimeterFilters[i].smoothingState);
     }
     printf("All filter counts and rate limits reset\n");
-    saveConfig();
+    compactStateJournal();
 }
 
 void enableFilter(const char* pattern) {
@@ -207,7 +250,7 @@ void listFilterRateLimits(void) {
         printf("No parameter filters configured\n");
         return;
     }
-
+    
     printf("Filter Rate Limits:\n");
     printf("%-40s %-12s %-12s %-10s %s\n", "Pattern", "Min Count", "Min Seconds", "Default?", "Status");
     printf("%-40s %-12s %-12s %-10s %s\n", "-------", "---------", "-----------", "--------", "------");
@@ -229,6 +272,7 @@ void resetFilterRateLimit(const char* pattern) {
     for (int i = 0; i < filterCount; i++) {
         if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
             initRateLimiter(&perimeterFilters[i].rateLimiter);
+            journalFilterState(&perimeterFilters[i]);
             printf("Reset rate limit for filter '%s' to defaults: %dc/%ds\n", 
                    pattern, DEFAULT_RATE_LIMIT_COUNT, DEFAULT_RATE_LIMIT_SECONDS);
             saveConfig();
@@ -257,54 +301,315 @@ int isMessagePrintingEnabled(void) {
     return messagePrintingEnabled;
 }
 
+// Filter i's pattern is known to match; the rest is per message
+// Counts the match and runs the action through the rate limiter
+static int fireFilter(int i, time_t currentTime, uint64_t* dispatchNs) {
+    int count = __atomic_add_fetch(&perimeterFilters[i].count, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&perimeterFilters[i].lastReceived, currentTime, __ATOMIC_RELAXED);
+    
+    RateLimiter* limiter = &perimeterFilters[i].rateLimiter;
+    
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_SUBSYS_FILTER)) {
+        logRecord(LOG_LEVEL_DEBUG, LOG_SUBSYS_FILTER, LOG_EVENT_FILTER_MATCH, perimeterFilters[i].pattern,
+                  count, limiter->lastExecutionCount,
+                  limiter->rateLimitCount, limiter->rateLimitSeconds);
+    }
+    
+    if (perimeterFilters[i].triggerAction && perimeterFilters[i].action[0]) {
+        traceLap(TRACE_STAGE_MATCH);
+        int allowed = claimRateLimitedExecution(limiter, count,
+                                                LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_SUBSYS_RATE));
+        traceLap(TRACE_STAGE_RATE);
+        
+        if (allowed) {
+            if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_SUBSYS_ACTION)) {
+                logRecord(LOG_LEVEL_DEBUG, LOG_SUBSYS_ACTION, LOG_EVENT_ACTION_EXECUTED,
+                          perimeterFilters[i].action, 0, 0, 0, 0);
+            }
+            
+            uint64_t dispatchStart = metricsNowNs();
+            executeParsedAction(&perimeterFilters[i].parsedAction,
+                                perimeterFilters[i].action);
+            journalFilterState(&perimeterFilters[i]);
+            __atomic_fetch_add(&perimeterFilters[i].fireCount, 1, __ATOMIC_RELAXED);
+            uint64_t dispatchElapsed = metricsNowNs() - dispatchStart;
+            metricsRecordDispatchTime(dispatchElapsed);
+            *dispatchNs += dispatchElapsed;
+            traceLap(TRACE_STAGE_EXECUTE);
+        } else {
+            __atomic_fetch_add(&perimeterFilters[i].suppressCount, 1, __ATOMIC_RELAXED);
+            if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_SUBSYS_RATE)) {
+                logRecord(LOG_LEVEL_DEBUG, LOG_SUBSYS_RATE, LOG_EVENT_ACTION_RATE_LIMITED,
+                          perimeterFilters[i].action, limiter->rateLimitCount, limiter->rateLimitSeconds, 0, 0);
+            }
+        }
+    }
+    
+    return 1;
+}
+
+// The wheel check for a long press still held; runs on the event loop
+static void longPressExpired(int filter, uint32_t sequence) {
+    if (filter >= filterCount || !perimeterFilters[filter].enabled ||
+        !expireGesture(&perimeterFilters[filter].gestureState, sequence)) {
+        return;
+    }
+    
+    uint64_t dispatchNs = 0;
+    fireFilter(filter, time(NULL), &dispatchNs);
+}
+
+static int applyFilter(int i, uint64_t hash, int hasValue, double value, int unchanged, time_t currentTime,
+                       uint64_t* dispatchNs) {
+    const Smoothing* smoothing = &perimeterFilters[i].smoothingState;
+    int smoothed = hasValue && smoothingEnabled(smoothing);
+    
+    if (!perimeterFilters[i].enabled || (unchanged && !perimeterFilters[i].passUnchanged && !smoothed)) {
+        return 0;
+    }
+    
+    // Repeats still move an average or EMA towards the value, so smoothed
+    // filters take them; one that leaves the output where it was stops here
+    if (smoothed) {
+        int moved;
+        value = smoothValue(smoothing, hash, value, metricsNowNs(), &moved);
+        if (unchanged && !perimeterFilters[i].passUnchanged && !moved) return 0;
+    }
+    
+    // Gesture filters fire on the edge or timer that completes the gesture;
+    // everything else fires on values passing the condition. Either way,
+    // values the filter does not care about stop here, before they count
+    // towards the rate limiter or fork an action
+    Gesture* gesture = &perimeterFilters[i].gestureState;
+    if (gesture->kind != GESTURE_NONE) {
+        uint32_t sequence;
+        GestureResult result = updateGesture(gesture, hasValue, value, metricsNowNs(), &sequence);
+        if (result == GESTURE_ARM && timerWheelSchedule(gesture->thresholdMs, longPressExpired, i, sequence) < 0) {
+            if (LOG_ENABLED(LOG_LEVEL_WARN, LOG_SUBSYS_FILTER)) {
+                logRecord(LOG_LEVEL_WARN, LOG_SUBSYS_FILTER, LOG_EVENT_GESTURE_DROPPED,
+                          perimeterFilters[i].pattern, gesture->thresholdMs, 0, 0, 0);
+            }
+        }
+        if (result != GESTURE_FIRE) return 0;
+    } else if (!evaluateTriggerCondition(&perimeterFilters[i].trigger, hasValue, value)) {
+        return 0;
+    }
+    
+    return fireFilter(i, currentTime, dispatchNs);
+}
+
 int checkParameterFilter(const char* parameter) {
+    return checkParameterValue(parameter, 0, 0.0, 0);
+}
+
+// Every filter whose pattern matches and that applies to the avatar,
+// cheapest kinds first: a hash probe, a trie walk, one automaton for all
+// wildcard patterns, the substring scan and regexes last. The substring
+// scan only walks the global filters and the avatar's own; the indexed
+// kinds hold every avatar's filters and are sifted by binding at the end
+static int collectMatches(const AvatarProfileSet* profiles, uint64_t avatar, const char* parameter,
+                          int parameterLength, int* ids) {
+    const MatchIndex* index = profiles->matchIndex;
+    const int* hits;
+    int count = 0;
+    
+    int hitCount = index ? matchIndexExact(index, parameter, (size_t)parameterLength, &hits) : 0;
+    if (hitCount > 0) {
+        memcpy(ids, hits, sizeof(int) * (size_t)hitCount);
+        count += hitCount;
+    }
+    
+    for (int node = index && index->prefixCount ? 0 : -1, p = 0; node >= 0; p++) {
+        const PrefixNode* prefix = &index->prefixNodes[node];
+        memcpy(ids + count, index->ids + prefix->start, sizeof(int) * (size_t)prefix->count);
+        count += prefix->count;
+        if (!parameter[p]) break;
+        node = matchIndexPrefixStep(index, node, (unsigned char)parameter[p]);
+    }
+    
+    hitCount = oscPatternSetMatch(profiles->patterns, parameter, &hits);
+    if (hitCount > 0) {
+        memcpy(ids + count, hits, sizeof(int) * (size_t)hitCount);
+        count += hitCount;
+    }
+    
+    const AvatarProfile* active = avatarProfileForHash(profiles, avatar);
+    for (int l = 0; l < (active ? 2 : 1); l++) {
+        const int* list = l == 0 ? profiles->globalIndices : active->filterIndices;
+        int listCount = l == 0 ? profiles->globalCount : active->filterCount;
+        for (int f = 0; f < listCount; f++) {
+            const perimeterFilter* filter = &perimeterFilters[list[f]];
+            if (filter->patternLength <= parameterLength && strstr(parameter, filter->pattern)) {
+                ids[count++] = list[f];
+            }
+        }
+    }
+    
+    for (int r = 0; index && r < index->regexCount; r++) {
+        if (regexec(&index->regexes[r].regex, parameter, 0, NULL, 0) == 0) {
+            ids[count++] = index->regexes[r].filter;
+        }
+    }
+    
+    int kept = 0;
+    for (int h = 0; h < count; h++) {
+        uint64_t bound = profiles->boundHashes[ids[h]];
+        if (!bound || bound == avatar) {
+            ids[kept++] = ids[h];
+        }
+    }
+    return kept;
+}
+
+int checkParameterValue(const char* parameter, int hasValue, double value, int unchanged) {
+    static __thread int* matchBuffer = NULL;
+    
     int matched = 0;
+    uint64_t matchStart = metricsNowNs();
+    uint64_t dispatchNs = 0;
     time_t currentTime = time(NULL);
+    int parameterLength = (int)strlen(parameter);
+    
+    // After warm-up an address costs one probe here plus its actual matches
+    uint64_t hash = hashConfigBytes(parameter, (size_t)parameterLength);
+    feedStateMachines(parameter, hash, hasValue, value);
+    
+    if (!matchBuffer) {
+        matchBuffer = malloc(sizeof(int) * MAX_FILTERS);
+        if (!matchBuffer) return 0;
+    }
+    
+    // Everything reached from the published sets stays valid until the
+    // section is left; rebuilds wait for it before reusing their buffers
+    readSectionEnter();
+    
+    // Lists are per avatar, read once so the lookup, the scan and the
+    // stored entry all agree on it
+    uint64_t avatar = currentAvatarHash();
+    uint64_t generation;
+    const int* hits;
+    int hitCount = matchCacheLookup(parameter, hash, avatar, &generation, &hits);
+    
+    const AvatarProfileSet* profiles = currentAvatarProfiles();
+    if (!profiles) {
+        readSectionLeave();
+        return 0;
+    }
+    
+    if (hitCount < 0) {
+        hitCount = collectMatches(profiles, avatar, parameter, parameterLength, matchBuffer);
+        matchCacheStore(parameter, hash, avatar, generation, matchBuffer, hitCount);
+        hits = matchBuffer;
+    }
+    
+    for (int h = 0; h < hitCount; h++) {
+        matched |= applyFilter(hits[h], hash, hasValue, value, unchanged, currentTime, &dispatchNs);
+    }
+    readSectionLeave();
+    
+    // Match time excludes the actions themselves, which are tracked separately
+    metricsRecordMatchTime(metricsNowNs() - matchStart - dispatchNs);
+    traceLap(TRACE_STAGE_MATCH);
+    
+    return matched;
+}
+
+static void dispatchOscMessage(const OscMessage* message, void* context) {
+    int* matched = context;
+    
+    traceLap(TRACE_STAGE_PARSE);
+    
+    if (strcmp(message->address, AVATAR_CHANGE_ADDRESS) == 0) {
+        const char* avatarId;
+        if (oscArgumentString(message, 0, &avatarId)) {
+            selectAvatarProfile(avatarId);
+        }
+    }
+    
+    // Idle avatars mostly resend what they already sent; with no filter
+    // asking for repeats they skip matching entirely. One read section
+    // covers the store and the match that checkParameterValue nests in it
+    readSectionEnter();
+    int unchanged = !parameterStoreUpdate(message);
+    if (unchanged && passUnchangedCount == 0) {
+        readSectionLeave();
+        return;
+    }
+    
+    double value = 0.0;
+    int hasValue = oscArgumentNumber(message, 0, &value);
+    *matched |= checkParameterValue(message->address, hasValue, value, unchanged);
+    readSectionLeave();
+}
+
+int processOscPacket(const char* data, size_t length) {
+    int matched = 0;
+    
+    if (forEachOscMessage(data, length, dispatchOscMessage, &matched) < 0) {
+        traceLap(TRACE_STAGE_PARSE);
+        if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_SUBSYS_NET)) {
+            logRecord(LOG_LEVEL_DEBUG, LOG_SUBSYS_NET, LOG_EVENT_PACKET_MALFORMED, NULL, (int64_t)length, 0, 0, 0);
+        }
+        return 0;
+    }
+    
+    return matched;
+}
+
+void rebuildFilterIndex(void) {
+    static Smoothing* smoothings[MAX_FILTERS];
+    int passing = 0;
     
     for (int i = 0; i < filterCount; i++) {
-        if (perimeterFilters[i].enabled && strstr(parameter, perimeterFilters[i].pattern) != NULL) {
-            perimeterFilters[i].count++;
-            perimeterFilters[i].lastReceived = currentTime;
-            
-            if (messagePrintingEnabled) {
-                char rateLimitStr[32];
-                formatRateLimitString(&perimeterFilters[i].rateLimiter, rateLimitStr, sizeof(rateLimitStr));
-                printf("FILTER MATCH: '%s' (Count: %d, LastExec: %d, Rate: %s)\n",
-                       perimeterFilters[i].pattern, perimeterFilters[i].count, 
-                       perimeterFilters[i].rateLimiter.lastExecutionCount, rateLimitStr);
-            }
-            
-            if (perimeterFilters[i].triggerAction && perimeterFilters[i].action[0]) {
-                if (canExecuteWithRateLimit(&perimeterFilters[i].rateLimiter, 
-                                          perimeterFilters[i].count, messagePrintingEnabled)) {
-                    if (messagePrintingEnabled) {
-                        printf("Executing action (rate limits OK): %s\n", 
-                               perimeterFilters[i].action);
-                    }
-                    
-                    executeAction(perimeterFilters[i].action);
-                    updateRateLimiterExecution(&perimeterFilters[i].rateLimiter, 
-                                             perimeterFilters[i].count);
-                } else {
-                    if (messagePrintingEnabled) {
-                        char rateLimitStr[32];
-                        formatRateLimitString(&perimeterFilters[i].rateLimiter, rateLimitStr, sizeof(rateLimitStr));
-                        printf("Action RATE LIMITED (%s): %s\n", rateLimitStr, perimeterFilters[i].action);
-                    }
-                }
+        smoothings[i] = &perimeterFilters[i].smoothingState;
+        // Smoothed filters need repeats too, see applyFilter
+        passing += perimeterFilters[i].passUnchanged || smoothingEnabled(smoothings[i]);
+    }
+    // Filters keep their channels; only those of removed or reloaded
+    // filters are dropped
+    collectSmoothingChannels(smoothings, filterCount);
+    for (int i = 0; i < filterCount; i++) {
+        attachSmoothing(smoothings[i]);
+    }
+    __atomic_store_n(&passUnchangedCount, passing, __ATOMIC_RELAXED);
+    
+    // Profiles first: a lookup that sees the new generation then also
+    // sees the index it must be computed from
+    rebuildAvatarProfiles();
+    matchCacheInvalidate();
+    // Pending long presses name filters by position, which may have moved
+    timerWheelClear();
+}
+
+void setFilterAvatar(const char* pattern, const char* avatarId) {
+    for (int i = 0; i < filterCount; i++) {
+        if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            if (!avatarId || strcmp(avatarId, "global") == 0) {
+                perimeterFilters[i].avatar[0] = '\0';
+            } else {
+                strncpy(perimeterFilters[i].avatar, avatarId, MAX_AVATAR_ID_LENGTH - 1);
+                perimeterFilters[i].avatar[MAX_AVATAR_ID_LENGTH - 1] = '\0';
             }
-            
-            matched = 1;
+            rebuildFilterIndex();
+            printf("Filter '%s' bound to %s\n", pattern,
+                   perimeterFilters[i].avatar[0] ? perimeterFilters[i].avatar : "all avatars");
+            saveConfig();
+            return;
         }
     }
-    return matched;
+    printf("Filter '%s' not found\n", pattern);
 }
 
 void setFilterAction(const char* pattern, const char* action) {
     for (int i = 0; i < filterCount; i++) {
         if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            // Only the action changes; conditions, gestures and smoothing
+            // keep their state. Matching waits while the text is rewritten
+            pauseReaders();
             strncpy(perimeterFilters[i].action, action, MAX_ACTION_LENGTH - 1);
             perimeterFilters[i].action[MAX_ACTION_LENGTH - 1] = '\0';
+            parseAction(perimeterFilters[i].action, &perimeterFilters[i].parsedAction);
+            resumeReaders();
             perimeterFilters[i].triggerAction = 1;
             
             char rateLimitStr[32];
@@ -330,6 +635,64 @@ void toggleFilterAction(const char* pattern) {
     printf("Filter '%s' not found\n", pattern);
 }
 
+void setFilterPassUnchanged(const char* pattern, int passUnchanged) {
+    for (int i = 0; i < filterCount; i++) {
+        if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            perimeterFilters[i].passUnchanged = passUnchanged;
+            rebuildFilterIndex();
+            printf("Filter '%s' %s updates that repeat the last value\n", pattern,
+                   passUnchanged ? "matches" : "ignores");
+            saveConfig();
+            return;
+        }
+    }
+    printf("Filter '%s' not found\n", pattern);
+}
+
+void setFilterCondition(const char* pattern, const char* condition) {
+    for (int i = 0; i < filterCount; i++) {
+        if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            TriggerCondition trigger;
+            if (strlen(condition) >= MAX_CONDITION_LENGTH || compileTriggerCondition(condition, &trigger) < 0) {
+                printf("Invalid condition '%s'\n", condition);
+                return;
+            }
+    
+            // Matching threads read the compiled form without locks and it
+            // spans several fields, so it is replaced while matching waits
+            pauseReaders();
+            perimeterFilters[i].trigger = trigger;
+            resumeReaders();
+            if (trigger.kind == TRIGGER_ALWAYS) {
+                perimeterFilters[i].condition[0] = '\0';
+                printf("Filter '%s' fires on every value\n", pattern);
+            } else {
+                strcpy(perimeterFilters[i].condition, condition);
+                printf("Filter '%s' fires when value %s\n", pattern, condition);
+                if (isRateLimitDefault(&perimeterFilters[i].rateLimiter)) {
+                    printf("Note: only passing values count towards the rate limit; "
+                           "'rate %s 1 0' fires on each one\n", pattern);
+                }
+            }
+            saveConfig();
+            return;
+        }
+    }
+    printf("Filter '%s' not found\n", pattern);
+}
+
+static void spawnShellAction(const char* action) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl("/bin/sh", "sh", "-c", action, (char *)NULL);
+        exit(1);
+    } else if (pid > 0) {
+        // Non-blocking execution
+    } else {
+        perror("fork failed");
+    }
+}
+
 void executeAction(const char* action) {
     if (action[0] == '@') {
         char actionName[256];
@@ -346,17 +709,167 @@ void executeAction(const char* action) {
         }
     }
     
-    pid_t pid = fork();
-    if (pid == 0) {
-        execl("/bin/sh", "sh", "-c", action, (char *)NULL);
-        exit(1);
-    } else if (pid > 0) {
-        // Non-blocking execution
-    } else {
-        perror("fork failed");
+    spawnShellAction(action);
+}
+
+void parseAction(const char* action, ParsedAction* parsed) {
+    memset(parsed, 0, sizeof(ParsedAction));
+    
+    if (!action || !action[0]) {
+        parsed->type = ACTION_NONE;
+        return;
+    }
+    
+    parsed->type = ACTION_SHELL;
+    
+    if (action[0] == '@') {
+        char actionName[256];
+        char parameter[256] = {0};
+        
+        if (sscanf(action, "@%255[^:]:%255s", actionName, parameter) >= 1) {
+            MediaCommand mediaCommand = mediaCommandFromName(actionName);
+            if (mediaCommand != MEDIA_CMD_NONE) {
+                parsed->type = ACTION_MEDIA;
+                parsed->mediaCommand = mediaCommand;
+                return;
+            }
+            
+            const char* keyString = resolveBuiltinKeyString(actionName, parameter[0] ? parameter : NULL);
+            if (keyString && initKeyHashTable() == 0 && 
+                parseKeyString(keyString, &parsed->keyAction)) {
+                parsed->type = ACTION_KEY;
+                return;
+            }
+        }
+    }
+}
+
+void executeParsedAction(const ParsedAction* parsed, const char* action) {
+    switch (parsed->type) {
+        case ACTION_MEDIA:
+            runMediaCommand(parsed->mediaCommand);
+            break;
+        case ACTION_KEY:
+            sendKeyPressAction(&parsed->keyAction);
+            break;
+        case ACTION_SHELL:
+            spawnShellAction(action);
+            break;
+        default:
+            break;
     }
 }
 
+void setFilterGesture(const char* pattern, const char* gesture) {
+    for (int i = 0; i < filterCount; i++) {
+        if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            Gesture compiled;
+            if (strlen(gesture) >= MAX_GESTURE_LENGTH || compileGesture(gesture, &compiled) < 0) {
+                printf("Invalid gesture '%s'\n", gesture);
+                return;
+            }
+    
+            // Any press in progress starts over under the new gesture
+            setGesture(&perimeterFilters[i].gestureState, &compiled);
+            if (compiled.kind == GESTURE_NONE) {
+                perimeterFilters[i].gesture[0] = '\0';
+                printf("Filter '%s' has no gesture\n", pattern);
+            } else {
+                strcpy(perimeterFilters[i].gesture, gesture);
+                printf("Filter '%s' fires on %s\n", pattern, gesture);
+                if (perimeterFilters[i].condition[0]) {
+                    printf("Note: the gesture replaces condition '%s' while set\n", perimeterFilters[i].condition);
+                }
+            }
+            saveConfig();
+            return;
+        }
+    }
+    printf("Filter '%s' not found\n", pattern);
+}
+
+void setFilterSmoothing(const char* pattern, const char* smoothing) {
+    for (int i = 0; i < filterCount; i++) {
+        if (strcmp(perimeterFilters[i].pattern, pattern) == 0) {
+            Smoothing compiled;
+            if (strlen(smoothing) >= MAX_SMOOTHING_LENGTH || compileSmoothing(smoothing, &compiled) < 0) {
+                printf("Invalid smoothing '%s'\n", smoothing);
+                return;
+            }
+    
+            setSmoothing(&perimeterFilters[i].smoothingState, &compiled);
+            if (!smoothingEnabled(&compiled)) {
+                perimeterFilters[i].smoothing[0] = '\0';
+                printf("Filter '%s' sees raw values\n", pattern);
+            } else {
+                strcpy(perimeterFilters[i].smoothing, smoothing);
+                printf("Filter '%s' sees values smoothed by %s\n", pattern, smoothing);
+            }
+            // Smoothed filters count towards taking unchanged updates
+            rebuildFilterIndex();
+            saveConfig();
+            return;
+        }
+    }
+    printf("Filter '%s' not found\n", pattern);
+}
+
+void compileFilter(perimeterFilter* filter) {
+    filter->patternLength = (int)strlen(filter->pattern);
+    filter->patternHash = hashConfigBytes(filter->pattern, filter->patternLength);
+    parseAction(filter->action, &filter->parsedAction);
+    
+    if (filter->matchKind == MATCH_AUTO) {
+        filter->matchKind = oscPatternIsWildcard(filter->pattern) ? MATCH_WILDCARD : MATCH_SUBSTRING;
+    }
+    
+    // A pattern its kind cannot compile still matches as plain text
+    if (filter->matchKind == MATCH_WILDCARD && !oscPatternValid(filter->pattern)) {
+        printf("Warning: unbalanced [ or { in '%s', matching it as plain text\n", filter->pattern);
+        filter->matchKind = MATCH_SUBSTRING;
+    } else if (filter->matchKind == MATCH_REGEX) {
+        regex_t regex;
+        if (regcomp(&regex, filter->pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+            printf("Warning: invalid regex '%s', matching it as plain text\n", filter->pattern);
+            filter->matchKind = MATCH_SUBSTRING;
+        } else {
+            regfree(&regex);
+        }
+    }
+    
+    if (compileTriggerCondition(filter->condition, &filter->trigger) < 0) {
+        printf("Warning: ignoring invalid condition '%s' on filter '%s'\n", filter->condition, filter->pattern);
+        filter->condition[0] = '\0';
+        compileTriggerCondition(NULL, &filter->trigger);
+    }
+    if (compileGesture(filter->gesture, &filter->gestureState) < 0) {
+        printf("Warning: ignoring invalid gesture '%s' on filter '%s'\n", filter->gesture, filter->pattern);
+        filter->gesture[0] = '\0';
+        compileGesture(NULL, &filter->gestureState);
+    }
+    if (compileSmoothing(filter->smoothing, &filter->smoothingState) < 0) {
+        printf("Warning: ignoring invalid smoothing '%s' on filter '%s'\n", filter->smoothing, filter->pattern);
+        filter->smoothing[0] = '\0';
+        compileSmoothing(NULL, &filter->smoothingState);
+    }
+}
+
+static const char* const matchKindNames[] = {"auto", "substring", "exact", "prefix", "wildcard", "regex"};
+
+const char* matchKindName(MatchKind matchKind) {
+    return (unsigned)matchKind <= MATCH_REGEX ? matchKindNames[matchKind] : "unknown";
+}
+
+int parseMatchKind(const char* name, MatchKind* matchKind) {
+    for (int kind = MATCH_SUBSTRING; kind <= MATCH_REGEX; kind++) {
+        if (strcmp(name, matchKindNames[kind]) == 0) {
+            *matchKind = (MatchKind)kind;
+            return 0;
+        }
+    }
+    return -1;
+}
+
 void setupDefaultFilters(void) {
     printf("Setting up default media control filters...\n");
     
@@ -370,14 +883,17 @@ void setupDefaultFilters(void) {
         }
         
         if (!exists && filterCount < MAX_FILTERS) {
-            strcpy(perimeterFilters[filterCount].pattern, defaultFilters[i].pattern);
+            memset(&perimeterFilters[filterCount], 0, sizeof(perimeterFilter));
+        strcpy(perimeterFilters[filterCount].pattern, defaultFilters[i].pattern);
             strcpy(perimeterFilters[filterCount].action, defaultFilters[i].action);
             perimeterFilters[filterCount].count = 0;
             perimeterFilters[filterCount].enabled = 1;
             perimeterFilters[filterCount].lastReceived = 0;
             perimeterFilters[filterCount].triggerAction = 1;
+            perimeterFilters[filterCount].avatar[0] = '\0';
             
             initRateLimiter(&perimeterFilters[filterCount].rateLimiter);
+            compileFilter(&perimeterFilters[filterCount]);
             
             filterCount++;
             
@@ -387,6 +903,7 @@ void setupDefaultFilters(void) {
         }
     }
     
+    rebuildFilterIndex();
     saveConfig();
     printf("Default filters setup complete!\n");
 }
@@ -423,16 +940,20 @@ void addDefaultFilter(const char* pattern, const char* action, const char* descr
         return;
     }
     
+    memset(&perimeterFilters[filterCount], 0, sizeof(perimeterFilter));
     strcpy(perimeterFilters[filterCount].pattern, pattern);
     strcpy(perimeterFilters[filterCount].action, action);
     perimeterFilters[filterCount].count = 0;
     perimeterFilters[filterCount].enabled = 1;
     perimeterFilters[filterCount].lastReceived = 0;
     perimeterFilters[filterCount].triggerAction = 1;
+    perimeterFilters[filterCount].avatar[0] = '\0';
     
     initRateLimiter(&perimeterFilters[filterCount].rateLimiter);
+    compileFilter(&perimeterFilters[filterCount]);
     
     filterCount++;
+    rebuildFilterIndex();
     
     printf("Added default filter: '%s' with action '%s' [Rate: %dc/%ds]\n", 
            pattern, action, DEFAULT_RATE_LIMIT_COUNT, DEFAULT_RATE_LIMIT_SECONDS);
@@ -468,21 +989,7 @@ void listBuiltinActions(void) {
 int executeBuiltinAction(const char* actionName, const char* parameter) {
     (void)parameter; 
     
-    if (strcmp(actionName, "media-play") == 0) {
-        mediaPlayPause();
-        return 1;
-    } else if (strcmp(actionName, "media-stop") == 0) {
-        mediaStop();
-        return 1;
-    } else if (strcmp(actionName, "media-next") == 0) {
-        mediaNext();
-        return 1;
-    } else if (strcmp(actionName, "media-prev") == 0) {
-        mediaPrevious();
-        return 1;
-    }
-    
-    return 0; 
+    return runMediaCommand(mediaCommandFromName(actionName));
 }
 
 int saveConfig(void) {
@@ -492,7 +999,7 @@ int saveConfig(void) {
         perror("fopen failed");
         return -1;
     }
-
+    
     fprintf(file, "{\n");
     fprintf(file, "  \"messagePrintingEnabled\": %s,\n", messagePrintingEnabled ? "true" : "false");
     fprintf(file, "  \"defaultRateLimitCount\": %d,\n", DEFAULT_RATE_LIMIT_COUNT);
@@ -505,17 +1012,35 @@ int saveConfig(void) {
         
         fprintf(file, "    {\n");
         fprintf(file, "      \"pattern\": \"%s\",\n", perimeterFilters[i].pattern);
+        // Without the key a pattern is substring unless it has wildcards
+        if (perimeterFilters[i].matchKind != MATCH_SUBSTRING || oscPatternIsWildcard(perimeterFilters[i].pattern)) {
+            fprintf(file, "      \"match\": \"%s\",\n", matchKindName(perimeterFilters[i].matchKind));
+        }
         fprintf(file, "      \"enabled\": %s,\n", perimeterFilters[i].enabled ? "true" : "false");
         fprintf(file, "      \"triggerAction\": %s,\n", perimeterFilters[i].triggerAction ? "true" : "false");
         fprintf(file, "      \"action\": \"%s\",\n", perimeterFilters[i].action);
-        fprintf(file, "      \"lastExecutionCount\": %d,\n", perimeterFilters[i].rateLimiter.lastExecutionCount);
-        fprintf(file, "      \"lastExecutionTime\": %ld,\n", (long)perimeterFilters[i].rateLimiter.lastExecutionTime);
+        if (perimeterFilters[i].avatar[0]) {
+            fprintf(file, "      \"avatar\": \"%s\",\n", perimeterFilters[i].avatar);
+        }
+        if (perimeterFilters[i].condition[0]) {
+            fprintf(file, "      \"condition\": \"%s\",\n", perimeterFilters[i].condition);
+        }
+        if (perimeterFilters[i].gesture[0]) {
+            fprintf(file, "      \"gesture\": \"%s\",\n", perimeterFilters[i].gesture);
+        }
+        if (perimeterFilters[i].smoothing[0]) {
+            fprintf(file, "      \"smooth\": \"%s\",\n", perimeterFilters[i].smoothing);
+        }
+        if (perimeterFilters[i].passUnchanged) {
+            fprintf(file, "      \"passUnchanged\": true,\n");
+        }
         fprintf(file, "      \"rateLimitCount\": %d,\n", count);
         fprintf(file, "      \"rateLimitSeconds\": %d\n", seconds);
         fprintf(file, "    }%s\n", (i < filterCount - 1) ? "," : "");
     }
     
-    fprintf(file, "  ]\n");
+    fprintf(file, stateMachineCount() ? "  ],\n" : "  ]\n");
+    writeStateMachines(file);
     fprintf(file, "}\n");
     
     if (fclose(file) != 0) {
@@ -523,10 +1048,11 @@ int saveConfig(void) {
         return -1;
     }
     
+    writeConfigCache();
     return 0;
 }
 
-int loadConfig(void) {
+static int loadConfigFile(void) {
     if (!fileExists(CONFIG_FILE)) {
         printf("=== FIRST RUN SETUP ===\n");
         if (generateDefaultConfig() != 0) {
@@ -538,16 +1064,27 @@ int loadConfig(void) {
         printf("=== SETUP COMPLETE ===\n\n");
         return 0;
     }
-
+    
+    if (loadConfigCache() == 0) {
+        printf("Loaded %d filters from config cache\n", filterCount);
+        return 0;
+    }
+    
     FILE *file = fopen(CONFIG_FILE, "r");
     if (!file) {
         printf("Failed to open existing config file, generating default config\n");
         return generateDefaultConfig();
     }
-
+    
     char line[1024];
     char pattern[MAX_PATTERN_LENGTH] = {0};
     char action[MAX_ACTION_LENGTH] = {0};
+    char avatar[MAX_AVATAR_ID_LENGTH] = {0};
+    char condition[MAX_CONDITION_LENGTH] = {0};
+    char gesture[MAX_GESTURE_LENGTH] = {0};
+    char smoothing[MAX_SMOOTHING_LENGTH] = {0};
+    int passUnchanged = 0;
+    MatchKind matchKind = MATCH_AUTO;
     int enabled = 1;
     int triggerAction = 0;
     int lastExecutionCount = 0;
@@ -555,11 +1092,20 @@ int loadConfig(void) {
     int rateLimitCount = DEFAULT_RATE_LIMIT_COUNT;
     int rateLimitSeconds = DEFAULT_RATE_LIMIT_SECONDS;
     int inFilter = 0;
+    int machineDepth = 0;
     
     filterCount = 0;
     messagePrintingEnabled = 0;
     
     while (fgets(line, sizeof(line), file)) {
+        if (machineDepth > 0 || strstr(line, "\"machines\":")) {
+            // The section belongs to loadStateMachines; skip to its closing bracket
+            for (const char* c = line; *c; c++) {
+                machineDepth += (*c == '[') - (*c == ']');
+            }
+            continue;
+        }
+        
         if (strstr(line, "\"messagePrintingEnabled\":")) {
             char enabledStr[10];
             sscanf(line, " \"messagePrintingEnabled\": %9s", enabledStr);
@@ -567,6 +1113,13 @@ int loadConfig(void) {
         } else if (strstr(line, "\"pattern\":")) {
             sscanf(line, " \"pattern\": \"%255[^\"]\"", pattern);
             inFilter = 1;
+        } else if (strstr(line, "\"match\":")) {
+            char matchStr[16] = {0};
+            sscanf(line, " \"match\": \"%15[^\"]\"", matchStr);
+            if (parseMatchKind(matchStr, &matchKind) < 0) {
+                printf("Warning: unknown match kind '%s', detecting from the pattern\n", matchStr);
+                matchKind = MATCH_AUTO;
+            }
         } else if (strstr(line, "\"enabled\":")) {
             char enabledStr[10];
             sscanf(line, " \"enabled\": %9s", enabledStr);
@@ -577,7 +1130,21 @@ int loadConfig(void) {
             triggerAction = (strstr(triggerStr, "true") != NULL);
         } else if (strstr(line, "\"action\":")) {
             sscanf(line, " \"action\": \"%511[^\"]\"", action);
+        } else if (strstr(line, "\"avatar\":")) {
+            sscanf(line, " \"avatar\": \"%63[^\"]\"", avatar);
+        } else if (strstr(line, "\"condition\":")) {
+            sscanf(line, " \"condition\": \"%63[^\"]\"", condition);
+        } else if (strstr(line, "\"gesture\":")) {
+            sscanf(line, " \"gesture\": \"%31[^\"]\"", gesture);
+        } else if (strstr(line, "\"smooth\":")) {
+            sscanf(line, " \"smooth\": \"%31[^\"]\"", smoothing);
+        } else if (strstr(line, "\"passUnchanged\":")) {
+            char passStr[10];
+            sscanf(line, " \"passUnchanged\": %9s", passStr);
+            passUnchanged = (strstr(passStr, "true") != NULL);
         } else if (strstr(line, "\"lastExecutionCount\":")) {
+            // Runtime state now lives in the state journal; still accepted
+            // so configs written by older versions keep their limiter state
             sscanf(line, " \"lastExecutionCount\": %d", &lastExecutionCount);
         } else if (strstr(line, "\"lastExecutionTime\":")) {
             long temp;
@@ -589,10 +1156,17 @@ int loadConfig(void) {
             sscanf(line, " \"rateLimitSeconds\": %d", &rateLimitSeconds);
         } else if (strstr(line, "}") && inFilter) {
             if (filterCount < MAX_FILTERS && pattern[0]) {
-                strcpy(perimeterFilters[filterCount].pattern, pattern);
+                memset(&perimeterFilters[filterCount], 0, sizeof(perimeterFilter));
+    strcpy(perimeterFilters[filterCount].pattern, pattern);
                 perimeterFilters[filterCount].enabled = enabled;
                 perimeterFilters[filterCount].triggerAction = triggerAction;
                 strcpy(perimeterFilters[filterCount].action, action);
+                strcpy(perimeterFilters[filterCount].avatar, avatar);
+                strcpy(perimeterFilters[filterCount].condition, condition);
+                strcpy(perimeterFilters[filterCount].gesture, gesture);
+                strcpy(perimeterFilters[filterCount].smoothing, smoothing);
+                perimeterFilters[filterCount].passUnchanged = passUnchanged;
+                perimeterFilters[filterCount].matchKind = matchKind;
                 perimeterFilters[filterCount].count = 0;
                 perimeterFilters[filterCount].lastReceived = 0;
                 
@@ -600,12 +1174,19 @@ int loadConfig(void) {
                                         rateLimitCount, rateLimitSeconds);
                 perimeterFilters[filterCount].rateLimiter.lastExecutionCount = lastExecutionCount;
                 perimeterFilters[filterCount].rateLimiter.lastExecutionTime = lastExecutionTime;
+                compileFilter(&perimeterFilters[filterCount]);
                 
                 filterCount++;
             }
             
             memset(pattern, 0, sizeof(pattern));
             memset(action, 0, sizeof(action));
+            memset(avatar, 0, sizeof(avatar));
+            memset(condition, 0, sizeof(condition));
+            memset(gesture, 0, sizeof(gesture));
+            memset(smoothing, 0, sizeof(smoothing));
+            passUnchanged = 0;
+            matchKind = MATCH_AUTO;
             enabled = 1;
             triggerAction = 0;
             lastExecutionCount = 0;
@@ -617,6 +1198,22 @@ int loadConfig(void) {
     }
     
     fclose(file);
+    writeConfigCache();
     printf("Loaded %d filters from config\n", filterCount);
     return 0;
 }
+
+int loadConfig(void) {
+    // Reloading rewrites the filter table in place, like a removal
+    pauseReaders();
+    int result = loadConfigFile();
+    // The config cache holds filters only, so machines always come from the file
+    int machines = loadStateMachines(CONFIG_FILE);
+    if (machines > 0) {
+        printf("Loaded %d state machines\n", machines);
+    }
+    rebuildFilterIndex();
+    resumeReaders();
+    restoreStateJournal();
+    return result;
+}
@@ -5,22 +5,71 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <stdint.h>
 
 #include "mediaControl.h"
 #include "rateLimiter.h"
+#include "keyPress.h"
+#include "triggerCondition.h"
+#include "gesture.h"
+#include "smoothing.h"
 
-#define MAX_FILTERS 100
+#ifndef MAX_FILTERS
+#define MAX_FILTERS 100                 // Benchmarks build with a larger table
+#endif
 #define MAX_PATTERN_LENGTH 256
 #define MAX_ACTION_LENGTH 512
+#define MAX_AVATAR_ID_LENGTH 64
 #define CONFIG_FILE "config.json"
 
+typedef enum {
+    ACTION_NONE,
+    ACTION_SHELL,           // Passed to /bin/sh
+    ACTION_MEDIA,           // Built-in @media-* command
+    ACTION_KEY              // Built-in key press, resolved to keycodes at load
+} ActionType;
+
+// How a filter's pattern is compared with an address. Cheaper kinds are
+// tried first: a hash probe, a trie walk, one automaton for every wildcard
+// pattern, the substring scan, and regexes last
+typedef enum {
+    MATCH_AUTO,             // Not set: wildcard when the pattern uses OSC wildcards, else substring
+    MATCH_SUBSTRING,
+    MATCH_EXACT,
+    MATCH_PREFIX,
+    MATCH_WILDCARD,         // OSC address pattern on the whole address
+    MATCH_REGEX             // POSIX extended regex, unanchored
+} MatchKind;
+
+// Action string resolved once at load so the hot path skips sscanf/strcmp
+typedef struct {
+    ActionType type;
+    MediaCommand mediaCommand;
+    KeyPressAction keyAction;
+} ParsedAction;
+
 typedef struct {
     char pattern[MAX_PATTERN_LENGTH];
+    int patternLength;
+    uint64_t patternHash;           // Stable key for the state journal
     int count;
     int enabled;
     time_t lastReceived;
+    uint64_t fireCount;             // Actions executed
+    uint64_t suppressCount;         // Actions blocked by the rate limiter
+    int journalPending;             // Limiter state not yet in the state journal
     char action[MAX_ACTION_LENGTH]; 
     int triggerAction;
+    char avatar[MAX_AVATAR_ID_LENGTH];  // Empty for filters active on every avatar
+    char condition[MAX_CONDITION_LENGTH];   // Empty when every value fires
+    char gesture[MAX_GESTURE_LENGTH];       // Empty for none; replaces the condition when set
+    char smoothing[MAX_SMOOTHING_LENGTH];   // Empty when conditions see raw values
+    int passUnchanged;              // Also match updates that repeat the last value
+    int matchKind;                  // MatchKind, never MATCH_AUTO once compiled
+    ParsedAction parsedAction;
+    TriggerCondition trigger;       // Compiled from condition
+    Gesture gestureState;           // Compiled from gesture
+    Smoothing smoothingState;       // Compiled from smoothing
     RateLimiter rateLimiter;        
 } perimeterFilter;
 
@@ -28,12 +77,19 @@ extern perimeterFilter perimeterFilters[MAX_FILTERS];
 extern int filterCount;
 extern int messagePrintingEnabled;  
 
-void addPerimeterFilter(const char* pattern);
+void addPerimeterFilter(const char* pattern, MatchKind matchKind);
 void removePerimeterFilter(const char* pattern);
 void listParameterFilters(void);
 void clearParameterFilters(void);
 void resetFilterCounts(void);
 int checkParameterFilter(const char* perimeter);
+// hasValue/value: the message's first argument, for filter conditions.
+// unchanged: it repeats the address's last update, so only filters that
+// pass unchanged updates are tried
+int checkParameterValue(const char* parameter, int hasValue, double value, int unchanged);
+int processOscPacket(const char* data, size_t length);
+void rebuildFilterIndex(void);
+void setFilterAvatar(const char* pattern, const char* avatarId);
 void enableFilter(const char* pattern);
 void disableFilter(const char* pattern);
 
@@ -47,7 +103,17 @@ int loadConfig(void);
 
 void setFilterAction(const char* pattern, const char* action);
 void toggleFilterAction(const char* pattern);
+void setFilterCondition(const char* pattern, const char* condition);
+void setFilterPassUnchanged(const char* pattern, int passUnchanged);
+void setFilterGesture(const char* pattern, const char* gesture);
+void setFilterSmoothing(const char* pattern, const char* smoothing);
 void executeAction(const char* action);
+void parseAction(const char* action, ParsedAction* parsed);
+void executeParsedAction(const ParsedAction* parsed, const char* action);
+void compileFilter(perimeterFilter* filter);
+const char* matchKindName(MatchKind matchKind);
+// Returns -1 for an unknown name
+int parseMatchKind(const char* name, MatchKind* matchKind);
 
 void setFilterRateLimit(const char* pattern, int count, int seconds);
 void listFilterRateLimits(void);
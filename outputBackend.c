@@ -0,0 +1,418 @@
+#include "outputBackend.h"
+#include "mediaControl.h"
+#include "keyPress.h"
+#include "metrics.h"
+#include "trace.h"
+#include "eventLoop.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/input.h>
+
+static const char* deviceNames[OUTPUT_DEVICE_COUNT] = {"media", "keyboard"};
+
+// ---- uinput: the real virtual devices owned by mediaControl/keyPress ----
+
+static int uinputDeviceFd(OutputDevice device) {
+    return device == OUTPUT_DEVICE_MEDIA ? setupUinputDevice() : setupKeypressUinputDevice();
+}
+
+static int uinputOpen(OutputDevice device) {
+    return uinputDeviceFd(device) >= 0 ? 0 : -1;
+}
+
+static int uinputEmit(OutputDevice device, int type, int code, int value) {
+    int fd = uinputDeviceFd(device);
+    if (fd < 0) return -1;
+    
+    struct input_event ie;
+    memset(&ie, 0, sizeof(ie));
+    ie.type = type;
+    ie.code = code;
+    ie.value = value;
+    return write(fd, &ie, sizeof(ie)) == sizeof(ie) ? 0 : -1;
+}
+
+static void uinputClose(OutputDevice device) {
+    if (device == OUTPUT_DEVICE_MEDIA) {
+        releaseUinputDevice();
+    } else {
+        cleanupKeypressUinputDevice();
+    }
+}
+
+// ---- ring: timestamped events kept in memory for tests and benchmarks ----
+
+static OutputEvent ringEvents[OUTPUT_RING_SIZE];
+static uint64_t ringSequence[OUTPUT_RING_SIZE];    // position + 1 once the slot is complete
+static uint64_t ringPosition = 0;
+
+static int ringOpen(OutputDevice device) {
+    (void)device;
+    return 0;
+}
+
+static int ringEmit(OutputDevice device, int type, int code, int value) {
+    uint64_t position = __atomic_fetch_add(&ringPosition, 1, __ATOMIC_RELAXED);
+    size_t slot = position & (OUTPUT_RING_SIZE - 1);
+    
+    __atomic_store_n(&ringSequence[slot], 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    OutputEvent* event = &ringEvents[slot];
+    event->timestampNs = metricsNowNs();
+    event->device = (uint16_t)device;
+    event->type = (uint16_t)type;
+    event->code = (uint16_t)code;
+    event->reserved = 0;
+    event->value = value;
+    
+    __atomic_store_n(&ringSequence[slot], position + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void ringClose(OutputDevice device) {
+    (void)device;
+}
+
+// ---- file: one text line per event, to a file or a FIFO ----
+
+static char sinkPath[256];
+static int sinkFd = -1;
+static int sinkOpenDevices = 0;
+
+static int fileOpen(OutputDevice device) {
+    if (sinkFd < 0) {
+        sinkFd = open(sinkPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (sinkFd < 0) {
+            fprintf(stderr, "Failed to open output sink %s: %s\n", sinkPath, strerror(errno));
+            return -1;
+        }
+    }
+    sinkOpenDevices |= 1 << device;
+    return 0;
+}
+
+static int fileEmit(OutputDevice device, int type, int code, int value) {
+    if (sinkFd < 0 && fileOpen(device) < 0) return -1;
+    
+    // Lines stay below PIPE_BUF so concurrent writers never interleave
+    char line[96];
+    int length = snprintf(line, sizeof(line), "%llu %s %d %d %d\n",
+                          (unsigned long long)metricsNowNs(), deviceNames[device], type, code, value);
+    return write(sinkFd, line, (size_t)length) == length ? 0 : -1;
+}
+
+static void fileClose(OutputDevice device) {
+    sinkOpenDevices &= ~(1 << device);
+    if (sinkOpenDevices == 0 && sinkFd >= 0) {
+        close(sinkFd);
+        sinkFd = -1;
+    }
+}
+
+static const OutputBackend uinputBackend = {"uinput", 1, uinputOpen, uinputEmit, uinputClose};
+static const OutputBackend ringBackend = {"ring", 0, ringOpen, ringEmit, ringClose};
+static const OutputBackend fileBackend = {"file", 0, fileOpen, fileEmit, fileClose};
+
+static const OutputBackend* activeBackend = &uinputBackend;
+
+int selectOutputBackend(const char* spec) {
+    const OutputBackend* backend;
+    
+    if (strcmp(spec, "uinput") == 0) {
+        backend = &uinputBackend;
+    } else if (strcmp(spec, "ring") == 0) {
+        backend = &ringBackend;
+    } else if (strncmp(spec, "file:", 5) == 0 && spec[5]) {
+        backend = &fileBackend;
+    } else {
+        return -1;
+    }
+    
+    outputFlushPending();
+    outputCloseAll();
+    if (backend == &fileBackend) {
+        snprintf(sinkPath, sizeof(sinkPath), "%s", spec + 5);
+    }
+    __atomic_store_n(&activeBackend, backend, __ATOMIC_RELEASE);
+    return 0;
+}
+
+const OutputBackend* currentOutputBackend(void) {
+    return __atomic_load_n(&activeBackend, __ATOMIC_ACQUIRE);
+}
+
+void printOutputBackend(void) {
+    const OutputBackend* backend = currentOutputBackend();
+    
+    printf("Output backend: %s", backend->name);
+    if (backend == &fileBackend) {
+        printf(" (%s)", sinkPath);
+    }
+    printf("%s\n", backend->paced ? "" : ", unpaced");
+    
+    if (backend == &ringBackend) {
+        printf("Ring events: %llu\n", (unsigned long long)outputRingPosition());
+    }
+}
+
+int outputOpen(OutputDevice device) {
+    return currentOutputBackend()->open(device);
+}
+
+void outputClose(OutputDevice device) {
+    currentOutputBackend()->close(device);
+}
+
+void outputCloseAll(void) {
+    for (int device = 0; device < OUTPUT_DEVICE_COUNT; device++) {
+        outputClose((OutputDevice)device);
+    }
+}
+
+int outputKeyEvent(OutputDevice device, int keycode, int value) {
+    const OutputBackend* backend = currentOutputBackend();
+    
+    if (backend->emit(device, EV_KEY, keycode, value) < 0) {
+        return -1;
+    }
+    traceOutputEvent();
+    return backend->emit(device, EV_SYN, SYN_REPORT, 0);
+}
+
+// Remainder of a key schedule waiting on an event loop timer
+typedef struct PendingSchedule {
+    OutputDevice device;
+    int next;
+    int count;
+    int timer;
+    OutputStep steps[OUTPUT_MAX_STEPS];
+    struct PendingSchedule* nextPending;
+} PendingSchedule;
+
+static PendingSchedule* pendingSchedules = NULL;
+
+static void unlinkPending(PendingSchedule* schedule) {
+    for (PendingSchedule** link = &pendingSchedules; *link; link = &(*link)->nextPending) {
+        if (*link == schedule) {
+            *link = schedule->nextPending;
+            return;
+        }
+    }
+}
+
+static void continueSchedule(void* context);
+
+// Emits steps up to the next delay; returns 1 when the schedule finished
+static int advanceSchedule(PendingSchedule* schedule) {
+    while (schedule->next < schedule->count) {
+        const OutputStep* step = &schedule->steps[schedule->next];
+        
+        if (step->delayMs > 0) {
+            schedule->timer = eventLoopAddTimer((uint64_t)step->delayMs * 1000000ULL, 0,
+                                                continueSchedule, schedule);
+            if (schedule->timer >= 0) return 0;
+            
+            // No timer available: fall back to sleeping rather than losing a release
+            struct timespec ts = {step->delayMs / 1000, (step->delayMs % 1000) * 1000000L};
+            nanosleep(&ts, NULL);
+        }
+        
+        outputKeyEvent(schedule->device, step->keycode, step->value);
+        schedule->next++;
+    }
+    return 1;
+}
+
+static void continueSchedule(void* context) {
+    PendingSchedule* schedule = context;
+    schedule->timer = -1;
+    
+    // The step that armed the timer has waited out its delay
+    const OutputStep* step = &schedule->steps[schedule->next];
+    outputKeyEvent(schedule->device, step->keycode, step->value);
+    schedule->next++;
+    
+    if (advanceSchedule(schedule)) {
+        unlinkPending(schedule);
+        free(schedule);
+    }
+}
+
+static PendingSchedule* newSchedule(OutputDevice device, const OutputStep* steps, int count) {
+    PendingSchedule* schedule = malloc(sizeof(PendingSchedule));
+    if (!schedule) return NULL;
+    
+    schedule->device = device;
+    schedule->next = 0;
+    schedule->count = count;
+    schedule->timer = -1;
+    schedule->nextPending = NULL;
+    memcpy(schedule->steps, steps, sizeof(OutputStep) * (size_t)count);
+    return schedule;
+}
+
+static void startSchedule(PendingSchedule* schedule) {
+    if (advanceSchedule(schedule)) {
+        free(schedule);
+    } else {
+        schedule->nextPending = pendingSchedules;
+        pendingSchedules = schedule;
+    }
+}
+
+// Schedules submitted off the loop thread, in submission order, waiting
+// for the loop to pick them up. One wakeup is posted per batch
+static PendingSchedule* submittedHead = NULL;
+static PendingSchedule* submittedTail = NULL;
+static int submittedPosted = 0;
+static pthread_mutex_t submittedMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static PendingSchedule* takeSubmitted(void) {
+    pthread_mutex_lock(&submittedMutex);
+    PendingSchedule* schedules = submittedHead;
+    submittedHead = submittedTail = NULL;
+    submittedPosted = 0;
+    pthread_mutex_unlock(&submittedMutex);
+    return schedules;
+}
+
+static void startSubmitted(void* context) {
+    (void)context;
+    
+    PendingSchedule* schedule = takeSubmitted();
+    while (schedule) {
+        PendingSchedule* next = schedule->nextPending;
+        startSchedule(schedule);
+        schedule = next;
+    }
+}
+
+// Plays schedules in the calling thread, sleeping through the delays when paced
+static void playSchedules(PendingSchedule* schedule, int paced) {
+    while (schedule) {
+        PendingSchedule* next = schedule->nextPending;
+        
+        for (; schedule->next < schedule->count; schedule->next++) {
+            const OutputStep* step = &schedule->steps[schedule->next];
+            if (paced && step->delayMs > 0) {
+                struct timespec ts = {step->delayMs / 1000, (step->delayMs % 1000) * 1000000L};
+                nanosleep(&ts, NULL);
+            }
+            outputKeyEvent(schedule->device, step->keycode, step->value);
+        }
+        free(schedule);
+        schedule = next;
+    }
+}
+
+int outputSubmit(OutputDevice device, const OutputStep* steps, int count) {
+    const OutputBackend* backend = currentOutputBackend();
+    if (count <= 0 || count > OUTPUT_MAX_STEPS) return -1;
+    if (backend->open(device) < 0) return -1;
+    
+    if (!backend->paced) {
+        for (int i = 0; i < count; i++) {
+            if (outputKeyEvent(device, steps[i].keycode, steps[i].value) < 0) return -1;
+        }
+        return 0;
+    }
+    
+    PendingSchedule* schedule = newSchedule(device, steps, count);
+    if (!schedule) return -1;
+    
+    if (onEventLoopThread()) {
+        startSchedule(schedule);
+        return 0;
+    }
+    
+    // Shard threads hand the schedule to the loop so receiving never sleeps
+    pthread_mutex_lock(&submittedMutex);
+    if (submittedTail) {
+        submittedTail->nextPending = schedule;
+    } else {
+        submittedHead = schedule;
+    }
+    submittedTail = schedule;
+    int needsPost = !submittedPosted;
+    submittedPosted = 1;
+    pthread_mutex_unlock(&submittedMutex);
+    
+    if (needsPost && eventLoopPost(startSubmitted, NULL) < 0) {
+        // No loop running (replay, shutdown): pace in this thread
+        playSchedules(takeSubmitted(), 1);
+    }
+    return 0;
+}
+
+void outputFlushPending(void) {
+    playSchedules(takeSubmitted(), 0);
+    
+    while (pendingSchedules) {
+        PendingSchedule* schedule = pendingSchedules;
+        pendingSchedules = schedule->nextPending;
+        schedule->nextPending = NULL;
+        
+        eventLoopCancelTimer(schedule->timer);
+        playSchedules(schedule, 0);
+    }
+}
+
+uint64_t outputRingPosition(void) {
+    return __atomic_load_n(&ringPosition, __ATOMIC_ACQUIRE);
+}
+
+// Copies events after *cursor; a reader that fell more than a ring behind
+// skips ahead to the oldest event still present
+int outputRingRead(uint64_t* cursor, OutputEvent* events, int maxEvents) {
+    uint64_t head = outputRingPosition();
+    if (head - *cursor > OUTPUT_RING_SIZE) {
+        *cursor = head - OUTPUT_RING_SIZE;
+    }
+    
+    int count = 0;
+    while (*cursor < head && count < maxEvents) {
+        size_t slot = *cursor & (OUTPUT_RING_SIZE - 1);
+        if (__atomic_load_n(&ringSequence[slot], __ATOMIC_ACQUIRE) != *cursor + 1) break;
+    
+        events[count] = ringEvents[slot];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&ringSequence[slot], __ATOMIC_RELAXED) != *cursor + 1) break;
+    
+        count++;
+        (*cursor)++;
+    }
+    
+    return count;
+}
+
+void printOutputRing(int maxEvents) {
+    uint64_t head = outputRingPosition();
+    uint64_t cursor = head > (uint64_t)maxEvents ? head - (uint64_t)maxEvents : 0;
+    OutputEvent events[64];
+    int count;
+    
+    if (head == 0) {
+        printf("No output events recorded\n");
+        return;
+    }
+    
+    while ((count = outputRingRead(&cursor, events, 64)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (events[i].type != EV_KEY) continue;
+    
+            const char* keyName = getKeyNameFromCode(events[i].code);
+            printf("  %llu.%06llu  %-8s %-12s %-4d %s\n",
+                   (unsigned long long)(events[i].timestampNs / 1000000000ULL),
+                   (unsigned long long)(events[i].timestampNs % 1000000000ULL) / 1000,
+                   deviceNames[events[i].device], keyName, events[i].code,
+                   events[i].value ? "down" : "up");
+        }
+    }
+}
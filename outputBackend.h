@@ -0,0 +1,64 @@
+#ifndef OUTPUT_BACKEND_H
+#define OUTPUT_BACKEND_H
+
+#include <stdint.h>
+
+#define OUTPUT_RING_SIZE 4096               // Power of two
+#define OUTPUT_MAX_STEPS 16                 // Press and release for up to 8 keys
+#define OUTPUT_DEFAULT_BACKEND "uinput"
+
+// Virtual devices the daemon drives; each backend keeps them apart
+typedef enum {
+    OUTPUT_DEVICE_MEDIA,
+    OUTPUT_DEVICE_KEYBOARD,
+    OUTPUT_DEVICE_COUNT
+} OutputDevice;
+
+typedef struct {
+    uint64_t timestampNs;                   // CLOCK_MONOTONIC when emitted
+    uint16_t device;
+    uint16_t type;                          // EV_KEY / EV_SYN
+    uint16_t code;
+    int16_t reserved;
+    int32_t value;
+} OutputEvent;
+
+// One key transition of a synthetic key action
+typedef struct {
+    int keycode;
+    int value;                              // 1 press, 0 release
+    int delayMs;                            // Wait after the previous step
+} OutputStep;
+
+typedef struct {
+    const char* name;
+    int paced;                              // Honour press/release delays meant for real input stacks
+    int (*open)(OutputDevice device);       // Idempotent, 0 on success
+    int (*emit)(OutputDevice device, int type, int code, int value);
+    void (*close)(OutputDevice device);
+} OutputBackend;
+
+// spec: "uinput", "ring" or "file:<path>" (a FIFO works as a pipe sink)
+int selectOutputBackend(const char* spec);
+const OutputBackend* currentOutputBackend(void);
+void printOutputBackend(void);
+
+int outputOpen(OutputDevice device);
+void outputClose(OutputDevice device);
+void outputCloseAll(void);
+// EV_KEY followed by SYN_REPORT
+int outputKeyEvent(OutputDevice device, int keycode, int value);
+// Plays a key schedule. Delays become event loop timers so dispatch never
+// sleeps; other threads post the schedule to the loop through its wake
+// eventfd. Only without a running loop (replay) do the delays sleep.
+// Unpaced backends skip them
+int outputSubmit(OutputDevice device, const OutputStep* steps, int count);
+// Plays every pending schedule to completion without delays (no stuck keys)
+void outputFlushPending(void);
+
+// In-memory ring sink
+uint64_t outputRingPosition(void);
+int outputRingRead(uint64_t* cursor, OutputEvent* events, int maxEvents);
+void printOutputRing(int maxEvents);
+
+#endif
@@ -0,0 +1,103 @@
+#include "packetPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+typedef struct {
+    size_t size;                            // Largest payload, a NUL always fits after it
+    int capacity;
+    char* slab;                             // capacity buffers of size + 1 bytes
+    int* freeList;
+    int freeCount;
+    int highWater;
+    uint64_t acquired;
+    uint64_t exhausted;                     // Requests refused because every buffer was out
+    pthread_mutex_t mutex;
+} SizeClass;
+
+// Only oversize datagrams come here, so a mutex per class is cheap enough
+static SizeClass sizeClasses[PACKET_POOL_CLASSES] = {
+    { .size = 4096, .capacity = 64, .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .size = 16384, .capacity = 16, .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .size = PACKET_MAX_DATAGRAM, .capacity = 8, .mutex = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static int allocateClass(SizeClass* sizeClass) {
+    sizeClass->slab = malloc((size_t)sizeClass->capacity * (sizeClass->size + 1));
+    sizeClass->freeList = malloc(sizeof(int) * sizeClass->capacity);
+    if (!sizeClass->slab || !sizeClass->freeList) {
+        free(sizeClass->slab);
+        free(sizeClass->freeList);
+        sizeClass->slab = NULL;
+        sizeClass->freeList = NULL;
+        return -1;
+    }
+    
+    for (int i = 0; i < sizeClass->capacity; i++) {
+        sizeClass->freeList[i] = sizeClass->capacity - 1 - i;
+    }
+    sizeClass->freeCount = sizeClass->capacity;
+    return 0;
+}
+
+char* packetPoolAcquire(size_t bytes) {
+    for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        SizeClass* sizeClass = &sizeClasses[i];
+        if (bytes > sizeClass->size) continue;
+    
+        char* buffer = NULL;
+        pthread_mutex_lock(&sizeClass->mutex);
+        if (!sizeClass->slab && allocateClass(sizeClass) < 0) {
+            perror("Failed to allocate packet pool");
+        } else if (sizeClass->freeCount == 0) {
+            sizeClass->exhausted++;
+        } else {
+            int index = sizeClass->freeList[--sizeClass->freeCount];
+            buffer = sizeClass->slab + (size_t)index * (sizeClass->size + 1);
+            sizeClass->acquired++;
+    
+            int inUse = sizeClass->capacity - sizeClass->freeCount;
+            if (inUse > sizeClass->highWater) sizeClass->highWater = inUse;
+        }
+        pthread_mutex_unlock(&sizeClass->mutex);
+    
+        // A full class does not spill into the next one; bigger buffers
+        // are scarcer and kept for the datagrams that need them
+        return buffer;
+    }
+    return NULL;
+}
+
+void packetPoolRelease(char* buffer) {
+    if (!buffer) return;
+    
+    for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        SizeClass* sizeClass = &sizeClasses[i];
+        size_t stride = sizeClass->size + 1;
+    
+        pthread_mutex_lock(&sizeClass->mutex);
+        if (sizeClass->slab && buffer >= sizeClass->slab &&
+            buffer < sizeClass->slab + (size_t)sizeClass->capacity * stride) {
+            sizeClass->freeList[sizeClass->freeCount++] = (int)((buffer - sizeClass->slab) / stride);
+            pthread_mutex_unlock(&sizeClass->mutex);
+            return;
+        }
+        pthread_mutex_unlock(&sizeClass->mutex);
+    }
+}
+
+void printPacketPoolStats(void) {
+    printf("\n%-10s %-10s %-8s %-10s %-12s %s\n", "Class", "Capacity", "InUse", "HighWater", "Acquired", "Exhausted");
+    printf("%-10s %-10s %-8s %-10s %-12s %s\n", "-----", "--------", "-----", "---------", "--------", "---------");
+    for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        SizeClass* sizeClass = &sizeClasses[i];
+    
+        pthread_mutex_lock(&sizeClass->mutex);
+        int inUse = sizeClass->slab ? sizeClass->capacity - sizeClass->freeCount : 0;
+        printf("%-10zu %-10d %-8d %-10d %-12llu %llu\n", sizeClass->size, sizeClass->capacity, inUse,
+               sizeClass->highWater, (unsigned long long)sizeClass->acquired,
+               (unsigned long long)sizeClass->exhausted);
+        pthread_mutex_unlock(&sizeClass->mutex);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stddef.h>
+
+#define PACKET_MAX_DATAGRAM 65536           // Largest UDP payload we accept, plus slack
+#define PACKET_POOL_CLASSES 3
+
+// Fixed slabs for datagrams too long for the small inline buffers. Each
+// size class is allocated once on first use, so steady traffic never hits
+// malloc. Safe to acquire on one thread and release on another
+char* packetPoolAcquire(size_t bytes);
+void packetPoolRelease(char* buffer);
+
+void printPacketPoolStats(void);
+
+#endif
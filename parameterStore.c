@@ -0,0 +1,261 @@
+#include "parameterStore.h"
+#include "configCache.h"
+#include "metrics.h"
+#include "quiescence.h"
+#include "eventLoop.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    uint64_t hash;                          // 0 while empty; written last when claimed
+    const char* address;                    // Interned in the arena
+    uint64_t fingerprint;                   // Hash of the type tags and argument bytes
+    uint64_t valueBits;                     // First numeric argument as a double
+    char typeTag;                           // First argument's tag, 0 without arguments
+    uint64_t updatedNs;
+    uint64_t changedNs;
+    uint64_t updates;
+    uint64_t unchanged;
+} ParameterEntry;
+
+typedef struct {
+    ParameterEntry entries[PARAMETER_STORE_SLOTS];
+    int entryCount;
+    char arena[PARAMETER_ARENA_SIZE];
+    size_t arenaUsed;
+} ParameterTable;
+
+// A reset fills the spare table and publishes it, like the match cache,
+// so lookups never see a table being cleared under them
+static ParameterTable tables[2];
+static ParameterTable* publishedTable = &tables[0];
+static pthread_mutex_t insertMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t totalUpdates = 0;
+static uint64_t totalUnchanged = 0;
+static uint64_t overflowUpdates = 0;
+static uint64_t storeResets = 0;
+static int resetPosted = 0;
+static uint64_t lastResetNs = 0;
+
+static uint64_t messageFingerprint(const OscMessage* message) {
+    // Tags and arguments are contiguous in the datagram
+    const char* start = message->typeTags;
+    return hashConfigBytes(start, (size_t)((const char*)message->end - start));
+}
+
+static void recordValue(ParameterEntry* entry, const OscMessage* message, uint64_t now) {
+    double value = 0.0;
+    uint64_t bits = 0;
+    if (oscArgumentNumber(message, 0, &value)) {
+        memcpy(&bits, &value, sizeof(bits));
+    }
+    
+    __atomic_store_n(&entry->valueBits, bits, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->typeTag, message->typeTags[0], __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->changedNs, now, __ATOMIC_RELAXED);
+}
+
+static ParameterEntry* findEntry(ParameterTable* table, const char* address, uint64_t hash) {
+    for (int probe = 0; probe < PARAMETER_STORE_SLOTS; probe++) {
+        ParameterEntry* entry = &table->entries[(hash + probe) & (PARAMETER_STORE_SLOTS - 1)];
+        uint64_t slotHash = __atomic_load_n(&entry->hash, __ATOMIC_ACQUIRE);
+        if (slotHash == 0) return NULL;
+        if (slotHash == hash && strcmp(entry->address, address) == 0) return entry;
+    }
+    return NULL;
+}
+
+static void resetFullStore(void* context) {
+    (void)context;
+    
+    // The spare table was unpublished by the previous reset, and an update
+    // from back then may still hold one of its entries. Waited for outside
+    // insertMutex, which those readers take to insert
+    waitForReaders();
+    pthread_mutex_lock(&insertMutex);
+    
+    ParameterTable* spare = publishedTable == &tables[0] ? &tables[1] : &tables[0];
+    memset(spare->entries, 0, sizeof(spare->entries));
+    spare->entryCount = 0;
+    spare->arenaUsed = 0;
+    __atomic_store_n(&publishedTable, spare, __ATOMIC_RELEASE);
+    
+    pthread_mutex_unlock(&insertMutex);
+    
+    __atomic_fetch_add(&storeResets, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&lastResetNs, metricsNowNs(), __ATOMIC_RELAXED);
+    __atomic_store_n(&resetPosted, 0, __ATOMIC_RELEASE);
+}
+
+// Readers cannot wait for each other, so the event loop runs the reset
+static void storeFull(uint64_t now) {
+    __atomic_fetch_add(&overflowUpdates, 1, __ATOMIC_RELAXED);
+    
+    if (now - __atomic_load_n(&lastResetNs, __ATOMIC_RELAXED) < PARAMETER_STORE_RESET_INTERVAL_NS ||
+        __atomic_exchange_n(&resetPosted, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    if (eventLoopPost(resetFullStore, NULL) < 0) {
+        __atomic_store_n(&resetPosted, 0, __ATOMIC_RELEASE);
+    }
+}
+
+static int tableFull(const ParameterTable* table, size_t length) {
+    return __atomic_load_n(&table->entryCount, __ATOMIC_RELAXED) >= PARAMETER_STORE_CAPACITY ||
+           __atomic_load_n(&table->arenaUsed, __ATOMIC_RELAXED) + length > PARAMETER_ARENA_SIZE;
+}
+
+// Claims a slot for a new address. The lock only orders inserters; readers
+// see the entry once its hash is published. A full table is recognised
+// before taking the lock
+static ParameterEntry* insertEntry(const char* address, uint64_t hash, const OscMessage* message,
+                                   uint64_t now) {
+    size_t length = strlen(address) + 1;
+    if (tableFull(__atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE), length)) {
+        storeFull(now);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&insertMutex);
+    ParameterTable* table = publishedTable;
+    
+    // Another receiver may have added it since the lock-free lookup
+    ParameterEntry* entry = findEntry(table, address, hash);
+    if (entry) {
+        pthread_mutex_unlock(&insertMutex);
+        return entry;
+    }
+    
+    if (tableFull(table, length)) {
+        pthread_mutex_unlock(&insertMutex);
+        storeFull(now);
+        return NULL;
+    }
+    
+    for (int probe = 0; probe < PARAMETER_STORE_SLOTS; probe++) {
+        entry = &table->entries[(hash + probe) & (PARAMETER_STORE_SLOTS - 1)];
+        if (entry->hash == 0) break;
+    }
+    
+    memcpy(table->arena + table->arenaUsed, address, length);
+    entry->address = table->arena + table->arenaUsed;
+    __atomic_store_n(&table->arenaUsed, table->arenaUsed + length, __ATOMIC_RELAXED);
+    
+    entry->fingerprint = messageFingerprint(message);
+    entry->updatedNs = now;
+    entry->updates = 1;
+    recordValue(entry, message, now);
+    __atomic_store_n(&entry->hash, hash, __ATOMIC_RELEASE);
+    __atomic_store_n(&table->entryCount, table->entryCount + 1, __ATOMIC_RELAXED);
+    
+    pthread_mutex_unlock(&insertMutex);
+    return entry;
+}
+
+int parameterStoreUpdate(const OscMessage* message) {
+    // Without arguments a message is an event, not state; never a repeat
+    if (!message->typeTags[0]) return 1;
+    
+    const char* address = message->address;
+    uint64_t hash = hashConfigBytes(address, strlen(address));
+    if (hash == 0) hash = 1;
+    
+    uint64_t now = metricsNowNs();
+    __atomic_fetch_add(&totalUpdates, 1, __ATOMIC_RELAXED);
+    
+    ParameterEntry* entry = findEntry(__atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE), address, hash);
+    if (!entry) {
+        insertEntry(address, hash, message, now);
+        return 1;
+    }
+    
+    __atomic_fetch_add(&entry->updates, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->updatedNs, now, __ATOMIC_RELAXED);
+    
+    // The swap makes concurrent receivers agree: only one of them sees a
+    // given change, the others see a repeat
+    uint64_t fingerprint = messageFingerprint(message);
+    if (__atomic_exchange_n(&entry->fingerprint, fingerprint, __ATOMIC_RELAXED) == fingerprint) {
+        __atomic_fetch_add(&entry->unchanged, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&totalUnchanged, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    
+    recordValue(entry, message, now);
+    return 1;
+}
+
+void parameterStoreGetStats(ParameterStoreStats* stats) {
+    stats->updates = __atomic_load_n(&totalUpdates, __ATOMIC_RELAXED);
+    stats->unchanged = __atomic_load_n(&totalUnchanged, __ATOMIC_RELAXED);
+    const ParameterTable* table = __atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE);
+    stats->addresses = (uint64_t)__atomic_load_n(&table->entryCount, __ATOMIC_RELAXED);
+    stats->overflow = __atomic_load_n(&overflowUpdates, __ATOMIC_RELAXED);
+    stats->resets = __atomic_load_n(&storeResets, __ATOMIC_RELAXED);
+}
+
+static void formatValue(char typeTag, uint64_t bits, char* buffer, size_t size) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    
+    switch (typeTag) {
+        case 'T': case 'F':
+            snprintf(buffer, size, "%s", value != 0.0 ? "true" : "false");
+            break;
+        case 'i': case 'h':
+            snprintf(buffer, size, "%.0f", value);
+            break;
+        case 'f': case 'd':
+            snprintf(buffer, size, "%.4f", value);
+            break;
+        case 0:
+            snprintf(buffer, size, "-");
+            break;
+        default:
+            snprintf(buffer, size, "(%c)", typeTag);
+            break;
+    }
+}
+
+void printParameterSnapshot(const char* prefix) {
+    size_t prefixLength = prefix ? strlen(prefix) : 0;
+    uint64_t now = metricsNowNs();
+    int shown = 0;
+    
+    printf("%-48s %-12s %-10s %-10s %s\n", "Address", "Value", "Changed", "Updates", "Unchanged");
+    printf("%-48s %-12s %-10s %-10s %s\n", "-------", "-----", "-------", "-------", "---------");
+    
+    readSectionEnter();
+    const ParameterTable* table = __atomic_load_n(&publishedTable, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < PARAMETER_STORE_SLOTS; i++) {
+        const ParameterEntry* entry = &table->entries[i];
+        if (__atomic_load_n(&entry->hash, __ATOMIC_ACQUIRE) == 0) continue;
+        if (prefixLength && strncmp(entry->address, prefix, prefixLength) != 0) continue;
+    
+        char value[32];
+        formatValue(__atomic_load_n(&entry->typeTag, __ATOMIC_RELAXED),
+                    __atomic_load_n(&entry->valueBits, __ATOMIC_RELAXED), value, sizeof(value));
+    
+        char changed[32];
+        uint64_t changedNs = __atomic_load_n(&entry->changedNs, __ATOMIC_RELAXED);
+        snprintf(changed, sizeof(changed), "%.1fs ago", now > changedNs ? (now - changedNs) / 1e9 : 0.0);
+    
+        printf("%-48s %-12s %-10s %-10llu %llu\n", entry->address, value, changed,
+               (unsigned long long)__atomic_load_n(&entry->updates, __ATOMIC_RELAXED),
+               (unsigned long long)__atomic_load_n(&entry->unchanged, __ATOMIC_RELAXED));
+        shown++;
+    }
+    readSectionLeave();
+    
+    ParameterStoreStats stats;
+    parameterStoreGetStats(&stats);
+    printf("\n%d shown, %llu addresses tracked; %llu of %llu updates repeated the previous value\n", shown,
+           (unsigned long long)stats.addresses, (unsigned long long)stats.unchanged,
+           (unsigned long long)stats.updates);
+    if (stats.overflow) {
+        printf("Store full: %llu updates for new addresses were not tracked, %llu resets\n",
+               (unsigned long long)stats.overflow, (unsigned long long)stats.resets);
+    }
+}
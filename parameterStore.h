@@ -0,0 +1,33 @@
+#ifndef PARAMETER_STORE_H
+#define PARAMETER_STORE_H
+
+#include <stdint.h>
+#include "oscMessage.h"
+
+#define PARAMETER_STORE_SLOTS 4096          // Power of two
+#define PARAMETER_STORE_CAPACITY 3072       // Addresses kept, bounds the load factor at 0.75
+#define PARAMETER_ARENA_SIZE (256 * 1024)   // Interned address strings
+#define PARAMETER_STORE_RESET_INTERVAL_NS 1000000000ULL    // At most one reset of a full store per second
+
+typedef struct {
+    uint64_t updates;
+    uint64_t unchanged;                     // Updates identical to the last one for their address
+    uint64_t addresses;
+    uint64_t overflow;                      // Updates not tracked because the store was full
+    uint64_t resets;                        // Full stores started over
+} ParameterStoreStats;
+
+// Records a message as the latest state of its address. Returns 0 when its
+// type tags and argument bytes repeat the previous update, 1 when they
+// changed, are the first seen, or could not be stored. Messages without
+// arguments are events and always return 1. Lookups are lock-free;
+// only the first sighting of an address takes a lock. A full store is
+// started over from the event loop, after which each address counts as
+// changed once more. Call inside a read section
+int parameterStoreUpdate(const OscMessage* message);
+
+void parameterStoreGetStats(ParameterStoreStats* stats);
+// Current value of every address starting with prefix (NULL for all)
+void printParameterSnapshot(const char* prefix);
+
+#endif
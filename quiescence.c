@@ -0,0 +1,89 @@
+#include "quiescence.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <sched.h>
+
+#define CACHE_LINE 64
+
+typedef struct {
+    uint64_t sequence __attribute__((aligned(CACHE_LINE)));    // Odd while in a section
+} ReaderSlot;
+
+static ReaderSlot readerSlots[MAX_READER_THREADS];
+static int readerSlotCount = 0;
+static uint64_t overflowReaders = 0;        // Sections open on threads without a slot
+static int pauseDepth = 0;
+
+static __thread ReaderSlot* localSlot = NULL;
+static __thread int localClaimed = 0;
+static __thread int localDepth = 0;         // Nested sections count once
+
+static void claimSlot(void) {
+    int index = __atomic_fetch_add(&readerSlotCount, 1, __ATOMIC_RELAXED);
+    localSlot = index < MAX_READER_THREADS ? &readerSlots[index] : NULL;
+    localClaimed = 1;
+}
+
+static void announce(int entering) {
+    if (localSlot) {
+        uint64_t sequence = localSlot->sequence + 1;
+        __atomic_store_n(&localSlot->sequence, sequence, entering ? __ATOMIC_RELAXED : __ATOMIC_RELEASE);
+    } else {
+        __atomic_fetch_add(&overflowReaders, entering ? 1 : (uint64_t)-1, __ATOMIC_RELEASE);
+    }
+}
+
+void readSectionEnter(void) {
+    if (localDepth++ > 0) return;
+    if (!localClaimed) claimSlot();
+    
+    for (;;) {
+        announce(1);
+        // Pairs with the fence in waitForReaders: either the writer sees
+        // this section open, or this section sees what it published
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&pauseDepth, __ATOMIC_ACQUIRE)) return;
+    
+        announce(0);
+        while (__atomic_load_n(&pauseDepth, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    }
+}
+
+void readSectionLeave(void) {
+    if (--localDepth > 0) return;
+    announce(0);
+}
+
+void waitForReaders(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    
+    int count = __atomic_load_n(&readerSlotCount, __ATOMIC_RELAXED);
+    if (count > MAX_READER_THREADS) count = MAX_READER_THREADS;
+    
+    for (int i = 0; i < count; i++) {
+        ReaderSlot* slot = &readerSlots[i];
+        if (slot == localSlot) continue;
+    
+        // Only the section open now matters; later ones see the new state
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        while ((sequence & 1) && __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == sequence) {
+            sched_yield();
+        }
+    }
+    
+    uint64_t own = !localSlot && localDepth > 0;
+    while (__atomic_load_n(&overflowReaders, __ATOMIC_ACQUIRE) > own) {
+        sched_yield();
+    }
+}
+
+void pauseReaders(void) {
+    __atomic_fetch_add(&pauseDepth, 1, __ATOMIC_SEQ_CST);
+    waitForReaders();
+}
+
+void resumeReaders(void) {
+    __atomic_fetch_sub(&pauseDepth, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,23 @@
+#ifndef QUIESCENCE_H
+#define QUIESCENCE_H
+
+#define MAX_READER_THREADS 64               // Threads beyond this share one counter
+
+// Grace periods for the double-buffered sets that matching threads walk
+// without locks. A reader brackets each walk; a writer that is about to
+// reuse a buffer it unpublished earlier first waits for every walk that
+// may still be inside it. Entering and leaving cost a store each to a
+// cache line the thread owns, plus one fence
+void readSectionEnter(void);
+void readSectionLeave(void);
+
+// Returns once every section running at the call has left. Sections the
+// calling thread is in are not waited for
+void waitForReaders(void);
+
+// For edits that move filters in place: new sections wait at the door
+// until resumeReaders, and pauseReaders returns once the running ones left
+void pauseReaders(void);
+void resumeReaders(void);
+
+#endif
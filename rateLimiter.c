@@ -1,4 +1,5 @@
 #include "rateLimiter.h"
+#include "asyncLog.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -20,29 +21,34 @@ void initRateLimiterWithValues(RateLimiter* limiter, int count, int seconds) {
     limiter->lastExecutionTime = 0;
 }
 
+// Fields are read and written atomically: receiver shards may match the
+// same filter concurrently
 int canExecuteWithRateLimit(RateLimiter* limiter, int currentCount, int enableDebug) {
     if (!limiter) return 0;
     
     time_t currentTime = time(NULL);
+    int lastCount = __atomic_load_n(&limiter->lastExecutionCount, __ATOMIC_ACQUIRE);
+    time_t lastTime = __atomic_load_n(&limiter->lastExecutionTime, __ATOMIC_ACQUIRE);
     
-    int countDiff = currentCount - limiter->lastExecutionCount;
+    int countDiff = currentCount - lastCount;
     int countOK = (countDiff >= limiter->rateLimitCount);
     
     int timeOK = 0;
     double timeDiff = 0.0;
     
-    if (limiter->lastExecutionTime == 0) {
+    if (lastTime == 0) {
         timeOK = 1; 
         timeDiff = 0.0;
     } else {
-        timeDiff = difftime(currentTime, limiter->lastExecutionTime);
+        timeDiff = difftime(currentTime, lastTime);
         timeOK = (timeDiff >= limiter->rateLimitSeconds);
     }
     
     if (enableDebug) {
-        printf("Rate limit check: Count diff=%d (need >=%d, %s), Time diff=%.1fs (need >=%ds, %s)\n",
-               countDiff, limiter->rateLimitCount, countOK ? "OK" : "BLOCKED",
-               timeDiff, limiter->rateLimitSeconds, timeOK ? "OK" : "BLOCKED");
+        logRecord(LOG_LEVEL_DEBUG, LOG_SUBSYS_RATE, LOG_EVENT_RATE_CHECK, NULL,
+                  countDiff, limiter->rateLimitCount, (int64_t)(timeDiff * 1000.0),
+                  (int64_t)(uint32_t)limiter->rateLimitSeconds |
+                  ((int64_t)countOK << 32) | ((int64_t)timeOK << 33));
     }
     
     if (limiter->rateLimitCount <= 1 && limiter->rateLimitSeconds <= 0) {
@@ -56,15 +62,35 @@ int canExecuteWithRateLimit(RateLimiter* limiter, int currentCount, int enableDe
 void updateRateLimiterExecution(RateLimiter* limiter, int currentCount) {
     if (!limiter) return;
     
-    limiter->lastExecutionCount = currentCount;
-    limiter->lastExecutionTime = time(NULL);
+    __atomic_store_n(&limiter->lastExecutionCount, currentCount, __ATOMIC_RELEASE);
+    __atomic_store_n(&limiter->lastExecutionTime, time(NULL), __ATOMIC_RELEASE);
+}
+
+// Check and record in one step. When several threads pass the check for
+// the same window, only the one that moves lastExecutionCount wins
+int claimRateLimitedExecution(RateLimiter* limiter, int currentCount, int enableDebug) {
+    if (!limiter) return 0;
+    
+    int lastCount = __atomic_load_n(&limiter->lastExecutionCount, __ATOMIC_ACQUIRE);
+    if (!canExecuteWithRateLimit(limiter, currentCount, enableDebug)) {
+        return 0;
+    }
+    
+    if (!__atomic_compare_exchange_n(&limiter->lastExecutionCount, &lastCount, currentCount, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // Unlimited filters fire on every match regardless of the race
+        return limiter->rateLimitCount <= 1 && limiter->rateLimitSeconds <= 0;
+    }
+    
+    __atomic_store_n(&limiter->lastExecutionTime, time(NULL), __ATOMIC_RELEASE);
+    return 1;
 }
 
 void resetRateLimiter(RateLimiter* limiter) {
     if (!limiter) return;
     
-    limiter->lastExecutionCount = 0;
-    limiter->lastExecutionTime = 0;
+    __atomic_store_n(&limiter->lastExecutionCount, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&limiter->lastExecutionTime, 0, __ATOMIC_RELEASE);
 }
 
 void setRateLimitValues(RateLimiter* limiter, int count, int seconds) {
@@ -18,6 +18,7 @@ void initRateLimiter(RateLimiter* limiter);
 void initRateLimiterWithValues(RateLimiter* limiter, int count, int seconds);
 int canExecuteWithRateLimit(RateLimiter* limiter, int currentCount, int enableDebug);
 void updateRateLimiterExecution(RateLimiter* limiter, int currentCount);
+int claimRateLimitedExecution(RateLimiter* limiter, int currentCount, int enableDebug);
 void resetRateLimiter(RateLimiter* limiter);
 
 // Configuration functions
@@ -0,0 +1,267 @@
+#include "smoothing.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#define SMOOTHING_TABLE (SMOOTHING_CHANNELS * 2)
+
+typedef struct {
+    uint32_t owner;
+    uint64_t address;
+    uint8_t primed;                 // output holds a value
+    double average;                 // EMA state
+    double output;
+    double values[SMOOTHING_RING];
+    uint64_t timesNs[SMOOTHING_RING];
+    int head;                       // Oldest sample
+    int count;
+    double sum;                     // Average only
+    int nextFree;
+} SmoothingChannel;
+
+// Open addressing on (owner, address) into the channel pool; everything
+// here is guarded by smoothingMutex, which every sample holds
+static SmoothingChannel channels[SMOOTHING_CHANNELS];
+static int16_t channelTable[SMOOTHING_TABLE];   // Channel index + 1, 0 when empty
+static int channelsUsed = 0;
+static int freeChannels = -1;
+static uint32_t nextOwner = 1;
+static pthread_mutex_t smoothingMutex = PTHREAD_MUTEX_INITIALIZER;
+
+int compileSmoothing(const char* text, Smoothing* smoothing) {
+    memset(smoothing, 0, sizeof(Smoothing));
+    if (!text) return 0;
+    
+    char words[MAX_SMOOTHING_LENGTH];
+    strncpy(words, text, sizeof(words) - 1);
+    words[sizeof(words) - 1] = '\0';
+    
+    char* save;
+    for (char* name = strtok_r(words, " \t", &save); name; name = strtok_r(NULL, " \t", &save)) {
+        if (strcasecmp(name, "none") == 0) continue;
+    
+        char* argument = strtok_r(NULL, " \t", &save);
+        char* end;
+        double number = argument ? strtod(argument, &end) : 0.0;
+        if (!argument || end == argument || *end) return -1;
+    
+        if (strcasecmp(name, "band") == 0) {
+            if (number <= 0.0) return -1;
+            smoothing->band = number;
+            continue;
+        }
+        if (smoothing->kind != SMOOTH_NONE) return -1;
+    
+        if (strcasecmp(name, "ema") == 0) {
+            if (number <= 0.0 || number > 1.0) return -1;
+            smoothing->kind = SMOOTH_EMA;
+            smoothing->alpha = number;
+            continue;
+        }
+    
+        if (number < 1.0 || number > 600000.0) return -1;
+        smoothing->windowMs = (uint32_t)number;
+        if (strcasecmp(name, "avg") == 0) {
+            smoothing->kind = SMOOTH_AVERAGE;
+        } else if (strcasecmp(name, "min") == 0) {
+            smoothing->kind = SMOOTH_MIN;
+        } else if (strcasecmp(name, "max") == 0) {
+            smoothing->kind = SMOOTH_MAX;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int smoothingEnabled(const Smoothing* smoothing) {
+    return smoothing->kind != SMOOTH_NONE || smoothing->band > 0.0;
+}
+
+static int homeSlot(uint32_t owner, uint64_t address) {
+    uint64_t mixed = (address ^ ((uint64_t)owner * 0x9E3779B97F4A7C15ULL)) * 0xFF51AFD7ED558CCDULL;
+    return (int)(mixed >> 32) & (SMOOTHING_TABLE - 1);
+}
+
+static SmoothingChannel* findChannel(uint32_t owner, uint64_t address) {
+    int slot = homeSlot(owner, address);
+    
+    while (channelTable[slot]) {
+        SmoothingChannel* channel = &channels[channelTable[slot] - 1];
+        if (channel->owner == owner && channel->address == address) return channel;
+        slot = (slot + 1) & (SMOOTHING_TABLE - 1);
+    }
+    
+    int index = freeChannels;
+    if (index >= 0) {
+        freeChannels = channels[index].nextFree;
+    } else if (channelsUsed < SMOOTHING_CHANNELS) {
+        index = channelsUsed++;
+    } else {
+        return NULL;
+    }
+    
+    SmoothingChannel* channel = &channels[index];
+    channel->owner = owner;
+    channel->address = address;
+    channel->primed = 0;
+    channel->head = 0;
+    channel->count = 0;
+    channel->sum = 0.0;
+    channelTable[slot] = (int16_t)(index + 1);
+    return channel;
+}
+
+// Frees the slot's channel and shifts later entries of the probe run back
+// so lookups never stop at the hole
+static void removeSlot(int slot) {
+    int index = channelTable[slot] - 1;
+    channels[index].owner = 0;
+    channels[index].nextFree = freeChannels;
+    freeChannels = index;
+    channelTable[slot] = 0;
+    
+    int hole = slot;
+    for (int next = (slot + 1) & (SMOOTHING_TABLE - 1); channelTable[next]; next = (next + 1) & (SMOOTHING_TABLE - 1)) {
+        const SmoothingChannel* channel = &channels[channelTable[next] - 1];
+        int home = homeSlot(channel->owner, channel->address);
+        if (((next - home) & (SMOOTHING_TABLE - 1)) >= ((next - hole) & (SMOOTHING_TABLE - 1))) {
+            channelTable[hole] = channelTable[next];
+            channelTable[next] = 0;
+            hole = next;
+        }
+    }
+}
+
+static int ownerListed(uint32_t owner, Smoothing* const* live, int count) {
+    for (int i = 0; i < count; i++) {
+        if (live[i]->owner == owner) return 1;
+    }
+    return 0;
+}
+
+// Drops the channels of one owner, or of every owner not in live when owner is 0
+static void dropChannels(uint32_t owner, Smoothing* const* live, int count) {
+    for (int slot = 0; slot < SMOOTHING_TABLE; ) {
+        if (channelTable[slot]) {
+            uint32_t held = channels[channelTable[slot] - 1].owner;
+            if (owner ? held == owner : !ownerListed(held, live, count)) {
+                // An entry from later in the run may now sit here
+                removeSlot(slot);
+                continue;
+            }
+        }
+        slot++;
+    }
+}
+
+void setSmoothing(Smoothing* smoothing, const Smoothing* compiled) {
+    pthread_mutex_lock(&smoothingMutex);
+    
+    if (smoothing->owner) {
+        dropChannels(smoothing->owner, NULL, 0);
+    }
+    *smoothing = *compiled;
+    smoothing->owner = 0;
+    if (smoothingEnabled(compiled)) {
+        smoothing->owner = nextOwner++;
+    }
+    
+    pthread_mutex_unlock(&smoothingMutex);
+}
+
+void collectSmoothingChannels(Smoothing* const* live, int count) {
+    pthread_mutex_lock(&smoothingMutex);
+    dropChannels(0, live, count);
+    pthread_mutex_unlock(&smoothingMutex);
+}
+
+void attachSmoothing(Smoothing* smoothing) {
+    pthread_mutex_lock(&smoothingMutex);
+    if (!smoothing->owner && smoothingEnabled(smoothing)) {
+        smoothing->owner = nextOwner++;
+    }
+    pthread_mutex_unlock(&smoothingMutex);
+}
+
+static void dropOldest(SmoothingChannel* channel, int subtract) {
+    if (subtract) channel->sum -= channel->values[channel->head];
+    channel->head = (channel->head + 1) % SMOOTHING_RING;
+    channel->count--;
+}
+
+static double windowedValue(const Smoothing* smoothing, SmoothingChannel* channel, double value, uint64_t nowNs) {
+    uint64_t windowNs = (uint64_t)smoothing->windowMs * 1000000ULL;
+    int average = smoothing->kind == SMOOTH_AVERAGE;
+    
+    while (channel->count > 0 && nowNs - channel->timesNs[channel->head] > windowNs) {
+        dropOldest(channel, average);
+    }
+    if (channel->count == SMOOTHING_RING) {
+        dropOldest(channel, average);
+    }
+    
+    if (!average) {
+        // Monotonic queue: samples that can never be the extreme again
+        // leave from the back, so the front is always the answer
+        while (channel->count > 0) {
+            int back = (channel->head + channel->count - 1) % SMOOTHING_RING;
+            double last = channel->values[back];
+            if (smoothing->kind == SMOOTH_MIN ? last < value : last > value) break;
+            channel->count--;
+        }
+    }
+    
+    int slot = (channel->head + channel->count) % SMOOTHING_RING;
+    channel->values[slot] = value;
+    channel->timesNs[slot] = nowNs;
+    channel->count++;
+    
+    if (!average) return channel->values[channel->head];
+    
+    // Start over from an empty window so rounding never accumulates
+    channel->sum = channel->count == 1 ? value : channel->sum + value;
+    return channel->sum / channel->count;
+}
+
+double smoothValue(const Smoothing* smoothing, uint64_t address, double value, uint64_t nowNs, int* moved) {
+    pthread_mutex_lock(&smoothingMutex);
+    
+    SmoothingChannel* channel = smoothing->owner ? findChannel(smoothing->owner, address) : NULL;
+    if (!channel) {
+        pthread_mutex_unlock(&smoothingMutex);
+        *moved = 1;
+        return value;
+    }
+    
+    double smoothed = value;
+    if (smoothing->kind == SMOOTH_EMA) {
+        channel->average = channel->primed ? channel->average + smoothing->alpha * (value - channel->average)
+                                           : value;
+        smoothed = channel->average;
+    } else if (smoothing->kind != SMOOTH_NONE) {
+        smoothed = windowedValue(smoothing, channel, value, nowNs);
+    }
+    
+    double change = smoothed - channel->output;
+    *moved = !channel->primed;
+    if (!channel->primed || change >= smoothing->band || -change >= smoothing->band) {
+        *moved |= smoothed != channel->output;
+        channel->output = smoothed;
+    }
+    channel->primed = 1;
+    double output = channel->output;
+    
+    pthread_mutex_unlock(&smoothingMutex);
+    return output;
+}
+
+void resetSmoothing(const Smoothing* smoothing) {
+    pthread_mutex_lock(&smoothingMutex);
+    if (smoothing->owner) {
+        dropChannels(smoothing->owner, NULL, 0);
+    }
+    pthread_mutex_unlock(&smoothingMutex);
+}
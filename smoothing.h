@@ -0,0 +1,54 @@
+#ifndef SMOOTHING_H
+#define SMOOTHING_H
+
+#include <stdint.h>
+
+#define MAX_SMOOTHING_LENGTH 32
+#define SMOOTHING_CHANNELS 512              // Smoothed (filter, address) pairs at once
+#define SMOOTHING_RING 128                  // Samples per channel; older ones leave early
+
+typedef enum {
+    SMOOTH_NONE,
+    SMOOTH_AVERAGE,                 // Mean of the samples within windowMs
+    SMOOTH_EMA,                     // Exponential moving average with factor alpha
+    SMOOTH_MIN,                     // Lowest sample within windowMs
+    SMOOTH_MAX                      // Highest sample within windowMs
+} SmoothingKind;
+
+// What a filter's condition sees instead of the raw value. The state lives
+// in channels, one per address the filter matches, so a wildcard filter
+// smooths each address on its own. Channels are preallocated; every sample
+// is O(1) amortized: a running sum for the average, a monotonic queue for
+// min and max
+typedef struct {
+    uint8_t kind;
+    uint32_t windowMs;
+    double alpha;
+    double band;                    // Hysteresis: output moves only by at least this much
+    uint32_t owner;                 // Names this filter's channels; 0 until attached
+} Smoothing;
+
+// Text forms, combinable: avg <ms> | ema <alpha> | min <ms> | max <ms> |
+// band <width> | none. "band" alone smooths nothing but holds the output
+// until the value moves by width. Returns -1 when the text is not valid
+int compileSmoothing(const char* text, Smoothing* smoothing);
+int smoothingEnabled(const Smoothing* smoothing);
+
+// Owners are never reused, so a match still holding an old filter state
+// cannot push samples into another filter's channels.
+// Replaces a live filter's smoothing and drops its channels
+void setSmoothing(Smoothing* smoothing, const Smoothing* compiled);
+// Drops the channels of every owner none of the given states holds, such
+// as those of removed or reloaded filters
+void collectSmoothingChannels(Smoothing* const* live, int count);
+// Gives an enabled smoothing an owner if it has none
+void attachSmoothing(Smoothing* smoothing);
+
+// Adds one sample for the address (its hashConfigBytes) and returns the
+// smoothed value; moved is set when the output changed. Addresses beyond
+// the channel limit see raw values. Samples are serialized internally, so
+// receivers on several threads can share a filter
+double smoothValue(const Smoothing* smoothing, uint64_t address, double value, uint64_t nowNs, int* moved);
+void resetSmoothing(const Smoothing* smoothing);
+
+#endif
@@ -1,58 +1,404 @@
 #include "socket.h"
 #include "oscUtility.h"
+#include "metrics.h"
+#include "asyncLog.h"
+#include "capture.h"
+#include "trace.h"
+#include "eventLoop.h"
+#include "uringIngest.h"
+#include "dispatchQueue.h"
+#include "packetPool.h"
+#include "oscDecode.h"
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
 
-int udpSocket(int port) {
+static int stopRequested = 0;
+static IngestBackend requestedIngest = INGEST_AUTO;
+static IngestBackend activeIngest = INGEST_RECVMSG;
+static int ingestFd = -1;                   // Descriptor registered with the event loop
+static int dispatchThreadEnabled = 0;
+static __thread DispatchQueue* localQueue = NULL;   // Set while this thread hands packets off
+static __thread uint32_t lastOverflowCount = 0;     // SO_RXQ_OVFL is cumulative per socket
+
+static int requestedReceiveBuffer = 0;
+static int effectiveReceiveBuffer = 0;
+static int busyPollMicros = 0;
+static int socketTuningReported = 0;
+
+static int readRmemMax(void) {
+    FILE* file = fopen("/proc/sys/net/core/rmem_max", "r");
+    if (!file) return -1;
+    
+    int value = -1;
+    if (fscanf(file, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(file);
+    return value;
+}
+
+// SO_RCVBUF is capped at net.core.rmem_max; SO_RCVBUFFORCE ignores the cap
+// but needs CAP_NET_ADMIN. Warnings are printed for the first socket only
+static void applyReceiveBuffer(int sockfd) {
+    int report = !socketTuningReported;
+    int rmemMax = readRmemMax();
+    
+    if (report && rmemMax >= 0 && rmemMax < requestedReceiveBuffer) {
+        printf("Warning: net.core.rmem_max is %d, below the requested receive buffer of %d\n",
+               rmemMax, requestedReceiveBuffer);
+    }
+    
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &requestedReceiveBuffer, sizeof(requestedReceiveBuffer)) < 0 &&
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &requestedReceiveBuffer, sizeof(requestedReceiveBuffer)) < 0) {
+        perror("Setting receive buffer failed");
+    }
+    
+    // The kernel doubles the value for bookkeeping overhead and reports that
+    int reported = 0;
+    socklen_t length = sizeof(reported);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &reported, &length) == 0) {
+        effectiveReceiveBuffer = reported / 2;
+    }
+    
+    if (report && rmemMax >= 0 && rmemMax < requestedReceiveBuffer &&
+        effectiveReceiveBuffer >= requestedReceiveBuffer) {
+        printf("  Overridden with SO_RCVBUFFORCE\n");
+    }
+    if (report && effectiveReceiveBuffer < requestedReceiveBuffer) {
+        printf("Warning: receive buffer capped at %d bytes; run as root or raise it with\n", effectiveReceiveBuffer);
+        printf("  sysctl -w net.core.rmem_max=%d\n", requestedReceiveBuffer);
+    }
+}
+
+static int openUdpSocket(int port, int reusePort) {
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("Socket creation failed");
         return -1;
     }
-
+    
     int opt = 1;
     if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("Setting socket options failed");
         close(sockfd);
         return -1;
     }
-
+    
+    // Every socket bound with SO_REUSEPORT gets a share of the port's
+    // flows, hashed on the source address and port
+    if (reusePort && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("Setting SO_REUSEPORT failed");
+        close(sockfd);
+        return -1;
+    }
+    
+    // Kernel receive timestamps feed the socket stage of the latency trace
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) < 0) {
+        perror("Enabling receive timestamps failed");
+    }
+    
+    // Every datagram then carries the socket's running drop count
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) < 0) {
+        perror("Enabling drop counters failed");
+    }
+    
+    if (requestedReceiveBuffer > 0) {
+        applyReceiveBuffer(sockfd);
+    } else {
+        int reported = 0;
+        socklen_t length = sizeof(reported);
+        if (getsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &reported, &length) == 0) {
+            effectiveReceiveBuffer = reported / 2;
+        }
+    }
+    
+    // Busy polling spins in recvmsg for up to this long before sleeping,
+    // trading CPU for wakeup latency; raising it needs CAP_NET_ADMIN
+    if (busyPollMicros > 0 &&
+        setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busyPollMicros, sizeof(busyPollMicros)) < 0 &&
+        !socketTuningReported) {
+        perror("Setting SO_BUSY_POLL failed");
+    }
+    socketTuningReported = 1;
+    
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
-
+    
     if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
         perror("Bind failed");
         close(sockfd);
         return -1;
     }
-
+    
     return sockfd;
 }
 
-void receiveMessages(int sockfd) {
-    char buffer[1024];
+int udpSocket(int port) {
+    return openUdpSocket(port, 0);
+}
+
+int udpSocketReusePort(int port) {
+    return openUdpSocket(port, 1);
+}
+
+uint64_t readControlData(struct msghdr* message) {
+    uint64_t timestamp = 0;
+    
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(message); cmsg; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) continue;
+        
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            timestamp = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        } else if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t overflows;
+            memcpy(&overflows, CMSG_DATA(cmsg), sizeof(overflows));
+            if (overflows != lastOverflowCount) {
+                metricsRecordSocketOverflows(overflows - lastOverflowCount);
+                lastOverflowCount = overflows;
+            }
+        }
+    }
+    return timestamp;
+}
+
+void handleDatagram(char* buffer, size_t length, const struct sockaddr_in* source, uint64_t kernelNs) {
+    uint64_t receivedNs = localQueue ? metricsNowNs() : traceBeginPacket(kernelNs);
+    
+    buffer[length] = '\0';
+    metricsRecordPacket(length);
+    
+    if (isCaptureActive()) {
+        captureDatagram(buffer, length, source, kernelNs ? kernelNs : captureTimestampNow());
+    }
+    
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_SUBSYS_NET)) {
+        logRecord(LOG_LEVEL_DEBUG, LOG_SUBSYS_NET, LOG_EVENT_PACKET_RECEIVED, buffer,
+                  source->sin_addr.s_addr, ntohs(source->sin_port), (int)length, 0);
+    }
+    
+    // With a dispatcher thread, matching and actions happen over there
+    if (localQueue) {
+        dispatchQueueSubmit(localQueue, buffer, length, traceReceiveOrigin(kernelNs, receivedNs), receivedNs);
+        return;
+    }
+    
+    traceLap(TRACE_STAGE_QUEUE);
+    processOscPacket(buffer, (int)length);
+    traceEndPacket();
+}
+
+// Tail of datagrams longer than the first buffer. The front stays free so
+// the head can be copied in, leaving the whole datagram contiguous
+static __thread char overflowBuffer[PACKET_MAX_DATAGRAM + 1];
+
+// Receives and processes one datagram; returns -1 with errno set when
+// nothing was read (EAGAIN on a drained non-blocking socket)
+static int receiveDatagram(int sockfd) {
+    char stackBuffer[DISPATCH_BUFFER_SIZE + 1];
+    char control[SOCKET_CONTROL_SIZE];
     struct sockaddr_in srcAddr;
-    socklen_t addrLen = sizeof(srcAddr);
-
-    while (1) {
-        ssize_t bytesReceived = recvfrom(sockfd, buffer, sizeof(buffer) - 1, 0,
-                                       (struct sockaddr *)&srcAddr, &addrLen);
-        if (bytesReceived < 0) {
-            perror("Receive failed");
-            continue;
+    
+    // Land straight in a pooled buffer when handing off to a dispatcher
+    PacketBuffer* pooled = localQueue ? dispatchQueueAcquire(localQueue) : NULL;
+    char* buffer = pooled ? pooled->data : stackBuffer;
+    
+    // Typical packets fit the first buffer and are never copied; the
+    // kernel scatters anything longer into the overflow buffer
+    struct iovec iov[2] = {
+        {buffer, DISPATCH_BUFFER_SIZE},
+        {overflowBuffer + DISPATCH_BUFFER_SIZE, PACKET_MAX_DATAGRAM - DISPATCH_BUFFER_SIZE}
+    };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_name = &srcAddr;
+    message.msg_namelen = sizeof(srcAddr);
+    message.msg_iov = iov;
+    message.msg_iovlen = 2;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    
+    ssize_t bytesReceived = recvmsg(sockfd, &message, 0);
+    if (bytesReceived < 0) {
+        return -1;
+    }
+    if (bytesReceived == 0 && __atomic_load_n(&stopRequested, __ATOMIC_ACQUIRE)) {
+        // Woken by shutdown() rather than a datagram
+        return 0;
+    }
+    
+    uint64_t kernelNs = readControlData(&message);
+    if (message.msg_flags & MSG_TRUNC) {
+        // A partial OSC packet would be misparsed; count it and move on
+        metricsRecordTruncated();
+        return 0;
+    }
+    
+    if (bytesReceived > DISPATCH_BUFFER_SIZE) {
+        memcpy(overflowBuffer, buffer, DISPATCH_BUFFER_SIZE);
+        buffer = overflowBuffer;
+    }
+    
+    handleDatagram(buffer, (size_t)bytesReceived, &srcAddr, kernelNs);
+    return 0;
+}
+
+// Blocking receive loop for callers without an event loop; uses the
+// selected ingest backend like startIngest
+void receiveMessages(int sockfd) {
+    __atomic_store_n(&stopRequested, 0, __ATOMIC_RELEASE);
+    lastOverflowCount = 0;
+    if (dispatchThreadEnabled) {
+        localQueue = dispatchQueueStart();
+    }
+    
+    if (requestedIngest != INGEST_RECVMSG && uringIngestStart(sockfd) >= 0) {
+        activeIngest = INGEST_URING;
+        while (!__atomic_load_n(&stopRequested, __ATOMIC_ACQUIRE)) {
+            if (uringIngestWait() < 0) {
+                perror("io_uring wait failed");
+                break;
+            }
         }
+        uringIngestStop();
+    } else {
+        activeIngest = INGEST_RECVMSG;
+        while (!__atomic_load_n(&stopRequested, __ATOMIC_ACQUIRE)) {
+            if (receiveDatagram(sockfd) < 0 && errno != EINTR) {
+                perror("Receive failed");
+            }
+        }
+    }
+    
+    dispatchQueueStop(localQueue);
+    localQueue = NULL;
+}
 
-        buffer[bytesReceived] = '\0';
-        
-        if (isMessagePrintingEnabled()) {
-            printf("Received message: %s\n", buffer);
+int setSocketNonBlocking(int sockfd) {
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("Setting socket non-blocking failed");
+        return -1;
+    }
+    return 0;
+}
 
-            char srcIP[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &srcAddr.sin_addr, srcIP, sizeof(srcIP));
-            printf("From IP: %s, Port: %d\n", srcIP, ntohs(srcAddr.sin_port));
+// Event loop callback for a non-blocking socket. The batch limit keeps a
+// flood from starving the CLI and timers sharing the loop
+void drainSocket(int sockfd, uint32_t events, void* context) {
+    (void)events; (void)context;
+    
+    for (int i = 0; i < SOCKET_DRAIN_BATCH; i++) {
+        if (receiveDatagram(sockfd) < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("Receive failed");
+            }
+            return;
+        }
+    }
+}
+
+// Takes effect after the next datagram (or error) wakes the receiver;
+// shutdown(SHUT_RD) on the socket wakes it immediately
+void stopReceiving(void) {
+    __atomic_store_n(&stopRequested, 1, __ATOMIC_RELEASE);
+}
+
+int selectIngestBackend(const char* name) {
+    if (strcmp(name, "auto") == 0) {
+        requestedIngest = INGEST_AUTO;
+    } else if (strcmp(name, "io_uring") == 0) {
+        requestedIngest = INGEST_URING;
+    } else if (strcmp(name, "recvmsg") == 0) {
+        requestedIngest = INGEST_RECVMSG;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char* ingestBackendName(void) {
+    return activeIngest == INGEST_URING ? "io_uring" : "recvmsg";
+}
+
+// Registers the socket with the event loop through io_uring when the
+// kernel allows it, otherwise through the recvmsg drain
+int startIngest(int sockfd) {
+    if (dispatchThreadEnabled && !localQueue) {
+        localQueue = dispatchQueueStart();
+    }
+    
+    if (requestedIngest != INGEST_RECVMSG) {
+        int ringFd = uringIngestStart(sockfd);
+        if (ringFd >= 0 && eventLoopAddFd(ringFd, EPOLLIN, uringIngestDrain, NULL) == 0) {
+            activeIngest = INGEST_URING;
+            ingestFd = ringFd;
+            return 0;
         }
         
-        checkParameterFilter(buffer);
+        if (requestedIngest == INGEST_URING) {
+            printf("io_uring ingest unavailable (%s), falling back to recvmsg\n", strerror(errno));
+        }
+        uringIngestStop();
+    }
+    
+    activeIngest = INGEST_RECVMSG;
+    if (setSocketNonBlocking(sockfd) < 0) {
+        return -1;
+    }
+    if (eventLoopAddFd(sockfd, EPOLLIN, drainSocket, NULL) < 0) {
+        perror("Failed to register socket");
+        return -1;
+    }
+    ingestFd = sockfd;
+    return 0;
+}
+
+void stopIngest(void) {
+    if (ingestFd >= 0) {
+        eventLoopRemoveFd(ingestFd);
+        ingestFd = -1;
+    }
+    uringIngestStop();
+    dispatchQueueStop(localQueue);
+    localQueue = NULL;
+}
+
+void setDispatchThread(int enabled) {
+    dispatchThreadEnabled = enabled;
+}
+
+void setSocketReceiveBuffer(int bytes) {
+    requestedReceiveBuffer = bytes;
+}
+
+void setSocketBusyPoll(int micros) {
+    busyPollMicros = micros;
+}
+
+void printIngestStatus(void) {
+    printf("Ingest backend: %s\n", ingestBackendName());
+    printf("Argument decoding: %s\n", oscDecodeLevelName(oscDecodeLevel()));
+    printf("Receive buffer: %d bytes", effectiveReceiveBuffer);
+    if (requestedReceiveBuffer > 0) {
+        printf(" (requested %d)", requestedReceiveBuffer);
+    }
+    printf("\n");
+    if (busyPollMicros > 0) {
+        printf("Busy poll: %d us\n", busyPollMicros);
+    }
+    
+    if (activeIngest == INGEST_URING) {
+        UringIngestStats stats;
+        uringIngestGetStats(&stats);
+        printf("Provided buffers: %d x %d bytes\n", URING_BUFFER_COUNT, URING_BUFFER_SIZE);
+        printf("Completions: %llu\n", (unsigned long long)stats.completions);
+        printf("Receive resubmits: %llu\n", (unsigned long long)stats.rearms);
+        printf("Buffer starvation: %llu\n", (unsigned long long)stats.bufferStarved);
     }
 }
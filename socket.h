@@ -6,8 +6,45 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define SOCKET_DRAIN_BATCH 64           // Datagrams handled per event loop wakeup
+// Room for SCM_TIMESTAMPNS and SO_RXQ_OVFL control messages
+#define SOCKET_CONTROL_SIZE (CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t)))
+
+typedef enum {
+    INGEST_AUTO,                        // io_uring when available, else recvmsg
+    INGEST_RECVMSG,
+    INGEST_URING
+} IngestBackend;
 
 int udpSocket(int port);
+int udpSocketReusePort(int port);
+// Applied to sockets opened afterwards; 0 keeps the kernel default
+void setSocketReceiveBuffer(int bytes);
+void setSocketBusyPoll(int micros);
+int setSocketNonBlocking(int sockfd);
+void drainSocket(int sockfd, uint32_t events, void* context);
 void receiveMessages(int sockfd);
+void stopReceiving(void);
+
+// Counts SO_RXQ_OVFL drops and returns SCM_TIMESTAMPNS as CLOCK_REALTIME
+// nanoseconds (0 when absent). Call from the thread that owns the socket
+uint64_t readControlData(struct msghdr* message);
+// Runs one received datagram through the pipeline; buffer must have room
+// for a terminating NUL after length bytes
+void handleDatagram(char* buffer, size_t length, const struct sockaddr_in* source, uint64_t kernelNs);
+
+// name: "auto", "io_uring" or "recvmsg"
+int selectIngestBackend(const char* name);
+int startIngest(int sockfd);
+void stopIngest(void);
+// Receivers started afterwards hand packets to a dispatcher thread
+// through a queue of pooled buffers instead of processing them inline
+void setDispatchThread(int enabled);
+const char* ingestBackendName(void);
+void printIngestStatus(void);
 
 #endif
@@ -0,0 +1,55 @@
+#include "startupReport.h"
+#include "configCache.h"
+#include <stdio.h>
+#include <time.h>
+
+typedef struct {
+    const char* name;
+    double elapsedMs;
+} StartupStage;
+
+static StartupStage stages[MAX_STARTUP_STAGES];
+static int stageCount = 0;
+static struct timespec startTime;
+static struct timespec lastMark;
+
+static double elapsedMs(const struct timespec* from, const struct timespec* to) {
+    return (to->tv_sec - from->tv_sec) * 1000.0 + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+void startupBegin(void) {
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    lastMark = startTime;
+    stageCount = 0;
+}
+
+void startupMark(const char* stage) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    if (stageCount < MAX_STARTUP_STAGES) {
+        stages[stageCount].name = stage;
+        stages[stageCount].elapsedMs = elapsedMs(&lastMark, &now);
+        stageCount++;
+    }
+    
+    lastMark = now;
+}
+
+void printStartupReport(void) {
+    if (stageCount == 0) {
+        printf("No startup timings recorded\n");
+        return;
+    }
+    
+    printf("=== Startup Time Breakdown ===\n");
+    printf("%-24s %12s\n", "Stage", "Time (ms)");
+    printf("%-24s %12s\n", "-----", "---------");
+    
+    for (int i = 0; i < stageCount; i++) {
+        printf("%-24s %12.3f\n", stages[i].name, stages[i].elapsedMs);
+    }
+    
+    printf("%-24s %12.3f\n", "Total", elapsedMs(&startTime, &lastMark));
+    printf("Config source: %s\n", configLoadedFromCache ? CONFIG_CACHE_FILE " (cached)" : "config.json (parsed)");
+}
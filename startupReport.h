@@ -0,0 +1,10 @@
+#ifndef STARTUP_REPORT_H
+#define STARTUP_REPORT_H
+
+#define MAX_STARTUP_STAGES 16
+
+void startupBegin(void);
+void startupMark(const char* stage);
+void printStartupReport(void);
+
+#endif
@@ -0,0 +1,293 @@
+#include "stateJournal.h"
+#include "configCache.h"
+#include "quiescence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define JOURNAL_BATCH 256                   // Records per write() while flushing
+
+static int journalFd = -1;
+static int journalRecords = 0;
+static int journalCompactions = 0;
+static pthread_mutex_t journalMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The writer thread; executed actions only mark their filter
+static pthread_t writerThread;
+static int writerRunning = 0;
+static int recordsPending = 0;              // Some filter was marked since the last flush
+static pthread_mutex_t wakeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;
+
+static uint32_t recordChecksum(const StateJournalRecord* record) {
+    const char* start = (const char*)&record->patternHash;
+    size_t length = sizeof(StateJournalRecord) - offsetof(StateJournalRecord, patternHash);
+    return (uint32_t)hashConfigBytes(start, length);
+}
+
+static void fillRecord(StateJournalRecord* record, const perimeterFilter* filter) {
+    memset(record, 0, sizeof(StateJournalRecord));
+    record->magic = STATE_JOURNAL_MAGIC;
+    record->patternHash = filter->patternHash;
+    record->lastExecutionTime = filter->rateLimiter.lastExecutionTime;
+    record->lastExecutionCount = filter->rateLimiter.lastExecutionCount;
+    record->checksum = recordChecksum(record);
+}
+
+static int openJournalForAppend(void) {
+    if (journalFd >= 0) return journalFd;
+    
+    journalFd = open(STATE_JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (journalFd < 0) {
+        perror("Failed to open state journal");
+    }
+    return journalFd;
+}
+
+// One record per filter, taken while the filters cannot move
+static StateJournalRecord* snapshotRecords(int* count) {
+    readSectionEnter();
+    
+    StateJournalRecord* records = malloc(sizeof(StateJournalRecord) * (size_t)(filterCount ? filterCount : 1));
+    *count = 0;
+    for (int i = 0; records && i < filterCount; i++) {
+        __atomic_store_n(&perimeterFilters[i].journalPending, 0, __ATOMIC_RELAXED);
+        fillRecord(&records[(*count)++], &perimeterFilters[i]);
+    }
+    
+    readSectionLeave();
+    return records;
+}
+
+static int compactLocked(const StateJournalRecord* records, int count) {
+    char tempFile[64];
+    snprintf(tempFile, sizeof(tempFile), "%s.tmp", STATE_JOURNAL_FILE);
+    
+    int fd = open(tempFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    
+    size_t bytes = sizeof(StateJournalRecord) * (size_t)count;
+    if (write(fd, records, bytes) != (ssize_t)bytes) {
+        close(fd);
+        unlink(tempFile);
+        return -1;
+    }
+    
+    if (fsync(fd) < 0 || close(fd) < 0 || rename(tempFile, STATE_JOURNAL_FILE) < 0) {
+        unlink(tempFile);
+        return -1;
+    }
+    
+    if (journalFd >= 0) {
+        close(journalFd);
+        journalFd = -1;
+    }
+    
+    journalRecords = count;
+    journalCompactions++;
+    return openJournalForAppend() >= 0 ? 0 : -1;
+}
+
+static int compact(void) {
+    int count;
+    StateJournalRecord* records = snapshotRecords(&count);
+    if (!records) return -1;
+    
+    pthread_mutex_lock(&journalMutex);
+    int result = compactLocked(records, count);
+    pthread_mutex_unlock(&journalMutex);
+    
+    free(records);
+    return result;
+}
+
+static void appendRecords(const StateJournalRecord* records, int count) {
+    pthread_mutex_lock(&journalMutex);
+    size_t bytes = sizeof(StateJournalRecord) * (size_t)count;
+    if (openJournalForAppend() >= 0 && write(journalFd, records, bytes) == (ssize_t)bytes) {
+        journalRecords += count;
+    }
+    pthread_mutex_unlock(&journalMutex);
+}
+
+// Appends the newest state of every marked filter, so a burst of actions
+// on one filter costs one record
+static void flushPendingRecords(void) {
+    if (!__atomic_exchange_n(&recordsPending, 0, __ATOMIC_ACQUIRE)) return;
+    
+    StateJournalRecord records[JOURNAL_BATCH];
+    int count = 0;
+    
+    readSectionEnter();
+    for (int i = 0; i < filterCount; i++) {
+        if (!__atomic_exchange_n(&perimeterFilters[i].journalPending, 0, __ATOMIC_ACQUIRE)) continue;
+    
+        fillRecord(&records[count++], &perimeterFilters[i]);
+        if (count == JOURNAL_BATCH) {
+            appendRecords(records, count);
+            count = 0;
+        }
+    }
+    readSectionLeave();
+    
+    if (count > 0) {
+        appendRecords(records, count);
+    }
+    
+    if (__atomic_load_n(&journalRecords, __ATOMIC_RELAXED) >= STATE_JOURNAL_COMPACT_THRESHOLD) {
+        compact();
+    }
+}
+
+static void *journalWriterLoop(void *arg) {
+    (void)arg;
+    
+    pthread_mutex_lock(&wakeMutex);
+    while (__atomic_load_n(&writerRunning, __ATOMIC_ACQUIRE)) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += STATE_JOURNAL_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&wakeCond, &wakeMutex, &deadline);
+    
+        pthread_mutex_unlock(&wakeMutex);
+        flushPendingRecords();
+        pthread_mutex_lock(&wakeMutex);
+    }
+    pthread_mutex_unlock(&wakeMutex);
+    
+    return NULL;
+}
+
+static void startJournalWriter(void) {
+    if (writerRunning) return;
+    
+    writerRunning = 1;
+    if (pthread_create(&writerThread, NULL, journalWriterLoop, NULL) != 0) {
+        perror("Failed to create state journal thread, journaling on close only");
+        writerRunning = 0;
+    }
+}
+
+int restoreStateJournal(void) {
+    pthread_mutex_lock(&journalMutex);
+    
+    if (journalFd >= 0) {
+        close(journalFd);
+        journalFd = -1;
+    }
+    journalRecords = 0;
+    
+    int fd = open(STATE_JOURNAL_FILE, O_RDONLY | O_CLOEXEC);
+    char restoredFilters[MAX_FILTERS] = {0};
+    int forceCompaction = 0;
+    
+    if (fd >= 0) {
+        StateJournalRecord records[256];
+        ssize_t bytesRead;
+        off_t fileBytes = 0;
+        
+        while ((bytesRead = read(fd, records, sizeof(records))) > 0) {
+            fileBytes += bytesRead;
+            int recordCount = (int)(bytesRead / sizeof(StateJournalRecord));
+            
+            for (int r = 0; r < recordCount; r++) {
+                const StateJournalRecord* record = &records[r];
+                if (record->magic != STATE_JOURNAL_MAGIC || record->checksum != recordChecksum(record)) {
+                    continue;   // Torn or foreign record
+                }
+                journalRecords++;
+                
+                for (int i = 0; i < filterCount; i++) {
+                    if (perimeterFilters[i].patternHash == record->patternHash) {
+                        RateLimiter* limiter = &perimeterFilters[i].rateLimiter;
+                        limiter->lastExecutionCount = record->lastExecutionCount;
+                        limiter->lastExecutionTime = (time_t)record->lastExecutionTime;
+                        // Count restarts at the last executed count so the
+                        // count difference continues from where it left off
+                        perimeterFilters[i].count = record->lastExecutionCount;
+                        restoredFilters[i] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+        close(fd);
+        
+        // A write cut short by a crash leaves part of a record at the end;
+        // appending after it would misalign every later record
+        off_t tornBytes = fileBytes % (off_t)sizeof(StateJournalRecord);
+        if (tornBytes && truncate(STATE_JOURNAL_FILE, fileBytes - tornBytes) < 0) {
+            perror("Failed to drop torn state journal record");
+            forceCompaction = 1;
+        }
+    }
+    
+    int needsCompaction = forceCompaction || journalRecords > filterCount * 2 ||
+                          journalRecords >= STATE_JOURNAL_COMPACT_THRESHOLD;
+    int result = !needsCompaction && openJournalForAppend() < 0 ? -1 : 0;
+    
+    pthread_mutex_unlock(&journalMutex);
+    
+    if (needsCompaction) {
+        result = compact();
+    }
+    startJournalWriter();
+    
+    int restored = 0;
+    for (int i = 0; i < filterCount; i++) {
+        restored += restoredFilters[i];
+    }
+    
+    if (messagePrintingEnabled && restored > 0) {
+        printf("Restored rate limiter state for %d filters from %s\n", restored, STATE_JOURNAL_FILE);
+    }
+    return result;
+}
+
+void journalFilterState(perimeterFilter* filter) {
+    __atomic_store_n(&filter->journalPending, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&recordsPending, 1, __ATOMIC_RELEASE);
+}
+
+int compactStateJournal(void) {
+    return compact();
+}
+
+void closeStateJournal(void) {
+    if (writerRunning) {
+        pthread_mutex_lock(&wakeMutex);
+        __atomic_store_n(&writerRunning, 0, __ATOMIC_RELEASE);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&wakeMutex);
+        pthread_join(writerThread, NULL);
+    }
+    
+    // Whatever was marked after the writer's last pass
+    flushPendingRecords();
+    
+    pthread_mutex_lock(&journalMutex);
+    if (journalFd >= 0) {
+        close(journalFd);
+        journalFd = -1;
+    }
+    pthread_mutex_unlock(&journalMutex);
+}
+
+void printStateJournalStats(void) {
+    pthread_mutex_lock(&journalMutex);
+    printf("=== State Journal ===\n");
+    printf("File: %s\n", STATE_JOURNAL_FILE);
+    printf("Records: %d (%zu bytes)\n", journalRecords, journalRecords * sizeof(StateJournalRecord));
+    printf("Compaction threshold: %d records\n", STATE_JOURNAL_COMPACT_THRESHOLD);
+    printf("Compactions this session: %d\n", journalCompactions);
+    printf("Writes: coalesced per filter every %d ms on a writer thread\n", STATE_JOURNAL_FLUSH_MS);
+    pthread_mutex_unlock(&journalMutex);
+}
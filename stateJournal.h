@@ -0,0 +1,33 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <stdint.h>
+#include "oscUtility.h"
+
+#define STATE_JOURNAL_FILE "state.journal"
+#define STATE_JOURNAL_MAGIC 0x4f534a31u   // "OSJ1"
+#define STATE_JOURNAL_COMPACT_THRESHOLD 4096
+#define STATE_JOURNAL_FLUSH_MS 100
+
+// Fixed-size append-only record; the newest record for a pattern wins on replay
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum;              // Covers every field after this one
+    uint64_t patternHash;
+    int64_t lastExecutionTime;
+    int32_t lastExecutionCount;
+    int32_t reserved;
+} StateJournalRecord;
+
+// Also starts the writer thread that appends and compacts off the
+// dispatch path
+int restoreStateJournal(void);
+// Marks the filter's limiter state for the writer's next pass; two
+// relaxed stores, safe from any thread
+void journalFilterState(perimeterFilter* filter);
+int compactStateJournal(void);
+// Stops the writer and appends what it had not yet written
+void closeStateJournal(void);
+void printStateJournalStats(void);
+
+#endif
@@ -0,0 +1,351 @@
+#include "stateMachine.h"
+#include "oscUtility.h"
+#include "configCache.h"
+#include "quiescence.h"
+#include <pthread.h>
+
+#define STATE_MACHINE_EVENTS (STATE_MACHINE_MAX_INPUTS * 2)     // on and off per input
+#define TRANSITION_TEXT_LENGTH 256
+#define BINDING_SLOTS 512                                       // Power of two, over twice the inputs
+
+typedef struct {
+    char name[STATE_MACHINE_NAME_LENGTH];
+    int inputCount;
+    char inputNames[STATE_MACHINE_MAX_INPUTS][STATE_MACHINE_NAME_LENGTH];
+    char inputAddresses[STATE_MACHINE_MAX_INPUTS][MAX_PATTERN_LENGTH];
+    int transitionCount;
+    char transitions[STATE_MACHINE_MAX_TRANSITIONS][TRANSITION_TEXT_LENGTH];   // As written in the config
+    
+    // Compiled; invalid machines are kept only to be written back
+    int valid;
+    int stateCount;
+    char stateNames[STATE_MACHINE_MAX_STATES][STATE_MACHINE_NAME_LENGTH];
+    int8_t next[STATE_MACHINE_MAX_STATES][STATE_MACHINE_EVENTS];      // -1: event ignored in this state
+    int8_t action[STATE_MACHINE_MAX_STATES][STATE_MACHINE_EVENTS];    // Transition whose action runs, -1 none
+    const char* actionText[STATE_MACHINE_MAX_TRANSITIONS];            // Points into transitions
+    ParsedAction parsedActions[STATE_MACHINE_MAX_TRANSITIONS];
+    
+    // Runtime, under machineMutex
+    int current;
+    uint32_t inputsOn;
+    uint64_t taken;
+} StateMachine;
+
+typedef struct {
+    uint64_t hash;                  // 0 while empty
+    int16_t machine;
+    int16_t input;
+} MachineBinding;
+
+typedef struct {
+    StateMachine machines[MAX_STATE_MACHINES];
+    int machineCount;
+    MachineBinding bindings[BINDING_SLOTS];
+} StateMachineSet;
+
+// Loads fill the spare set and publish it, like the avatar profile sets
+static StateMachineSet sets[2];
+static StateMachineSet* publishedSet = &sets[0];
+static pthread_mutex_t machineMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t loadMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int findName(char names[][STATE_MACHINE_NAME_LENGTH], int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static int stateIndex(StateMachine* machine, const char* name) {
+    int state = findName(machine->stateNames, machine->stateCount, name);
+    if (state >= 0 || machine->stateCount >= STATE_MACHINE_MAX_STATES) return state;
+    
+    strcpy(machine->stateNames[machine->stateCount], name);
+    return machine->stateCount++;
+}
+
+// Turns the transition texts into the tables; prints why on failure
+static int compileStateMachine(StateMachine* machine) {
+    memset(machine->next, -1, sizeof(machine->next));
+    memset(machine->action, -1, sizeof(machine->action));
+    machine->stateCount = 0;
+    
+    if (!machine->name[0] || machine->inputCount == 0 || machine->transitionCount == 0) {
+        printf("Warning: state machine '%s' needs a name, inputs and transitions\n", machine->name);
+        return -1;
+    }
+    
+    for (int t = 0; t < machine->transitionCount; t++) {
+        const char* text = machine->transitions[t];
+        char from[STATE_MACHINE_NAME_LENGTH], input[STATE_MACHINE_NAME_LENGTH], edge[4], arrow[3];
+        char to[STATE_MACHINE_NAME_LENGTH];
+        int consumed = 0;
+    
+        if (sscanf(text, " %31s %31s %3s %2s %31s %n", from, input, edge, arrow, to, &consumed) < 5 ||
+            strcmp(arrow, "->") != 0 || (strcmp(edge, "on") != 0 && strcmp(edge, "off") != 0)) {
+            printf("Warning: state machine '%s': cannot read transition '%s'\n", machine->name, text);
+            return -1;
+        }
+    
+        int inputIndex = findName(machine->inputNames, machine->inputCount, input);
+        int fromState = stateIndex(machine, from);
+        int toState = stateIndex(machine, to);
+        if (inputIndex < 0 || fromState < 0 || toState < 0) {
+            printf("Warning: state machine '%s': unknown input or too many states in '%s'\n", machine->name, text);
+            return -1;
+        }
+    
+        int event = inputIndex * 2 + (edge[1] == 'f');
+        if (machine->next[fromState][event] >= 0) {
+            printf("Warning: state machine '%s': '%s' repeats an earlier transition\n", machine->name, text);
+            return -1;
+        }
+    
+        machine->next[fromState][event] = (int8_t)toState;
+        machine->actionText[t] = text + consumed;
+        parseAction(machine->actionText[t], &machine->parsedActions[t]);
+        if (machine->parsedActions[t].type != ACTION_NONE) {
+            machine->action[fromState][event] = (int8_t)t;
+        }
+    }
+    
+    machine->current = 0;
+    machine->inputsOn = 0;
+    machine->taken = 0;
+    return 0;
+}
+
+static void bindInputs(StateMachineSet* set) {
+    memset(set->bindings, 0, sizeof(set->bindings));
+    
+    for (int m = 0; m < set->machineCount; m++) {
+        const StateMachine* machine = &set->machines[m];
+        for (int i = 0; machine->valid && i < machine->inputCount; i++) {
+            const char* address = machine->inputAddresses[i];
+            uint64_t hash = hashConfigBytes(address, strlen(address));
+            if (hash == 0) hash = 1;
+    
+            for (int probe = 0; probe < BINDING_SLOTS; probe++) {
+                MachineBinding* binding = &set->bindings[(hash + probe) & (BINDING_SLOTS - 1)];
+                if (binding->hash == 0) {
+                    *binding = (MachineBinding){ .hash = hash, .machine = (int16_t)m, .input = (int16_t)i };
+                    break;
+                }
+            }
+        }
+    }
+}
+
+typedef enum {
+    BLOCK_NONE,
+    BLOCK_INPUTS,
+    BLOCK_TRANSITIONS
+} MachineBlock;
+
+static const char* skipSpaces(const char* text) {
+    while (*text == ' ' || *text == '\t') text++;
+    return text;
+}
+
+int loadStateMachines(const char* path) {
+    FILE* file = fopen(path, "r");
+    
+    // The spare set was unpublished by the previous load; feeds from back
+    // then may still be walking it or running its actions
+    pthread_mutex_lock(&loadMutex);
+    waitForReaders();
+    StateMachineSet* set = publishedSet == &sets[0] ? &sets[1] : &sets[0];
+    set->machineCount = 0;
+    
+    int rejected = 0;
+    int inSection = 0;
+    MachineBlock block = BLOCK_NONE;
+    StateMachine* machine = NULL;
+    char line[1024];
+    
+    while (file && fgets(line, sizeof(line), file)) {
+        const char* text = skipSpaces(line);
+    
+        if (!inSection) {
+            inSection = strstr(line, "\"machines\":") != NULL;
+            continue;
+        }
+    
+        if (block == BLOCK_INPUTS) {
+            char name[STATE_MACHINE_NAME_LENGTH], address[MAX_PATTERN_LENGTH];
+            if (*text == '}') {
+                block = BLOCK_NONE;
+            } else if (sscanf(text, "\"%31[^\"]\": \"%255[^\"]\"", name, address) == 2) {
+                if (machine->inputCount < STATE_MACHINE_MAX_INPUTS) {
+                    strcpy(machine->inputNames[machine->inputCount], name);
+                    strcpy(machine->inputAddresses[machine->inputCount], address);
+                }
+                machine->inputCount++;
+            }
+        } else if (block == BLOCK_TRANSITIONS) {
+            char transition[TRANSITION_TEXT_LENGTH];
+            if (*text == ']') {
+                block = BLOCK_NONE;
+            } else if (sscanf(text, "\"%255[^\"]\"", transition) == 1) {
+                if (machine->transitionCount < STATE_MACHINE_MAX_TRANSITIONS) {
+                    strcpy(machine->transitions[machine->transitionCount], transition);
+                }
+                machine->transitionCount++;
+            }
+        } else if (strstr(text, "\"name\":")) {
+            if (set->machineCount >= MAX_STATE_MACHINES) {
+                printf("Warning: only %d state machines are supported\n", MAX_STATE_MACHINES);
+                break;
+            }
+            machine = &set->machines[set->machineCount];
+            memset(machine, 0, sizeof(StateMachine));
+            sscanf(text, "\"name\": \"%31[^\"]\"", machine->name);
+        } else if (machine && strstr(text, "\"inputs\":")) {
+            block = strchr(text, '}') ? BLOCK_NONE : BLOCK_INPUTS;
+        } else if (machine && strstr(text, "\"transitions\":")) {
+            block = strchr(text, ']') ? BLOCK_NONE : BLOCK_TRANSITIONS;
+        } else if (*text == '}' && machine) {
+            int oversized = machine->inputCount > STATE_MACHINE_MAX_INPUTS ||
+                            machine->transitionCount > STATE_MACHINE_MAX_TRANSITIONS;
+            if (oversized) {
+                printf("Warning: state machine '%s' has over %d inputs or %d transitions\n", machine->name,
+                       STATE_MACHINE_MAX_INPUTS, STATE_MACHINE_MAX_TRANSITIONS);
+                if (machine->inputCount > STATE_MACHINE_MAX_INPUTS) machine->inputCount = STATE_MACHINE_MAX_INPUTS;
+                if (machine->transitionCount > STATE_MACHINE_MAX_TRANSITIONS) {
+                    machine->transitionCount = STATE_MACHINE_MAX_TRANSITIONS;
+                }
+            }
+            machine->valid = !oversized && compileStateMachine(machine) == 0;
+            rejected += !machine->valid;
+            set->machineCount++;
+            machine = NULL;
+        } else if (*text == ']') {
+            break;
+        }
+    }
+    
+    if (file) fclose(file);
+    
+    bindInputs(set);
+    pthread_mutex_lock(&machineMutex);
+    __atomic_store_n(&publishedSet, set, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&machineMutex);
+    pthread_mutex_unlock(&loadMutex);
+    
+    return rejected ? -1 : set->machineCount;
+}
+
+void writeStateMachines(FILE* file) {
+    const StateMachineSet* set = __atomic_load_n(&publishedSet, __ATOMIC_ACQUIRE);
+    if (set->machineCount == 0) return;
+    
+    fprintf(file, "  \"machines\": [\n");
+    for (int m = 0; m < set->machineCount; m++) {
+        const StateMachine* machine = &set->machines[m];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", machine->name);
+        fprintf(file, "      \"inputs\": {\n");
+        for (int i = 0; i < machine->inputCount; i++) {
+            fprintf(file, "        \"%s\": \"%s\"%s\n", machine->inputNames[i], machine->inputAddresses[i],
+                    i < machine->inputCount - 1 ? "," : "");
+        }
+        fprintf(file, "      },\n");
+        fprintf(file, "      \"transitions\": [\n");
+        for (int t = 0; t < machine->transitionCount; t++) {
+            fprintf(file, "        \"%s\"%s\n", machine->transitions[t], t < machine->transitionCount - 1 ? "," : "");
+        }
+        fprintf(file, "      ]\n");
+        fprintf(file, "    }%s\n", m < set->machineCount - 1 ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+}
+
+int stateMachineCount(void) {
+    return __atomic_load_n(&publishedSet, __ATOMIC_ACQUIRE)->machineCount;
+}
+
+void feedStateMachines(const char* address, uint64_t hash, int hasValue, double value) {
+    if (!hasValue || __atomic_load_n(&publishedSet, __ATOMIC_ACQUIRE)->machineCount == 0) return;
+    if (hash == 0) hash = 1;
+    
+    // The set, and the actions it holds, stay valid until the section ends
+    readSectionEnter();
+    StateMachineSet* set = __atomic_load_n(&publishedSet, __ATOMIC_ACQUIRE);
+    
+    // Actions run after the lock is dropped; at most one per binding
+    const ParsedAction* fired[MAX_STATE_MACHINES * STATE_MACHINE_MAX_INPUTS];
+    const char* firedText[MAX_STATE_MACHINES * STATE_MACHINE_MAX_INPUTS];
+    int firedCount = 0;
+    int on = value != 0.0;
+    
+    for (int probe = 0; probe < BINDING_SLOTS; probe++) {
+        const MachineBinding* binding = &set->bindings[(hash + probe) & (BINDING_SLOTS - 1)];
+        if (binding->hash == 0) break;
+        if (binding->hash != hash) continue;
+    
+        StateMachine* machine = &set->machines[binding->machine];
+        if (strcmp(machine->inputAddresses[binding->input], address) != 0) continue;
+    
+        uint32_t bit = 1u << binding->input;
+        int event = binding->input * 2 + !on;
+    
+        pthread_mutex_lock(&machineMutex);
+        if (((machine->inputsOn & bit) != 0) != on) {
+            machine->inputsOn ^= bit;
+            int next = machine->next[machine->current][event];
+            if (next >= 0) {
+                int action = machine->action[machine->current][event];
+                if (action >= 0) {
+                    fired[firedCount] = &machine->parsedActions[action];
+                    firedText[firedCount++] = machine->actionText[action];
+                }
+                machine->current = next;
+                machine->taken++;
+            }
+        }
+        pthread_mutex_unlock(&machineMutex);
+    }
+    
+    for (int f = 0; f < firedCount; f++) {
+        executeParsedAction(fired[f], firedText[f]);
+    }
+    readSectionLeave();
+}
+
+void resetStateMachines(void) {
+    pthread_mutex_lock(&machineMutex);
+    StateMachineSet* set = publishedSet;
+    for (int m = 0; m < set->machineCount; m++) {
+        set->machines[m].current = 0;
+        set->machines[m].inputsOn = 0;
+    }
+    pthread_mutex_unlock(&machineMutex);
+    printf("State machines back in their initial states\n");
+}
+
+void listStateMachines(void) {
+    StateMachineSet* set = __atomic_load_n(&publishedSet, __ATOMIC_ACQUIRE);
+    if (set->machineCount == 0) {
+        printf("No state machines configured (\"machines\" in %s)\n", CONFIG_FILE);
+        return;
+    }
+    
+    pthread_mutex_lock(&machineMutex);
+    for (int m = 0; m < set->machineCount; m++) {
+        const StateMachine* machine = &set->machines[m];
+        if (!machine->valid) {
+            printf("%s: invalid, ignored\n", machine->name);
+            continue;
+        }
+        printf("%s: state %s, %d states, %llu transitions taken\n", machine->name,
+               machine->stateNames[machine->current], machine->stateCount, (unsigned long long)machine->taken);
+        for (int i = 0; i < machine->inputCount; i++) {
+            printf("  %-12s %-40s %s\n", machine->inputNames[i], machine->inputAddresses[i],
+                   (machine->inputsOn >> i) & 1 ? "on" : "off");
+        }
+        for (int t = 0; t < machine->transitionCount; t++) {
+            printf("  %s\n", machine->transitions[t]);
+        }
+    }
+    pthread_mutex_unlock(&machineMutex);
+}
@@ -0,0 +1,51 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define MAX_STATE_MACHINES 16
+#define STATE_MACHINE_MAX_INPUTS 16
+#define STATE_MACHINE_MAX_STATES 32
+#define STATE_MACHINE_MAX_TRANSITIONS 64
+#define STATE_MACHINE_NAME_LENGTH 32
+
+// Machines are declared in config.json next to the filters:
+//
+//   "machines": [
+//     {
+//       "name": "grabCopy",
+//       "inputs": {
+//         "A": "/avatar/parameters/A",
+//         "B": "/avatar/parameters/B"
+//       },
+//       "transitions": [
+//         "idle A on -> armed",
+//         "armed A off -> idle",
+//         "armed B on -> idle @copy"
+//       ]
+//     }
+//   ]
+//
+// An input is on while its value is nonzero; its edges are the events. A
+// transition "<state> <input> on|off -> <state> [action]" runs the action
+// (any filter action) when taken. The first state named is the initial one.
+// Each machine compiles to a dense next-state and action table indexed by
+// state and event, so the dispatcher does a hash probe and a table load
+
+// Replaces every machine with the ones in the config file; all of them
+// restart from their initial state. Returns the number loaded, or -1 when
+// a machine was rejected (the others still load)
+int loadStateMachines(const char* path);
+// Writes the "machines" section back in the form it was loaded from
+void writeStateMachines(FILE* file);
+int stateMachineCount(void);
+
+// Feeds one parameter update; hash is hashConfigBytes of the address.
+// Costs one load when no machine exists
+void feedStateMachines(const char* address, uint64_t hash, int hasValue, double value);
+
+void resetStateMachines(void);
+void listStateMachines(void);
+
+#endif
@@ -0,0 +1,165 @@
+#include "timerWheel.h"
+#include "eventLoop.h"
+#include "metrics.h"
+#include <pthread.h>
+
+#define TICK_NS ((uint64_t)TIMER_WHEEL_TICK_MS * 1000000ULL)
+
+typedef struct {
+    int next;                       // Next entry in the slot or free list, -1 ends it
+    uint32_t rounds;                // Full turns left before it is due
+    TimerWheelCallback callback;
+    int owner;
+    uint32_t token;
+} WheelEntry;
+
+// A hashed wheel: an entry sits in the slot its deadline falls into and is
+// skipped for each full turn still ahead of it, so scheduling and each
+// tick are O(1) plus the entries actually due
+static WheelEntry entries[TIMER_WHEEL_CAPACITY];
+static int slots[TIMER_WHEEL_SLOTS];
+static int freeList = -1;
+static int initialized = 0;
+static uint64_t cursor = 0;         // Ticks processed
+static uint64_t baseNs = 0;         // When tick 0 was, while the wheel runs
+static int tickTimer = -1;
+static pthread_mutex_t wheelMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int pendingCount = 0;
+static uint64_t scheduledCount = 0;
+static uint64_t firedCount = 0;
+static uint64_t droppedCount = 0;
+
+// Caller holds wheelMutex
+static void initializeWheel(void) {
+    for (int s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+        slots[s] = -1;
+    }
+    for (int e = 0; e < TIMER_WHEEL_CAPACITY; e++) {
+        entries[e].next = e + 1 < TIMER_WHEEL_CAPACITY ? e + 1 : -1;
+    }
+    freeList = 0;
+    initialized = 1;
+}
+
+static void tickWheel(void* context) {
+    (void)context;
+    int due = -1;
+    
+    pthread_mutex_lock(&wheelMutex);
+    
+    // Timer expirations can coalesce, so catch up from the clock rather
+    // than counting callbacks
+    uint64_t target = (metricsNowNs() - baseNs) / TICK_NS;
+    while (cursor < target) {
+        cursor++;
+        int* link = &slots[cursor & (TIMER_WHEEL_SLOTS - 1)];
+        while (*link >= 0) {
+            WheelEntry* entry = &entries[*link];
+            if (entry->rounds > 0) {
+                entry->rounds--;
+                link = &entry->next;
+                continue;
+            }
+            int id = *link;
+            *link = entry->next;
+            entry->next = due;
+            due = id;
+        }
+    }
+    
+    pthread_mutex_unlock(&wheelMutex);
+    
+    // Callbacks run unlocked so they may schedule again
+    int last = -1;
+    for (int id = due; id >= 0; id = entries[id].next) {
+        entries[id].callback(entries[id].owner, entries[id].token);
+        last = id;
+    }
+    
+    pthread_mutex_lock(&wheelMutex);
+    if (last >= 0) {
+        for (int id = due; id >= 0; id = entries[id].next) {
+            pendingCount--;
+            firedCount++;
+        }
+        entries[last].next = freeList;
+        freeList = due;
+    }
+    if (pendingCount == 0 && tickTimer >= 0) {
+        eventLoopCancelTimer(tickTimer);
+        tickTimer = -1;
+    }
+    pthread_mutex_unlock(&wheelMutex);
+}
+
+int timerWheelSchedule(uint32_t delayMs, TimerWheelCallback callback, int owner, uint32_t token) {
+    pthread_mutex_lock(&wheelMutex);
+    if (!initialized) initializeWheel();
+    
+    if (freeList < 0) {
+        droppedCount++;
+        pthread_mutex_unlock(&wheelMutex);
+        return -1;
+    }
+    
+    if (tickTimer < 0) {
+        // Idle wheels have no timer; restart the clock where the cursor is
+        baseNs = metricsNowNs() - cursor * TICK_NS;
+        tickTimer = eventLoopAddTimer(TICK_NS, TICK_NS, tickWheel, NULL);
+        if (tickTimer < 0) {
+            droppedCount++;
+            pthread_mutex_unlock(&wheelMutex);
+            return -1;
+        }
+    }
+    
+    // Due on the first tick at or after the deadline; the current tick has
+    // partly elapsed, so one more keeps it from firing early
+    uint64_t ticks = (delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS + 1;
+    
+    int id = freeList;
+    WheelEntry* entry = &entries[id];
+    freeList = entry->next;
+    entry->rounds = (uint32_t)((ticks - 1) / TIMER_WHEEL_SLOTS);
+    entry->callback = callback;
+    entry->owner = owner;
+    entry->token = token;
+    
+    int* slot = &slots[(cursor + ticks) & (TIMER_WHEEL_SLOTS - 1)];
+    entry->next = *slot;
+    *slot = id;
+    pendingCount++;
+    scheduledCount++;
+    
+    pthread_mutex_unlock(&wheelMutex);
+    return 0;
+}
+
+void timerWheelClear(void) {
+    pthread_mutex_lock(&wheelMutex);
+    // Entries a tick has already taken out are left to it
+    for (int s = 0; initialized && s < TIMER_WHEEL_SLOTS; s++) {
+        while (slots[s] >= 0) {
+            int id = slots[s];
+            slots[s] = entries[id].next;
+            entries[id].next = freeList;
+            freeList = id;
+            pendingCount--;
+        }
+    }
+    if (pendingCount == 0 && tickTimer >= 0) {
+        eventLoopCancelTimer(tickTimer);
+        tickTimer = -1;
+    }
+    pthread_mutex_unlock(&wheelMutex);
+}
+
+void timerWheelGetStats(TimerWheelStats* stats) {
+    pthread_mutex_lock(&wheelMutex);
+    stats->pending = pendingCount;
+    stats->scheduled = scheduledCount;
+    stats->fired = firedCount;
+    stats->dropped = droppedCount;
+    pthread_mutex_unlock(&wheelMutex);
+}
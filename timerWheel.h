@@ -0,0 +1,31 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_SLOTS 256               // Power of two
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_CAPACITY 4096           // Pending entries
+
+// owner and token come back as given; owners bump their token to make an
+// entry stale instead of cancelling it
+typedef void (*TimerWheelCallback)(int owner, uint32_t token);
+
+typedef struct {
+    int pending;
+    uint64_t scheduled;
+    uint64_t fired;
+    uint64_t dropped;                       // Wheel full or no event loop to tick it
+} TimerWheelStats;
+
+// Runs callback on the event loop thread after at least delayMs, rounded
+// up to whole ticks. Safe from any thread. One event loop timer ticks the
+// wheel, and only while entries are pending. Returns -1 when the entry
+// could not be scheduled
+int timerWheelSchedule(uint32_t delayMs, TimerWheelCallback callback, int owner, uint32_t token);
+// Drops every pending entry without running it
+void timerWheelClear(void);
+
+void timerWheelGetStats(TimerWheelStats* stats);
+
+#endif
@@ -0,0 +1,340 @@
+#include "trace.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#define TRACE_MAX_THREADS MAX_METRICS_THREADS
+#define TRACE_PACKET_SPANS 64                // Spans buffered per sampled packet
+
+typedef struct {
+    LatencyHistogram stages[TRACE_STAGE_COUNT];
+} TraceThreadSlot;
+
+typedef struct {
+    uint64_t packet;
+    uint64_t startNs;
+    uint64_t endNs;
+    uint32_t threadId;
+    uint16_t stage;
+} TraceSpan;
+
+// Timeline of the packet the current thread is processing
+typedef struct {
+    int active;
+    int sampled;
+    uint64_t packet;
+    uint64_t originNs;                        // Kernel receive, on the monotonic clock
+    uint64_t lastLapNs;
+    uint64_t stageNs[TRACE_STAGE_COUNT];
+    uint32_t stagesSeen;
+    int spanCount;
+    TraceSpan spans[TRACE_PACKET_SPANS];
+} PacketTrace;
+
+static const char* stageNames[TRACE_STAGE_COUNT] = {
+    "socket", "queue", "parse", "match", "rate", "execute", "output", "total"
+};
+
+int tracingEnabled = 1;
+
+static TraceThreadSlot threadSlots[TRACE_MAX_THREADS];
+static int threadSlotCount = 0;
+static __thread TraceThreadSlot* localSlot = NULL;
+static __thread int localShared = 0;        // localSlot is the overflow slot
+static __thread PacketTrace packetTrace;
+static __thread uint32_t localThreadId = 0;
+
+static pthread_mutex_t recordMutex = PTHREAD_MUTEX_INITIALIZER;
+static int recording = 0;
+static int recordSampleEvery = TRACE_DEFAULT_SAMPLE;
+static char recordPath[256];
+static TraceSpan* recordedSpans = NULL;
+static int recordedSpanCount = 0;
+static uint64_t recordStartNs = 0;
+static uint64_t recordPacketCounter = 0;
+static uint64_t droppedSpans = 0;
+
+static TraceThreadSlot* currentSlot(void) {
+    if (!localSlot) {
+        int index = __atomic_fetch_add(&threadSlotCount, 1, __ATOMIC_RELAXED);
+        if (index >= TRACE_MAX_THREADS - 1) {
+            index = TRACE_MAX_THREADS - 1;
+            localShared = 1;
+        }
+        localSlot = &threadSlots[index];
+    }
+    return localSlot;
+}
+
+static uint32_t currentThreadId(void) {
+    if (!localThreadId) {
+        localThreadId = (uint32_t)syscall(SYS_gettid);
+    }
+    return localThreadId;
+}
+
+static uint64_t realtimeNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void addSpan(TraceStage stage, uint64_t startNs, uint64_t endNs) {
+    if (!packetTrace.sampled || packetTrace.spanCount >= TRACE_PACKET_SPANS) return;
+    
+    TraceSpan* span = &packetTrace.spans[packetTrace.spanCount++];
+    span->packet = packetTrace.packet;
+    span->startNs = startNs;
+    span->endNs = endNs;
+    span->threadId = currentThreadId();
+    span->stage = (uint16_t)stage;
+}
+
+static void addStage(TraceStage stage, uint64_t startNs, uint64_t endNs) {
+    packetTrace.stageNs[stage] += endNs - startNs;
+    packetTrace.stagesSeen |= 1u << stage;
+    addSpan(stage, startNs, endNs);
+}
+
+uint64_t traceReceiveOrigin(uint64_t kernelRealtimeNs, uint64_t receivedNs) {
+    if (!kernelRealtimeNs) return 0;
+    
+    // The kernel stamps CLOCK_REALTIME; convert the wait into an offset
+    // on the monotonic clock the other stages use
+    uint64_t socketNs = 0;
+    uint64_t realNow = realtimeNowNs();
+    if (realNow > kernelRealtimeNs) {
+        socketNs = realNow - kernelRealtimeNs;
+    }
+    return receivedNs - socketNs;
+}
+
+void traceBeginQueuedPacket(uint64_t originNs, uint64_t receivedNs) {
+    if (!tracingEnabled) {
+        packetTrace.active = 0;
+        return;
+    }
+    
+    packetTrace.active = 1;
+    packetTrace.sampled = 0;
+    packetTrace.originNs = originNs ? originNs : receivedNs;
+    packetTrace.lastLapNs = receivedNs;
+    memset(packetTrace.stageNs, 0, sizeof(packetTrace.stageNs));
+    packetTrace.stagesSeen = 0;
+    packetTrace.spanCount = 0;
+    
+    if (__atomic_load_n(&recording, __ATOMIC_ACQUIRE)) {
+        uint64_t packet = __atomic_fetch_add(&recordPacketCounter, 1, __ATOMIC_RELAXED);
+        if (packet % (uint64_t)recordSampleEvery == 0) {
+            packetTrace.sampled = 1;
+            packetTrace.packet = packet;
+        }
+    }
+    
+    if (originNs) {
+        addStage(TRACE_STAGE_SOCKET, packetTrace.originNs, receivedNs);
+    }
+}
+
+uint64_t traceBeginPacket(uint64_t kernelRealtimeNs) {
+    if (!tracingEnabled) {
+        packetTrace.active = 0;
+        return 0;
+    }
+    
+    uint64_t now = metricsNowNs();
+    traceBeginQueuedPacket(traceReceiveOrigin(kernelRealtimeNs, now), now);
+    return now;
+}
+
+void traceLap(TraceStage stage) {
+    if (!packetTrace.active) return;
+    
+    uint64_t now = metricsNowNs();
+    addStage(stage, packetTrace.lastLapNs, now);
+    packetTrace.lastLapNs = now;
+}
+
+void traceOutputEvent(void) {
+    if (!packetTrace.active || (packetTrace.stagesSeen & (1u << TRACE_STAGE_OUTPUT))) return;
+    
+    uint64_t now = metricsNowNs();
+    packetTrace.stageNs[TRACE_STAGE_OUTPUT] = now - packetTrace.originNs;
+    packetTrace.stagesSeen |= 1u << TRACE_STAGE_OUTPUT;
+    addSpan(TRACE_STAGE_OUTPUT, now, now);
+}
+
+void traceEndPacket(void) {
+    if (!packetTrace.active) return;
+    packetTrace.active = 0;
+    
+    uint64_t now = metricsNowNs();
+    packetTrace.stageNs[TRACE_STAGE_TOTAL] = now - packetTrace.originNs;
+    packetTrace.stagesSeen |= 1u << TRACE_STAGE_TOTAL;
+    
+    TraceThreadSlot* slot = currentSlot();
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        if (packetTrace.stagesSeen & (1u << stage)) {
+            if (localShared) {
+                histogramRecordShared(&slot->stages[stage], packetTrace.stageNs[stage]);
+            } else {
+                histogramRecord(&slot->stages[stage], packetTrace.stageNs[stage]);
+            }
+        }
+    }
+    
+    if (!packetTrace.sampled) return;
+    addSpan(TRACE_STAGE_TOTAL, packetTrace.originNs, now);
+    
+    pthread_mutex_lock(&recordMutex);
+    if (recording && recordedSpans) {
+        for (int i = 0; i < packetTrace.spanCount; i++) {
+            if (recordedSpanCount >= TRACE_MAX_SPANS) {
+                droppedSpans += (uint64_t)(packetTrace.spanCount - i);
+                break;
+            }
+            recordedSpans[recordedSpanCount++] = packetTrace.spans[i];
+        }
+    }
+    pthread_mutex_unlock(&recordMutex);
+}
+
+int traceStartRecording(const char* path, int sampleEvery) {
+    pthread_mutex_lock(&recordMutex);
+    if (recording) {
+        pthread_mutex_unlock(&recordMutex);
+        printf("Trace recording already running (%s)\n", recordPath);
+        return -1;
+    }
+    
+    recordedSpans = malloc(sizeof(TraceSpan) * TRACE_MAX_SPANS);
+    if (!recordedSpans) {
+        pthread_mutex_unlock(&recordMutex);
+        printf("Failed to allocate trace buffer\n");
+        return -1;
+    }
+    
+    snprintf(recordPath, sizeof(recordPath), "%s", path);
+    recordSampleEvery = sampleEvery > 0 ? sampleEvery : TRACE_DEFAULT_SAMPLE;
+    recordedSpanCount = 0;
+    droppedSpans = 0;
+    recordPacketCounter = 0;
+    recordStartNs = metricsNowNs();
+    __atomic_store_n(&recording, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&recordMutex);
+    
+    printf("Recording 1 in %d packets to %s\n", recordSampleEvery, recordPath);
+    return 0;
+}
+
+static double relativeMicros(uint64_t ns) {
+    return ns > recordStartNs ? (ns - recordStartNs) / 1000.0 : 0.0;
+}
+
+// Chrome trace event format: one complete ("X") event per packet with its
+// stages nested inside, plus an instant event for the first output event
+static int writeChromeTrace(void) {
+    FILE* file = fopen(recordPath, "w");
+    if (!file) {
+        perror("Failed to write trace file");
+        return -1;
+    }
+    
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"osc_utility\"}}");
+    
+    for (int i = 0; i < recordedSpanCount; i++) {
+        const TraceSpan* span = &recordedSpans[i];
+        const char* name = span->stage == TRACE_STAGE_TOTAL ? "packet" : stageNames[span->stage];
+    
+        if (span->stage == TRACE_STAGE_OUTPUT) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"osc\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                          "\"pid\":1,\"tid\":%u,\"args\":{\"packet\":%llu}}",
+                    name, relativeMicros(span->startNs), span->threadId, (unsigned long long)span->packet);
+        } else {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"osc\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"pid\":1,\"tid\":%u,\"args\":{\"packet\":%llu}}",
+                    name, relativeMicros(span->startNs), (span->endNs - span->startNs) / 1000.0,
+                    span->threadId, (unsigned long long)span->packet);
+        }
+    }
+    
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return 0;
+}
+
+int traceStopRecording(void) {
+    pthread_mutex_lock(&recordMutex);
+    if (!recording) {
+        pthread_mutex_unlock(&recordMutex);
+        return -1;
+    }
+    
+    __atomic_store_n(&recording, 0, __ATOMIC_RELEASE);
+    int result = writeChromeTrace();
+    if (result == 0) {
+        printf("Wrote %d trace spans to %s", recordedSpanCount, recordPath);
+        if (droppedSpans) {
+            printf(" (%llu dropped, buffer full)", (unsigned long long)droppedSpans);
+        }
+        printf("\n");
+    }
+    
+    free(recordedSpans);
+    recordedSpans = NULL;
+    recordedSpanCount = 0;
+    pthread_mutex_unlock(&recordMutex);
+    return result;
+}
+
+int isTraceRecording(void) {
+    return __atomic_load_n(&recording, __ATOMIC_ACQUIRE);
+}
+
+void traceStageHistogram(TraceStage stage, LatencyHistogram* into) {
+    histogramReset(into);
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        histogramMerge(into, &threadSlots[i].stages[stage]);
+    }
+}
+
+const char* traceStageName(TraceStage stage) {
+    return stage < TRACE_STAGE_COUNT ? stageNames[stage] : "unknown";
+}
+
+// Racy against recording threads, like metricsReset
+void traceReset(void) {
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        memset(&threadSlots[i], 0, sizeof(TraceThreadSlot));
+    }
+}
+
+void printTraceStats(void) {
+    static LatencyHistogram histogram;
+    
+    printf("=== Packet Latency by Stage ===\n");
+    printf("Tracing: %s", tracingEnabled ? "ENABLED" : "DISABLED");
+    if (isTraceRecording()) {
+        printf(", recording 1 in %d packets to %s (%d spans)", recordSampleEvery, recordPath, recordedSpanCount);
+    }
+    printf("\n\n");
+    
+    printf("%-16s %-10s %-10s %-10s %-10s %-10s %s\n", "Stage", "Samples", "p50", "p90", "p99", "p99.9", "Max");
+    printf("%-16s %-10s %-10s %-10s %-10s %-10s %s\n", "-----", "-------", "---", "---", "---", "-----", "---");
+    
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        traceStageHistogram((TraceStage)stage, &histogram);
+        printHistogramRow(stageNames[stage], &histogram);
+    }
+    
+    traceStageHistogram(TRACE_STAGE_SOCKET, &histogram);
+    if (histogram.totalCount == 0) {
+        printf("\nNo kernel receive timestamps yet; socket and totals start at recvmsg\n");
+    }
+}
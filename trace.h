@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "histogram.h"
+
+#define TRACE_MAX_SPANS 65536               // Recorded spans kept for a Chrome trace export
+#define TRACE_DEFAULT_SAMPLE 100            // Record every Nth packet
+
+// Stages tile a packet's timeline: each lap closes the stage that has
+// been running since the previous lap
+typedef enum {
+    TRACE_STAGE_SOCKET,     // Kernel receive timestamp (SO_TIMESTAMPNS) to recvmsg return
+    TRACE_STAGE_QUEUE,      // recvmsg return to the start of packet processing (incl. dispatch queue wait)
+    TRACE_STAGE_PARSE,      // OSC/bundle decoding
+    TRACE_STAGE_MATCH,      // Filter lookup
+    TRACE_STAGE_RATE,       // Rate limiter checks
+    TRACE_STAGE_EXECUTE,    // Action dispatch
+    TRACE_STAGE_OUTPUT,     // Kernel receive to the first output event (not a lap)
+    TRACE_STAGE_TOTAL,      // Kernel receive to the end of processing (not a lap)
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+extern int tracingEnabled;
+
+// Returns the monotonic receive time; kernelRealtimeNs is 0 when the
+// datagram carried no timestamp
+uint64_t traceBeginPacket(uint64_t kernelRealtimeNs);
+// Packets handed to another thread: the receiver converts the kernel
+// timestamp at receive time, the dispatcher begins the trace with it so
+// the queue lap covers the handoff
+uint64_t traceReceiveOrigin(uint64_t kernelRealtimeNs, uint64_t receivedNs);
+void traceBeginQueuedPacket(uint64_t originNs, uint64_t receivedNs);
+void traceLap(TraceStage stage);
+void traceOutputEvent(void);
+void traceEndPacket(void);
+
+int traceStartRecording(const char* path, int sampleEvery);
+int traceStopRecording(void);
+int isTraceRecording(void);
+
+void traceStageHistogram(TraceStage stage, LatencyHistogram* into);
+const char* traceStageName(TraceStage stage);
+void traceReset(void);
+void printTraceStats(void);
+
+#endif
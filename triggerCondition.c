@@ -0,0 +1,128 @@
+#include "triggerCondition.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+
+#define STATE_UNKNOWN 0
+#define STATE_OUTSIDE 1
+#define STATE_INSIDE 2
+
+static const char* skipSpaces(const char* text) {
+    while (isspace((unsigned char)*text)) text++;
+    return text;
+}
+
+// Parses one number; rest points past it and any spaces
+static int parseNumber(const char* text, double* value, const char** rest) {
+    char* end;
+    *value = strtod(text, &end);
+    if (end == text) return -1;
+    
+    *rest = skipSpaces(end);
+    return 0;
+}
+
+static int parseLevel(const char* text, TriggerCondition* condition) {
+    text = skipSpaces(text);
+    condition->low = -INFINITY;
+    condition->high = INFINITY;
+    condition->lowOpen = 0;
+    condition->highOpen = 0;
+    condition->negate = 0;
+    
+    if (strcasecmp(text, "true") == 0) {
+        condition->low = condition->high = 1.0;
+        return 0;
+    }
+    if (strcasecmp(text, "false") == 0) {
+        condition->low = condition->high = 0.0;
+        return 0;
+    }
+    
+    double value;
+    const char* rest;
+    
+    if (strncmp(text, "==", 2) == 0 || strncmp(text, "!=", 2) == 0) {
+        condition->negate = text[0] == '!';
+        if (parseNumber(skipSpaces(text + 2), &value, &rest) < 0 || *rest) return -1;
+        condition->low = condition->high = value;
+        return 0;
+    }
+    
+    if (text[0] == '>' || text[0] == '<') {
+        int inclusive = text[1] == '=';
+        if (parseNumber(skipSpaces(text + 1 + inclusive), &value, &rest) < 0 || *rest) return -1;
+        if (text[0] == '>') {
+            condition->low = value;
+            condition->lowOpen = !inclusive;
+        } else {
+            condition->high = value;
+            condition->highOpen = !inclusive;
+        }
+        return 0;
+    }
+    
+    if (text[0] == '!') {
+        condition->negate = 1;
+        text = skipSpaces(text + 1);
+    }
+    
+    // strtod would read "1..2" as "1." followed by ".2", so the low bound
+    // must end exactly at the separator
+    const char* separator = strstr(text, "..");
+    double high;
+    if (!separator || parseNumber(text, &value, &rest) < 0) return -1;
+    if (rest != separator && !(rest == separator + 1 && rest[-1] == '.')) return -1;
+    if (parseNumber(skipSpaces(separator + 2), &high, &rest) < 0 || *rest || high < value) return -1;
+    condition->low = value;
+    condition->high = high;
+    return 0;
+}
+
+int compileTriggerCondition(const char* text, TriggerCondition* condition) {
+    TriggerCondition compiled;
+    memset(&compiled, 0, sizeof(compiled));
+    text = skipSpaces(text ? text : "");
+    
+    if (*text == '\0' || strcasecmp(text, "any") == 0) {
+        compiled.kind = TRIGGER_ALWAYS;
+    } else if (strncasecmp(text, "rising", 6) == 0 || strncasecmp(text, "falling", 7) == 0) {
+        int rising = tolower((unsigned char)text[0]) == 'r';
+        const char* level = skipSpaces(text + (rising ? 6 : 7));
+        compiled.kind = rising ? TRIGGER_RISING : TRIGGER_FALLING;
+        if (parseLevel(*level ? level : ">=0.5", &compiled) < 0) return -1;
+    } else {
+        compiled.kind = TRIGGER_LEVEL;
+        if (parseLevel(text, &compiled) < 0) return -1;
+    }
+    
+    *condition = compiled;
+    return 0;
+}
+
+int evaluateTriggerCondition(TriggerCondition* condition, int hasValue, double value) {
+    if (condition->kind == TRIGGER_ALWAYS) return 1;
+    if (!hasValue) return 0;
+    
+    int inside = (condition->lowOpen ? value > condition->low : value >= condition->low) &&
+                 (condition->highOpen ? value < condition->high : value <= condition->high);
+    inside ^= condition->negate;
+    
+    if (condition->kind == TRIGGER_LEVEL) return inside;
+    
+    // An unknown previous state counts as outside: the first press after
+    // startup fires even if the idle value was never sent, while a release
+    // needs a press seen first
+    int state = inside ? STATE_INSIDE : STATE_OUTSIDE;
+    int previous = __atomic_exchange_n(&condition->state, state, __ATOMIC_RELAXED);
+    if (previous == STATE_UNKNOWN) previous = STATE_OUTSIDE;
+    if (previous == state) return 0;
+    
+    return condition->kind == TRIGGER_RISING ? inside : !inside;
+}
+
+void resetTriggerCondition(TriggerCondition* condition) {
+    __atomic_store_n(&condition->state, STATE_UNKNOWN, __ATOMIC_RELAXED);
+}
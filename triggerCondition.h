@@ -0,0 +1,38 @@
+#ifndef TRIGGER_CONDITION_H
+#define TRIGGER_CONDITION_H
+
+#include <stdint.h>
+
+#define MAX_CONDITION_LENGTH 64
+
+typedef enum {
+    TRIGGER_ALWAYS,                 // No condition; every match fires
+    TRIGGER_LEVEL,                  // Value inside the range
+    TRIGGER_RISING,                 // Value entered the range
+    TRIGGER_FALLING                 // Value left the range
+} TriggerKind;
+
+// Every comparison compiles to one range test, so evaluating a condition
+// is two compares and an optional edge check, with no parsing per packet
+typedef struct {
+    uint8_t kind;
+    uint8_t negate;                 // Range is the excluded part ("!=", "!a..b")
+    uint8_t lowOpen;
+    uint8_t highOpen;
+    int state;                      // Edge conditions: 0 unknown, 1 outside, 2 inside
+    double low;
+    double high;
+} TriggerCondition;
+
+// Text forms, with optional spaces:
+//   any | true | false | ==v | !=v | >v | >=v | <v | <=v | a..b | !a..b
+//   rising [level] | falling [level]     level defaults to ">=0.5"
+// Returns -1 when the text is not a condition
+int compileTriggerCondition(const char* text, TriggerCondition* condition);
+// hasValue is 0 when the message carried no numeric first argument; only
+// TRIGGER_ALWAYS passes then. Edge state updates atomically, so receivers
+// on several threads can share a filter
+int evaluateTriggerCondition(TriggerCondition* condition, int hasValue, double value);
+void resetTriggerCondition(TriggerCondition* condition);
+
+#endif
@@ -0,0 +1,371 @@
+#include "uringIngest.h"
+#include "socket.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_BUFFER_STRIDE (URING_BUFFER_SIZE + 1)   // Room to NUL-terminate a full payload
+#define URING_BUFFERS_SIZE ((size_t)URING_BUFFER_COUNT * URING_BUFFER_STRIDE)
+#define URING_RECEIVE_TAG 1
+#define URING_WAIT_TIMEOUT_MS 100
+#define URING_MAX_RINGS 16                            // Stats slots; extra rings share the last
+
+// Raw syscalls; liburing is not a dependency
+static int ioUringSetup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                        void* arg, size_t argSize) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+typedef struct {
+    int ringFd;
+    int sockfd;
+    int armed;
+    
+    // Submission queue, shared with the kernel
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    struct io_uring_sqe* sqes;
+    
+    // Completion queue, shared with the kernel
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+    
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+    
+    struct io_uring_buf_ring* bufferRing;
+    size_t bufferRingSize;
+    char* buffers;
+    unsigned short bufferTail;
+    
+    // Sizes the kernel reserves for the source address and control data
+    // at the front of every provided buffer
+    struct msghdr messageTemplate;
+    
+    UringIngestStats* stats;
+} UringIngest;
+
+// One ring per receiving thread; counters live in shared slots so they
+// outlive the thread and are merged on read
+static __thread UringIngest ring = { .ringFd = -1 };
+static UringIngestStats ringStats[URING_MAX_RINGS];
+static int ringStatsCount = 0;
+
+static void statAdd(uint64_t* counter) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+static void provideBuffer(unsigned short id) {
+    struct io_uring_buf* entry = &ring.bufferRing->bufs[ring.bufferTail & (URING_BUFFER_COUNT - 1)];
+    entry->addr = (uint64_t)(uintptr_t)(ring.buffers + (size_t)id * URING_BUFFER_STRIDE);
+    entry->len = URING_BUFFER_SIZE;
+    entry->bid = id;
+    ring.bufferTail++;
+}
+
+static void publishBuffers(void) {
+    __atomic_store_n(&ring.bufferRing->tail, ring.bufferTail, __ATOMIC_RELEASE);
+}
+
+static int armReceive(void) {
+    unsigned tail = *ring.sqTail;
+    unsigned index = tail & *ring.sqMask;
+    
+    struct io_uring_sqe* sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = ring.sockfd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring.messageTemplate;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_RECEIVE_TAG;
+    
+    ring.sqArray[index] = index;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    
+    if (ioUringEnter(ring.ringFd, 1, 0, 0, NULL, 0) < 0) {
+        return -1;
+    }
+    ring.armed = 1;
+    return 0;
+}
+
+static int mapRings(struct io_uring_params* params) {
+    ring.sqRingSize = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    ring.cqRingSize = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    
+    // Newer kernels share one mapping between both rings
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring.cqRingSize > ring.sqRingSize) ring.sqRingSize = ring.cqRingSize;
+        ring.cqRingSize = 0;
+    }
+    
+    ring.sqRing = mmap(NULL, ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring.ringFd, IORING_OFF_SQ_RING);
+    if (ring.sqRing == MAP_FAILED) {
+        ring.sqRing = NULL;
+        return -1;
+    }
+    
+    ring.cqRing = ring.sqRing;
+    if (ring.cqRingSize) {
+        ring.cqRing = mmap(NULL, ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring.ringFd, IORING_OFF_CQ_RING);
+        if (ring.cqRing == MAP_FAILED) {
+            ring.cqRing = NULL;
+            return -1;
+        }
+    }
+    
+    ring.sqesSize = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring.ringFd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) {
+        ring.sqes = NULL;
+        return -1;
+    }
+    
+    char* sq = ring.sqRing;
+    ring.sqTail = (unsigned*)(sq + params->sq_off.tail);
+    ring.sqMask = (unsigned*)(sq + params->sq_off.ring_mask);
+    ring.sqArray = (unsigned*)(sq + params->sq_off.array);
+    
+    char* cq = ring.cqRing;
+    ring.cqHead = (unsigned*)(cq + params->cq_off.head);
+    ring.cqTail = (unsigned*)(cq + params->cq_off.tail);
+    ring.cqMask = (unsigned*)(cq + params->cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+    return 0;
+}
+
+static int registerBuffers(void) {
+    ring.bufferRingSize = URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    ring.bufferRing = mmap(NULL, ring.bufferRingSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring.bufferRing == MAP_FAILED) {
+        ring.bufferRing = NULL;
+        return -1;
+    }
+    
+    ring.buffers = mmap(NULL, URING_BUFFERS_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ring.buffers == MAP_FAILED) {
+        ring.buffers = NULL;
+        return -1;
+    }
+    
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (uint64_t)(uintptr_t)ring.bufferRing;
+    registration.ring_entries = URING_BUFFER_COUNT;
+    registration.bgid = URING_BUFFER_GROUP;
+    
+    if (ioUringRegister(ring.ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        return -1;
+    }
+    
+    ring.bufferTail = 0;
+    for (int i = 0; i < URING_BUFFER_COUNT; i++) {
+        provideBuffer((unsigned short)i);
+    }
+    publishBuffers();
+    return 0;
+}
+
+int uringIngestStart(int sockfd) {
+    if (ring.ringFd >= 0) {
+        errno = EBUSY;
+        return -1;
+    }
+    
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_COMPLETION_DEPTH;
+    
+    ring.ringFd = ioUringSetup(URING_QUEUE_DEPTH, &params);
+    if (ring.ringFd < 0) {
+        ring.ringFd = -1;
+        return -1;
+    }
+    ring.sockfd = sockfd;
+    if (!ring.stats) {
+        int index = __atomic_fetch_add(&ringStatsCount, 1, __ATOMIC_RELAXED);
+        ring.stats = &ringStats[index < URING_MAX_RINGS ? index : URING_MAX_RINGS - 1];
+    }
+    
+    memset(&ring.messageTemplate, 0, sizeof(ring.messageTemplate));
+    ring.messageTemplate.msg_namelen = sizeof(struct sockaddr_in);
+    ring.messageTemplate.msg_controllen = SOCKET_CONTROL_SIZE;
+    
+    if (mapRings(&params) < 0 || registerBuffers() < 0 || armReceive() < 0) {
+        int savedErrno = errno;
+        uringIngestStop();
+        errno = savedErrno;
+        return -1;
+    }
+    
+    return ring.ringFd;
+}
+
+void uringIngestStop(void) {
+    if (ring.ringFd < 0) return;
+    
+    // Closing the ring cancels the multishot receive and drops the
+    // buffer ring registration
+    close(ring.ringFd);
+    ring.ringFd = -1;
+    ring.armed = 0;
+    
+    if (ring.sqes) munmap(ring.sqes, ring.sqesSize);
+    if (ring.cqRing && ring.cqRing != ring.sqRing) munmap(ring.cqRing, ring.cqRingSize);
+    if (ring.sqRing) munmap(ring.sqRing, ring.sqRingSize);
+    if (ring.bufferRing) munmap(ring.bufferRing, ring.bufferRingSize);
+    if (ring.buffers) munmap(ring.buffers, URING_BUFFERS_SIZE);
+    
+    ring.sqes = NULL;
+    ring.cqRing = NULL;
+    ring.sqRing = NULL;
+    ring.bufferRing = NULL;
+    ring.buffers = NULL;
+}
+
+int uringIngestActive(void) {
+    return ring.ringFd >= 0;
+}
+
+static void handleCompletion(const struct io_uring_cqe* cqe) {
+    statAdd(&ring.stats->completions);
+    
+    // Without F_MORE the multishot receive has ended and must be resubmitted
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        ring.armed = 0;
+    }
+    
+    if (cqe->res < 0) {
+        if (cqe->res == -ENOBUFS) {
+            statAdd(&ring.stats->bufferStarved);
+        } else if (cqe->res != -ECANCELED) {
+            fprintf(stderr, "io_uring receive failed: %s\n", strerror(-cqe->res));
+        }
+        return;
+    }
+    
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) return;
+    
+    unsigned short id = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    char* buffer = ring.buffers + (size_t)id * URING_BUFFER_STRIDE;
+    
+    // Provided buffer layout: io_uring_recvmsg_out, source address,
+    // control data, then the payload
+    struct io_uring_recvmsg_out out;
+    memcpy(&out, buffer, sizeof(out));
+    char* name = buffer + sizeof(out);
+    char* control = name + ring.messageTemplate.msg_namelen;
+    char* payload = control + ring.messageTemplate.msg_controllen;
+    
+    // A partial OSC packet would be misparsed; count it and move on
+    size_t available = URING_BUFFER_SIZE - (size_t)(payload - buffer);
+    size_t length = out.payloadlen;
+    if (length > available || (out.flags & MSG_TRUNC)) {
+        metricsRecordTruncated();
+        provideBuffer(id);
+        return;
+    }
+    
+    struct sockaddr_in source;
+    memset(&source, 0, sizeof(source));
+    memcpy(&source, name, out.namelen < sizeof(source) ? out.namelen : sizeof(source));
+    
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_control = control;
+    message.msg_controllen = out.controllen;
+    
+    handleDatagram(payload, length, &source, readControlData(&message));
+    provideBuffer(id);
+}
+
+// Completions and buffer returns go through shared memory; the only
+// syscall is resubmitting the receive after the kernel ends it
+static int reapCompletions(int limit) {
+    unsigned head = *ring.cqHead;
+    unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+    int handled = 0;
+    
+    while (head != tail && handled < limit) {
+        handleCompletion(&ring.cqes[head & *ring.cqMask]);
+        head++;
+        handled++;
+    }
+    
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    publishBuffers();
+    
+    if (!ring.armed && head == __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)) {
+        if (armReceive() < 0) {
+            perror("io_uring resubmit failed");
+        } else {
+            statAdd(&ring.stats->rearms);
+        }
+    }
+    return handled;
+}
+
+void uringIngestDrain(int ringFd, uint32_t events, void* context) {
+    (void)ringFd; (void)events; (void)context;
+    if (ring.ringFd < 0) return;
+    reapCompletions(SOCKET_DRAIN_BATCH);
+}
+
+int uringIngestWait(void) {
+    if (ring.ringFd < 0) return -1;
+    
+    if (reapCompletions(SOCKET_DRAIN_BATCH) > 0) return 0;
+    
+    // Bounded so stopReceiving is noticed on an idle socket: shutdown()
+    // does not end a multishot receive the way it wakes recvmsg
+    struct __kernel_timespec timeout = {0, URING_WAIT_TIMEOUT_MS * 1000000LL};
+    struct io_uring_getevents_arg wait;
+    memset(&wait, 0, sizeof(wait));
+    wait.ts = (uint64_t)(uintptr_t)&timeout;
+    
+    if (ioUringEnter(ring.ringFd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &wait, sizeof(wait)) < 0 &&
+        errno != EINTR && errno != ETIME) {
+        return -1;
+    }
+    reapCompletions(SOCKET_DRAIN_BATCH);
+    return 0;
+}
+
+void uringIngestGetStats(UringIngestStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        stats->completions += __atomic_load_n(&ringStats[i].completions, __ATOMIC_RELAXED);
+        stats->rearms += __atomic_load_n(&ringStats[i].rearms, __ATOMIC_RELAXED);
+        stats->bufferStarved += __atomic_load_n(&ringStats[i].bufferStarved, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef URING_INGEST_H
+#define URING_INGEST_H
+
+#include <stdint.h>
+#include "packetPool.h"
+
+#define URING_QUEUE_DEPTH 8                 // Only the multishot receive is ever queued
+#define URING_COMPLETION_DEPTH 1024         // Completions buffered between drains
+#define URING_BUFFER_COUNT 256              // Provided buffers, power of two
+// recvmsg header, source, control data and a full-size payload. Buffers are
+// mapped lazily, so small datagrams only ever touch their first page
+#define URING_BUFFER_SIZE (PACKET_MAX_DATAGRAM + 256)
+#define URING_BUFFER_GROUP 1
+
+typedef struct {
+    uint64_t completions;
+    uint64_t rearms;                        // Multishot receives resubmitted
+    uint64_t bufferStarved;                 // ENOBUFS: every provided buffer was in use
+} UringIngestStats;
+
+// Each thread owns at most one ring. Sets up the calling thread's ring
+// with a multishot recvmsg on sockfd. Returns the ring fd,
+// which polls readable while completions are pending, or -1 with errno set
+// when io_uring or provided buffer rings are unavailable
+int uringIngestStart(int sockfd);
+void uringIngestStop(void);
+int uringIngestActive(void);
+
+// Event loop callback: handles up to SOCKET_DRAIN_BATCH completions
+void uringIngestDrain(int ringFd, uint32_t events, void* context);
+// Blocks until a completion is available or a short timeout passes, then drains
+int uringIngestWait(void);
+
+// Totals across every ring started so far
+void uringIngestGetStats(UringIngestStats* stats);
+
+#endif